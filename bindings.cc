@@ -0,0 +1,428 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// Python bindings of networks, contraction and graph queries, built as
+// the module tensor_network with pybind11 ("make python").
+//
+// Tensor data is shared with NumPy without copying: Matrix supports the
+// buffer protocol over its row-major storage, and Tensor.array() views
+// that storage with one axis per leg (inputs, then outputs).  Arrays
+// keep the matrix they view alive, so they remain valid after the
+// tensor publishes a new matrix, though they then no longer show its
+// entries.  The views are read-only, since writing through them would
+// change every tensor sharing the storage and bypass version(), on
+// which caches of contractions rely; Tensor.set_array() copies new
+// entries in and publishes them.
+//
+// Contractions release the GIL, so Python threads may contract
+// concurrently under the rules of the concurrency model of Tensor.
+// Misuse which would abort the C++ library, such as legs out of range
+// or links between differing ranks, raises IndexError or ValueError.
+
+#include <complex>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <pybind11/complex.h>
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include "contract.hh"
+#include "graph.hh"
+#include "io.hh"
+#include "matrix.hh"
+#include "network.hh"
+#include "plan.hh"
+#include "plan_cache.hh"
+#include "tensor.hh"
+
+namespace py = pybind11;
+
+using std::complex;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+// A link as seen from Python: (input tensor, input, output tensor,
+// output), with None for a missing tensor.
+typedef std::tuple<Tensor*, size_t, Tensor*, size_t> PyLink;
+
+// ########################### require ###############################
+// Raise IndexError with message unless ok.
+static void require(bool ok, const char *message)
+{
+  if(!ok) throw py::index_error(message);
+}
+
+// ########################### leg_shape #############################
+// One dimension per leg of the tensor whose matrix is m, inputs first.
+static vector<size_t> leg_shape(const MatrixStruct& m)
+{
+  vector<size_t> ret(m.nin, m.inrank);
+  ret.insert(ret.end(), m.nout, m.outrank);
+  return ret;
+}
+
+// ########################### row_strides ###########################
+// Strides in bytes of a row-major array of complex doubles.
+static vector<size_t> row_strides(const vector<size_t>& shape)
+{
+  vector<size_t> ret(shape.size(), sizeof(complex<double>));
+  for(size_t i = shape.size(); i-- > 1;) ret[i-1] = ret[i] * shape[i];
+  return ret;
+}
+
+// ########################### check_legs ############################
+// Check that in and out index an entry of t.
+static void check_legs(Tensor& t, const vector<size_t>& in,
+		       const vector<size_t>& out)
+{
+  require(in.size() == t.inputs() && out.size() == t.outputs(),
+	  "wrong number of legs");
+  for(size_t i : in) require(i < t.input_rank(), "input out of range");
+  for(size_t o : out) require(o < t.output_rank(), "output out of range");
+}
+
+// ########################### check_link ############################
+// Check that input n of a may be linked to output m of b.
+static void check_link(Tensor& a, size_t n, Tensor& b, size_t m)
+{
+  require(n < a.inputs() && m < b.outputs(), "leg out of range");
+  if(a.input_rank() != b.output_rank())
+    throw py::value_error("linked legs have differing ranks");
+}
+
+// ########################### check_edges ###########################
+// Check that edges join existing tensors of net.
+static void check_edges(Network& net, const vector<NetworkEdge>& edges)
+{
+  for(const NetworkEdge &e : edges)
+    {
+      require(e.input_id < net.size() && e.output_id < net.size()
+	      && nullptr != net.tensor(e.input_id)
+	      && nullptr != net.tensor(e.output_id), "tensor out of range");
+      check_link(*net.tensor(e.input_id), e.input_num,
+		 *net.tensor(e.output_id), e.output_num);
+    }
+}
+
+// ########################### tensor_array ##########################
+// View the storage of t as a read-only array with one axis per leg.
+static py::array tensor_array(Tensor& t)
+{
+  MatrixStruct m = t.matrix();
+  if(m.conjugate)
+    throw py::value_error("a conjugate tensor stores its transpose");
+  const vector<size_t> shape = leg_shape(m);
+  // the Python matrix object holds a reference to the storage
+  py::object base = py::cast(m.matrix);
+  py::array ret(py::dtype::of<complex<double>>(), shape,
+		row_strides(shape), m.matrix->data(), base);
+  ret.attr("setflags")(py::arg("write") = false);
+  return ret;
+}
+
+// ########################### set_array #############################
+// Copy a into new storage for t and publish it.  a has one axis per leg
+// or is the matrix itself.
+static void set_array(Tensor& t, py::array_t<complex<double>,
+		      py::array::c_style | py::array::forcecast> a)
+{
+  MatrixStruct m = t.matrix();
+  const vector<size_t> shape = leg_shape(m),
+    given(a.shape(), a.shape() + a.ndim());
+  const size_t rows = m.matrix->rows(), cols = m.matrix->cols();
+  if(m.conjugate || (given != shape && given != vector<size_t>{rows, cols}))
+    throw py::value_error("array does not match the tensor");
+  shared_ptr<Matrix> s = std::make_shared<GSLMatrix>(rows, cols);
+  std::memcpy(s->data(), a.data(), rows * cols * sizeof(complex<double>));
+  t.set_matrix(s);
+}
+
+// ########################### graph_links ###########################
+// Links of an edge iterator range as tuples.
+template <typename Iterator>
+static vector<PyLink> graph_links(Iterator begin, Iterator end)
+{
+  vector<PyLink> ret;
+  for(Iterator i = begin; i != end; ++i)
+    ret.emplace_back(i->input_tensor, i->input_num, i->output_tensor,
+		     i->output_num);
+  return ret;
+}
+
+// ########################### contract_graph ########################
+// Contract every tensor of g, planning with planner ("greedy" or
+// "tree", given seconds to refine).
+static DenseTensor contract_graph(DFSGraph& g, const string& planner,
+				  double seconds)
+{
+  if("greedy" != planner && "tree" != planner)
+    throw py::value_error("planner must be \"greedy\" or \"tree\"");
+  py::gil_scoped_release release;
+  const vector<TensorView> operands = topology_operands(topology(g));
+  const ContractionPlan plan = "tree" == planner
+    ? tree_plan(operands, ELIMINATE_MIN_FILL, seconds)
+    : greedy_plan(operands);
+  return execute(plan, operands);
+}
+
+// ########################### tensor_network ########################
+PYBIND11_MODULE(tensor_network, m)
+{
+  m.doc() = "Tensor networks, their contraction and graph queries.";
+
+  py::class_<Matrix, shared_ptr<Matrix>>(m, "Matrix", py::buffer_protocol())
+    .def("rows", &Matrix::rows)
+    .def("cols", &Matrix::cols)
+    .def_buffer([](Matrix& x)
+		{
+		  const vector<size_t> shape{x.rows(), x.cols()};
+		  return py::buffer_info(x.data(), sizeof(complex<double>),
+					 py::format_descriptor
+					 <complex<double>>::format(), 2,
+					 shape, row_strides(shape), true);
+		});
+
+  py::class_<Tensor>(m, "Tensor")
+    .def(py::init([](size_t nin, size_t nout, size_t inrank, size_t outrank)
+		  -> Tensor*
+		  {
+		    return new ConcreteTensor(nin, nout, inrank, outrank);
+		  }), py::arg("nin"), py::arg("nout"), py::arg("inrank"),
+	 py::arg("outrank"))
+    .def(py::init([](size_t nin, size_t nout, size_t rank) -> Tensor*
+		  {
+		    return new ConcreteTensor(nin, nout, rank);
+		  }), py::arg("nin"), py::arg("nout"), py::arg("rank"))
+    .def("inputs", &Tensor::inputs)
+    .def("outputs", &Tensor::outputs)
+    .def("input_rank", &Tensor::input_rank)
+    .def("output_rank", &Tensor::output_rank)
+    .def("entry", [](Tensor& t, const vector<size_t>& in,
+		     const vector<size_t>& out)
+	 {
+	   check_legs(t, in, out);
+	   return t.entry(in, out);
+	 })
+    .def("set_entry", [](Tensor& t, const vector<size_t>& in,
+			 const vector<size_t>& out, complex<double> val)
+	 {
+	   check_legs(t, in, out);
+	   t.set_entry(in, out, val);
+	 })
+    .def("set_input", [](Tensor& t, size_t n, Tensor *u, size_t k)
+	 {
+	   if(nullptr == u) require(n < t.inputs(), "leg out of range");
+	   else check_link(t, n, *u, k);
+	   t.set_input(n, u, k);
+	 }, py::arg("n"), py::arg("tensor").none(true), py::arg("m") = 0)
+    .def("set_output", [](Tensor& t, size_t n, Tensor *u, size_t k)
+	 {
+	   if(nullptr == u) require(n < t.outputs(), "leg out of range");
+	   else check_link(*u, k, t, n);
+	   t.set_output(n, u, k);
+	 }, py::arg("n"), py::arg("tensor").none(true), py::arg("m") = 0)
+    .def("input_tensor", [](Tensor& t, size_t n)
+	 {
+	   require(n < t.inputs(), "leg out of range");
+	   return t.input_tensor(n);
+	 }, py::return_value_policy::reference)
+    .def("output_tensor", [](Tensor& t, size_t n)
+	 {
+	   require(n < t.outputs(), "leg out of range");
+	   return t.output_tensor(n);
+	 }, py::return_value_policy::reference)
+    .def("input_num", [](Tensor& t, size_t n)
+	 {
+	   require(n < t.inputs(), "leg out of range");
+	   return t.input_num(n);
+	 })
+    .def("output_num", [](Tensor& t, size_t n)
+	 {
+	   require(n < t.outputs(), "leg out of range");
+	   return t.output_num(n);
+	 })
+    .def("matrix", [](Tensor& t) { return t.matrix().matrix; })
+    .def("array", &tensor_array)
+    .def("set_array", &set_array)
+    .def("version", &Tensor::version);
+
+  py::class_<Network>(m, "Network")
+    .def(py::init<>())
+    .def("__len__", &Network::size)
+    .def("size", &Network::size)
+    .def("create", [](Network& net, size_t nin, size_t nout, size_t inrank,
+		      size_t outrank)
+	 {
+	   return static_cast<Tensor*>(net.create(nin, nout, inrank,
+						  outrank));
+	 }, py::return_value_policy::reference_internal)
+    .def("build", [](Network& net,
+		     const vector<std::tuple<size_t, size_t, size_t,
+		     size_t>>& shapes,
+		     const vector<std::tuple<size_t, size_t, size_t,
+		     size_t>>& edges)
+	 {
+	   // edges are checked against a network holding the new tensors
+	   const size_t first = net.size();
+	   vector<NetworkShape> s;
+	   for(const auto &x : shapes)
+	     s.push_back(NetworkShape{std::get<0>(x), std::get<1>(x),
+		   std::get<2>(x), std::get<3>(x)});
+	   vector<NetworkEdge> e;
+	   for(const auto &x : edges)
+	     {
+	       const NetworkEdge edge{std::get<0>(x), std::get<1>(x),
+		   std::get<2>(x), std::get<3>(x)};
+	       require(edge.input_id - first < s.size()
+		       && edge.output_id - first < s.size(),
+		       "tensor out of range");
+	       const NetworkShape &a = s[edge.input_id - first],
+		 &b = s[edge.output_id - first];
+	       require(edge.input_num < a.nin && edge.output_num < b.nout,
+		       "leg out of range");
+	       if(a.inrank != b.outrank)
+		 throw py::value_error("linked legs have differing ranks");
+	       e.push_back(edge);
+	     }
+	   return net.build(s, e);
+	 }, py::arg("shapes"), py::arg("edges"))
+    .def("mera", [](Network& net, size_t sites, size_t depth,
+		    size_t branching, size_t rank)
+	 {
+	   size_t covered = 1;
+	   for(size_t t = 0; t < depth && covered <= sites; ++t)
+	     covered *= branching;
+	   if(branching < 2 || 0 == sites || sites % covered)
+	     throw py::value_error("sites do not tile the layers");
+	   return net.mera(sites, depth, branching, rank);
+	 }, py::arg("sites"), py::arg("depth"), py::arg("branching"),
+	 py::arg("rank"))
+    .def("link", [](Network& net,
+		    const vector<std::tuple<size_t, size_t, size_t,
+		    size_t>>& edges)
+	 {
+	   vector<NetworkEdge> e;
+	   for(const auto &x : edges)
+	     e.push_back(NetworkEdge{std::get<0>(x), std::get<1>(x),
+		   std::get<2>(x), std::get<3>(x)});
+	   check_edges(net, e);
+	   net.link(e);
+	 })
+    .def("tensor", [](Network& net, size_t id)
+	 {
+	   require(id < net.size(), "tensor out of range");
+	   return net.tensor(id);
+	 }, py::return_value_policy::reference_internal)
+    .def("inputs", [](Network& net, size_t id)
+	 {
+	   require(id < net.size(), "tensor out of range");
+	   return net.inputs(id);
+	 })
+    .def("outputs", [](Network& net, size_t id)
+	 {
+	   require(id < net.size(), "tensor out of range");
+	   return net.outputs(id);
+	 })
+    .def("input_id", [](Network& net, size_t id, size_t n)
+	 {
+	   require(id < net.size() && n < net.inputs(id), "leg out of range");
+	   return net.input_id(id, n);
+	 })
+    .def("output_id", [](Network& net, size_t id, size_t n)
+	 {
+	   require(id < net.size() && n < net.outputs(id),
+		   "leg out of range");
+	   return net.output_id(id, n);
+	 })
+    .def("input_num", [](Network& net, size_t id, size_t n)
+	 {
+	   require(id < net.size() && n < net.inputs(id), "leg out of range");
+	   return net.input_num(id, n);
+	 })
+    .def("output_num", [](Network& net, size_t id, size_t n)
+	 {
+	   require(id < net.size() && n < net.outputs(id),
+		   "leg out of range");
+	   return net.output_num(id, n);
+	 })
+    .def("component", [](Network& net, size_t id)
+	 {
+	   require(id < net.size(), "tensor out of range");
+	   return net.component(id);
+	 })
+    .def("tensors", &network_tensors, py::arg("first") = 0,
+	 py::return_value_policy::reference_internal);
+  m.attr("NO_TENSOR") = kNoTensor;
+
+  py::class_<DFSGraph>(m, "DFSGraph")
+    .def(py::init<Tensor*>(), py::keep_alive<1, 2>())
+    .def("vertices", &DFSGraph::vertices)
+    .def("edges", &DFSGraph::edges)
+    .def("tensors", [](DFSGraph& g)
+	 {
+	   return vector<Tensor*>(g.vertex_begin(), g.vertex_end());
+	 }, py::return_value_policy::reference)
+    .def("links", [](DFSGraph& g)
+	 {
+	   return graph_links(g.edge_begin(), g.edge_end());
+	 }, py::return_value_policy::reference)
+    .def("endpoints", [](DFSGraph& g)
+	 {
+	   return graph_links(g.endpt_begin(), g.endpt_end());
+	 }, py::return_value_policy::reference)
+    .def("fingerprint", [](DFSGraph& g) { return topology(g).fingerprint; });
+
+  py::class_<DenseTensor>(m, "DenseTensor", py::buffer_protocol())
+    .def_readonly("dims", &DenseTensor::dims)
+    .def_readonly("labels", &DenseTensor::labels)
+    .def("permuted", &DenseTensor::permuted,
+	 py::call_guard<py::gil_scoped_release>())
+    .def_buffer([](DenseTensor& d)
+		{
+		  return py::buffer_info(d.data.data(),
+					 sizeof(complex<double>),
+					 py::format_descriptor
+					 <complex<double>>::format(),
+					 d.dims.size(), d.dims,
+					 row_strides(d.dims));
+		});
+
+  m.def("contract", [](Tensor *a, Tensor *b)
+	{
+	  if(a == b) throw py::value_error("contract a tensor with another");
+	  py::gil_scoped_release release;
+	  return contract(a, b);
+	}, "Contract two tensors over the links between them.");
+  m.def("contract", &contract_graph, py::arg("graph"),
+	py::arg("planner") = "greedy", py::arg("seconds") = 0,
+	"Contract every tensor of a graph.  The legs of the result are "
+	"its unlinked legs, as left by the plan.");
+
+  m.def("read_edge_list", [](const string& path, Network& net)
+	{
+	  py::gil_scoped_release release;
+	  return read_edge_list(path, net);
+	});
+  m.def("write_edge_list", &write_edge_list,
+	py::call_guard<py::gil_scoped_release>());
+  m.def("read_npz", &read_npz, py::call_guard<py::gil_scoped_release>());
+  m.def("write_npz", &write_npz, py::call_guard<py::gil_scoped_release>());
+}
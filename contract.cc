@@ -0,0 +1,770 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_complex_math.h>
+#include "contract.hh"
+#include "log_msg.hh"
+#include "matrix.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::vector;
+
+// Legs of a pairwise contraction, split into those which survive into
+// the result and those which are summed over.  asum[i] and bsum[i]
+// are the two legs joined by the i-th summed label.
+struct ContractionLegs
+{
+  vector<size_t> afree;
+  vector<size_t> bfree;
+  vector<size_t> asum;
+  vector<size_t> bsum;
+};
+
+// Function signature shared by the instantiations of fused_kernel.
+typedef void (*FusedKernel)(const complex<double> *a,
+			    const complex<double> *b,
+			    const size_t *afree, size_t m,
+			    const size_t *bfree, size_t n,
+			    const size_t *asum, const size_t *bsum, size_t k,
+			    complex<double> *c);
+
+// A matrix operand of zgemm: rows x cols entries stored at data with
+// leading dimension tda, used as op(matrix) according to trans.
+struct GemmOperand
+{
+  const complex<double> *data;
+  CBLAS_TRANSPOSE_t trans;
+  size_t rows;
+  size_t cols;
+  size_t tda;
+};
+
+// The legs and offset tables of the small kernel, kept by each thread
+// for the layouts (dimensions, strides and labels) of the operands
+// they were last built for.  A tiny contraction repeated on operands
+// laid out alike then allocates nothing but its result.
+struct SmallScratch
+{
+  bool cached = false;
+  TensorView a;
+  TensorView b;
+  ContractionLegs legs;
+  vector<size_t> afree;
+  vector<size_t> bfree;
+  vector<size_t> asum;
+  vector<size_t> bsum;
+};
+
+// ########################### small_scratch #########################
+static SmallScratch& small_scratch()
+{
+  thread_local SmallScratch s;
+  return s;
+}
+
+// ########################### classify_legs #########################
+// Fill legs, reusing its storage.
+static void classify_legs(const TensorView& a, const TensorView& b,
+			  ContractionLegs& legs)
+{
+  legs.afree.clear();
+  legs.bfree.clear();
+  legs.asum.clear();
+  legs.bsum.clear();
+
+  for(size_t i = 0; i < a.labels.size(); ++i)
+    {
+#ifndef NO_ERROR_CHECKING
+      // repeated labels on one operand would describe a trace
+      for(size_t j = 0; j < i; ++j)
+	if(a.labels[i] == a.labels[j])
+	  LOG_MSG_(FATAL) << kErrIncompatible << "label " << a.labels[i] <<
+	    " appears twice on one operand of contract()";
+#endif // NO_ERROR_CHECKING
+
+      size_t j = 0;
+      while(j < b.labels.size() && b.labels[j] != a.labels[i]) ++j;
+      if(j == b.labels.size())
+	{
+	  legs.afree.push_back(i);
+	  continue;
+	}
+
+#ifndef NO_ERROR_CHECKING
+      // summed legs must belong to the same vector space
+      if(a.dims[i] != b.dims[j])
+	LOG_MSG_(FATAL) << kErrIncompatible << "label " << a.labels[i] <<
+	  " joins legs of differing dimension in contract(): " <<
+	  a.dims[i] << " and " << b.dims[j];
+#endif // NO_ERROR_CHECKING
+
+      legs.asum.push_back(i);
+      legs.bsum.push_back(j);
+    }
+
+  for(size_t j = 0; j < b.labels.size(); ++j)
+    {
+#ifndef NO_ERROR_CHECKING
+      for(size_t i = 0; i < j; ++i)
+	if(b.labels[i] == b.labels[j])
+	  LOG_MSG_(FATAL) << kErrIncompatible << "label " << b.labels[j] <<
+	    " appears twice on one operand of contract()";
+#endif // NO_ERROR_CHECKING
+      if(std::find(legs.bsum.begin(), legs.bsum.end(), j) == legs.bsum.end())
+	legs.bfree.push_back(j);
+    }
+}
+
+// ########################### extent ################################
+// Product of the dimensions of the given legs of v.
+static size_t extent(const TensorView& v, const vector<size_t>& legs)
+{
+  size_t n = 1;
+  for(size_t l : legs) n *= v.dims[l];
+  return n;
+}
+
+// ########################### follows ###############################
+// Whether leg q of v directly follows leg p in memory, so that the two
+// can be indexed as a single leg.  Legs of dimension 1 follow anything.
+static bool follows(const TensorView& v, size_t p, size_t q)
+{
+  return 1 == v.dims[p] || 1 == v.dims[q]
+    || v.strides[p] == v.dims[q] * v.strides[q];
+}
+
+// ########################### merge #################################
+// Fold leg q of v into leg p, which it follows.  Leg q is left in
+// place but must no longer be referred to.
+static void merge(TensorView& v, size_t p, size_t q)
+{
+  if(1 != v.dims[q]) v.strides[p] = v.strides[q];
+  v.dims[p] *= v.dims[q];
+}
+
+// ########################### fuse_free #############################
+// Fuse consecutive free legs of v which follow one another.
+static void fuse_free(TensorView& v, vector<size_t>& free)
+{
+  for(size_t k = 0; k + 1 < free.size(); )
+    if(follows(v, free[k], free[k + 1]))
+      {
+	merge(v, free[k], free[k + 1]);
+	free.erase(free.begin() + k + 1);
+      }
+    else
+      ++k;
+}
+
+// ########################### fuse_legs #############################
+// Fuse legs of a and b which travel together: summed legs laid out
+// alike in both operands, and consecutive free legs of one operand.
+// Free legs keep their order, so the layout of the result is the same
+// as without fusion.  The fused legs are removed from legs.
+static void fuse_legs(TensorView& a, TensorView& b, ContractionLegs& legs)
+{
+  vector<size_t> &as = legs.asum, &bs = legs.bsum;
+  for(size_t i = 0; i < as.size(); )
+    {
+      bool merged = false;
+      for(size_t j = 0; j < as.size() && !merged; ++j)
+	if(i != j && follows(a, as[i], as[j]) && follows(b, bs[i], bs[j]))
+	  {
+	    merge(a, as[i], as[j]);
+	    merge(b, bs[i], bs[j]);
+	    as.erase(as.begin() + j);
+	    bs.erase(bs.begin() + j);
+	    if(j < i) --i;
+	    merged = true;
+	  }
+      // a merged leg may now be followed by another
+      if(!merged) ++i;
+    }
+
+  fuse_free(a, legs.afree);
+  fuse_free(b, legs.bfree);
+}
+
+// ########################### leg_offsets ###########################
+// Tabulate the offset into v.data of every combination of indices on
+// the given legs, in row-major order over legs, into ret.  This table
+// is what the kernels below interpret in place of generated loop
+// nests.
+static void leg_offsets(const TensorView& v, const vector<size_t>& legs,
+			vector<size_t>& ret)
+{
+  size_t n = 1;
+  for(size_t l : legs) n *= v.dims[l];
+  ret.assign(n, 0);
+  if(0 == n) return;
+
+  // Expand the table one leg at a time.  Working backwards allows the
+  // expansion to be done in place.
+  size_t filled = 1;
+  for(size_t l : legs)
+    {
+      const size_t d = v.dims[l], s = v.strides[l];
+      for(size_t t = filled; t-- > 0; )
+	for(size_t i = d; i-- > 0; )
+	  ret[t*d + i] = ret[t] + i*s;
+      filled *= d;
+    }
+}
+
+static vector<size_t> leg_offsets(const TensorView& v,
+				  const vector<size_t>& legs)
+{
+  vector<size_t> ret;
+  leg_offsets(v, legs, ret);
+  return ret;
+}
+
+// ########################### make_result ###########################
+// Shape ret as the zeroed result, reusing its storage, so that a new
+// tensor takes one allocation per member.
+static void make_result(const TensorView& a, const TensorView& b,
+			const ContractionLegs& legs, DenseTensor& ret)
+{
+  ret.dims.clear();
+  ret.labels.clear();
+  const size_t rank = legs.afree.size() + legs.bfree.size();
+  ret.dims.reserve(rank);
+  ret.labels.reserve(rank);
+  for(size_t l : legs.afree)
+    {
+      ret.dims.push_back(a.dims[l]);
+      ret.labels.push_back(a.labels[l]);
+    }
+  for(size_t l : legs.bfree)
+    {
+      ret.dims.push_back(b.dims[l]);
+      ret.labels.push_back(b.labels[l]);
+    }
+  size_t n = 1;
+  for(size_t d : ret.dims) n *= d;
+  ret.data.assign(n, complex<double>{});
+}
+
+static DenseTensor make_result(const TensorView& a, const TensorView& b,
+			       const ContractionLegs& legs)
+{
+  DenseTensor ret;
+  make_result(a, b, legs, ret);
+  return ret;
+}
+
+// ########################### fused_kernel ##########################
+// Direct evaluation of c[i][j] = sum_l a[afree[i]+asum[l]] *
+// b[bfree[j]+bsum[l]].  The conjugation flags are template parameters
+// so that the inner loop is branch-free, and the arithmetic is
+// written out by hand to avoid the NaN recovery performed by
+// std::complex multiplication.
+template <bool ConjA, bool ConjB>
+static void fused_kernel(const complex<double> *a, const complex<double> *b,
+			 const size_t *afree, size_t m,
+			 const size_t *bfree, size_t n,
+			 const size_t *asum, const size_t *bsum, size_t k,
+			 complex<double> *c)
+{
+  const double sa = ConjA ? -1.0 : 1.0, sb = ConjB ? -1.0 : 1.0;
+  for(size_t i = 0; i < m; ++i)
+    for(size_t j = 0; j < n; ++j)
+      {
+	const complex<double> *ap = a + afree[i], *bp = b + bfree[j];
+	double re = 0, im = 0;
+	for(size_t l = 0; l < k; ++l)
+	  {
+	    const complex<double> x = ap[asum[l]], y = bp[bsum[l]];
+	    const double xi = sa * x.imag(), yi = sb * y.imag();
+	    re += x.real() * y.real() - xi * yi;
+	    im += x.real() * yi + xi * y.real();
+	  }
+	c[i*n + j] = complex<double>{re, im};
+      }
+}
+
+// Table of kernels, indexed by the conjugation flags of the operands.
+static const FusedKernel fused_kernels[2][2] = {
+  { fused_kernel<false, false>, fused_kernel<false, true> },
+  { fused_kernel<true, false>, fused_kernel<true, true> }
+};
+
+// ########################### gather ################################
+// Pack the entries of v into a dense row-major (rows x cols) buffer,
+// applying complex conjugation if required.
+static void gather(const TensorView& v, const vector<size_t>& rows,
+		   const vector<size_t>& cols, complex<double> *buf)
+{
+  for(size_t i = 0; i < rows.size(); ++i)
+    {
+      const complex<double> *p = v.data + rows[i];
+      complex<double> *q = buf + i*cols.size();
+      if(v.conjugate)
+	for(size_t j = 0; j < cols.size(); ++j)
+	  q[j] = std::conj(p[cols[j]]);
+      else
+	for(size_t j = 0; j < cols.size(); ++j)
+	  q[j] = p[cols[j]];
+    }
+}
+
+// ########################### same_layout ###########################
+static bool same_layout(const TensorView& x, const TensorView& y)
+{
+  return x.dims == y.dims && x.strides == y.strides && x.labels == y.labels;
+}
+
+// ########################### small_tables ##########################
+// The legs and offset tables for a and b, built in the scratch space
+// of the thread unless it already holds them.
+static const SmallScratch& small_tables(const TensorView& a,
+					const TensorView& b)
+{
+  SmallScratch &s = small_scratch();
+  if(s.cached && same_layout(s.a, a) && same_layout(s.b, b)) return s;
+
+  // storage is reused, so nothing is allocated once it is large enough
+  s.cached = false;
+  classify_legs(a, b, s.legs);
+  leg_offsets(a, s.legs.afree, s.afree);
+  leg_offsets(b, s.legs.bfree, s.bfree);
+  leg_offsets(a, s.legs.asum, s.asum);
+  leg_offsets(b, s.legs.bsum, s.bsum);
+  s.a.dims = a.dims;
+  s.a.strides = a.strides;
+  s.a.labels = a.labels;
+  s.b.dims = b.dims;
+  s.b.strides = b.strides;
+  s.b.labels = b.labels;
+  s.cached = true;
+  return s;
+}
+
+// ########################### small_kernel ##########################
+static void small_kernel(const TensorView& a, const TensorView& b,
+			 DenseTensor& ret)
+{
+  const SmallScratch &s = small_tables(a, b);
+  make_result(a, b, s.legs, ret);
+  if(ret.data.empty()) return;
+
+  fused_kernels[a.conjugate][b.conjugate]
+    (a.data, b.data, s.afree.data(), s.afree.size(), s.bfree.data(),
+     s.bfree.size(), s.asum.data(), s.bsum.data(), s.asum.size(),
+     ret.data.data());
+}
+
+static DenseTensor small_kernel(const TensorView& a, const TensorView& b)
+{
+  DenseTensor ret;
+  small_kernel(a, b, ret);
+  return ret;
+}
+
+// ########################### gemm_operand ##########################
+// Describe v, with the given legs as rows and columns, as a zgemm
+// operand read in place, which is possible if each side has at most
+// one leg and one side is contiguous.  Conjugate views can only be
+// read in place when stored transposed.
+static bool gemm_operand(const TensorView& v, const vector<size_t>& rows,
+			 const vector<size_t>& cols, GemmOperand& op)
+{
+  if(rows.size() > 1 || cols.size() > 1) return false;
+  const size_t m = extent(v, rows), n = extent(v, cols);
+  // strides of the two sides, zero if they have a single index
+  const size_t rs = 1 == m ? 0 : v.strides[rows[0]];
+  const size_t cs = 1 == n ? 0 : v.strides[cols[0]];
+
+  if(!v.conjugate && cs <= 1 && (0 == rs || rs >= n))
+    op = GemmOperand{v.data, CblasNoTrans, m, n, 0 == rs ? n : rs};
+  else if(rs <= 1 && (0 == cs || cs >= m))
+    op = GemmOperand{v.data, v.conjugate ? CblasConjTrans : CblasTrans,
+		     n, m, 0 == cs ? m : cs};
+  else
+    return false;
+  return true;
+}
+
+// ########################### gemm_kernel ###########################
+static DenseTensor gemm_kernel(const TensorView& a, const TensorView& b,
+			       const ContractionLegs& legs)
+{
+  DenseTensor ret = make_result(a, b, legs);
+  const size_t m = extent(a, legs.afree), n = extent(b, legs.bfree),
+    k = extent(a, legs.asum);
+  // an empty sum leaves the zero-initialized result in place
+  if(0 == m || 0 == n || 0 == k) return ret;
+
+  // The result, whose legs are the free legs of a followed by those of
+  // b, is the row-major product of a (m x k) and b (k x n).  Operands
+  // which are already strided matrices, as fused operands often are,
+  // are read in place; others are packed first.
+  GemmOperand ga, gb;
+  vector<complex<double>> abuf, bbuf;
+  if(!gemm_operand(a, legs.afree, legs.asum, ga))
+    {
+      abuf.resize(m*k);
+      gather(a, leg_offsets(a, legs.afree), leg_offsets(a, legs.asum),
+	     abuf.data());
+      ga = GemmOperand{abuf.data(), CblasNoTrans, m, k, k};
+    }
+  if(!gemm_operand(b, legs.bsum, legs.bfree, gb))
+    {
+      bbuf.resize(k*n);
+      gather(b, leg_offsets(b, legs.bsum), leg_offsets(b, legs.bfree),
+	     bbuf.data());
+      gb = GemmOperand{bbuf.data(), CblasNoTrans, k, n, n};
+    }
+
+  gsl_matrix_complex_const_view av =
+    gsl_matrix_complex_const_view_array_with_tda
+    (reinterpret_cast<const double*>(ga.data), ga.rows, ga.cols, ga.tda);
+  gsl_matrix_complex_const_view bv =
+    gsl_matrix_complex_const_view_array_with_tda
+    (reinterpret_cast<const double*>(gb.data), gb.rows, gb.cols, gb.tda);
+  gsl_matrix_complex_view cv = gsl_matrix_complex_view_array
+    (reinterpret_cast<double*>(ret.data.data()), m, n);
+  gsl_blas_zgemm(ga.trans, gb.trans, GSL_COMPLEX_ONE,
+		 &av.matrix, &bv.matrix, GSL_COMPLEX_ZERO, &cv.matrix);
+  return ret;
+}
+
+// ########################### fuse_and_contract #####################
+// Contract a and b with the GEMM kernel after fusing their legs, then
+// restore the legs of the result, whose layout fusion leaves
+// unchanged.
+static DenseTensor fuse_and_contract(const TensorView& a,
+				     const TensorView& b, ContractionLegs legs)
+{
+  vector<size_t> dims, labels;
+  for(size_t l : legs.afree)
+    {
+      dims.push_back(a.dims[l]);
+      labels.push_back(a.labels[l]);
+    }
+  for(size_t l : legs.bfree)
+    {
+      dims.push_back(b.dims[l]);
+      labels.push_back(b.labels[l]);
+    }
+
+  TensorView fa = a, fb = b;
+  fuse_legs(fa, fb, legs);
+  DenseTensor ret = gemm_kernel(fa, fb, legs);
+  ret.dims.swap(dims);
+  ret.labels.swap(labels);
+  return ret;
+}
+
+// ########################### contract_identity #####################
+// Contract an identity view with an ordinary one, x.  When every pair
+// of legs joined by the identity has exactly one leg summed against x,
+// the result is x with those legs renamed to their partners, reordered
+// and scaled, and is gathered without arithmetic.  Returns false
+// otherwise.
+static bool contract_identity(const TensorView& a, const TensorView& b,
+			      const ContractionLegs& legs, DenseTensor& ret)
+{
+  const TensorView &id = a.identity ? a : b, &x = a.identity ? b : a;
+  const size_t n = id.dims.size() / 2;
+
+  // the leg of x reached through each free leg of the identity
+  vector<size_t> reached(id.dims.size());
+  for(size_t k = 0; k < n; ++k)
+    {
+      size_t in = 0, out = 0;
+      while(in < x.labels.size() && x.labels[in] != id.labels[k]) ++in;
+      while(out < x.labels.size() && x.labels[out] != id.labels[k + n])
+	++out;
+      const bool insum = in < x.labels.size(), outsum = out < x.labels.size();
+      if(insum == outsum) return false;
+      if(insum)
+	reached[k + n] = in;
+      else
+	reached[k] = out;
+    }
+
+  // free legs of a, then of b
+  TensorView y{x.data, x.conjugate, {}, {}, {}, false, 0};
+  const vector<size_t> &afree = legs.afree, &bfree = legs.bfree;
+  for(size_t side = 0; side < 2; ++side)
+    for(size_t l : 0 == side ? afree : bfree)
+      {
+	const bool ofid = (0 == side) == a.identity;
+	const size_t leg = ofid ? reached[l] : l;
+	y.dims.push_back(x.dims[leg]);
+	y.strides.push_back(x.strides[leg]);
+	y.labels.push_back(ofid ? id.labels[l] : x.labels[l]);
+      }
+
+  ret = to_dense(y);
+  if(complex<double>{1} != id.scale)
+    for(complex<double> &c : ret.data) c *= id.scale;
+  return true;
+}
+
+// ########################### TensorView ############################
+// ########################### size ##################################
+size_t TensorView::size() const
+{
+  size_t n = 1;
+  for(size_t d : dims) n *= d;
+  return n;
+}
+
+// ########################### DenseTensor ###########################
+// ########################### constructor ###########################
+DenseTensor::DenseTensor(const vector<size_t>& d, const vector<size_t>& l)
+  : dims(d), labels(l)
+{
+#ifndef NO_ERROR_CHECKING
+  if(dims.size() != labels.size())
+    LOG_MSG_(FATAL) << kErrListLength << "DenseTensor constructed with " <<
+      dims.size() << " dimensions but " << labels.size() << " labels";
+#endif // NO_ERROR_CHECKING
+
+  size_t n = 1;
+  for(size_t i : dims) n *= i;
+  data.assign(n, complex<double>{});
+}
+
+// ########################### view ##################################
+TensorView DenseTensor::view() const
+{
+  vector<size_t> strides(dims.size());
+  size_t s = 1;
+  for(size_t i = dims.size(); i-- > 0; )
+    {
+      strides[i] = s;
+      s *= dims[i];
+    }
+  return TensorView{data.data(), false, dims, strides, labels, false, 0};
+}
+
+// ########################### permuted ##############################
+DenseTensor DenseTensor::permuted(const vector<size_t>& l) const
+{
+#ifndef NO_ERROR_CHECKING
+  if(l.size() != labels.size())
+    LOG_MSG_(FATAL) << kErrListLength << "argument of "
+      "DenseTensor::permuted(): expected length " << labels.size() <<
+      " but detected " << l.size();
+#endif // NO_ERROR_CHECKING
+
+  // locate each requested label among the current legs
+  vector<size_t> legs(l.size()), d(l.size());
+  for(size_t i = 0; i < l.size(); ++i)
+    {
+      size_t j = 0;
+      while(j < labels.size() && labels[j] != l[i]) ++j;
+#ifndef NO_ERROR_CHECKING
+      if(j == labels.size())
+	LOG_MSG_(FATAL) << kErrIncompatible << "argument of "
+	  "DenseTensor::permuted(): label " << l[i] << " not present";
+#endif // NO_ERROR_CHECKING
+      legs[i] = j;
+      d[i] = dims[j];
+    }
+
+  DenseTensor ret{d, l};
+  vector<size_t> offsets = leg_offsets(view(), legs);
+  for(size_t i = 0; i < offsets.size(); ++i)
+    ret.data[i] = data[offsets[i]];
+  return ret;
+}
+
+// ###################################################################
+
+// ########################### tensor_view ###########################
+TensorView tensor_view(Tensor *t, const vector<size_t>& in,
+		       const vector<size_t>& out)
+{
+  return tensor_view(t->matrix(), in, out);
+}
+
+TensorView tensor_view(const MatrixStruct& m, const vector<size_t>& in,
+		       const vector<size_t>& out)
+{
+#ifndef NO_ERROR_CHECKING
+  // guard against wrongly-sized label lists
+  if(in.size() != m.nin || out.size() != m.nout)
+    LOG_MSG_(FATAL) << kErrListLength << "arguments of tensor_view(): "
+      "expected lengths " << m.nin << " and " << m.nout <<
+      " but detected " << in.size() << " and " << out.size();
+#endif // NO_ERROR_CHECKING
+
+  TensorView v;
+  v.conjugate = m.conjugate;
+  v.labels = in;
+  v.labels.insert(v.labels.end(), out.begin(), out.end());
+  v.dims.assign(m.nin, m.inrank);
+  v.dims.insert(v.dims.end(), m.nout, m.outrank);
+  v.strides.resize(m.nin + m.nout);
+
+  // Strides follow the packing of ConcreteTensor::_pack_input() and
+  // _pack_output().  For a conjugate tensor the underlying matrix is
+  // transposed, so the outputs select the row instead of the inputs.
+  size_t s = 1;
+  if(!m.conjugate)
+    {
+      for(size_t i = m.nout; i-- > 0; s *= m.outrank)
+	v.strides[m.nin + i] = s;
+      for(size_t i = m.nin; i-- > 0; s *= m.inrank)
+	v.strides[i] = s;
+    }
+  else
+    {
+      for(size_t i = m.nin; i-- > 0; s *= m.inrank)
+	v.strides[i] = s;
+      for(size_t i = m.nout; i-- > 0; s *= m.outrank)
+	v.strides[m.nin + i] = s;
+    }
+
+  // read an implicit identity without storing it
+  complex<double> scale;
+  v.identity = nullptr != m.matrix && m.nin == m.nout
+    && m.inrank == m.outrank && m.matrix->scaled_identity(scale);
+  if(v.identity)
+    {
+      v.data = nullptr;
+      v.conjugate = false;
+      v.scale = m.conjugate ? std::conj(scale) : scale;
+    }
+  else
+    v.data = nullptr != m.matrix ? m.matrix->data() : nullptr;
+
+  return v;
+}
+
+// ########################### to_dense ##############################
+DenseTensor to_dense(const TensorView& v)
+{
+  DenseTensor ret{v.dims, v.labels};
+  if(v.identity)
+    {
+      // Set the diagonal, where leg i and leg i + n agree: indexing
+      // only the first n legs, each steps along both.
+      const size_t n = v.dims.size() / 2;
+      TensorView diagonal = ret.view();
+      for(size_t i = 0; i < n; ++i)
+	diagonal.strides[i] += diagonal.strides[i + n];
+      diagonal.dims.resize(n);
+      diagonal.strides.resize(n);
+      vector<size_t> legs(n);
+      for(size_t i = 0; i < n; ++i) legs[i] = i;
+      for(size_t offset : leg_offsets(diagonal, legs))
+	ret.data[offset] = v.scale;
+      return ret;
+    }
+
+  vector<size_t> legs(v.dims.size());
+  for(size_t i = 0; i < legs.size(); ++i) legs[i] = i;
+
+  vector<size_t> offsets = leg_offsets(v, legs);
+  for(size_t i = 0; i < offsets.size(); ++i)
+    ret.data[i] = v.conjugate ? std::conj(v.data[offsets[i]])
+      : v.data[offsets[i]];
+  return ret;
+}
+
+// ########################### contract ##############################
+DenseTensor contract(const TensorView& a, const TensorView& b)
+{
+  if(a.identity || b.identity)
+    {
+      ContractionLegs legs;
+      classify_legs(a, b, legs);
+      DenseTensor ret;
+      if(!a.identity || !b.identity)
+	if(contract_identity(a, b, legs, ret)) return ret;
+      // otherwise store one identity and try again
+      DenseTensor d = to_dense(a.identity ? a : b);
+      return a.identity ? contract(d.view(), b) : contract(a, d.view());
+    }
+
+  // Total work is the product of all distinct leg dimensions, which
+  // is the size of a times the free dimensions of b.  It is found
+  // before classifying the legs, which the small kernel may not need.
+  size_t work = a.size();
+  for(size_t j = 0; j < b.labels.size(); ++j)
+    if(std::find(a.labels.begin(), a.labels.end(), b.labels[j])
+       == a.labels.end())
+      work *= b.dims[j];
+
+  // The loop kernel indexes every leg through its tables, which fusion
+  // would not shorten.
+  if(work <= kSmallContraction) return small_kernel(a, b);
+  ContractionLegs legs;
+  classify_legs(a, b, legs);
+  return fuse_and_contract(a, b, legs);
+}
+
+DenseTensor contract(Tensor *a, Tensor *b)
+{
+#ifndef NO_ERROR_CHECKING
+  if(a == b)
+    LOG_MSG_(FATAL) << kErrIncompatible << "contract() called with the "
+      "same tensor as both arguments";
+#endif // NO_ERROR_CHECKING
+
+  const size_t nin = a->inputs(), nout = a->outputs();
+  vector<size_t> ain(nin), aout(nout), bin(b->inputs()), bout(b->outputs());
+  size_t label = 0;
+  for(size_t &l : ain) l = label++;
+  for(size_t &l : aout) l = label++;
+  for(size_t &l : bin) l = label++;
+  for(size_t &l : bout) l = label++;
+
+  // legs of b which are linked to a take the label of the matching leg
+  for(size_t i = 0; i < nin; ++i)
+    if(a->input_tensor(i) == b)
+      bout[a->input_num(i)] = ain[i];
+  for(size_t i = 0; i < nout; ++i)
+    if(a->output_tensor(i) == b)
+      bin[a->output_num(i)] = aout[i];
+
+  return contract(tensor_view(a, ain, aout), tensor_view(b, bin, bout));
+}
+
+// ########################### contract_small ########################
+DenseTensor contract_small(const TensorView& a, const TensorView& b)
+{
+  if(a.identity) return contract_small(to_dense(a).view(), b);
+  if(b.identity) return contract_small(a, to_dense(b).view());
+  return small_kernel(a, b);
+}
+
+void contract_small(const TensorView& a, const TensorView& b,
+		    DenseTensor& ret)
+{
+  if(a.identity) return contract_small(to_dense(a).view(), b, ret);
+  if(b.identity) return contract_small(a, to_dense(b).view(), ret);
+  small_kernel(a, b, ret);
+}
+
+// ########################### contract_gemm #########################
+DenseTensor contract_gemm(const TensorView& a, const TensorView& b)
+{
+  if(a.identity) return contract_gemm(to_dense(a).view(), b);
+  if(b.identity) return contract_gemm(a, to_dense(b).view());
+  ContractionLegs legs;
+  classify_legs(a, b, legs);
+  return fuse_and_contract(a, b, legs);
+}
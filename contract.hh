@@ -0,0 +1,120 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// contraction of pairs of tensors
+
+#pragma once
+
+#include <complex>
+#include <string>
+#include <vector>
+
+// forward declare to avoid dependencies between headers
+class IndexedTensor;
+class Tensor;
+struct MatrixStruct;
+
+// Contractions whose total work (product of the dimensions of all
+// distinct legs) is at most this size are evaluated by the fused loop
+// kernel rather than being packed into matrices for a GEMM call.  For
+// tiny tensors the packing and the BLAS call overhead dominate.
+const size_t kSmallContraction = 4096;
+
+// A non-owning view of tensor data, as seen by the contraction
+// kernels.  Entry (i_0, i_1, ...) is located at
+// data[i_0*strides[0] + i_1*strides[1] + ...], and is complex
+// conjugated if conjugate is set.  Each leg carries a label; when two
+// views are contracted, legs sharing a label are summed over.
+//
+// If identity is set the view has no data: it is scale times the
+// identity joining leg i to leg i + n of its 2n legs, as viewed from a
+// matrix which was never stored.  contract() reduces contractions
+// with such a view to renaming legs of the other operand.
+struct TensorView
+{
+  const std::complex<double> *data;
+  bool conjugate;
+  std::vector<size_t> dims;
+  std::vector<size_t> strides;
+  std::vector<size_t> labels;
+  bool identity;
+  std::complex<double> scale;
+  // Total number of entries.
+  size_t size() const;
+};
+
+// A dense tensor with labelled legs, stored in row-major order (the
+// last leg varies fastest).  Used to hold the results of
+// contractions, whose legs need not share a common vector space rank.
+struct DenseTensor
+{
+  std::vector<size_t> dims;
+  std::vector<size_t> labels;
+  std::vector<std::complex<double>> data;
+  // Create a zeroed tensor of the given shape.
+  DenseTensor() = default;
+  DenseTensor(const std::vector<size_t>& d, const std::vector<size_t>& l);
+  // View of the data, valid for the lifetime of this object.
+  TensorView view() const;
+  // Copy of this tensor with legs reordered to match labels.
+  DenseTensor permuted(const std::vector<size_t>& l) const;
+  // Index the legs with one character each, for the expressions of
+  // einsum.hh.
+  IndexedTensor operator()(const std::string& indices);
+  IndexedTensor operator()(const std::string& indices) const;
+};
+
+// View the data of a tensor, labelling input n with in[n] and output
+// n with out[n].  The tensor must outlive the view.  A tensor with as
+// many inputs as outputs whose matrix is a ScaledIdentityMatrix not
+// yet stored gives an identity view, and is not allocated.
+TensorView tensor_view(Tensor *t, const std::vector<size_t>& in,
+		       const std::vector<size_t>& out);
+TensorView tensor_view(const MatrixStruct& m, const std::vector<size_t>& in,
+		       const std::vector<size_t>& out);
+// Copy the data of a view into a dense tensor with the same legs.
+DenseTensor to_dense(const TensorView& v);
+
+// Contract two views over all legs whose labels they share.  The
+// result has the free legs of a followed by the free legs of b, each
+// in their original order.  The fused loop kernel is chosen for
+// contractions of at most kSmallContraction work, and the GEMM kernel
+// otherwise.  The loop kernel reads operands through tables of
+// offsets, which each thread keeps for the layouts it last saw, so
+// that a tiny contraction repeated on operands laid out alike
+// allocates only its result.  For the GEMM kernel, legs which travel
+// together -- summed legs laid out alike in both views, or
+// consecutive free legs of one view adjacent in memory -- are first
+// fused into single legs, so that it can often read its operands in
+// place.
+DenseTensor contract(const TensorView& a, const TensorView& b);
+// The two kernels, exposed so they may be used or tested directly.
+// contract_small() does not fuse legs, while contract_gemm() fuses
+// them as contract() does.
+DenseTensor contract_small(const TensorView& a, const TensorView& b);
+// As contract_small(), into ret, whose storage is reused: a contraction
+// repeated on operands of the same shapes allocates nothing.  ret must
+// not be viewed by a or b.
+void contract_small(const TensorView& a, const TensorView& b,
+		    DenseTensor& ret);
+DenseTensor contract_gemm(const TensorView& a, const TensorView& b);
+// Contract two distinct tensors over the links connecting them.  The
+// legs of a are labelled 0, 1, ... (inputs before outputs), and the
+// unlinked legs of b continue the numbering in the same way, so the
+// result has the unlinked legs of a followed by those of b.  Links of
+// a tensor to itself are not traced over.
+DenseTensor contract(Tensor *a, Tensor *b);
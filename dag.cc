@@ -0,0 +1,315 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include "dag.hh"
+#include "log_msg.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::make_pair;
+using std::pair;
+using std::vector;
+
+// A node of the graph as reached while adding a network: its number
+// and the labels its legs carry in that network.
+struct DagOperand
+{
+  size_t node;
+  vector<size_t> labels;
+};
+
+// ########################### ContractionDag ########################
+// ########################### constructor ###########################
+ContractionDag::ContractionDag(bool retain, double capacity)
+  : _retain{retain}, _capacity{capacity}, _clock{0}, _computed{0}
+{
+}
+
+// ########################### add ###################################
+size_t ContractionDag::add(const vector<TensorView>& operands,
+			   const ContractionPlan& plan,
+			   const vector<Tensor*>& tensors)
+{
+  const size_t n = operands.size();
+
+#ifndef NO_ERROR_CHECKING
+  if(operands.empty() || plan.steps.size() + 1 != n)
+    LOG_MSG_(FATAL) << kErrListLength << "plan passed to "
+      "ContractionDag::add() has " << plan.steps.size() << " steps for "
+      << n << " operands";
+  if(!tensors.empty() && tensors.size() != n)
+    LOG_MSG_(FATAL) << kErrListLength << "ContractionDag::add() given " <<
+      tensors.size() << " tensors for " << n << " operands";
+#endif // NO_ERROR_CHECKING
+
+  vector<DagOperand> items;
+  items.reserve(n + plan.steps.size());
+  for(size_t i = 0; i < n; ++i)
+    {
+      const TensorView &v = operands[i];
+      Tensor *t = tensors.empty() ? nullptr : tensors[i];
+      LeafKey key{v.data, v.conjugate, v.dims, v.strides, v.identity,
+	  v.scale.real(), v.scale.imag()};
+      auto entry = _leaves.emplace(key, _nodes.size());
+      const size_t leaf = entry.first->second;
+      if(entry.second)
+	{
+	  _nodes.push_back(Node{kNoNode, kNoNode, {}, v, {}, {}});
+	  _results.emplace_back();
+	  _ready.push_back(false);
+	  _used.push_back(0);
+	}
+      else
+	_nodes[leaf].leaf = v;
+
+      // Only a retaining graph keeps results to discard, and only its
+      // tensors need outlive it.  A change to any tensor recorded for
+      // this storage discards the results depending on it.
+      if(_retain)
+	{
+	  Node &node = _nodes[leaf];
+	  bool known = false, changed = false;
+	  for(std::pair<Tensor*, uint64_t> &r : node.tensors)
+	    {
+	      known = known || r.first == t;
+	      if(r.first->version() != r.second)
+		{
+		  r.second = r.first->version();
+		  changed = true;
+		}
+	    }
+	  if(nullptr != t && !known) node.tensors.emplace_back(t, t->version());
+	  if(changed) _invalidate(leaf);
+	}
+      items.push_back(DagOperand{leaf, v.labels});
+    }
+
+  for(size_t i = 0; i < plan.steps.size(); ++i)
+    {
+      size_t a = plan.steps[i].first, b = plan.steps[i].second;
+#ifndef NO_ERROR_CHECKING
+      if(a >= n + i || b >= n + i || a == b)
+	LOG_MSG_(FATAL) << kErrBounds << "step " << i << " of plan passed "
+	  "to ContractionDag::add() uses operands " << a << " and " << b;
+#endif // NO_ERROR_CHECKING
+      if(items[b].node < items[a].node) std::swap(a, b);
+      const DagOperand &x = items[a], &y = items[b];
+
+      // pair the legs sharing labels, and keep the rest in order
+      StepKey key{x.node, y.node, {}};
+      DagOperand r{kNoNode, {}};
+      vector<bool> summed(y.labels.size(), false);
+      for(size_t p = 0; p < x.labels.size(); ++p)
+	{
+	  const size_t q = std::find(y.labels.begin(), y.labels.end(),
+				     x.labels[p]) - y.labels.begin();
+	  if(q < y.labels.size())
+	    {
+	      std::get<2>(key).push_back(make_pair(p, q));
+	      summed[q] = true;
+	    }
+	  else r.labels.push_back(x.labels[p]);
+	}
+      for(size_t q = 0; q < y.labels.size(); ++q)
+	if(!summed[q]) r.labels.push_back(y.labels[q]);
+
+      auto entry = _steps.emplace(key, _nodes.size());
+      if(entry.second)
+	{
+	  const size_t id = _nodes.size();
+	  _nodes.push_back(Node{x.node, y.node, std::get<2>(key), TensorView{},
+		{}, {}});
+	  _nodes[x.node].parents.push_back(id);
+	  if(y.node != x.node) _nodes[y.node].parents.push_back(id);
+	  _results.emplace_back();
+	  _ready.push_back(false);
+	  _used.push_back(0);
+	}
+      r.node = entry.first->second;
+      items.push_back(std::move(r));
+    }
+
+  _outputs.push_back(make_pair(items.back().node,
+			       std::move(items.back().labels)));
+  return _outputs.size() - 1;
+}
+
+// ########################### outputs ###############################
+size_t ContractionDag::outputs() const
+{
+  return _outputs.size();
+}
+
+// ########################### steps #################################
+size_t ContractionDag::steps() const
+{
+  return _steps.size();
+}
+
+// ########################### computed ##############################
+size_t ContractionDag::computed() const
+{
+  return _computed;
+}
+
+// ########################### evaluate ##############################
+vector<DenseTensor> ContractionDag::evaluate(size_t first)
+{
+#ifndef NO_ERROR_CHECKING
+  if(first > _outputs.size())
+    LOG_MSG_(FATAL) << kErrBounds << "argument of "
+      "ContractionDag::evaluate(): " << first << " exceeds number of "
+      "outputs " << _outputs.size();
+#endif // NO_ERROR_CHECKING
+
+  // Find the contractions needed, stopping at results already present,
+  // and count the users of each so that it can be released once the
+  // last of them is done.
+  ++_clock;
+  vector<size_t> users(_nodes.size(), 0);
+  vector<bool> needed(_nodes.size(), false);
+  vector<size_t> stack;
+  auto need = [&](size_t n)
+    {
+      ++users[n];
+      _used[n] = _clock;
+      if(kNoNode != _nodes[n].first && !_ready[n] && !needed[n])
+	{
+	  needed[n] = true;
+	  stack.push_back(n);
+	}
+    };
+  for(size_t o = first; o < _outputs.size(); ++o)
+    need(_outputs[o].first);
+  while(!stack.empty())
+    {
+      const size_t n = stack.back();
+      stack.pop_back();
+      need(_nodes[n].first);
+      need(_nodes[n].second);
+    }
+
+  // Children precede their parents, so one pass in order suffices.
+  auto legs = [&](size_t n)
+    {
+      return kNoNode == _nodes[n].first ? _nodes[n].leaf.dims.size()
+	: _results[n].dims.size();
+    };
+  auto done = [&](size_t n)
+    {
+      if(0 == --users[n] && !_retain) _release(n);
+    };
+  _computed = 0;
+  for(size_t n = 0; n < _nodes.size(); ++n)
+    {
+      if(!needed[n]) continue;
+      const Node &x = _nodes[n];
+
+      // Label the legs of the first child by position, and those of
+      // the second after them unless joined to the first.
+      const size_t na = legs(x.first), nb = legs(x.second);
+      vector<size_t> la(na), lb(nb);
+      for(size_t i = 0; i < na; ++i) la[i] = i;
+      for(size_t j = 0; j < nb; ++j) lb[j] = na + j;
+      for(const pair<size_t, size_t> &p : x.joined) lb[p.second] = p.first;
+
+      _results[n] = contract(_view(x.first, la), _view(x.second, lb));
+      _ready[n] = true;
+      ++_computed;
+      done(x.first);
+      done(x.second);
+    }
+
+  vector<DenseTensor> ret;
+  ret.reserve(_outputs.size() - first);
+  for(size_t o = first; o < _outputs.size(); ++o)
+    {
+      const size_t n = _outputs[o].first;
+      if(kNoNode == _nodes[n].first) ret.push_back(to_dense(_nodes[n].leaf));
+      else if(1 == users[n] && !_retain)
+	ret.push_back(std::move(_results[n]));
+      else ret.push_back(_results[n]);
+      ret.back().labels = _outputs[o].second;
+      done(n);
+    }
+
+  if(_retain) _evict();
+  return ret;
+}
+
+// ########################### _view #################################
+TensorView ContractionDag::_view(size_t n, vector<size_t> labels) const
+{
+  TensorView ret = kNoNode == _nodes[n].first ? _nodes[n].leaf
+    : _results[n].view();
+  ret.labels = std::move(labels);
+  return ret;
+}
+
+// ########################### _invalidate ###########################
+void ContractionDag::_invalidate(size_t n)
+{
+  // A missing result does not imply that its parents are missing, so
+  // every descendant is visited.
+  vector<bool> seen(_nodes.size(), false);
+  vector<size_t> stack{n};
+  while(!stack.empty())
+    {
+      const size_t m = stack.back();
+      stack.pop_back();
+      for(size_t p : _nodes[m].parents)
+	if(!seen[p])
+	  {
+	    seen[p] = true;
+	    _release(p);
+	    stack.push_back(p);
+	  }
+    }
+}
+
+// ########################### _release ##############################
+void ContractionDag::_release(size_t n)
+{
+  _ready[n] = false;
+  vector<complex<double>>{}.swap(_results[n].data);
+  _results[n].dims.clear();
+}
+
+// ########################### _evict ################################
+void ContractionDag::_evict()
+{
+  double held = 0;
+  vector<size_t> order;
+  for(size_t n = 0; n < _nodes.size(); ++n)
+    if(_ready[n])
+      {
+	held += _results[n].data.size();
+	order.push_back(n);
+      }
+  if(held <= _capacity) return;
+
+  std::sort(order.begin(), order.end(), [this](size_t a, size_t b)
+	    {
+	      return _used[a] < _used[b] || (_used[a] == _used[b] && a < b);
+	    });
+  for(size_t i = 0; i < order.size() && held > _capacity; ++i)
+    {
+      held -= _results[order[i]].data.size();
+      _release(order[i]);
+    }
+}
@@ -0,0 +1,132 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// contraction of several networks sharing their common subexpressions
+
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "contract.hh"
+#include "plan.hh"
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+
+// Marks a node of a ContractionDag which has no children.
+const size_t kNoNode = static_cast<size_t>(-1);
+
+// Default number of entries of the intermediates kept by a retaining
+// ContractionDag between evaluations.
+const double kDagCapacity = 1 << 24;
+
+// The pairwise contractions of several planned networks, gathered into
+// a directed acyclic graph so that a partial contraction appearing in
+// more than one of them is computed once.  Leaves are identified by
+// the storage they view, their conjugation and layout, so that views
+// of one tensor, or of tensors sharing a Matrix, are a single leaf.
+// Contractions are identified by their children and the positions of
+// the legs joined, regardless of labels, so that networks labelled
+// differently still share.
+//
+// A retaining graph keeps its intermediates between evaluations, so
+// that networks added later reuse the partial contractions of those
+// evaluated before.  Each leaf records the version() of every tensor
+// it was added for, and adding it again once any of them has changed
+// discards only the intermediates depending on it; the next evaluation
+// then recomputes just those branches.  Intermediates beyond the capacity
+// (in entries) are dropped, least recently used first, and recomputed
+// when next needed.
+class ContractionDag
+{
+public:
+  explicit ContractionDag(bool retain = false,
+			  double capacity = kDagCapacity);
+  ContractionDag(const ContractionDag&) = delete;
+  ContractionDag& operator=(const ContractionDag&) = delete;
+  // Add the contraction of operands by plan as an output, and return
+  // its number.  If tensors is not empty, operand i is the view of
+  // tensors[i] (as by tensor_view()), or of no tensor if that is null.
+  // Operands must remain valid until evaluated, and in a retaining
+  // graph tensors must outlive it and must not change between adding
+  // and evaluating.
+  size_t add(const std::vector<TensorView>& operands,
+	     const ContractionPlan& plan,
+	     const std::vector<Tensor*>& tensors = {});
+  // Number of outputs added.
+  size_t outputs() const;
+  // Number of distinct pairwise contractions in the graph.
+  size_t steps() const;
+  // Number of contractions performed by the last evaluation.
+  size_t computed() const;
+  // Evaluate the outputs numbered first onwards, in the order added.
+  // Each result carries the labels of its operands, but its legs may
+  // lie in a different order from those of execute(), so should be
+  // permuted as needed.  Each node is evaluated once; unless the graph
+  // retains them, intermediates are released as soon as the last node
+  // or output using them is done.
+  std::vector<DenseTensor> evaluate(size_t first = 0);
+protected:
+  // A leaf holds the view it was last added with, and in a retaining
+  // graph each tensor it was added for with its version when last
+  // checked.  A contraction holds the
+  // numbers of its two children (first the smaller) and the pairs of
+  // legs joined, as positions in the legs of each, and yields the free
+  // legs of first followed by those of second.
+  struct Node
+  {
+    size_t first;
+    size_t second;
+    std::vector<std::pair<size_t, size_t>> joined;
+    TensorView leaf;
+    std::vector<std::pair<Tensor*, uint64_t>> tensors;
+    // Contractions using this node.
+    std::vector<size_t> parents;
+  };
+  // View of the result of node n with leg i labelled labels[i].
+  TensorView _view(size_t n, std::vector<size_t> labels) const;
+  // Discard the results of every contraction depending on node n.
+  void _invalidate(size_t n);
+  // Release the result of node n.
+  void _release(size_t n);
+  // Drop retained results, least recently used first, until they fit
+  // within the capacity.
+  void _evict();
+private:
+  typedef std::tuple<const void*, bool, std::vector<size_t>,
+		     std::vector<size_t>, bool, double, double> LeafKey;
+  typedef std::tuple<size_t, size_t,
+		     std::vector<std::pair<size_t, size_t>>> StepKey;
+  bool _retain;
+  double _capacity;
+  std::vector<Node> _nodes;
+  std::map<LeafKey, size_t> _leaves;
+  std::map<StepKey, size_t> _steps;
+  // For each output, its node and the labels of the node's legs.
+  std::vector<std::pair<size_t, std::vector<size_t>>> _outputs;
+  // Results of contractions, whether each is present, and when each
+  // was last used, counted in evaluations.
+  std::vector<DenseTensor> _results;
+  std::vector<bool> _ready;
+  std::vector<uint64_t> _used;
+  uint64_t _clock;
+  size_t _computed;
+};
@@ -0,0 +1,821 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdint>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_complex_math.h>
+#include <limits>
+#include <memory>
+#include "distributed.hh"
+#include "log_msg.hh"
+
+using std::complex;
+using std::unique_ptr;
+using std::vector;
+
+// An operand of a distributed contraction step, which is either held
+// in full by every process (view) or distributed (tensor).
+struct DistributedOperand
+{
+  const vector<size_t> *dims;
+  const vector<size_t> *labels;
+  const TensorView *view;
+  const DistributedTensor *tensor;
+};
+
+// Legs of a pairwise contraction, as in contract.cc.
+struct DistributedLegs
+{
+  vector<size_t> afree;
+  vector<size_t> bfree;
+  vector<size_t> asum;
+  vector<size_t> bsum;
+};
+
+// Where each leg of a tensor goes when it is stored as a matrix: to
+// the rows or the columns, with the given place value.
+struct LegMap
+{
+  vector<bool> to_row;
+  vector<size_t> place;
+};
+
+// Buffers and requests for the broadcast of one pair of panels.
+struct SummaPanels
+{
+  vector<complex<double>> a;
+  vector<complex<double>> b;
+  MPI_Request requests[2];
+};
+
+// ########################### mpi_count #############################
+// Narrow a count or displacement to the int taken by MPI.
+static int mpi_count(size_t n)
+{
+#ifndef NO_ERROR_CHECKING
+  if(n > static_cast<size_t>(std::numeric_limits<int>::max()))
+    LOG_MSG_(FATAL) << kErrBounds << "distributed contraction needs a "
+      "message of " << n << " entries, beyond the range of an MPI count";
+#endif // NO_ERROR_CHECKING
+
+  return static_cast<int>(n);
+}
+
+// ########################### mpi_counts ############################
+// Narrow counts to ints, and give the displacement of each from the
+// first; returns the total.
+static size_t mpi_counts(const vector<size_t>& counts, vector<int>& narrow,
+			 vector<int>& displs)
+{
+  narrow.resize(counts.size());
+  displs.resize(counts.size());
+  size_t total = 0;
+  for(size_t p = 0; p < counts.size(); ++p)
+    {
+      narrow[p] = mpi_count(counts[p]);
+      displs[p] = mpi_count(total);
+      total += counts[p];
+    }
+  return total;
+}
+
+// ########################### local_extent ##########################
+// Number of the indices [0, n) held by grid coordinate p of np, with
+// block size nb.
+static size_t local_extent(size_t n, size_t nb, int p, int np)
+{
+  const size_t full = n / nb, q = p, nq = np;
+  size_t ret = (full / nq + (q < full % nq ? 1 : 0)) * nb;
+  if(full % nq == q) ret += n % nb;
+  return ret;
+}
+
+// ########################### global_index ##########################
+static size_t global_index(size_t i, size_t nb, int p, int np)
+{
+  return ((i / nb) * np + p) * nb + i % nb;
+}
+
+// ########################### owner_coord ###########################
+static int owner_coord(size_t g, size_t nb, int np)
+{
+  return (g / nb) % np;
+}
+
+// ########################### local_index ###########################
+static size_t local_index(size_t g, size_t nb, int np)
+{
+  return (g / nb) / np * nb + g % nb;
+}
+
+// ########################### extent ################################
+static size_t extent(const vector<size_t>& dims, const vector<size_t>& legs)
+{
+  size_t n = 1;
+  for(size_t l : legs) n *= dims[l];
+  return n;
+}
+
+// ########################### view_offset ###########################
+// Offset into v.data of entry g of the row-major product of legs.
+static size_t view_offset(const TensorView& v, const vector<size_t>& legs,
+			  size_t g)
+{
+  size_t off = 0;
+  for(size_t i = legs.size(); i-- > 0; )
+    {
+      off += (g % v.dims[legs[i]]) * v.strides[legs[i]];
+      g /= v.dims[legs[i]];
+    }
+  return off;
+}
+
+// ########################### make_leg_map ##########################
+static LegMap make_leg_map(const vector<size_t>& dims,
+			   const vector<size_t>& rows,
+			   const vector<size_t>& cols)
+{
+  LegMap m{vector<bool>(dims.size(), false), vector<size_t>(dims.size())};
+  size_t s = 1;
+  for(size_t i = rows.size(); i-- > 0; )
+    {
+      m.to_row[rows[i]] = true;
+      m.place[rows[i]] = s;
+      s *= dims[rows[i]];
+    }
+  s = 1;
+  for(size_t i = cols.size(); i-- > 0; )
+    {
+      m.place[cols[i]] = s;
+      s *= dims[cols[i]];
+    }
+  return m;
+}
+
+// ########################### split_index ###########################
+// Decompose g over legs [lo, hi) in row-major order, and add the
+// contribution of each leg to the row or column it is mapped to.
+static void split_index(const vector<size_t>& dims, size_t lo, size_t hi,
+			size_t g, const LegMap& m, size_t& row, size_t& col)
+{
+  row = col = 0;
+  for(size_t l = hi; l-- > lo; )
+    {
+      (m.to_row[l] ? row : col) += (g % dims[l]) * m.place[l];
+      g /= dims[l];
+    }
+}
+
+// ########################### in_layout #############################
+// Whether t is already stored with the given row and column legs.
+static bool in_layout(const DistributedTensor& t, const vector<size_t>& rows,
+		      const vector<size_t>& cols, size_t block)
+{
+  if(t.matrix.block() != block || rows.size() != t.split) return false;
+  for(size_t i = 0; i < rows.size(); ++i)
+    if(rows[i] != i) return false;
+  for(size_t i = 0; i < cols.size(); ++i)
+    if(cols[i] != t.split + i) return false;
+  return true;
+}
+
+// ########################### pack ##################################
+// Distribute a tensor held by every process with the given row and
+// column legs.  Each process copies out only its own blocks.
+static DistributedMatrix pack(const ProcessGrid& grid, const TensorView& v,
+			      const vector<size_t>& rows,
+			      const vector<size_t>& cols, size_t block)
+{
+  // implicit identities are stored before distributing
+  if(v.identity)
+    {
+      DenseTensor d = to_dense(v);
+      return pack(grid, d.view(), rows, cols, block);
+    }
+
+  DistributedMatrix ret{grid, extent(v.dims, rows), extent(v.dims, cols),
+      block};
+  const size_t lr = ret.local_rows(), lc = ret.local_cols();
+  vector<size_t> offsets(lc);
+  for(size_t j = 0; j < lc; ++j)
+    offsets[j] = view_offset(v, cols, ret.global_col(j));
+
+  for(size_t i = 0; i < lr; ++i)
+    {
+      const complex<double> *p = v.data + view_offset(v, rows,
+						      ret.global_row(i));
+      complex<double> *q = ret.data() + i*lc;
+      if(v.conjugate)
+	for(size_t j = 0; j < lc; ++j)
+	  q[j] = std::conj(p[offsets[j]]);
+      else
+	for(size_t j = 0; j < lc; ++j)
+	  q[j] = p[offsets[j]];
+    }
+  return ret;
+}
+
+// ########################### repack ################################
+// Redistribute t with the given row and column legs.  Every entry is
+// sent directly to its new owner in a single all-to-all exchange.
+static DistributedMatrix repack(const DistributedTensor& t,
+				const vector<size_t>& rows,
+				const vector<size_t>& cols, size_t block)
+{
+  const DistributedMatrix &src = t.matrix;
+  const ProcessGrid &grid = src.grid();
+  const int R = grid.rows(), C = grid.cols();
+  DistributedMatrix ret{grid, extent(t.dims, rows), extent(t.dims, cols),
+      block};
+
+  // Row and column of the new matrix reached from each local row and
+  // column of the old one; the new position is the sum of the two.
+  const LegMap m = make_leg_map(t.dims, rows, cols);
+  const size_t lr = src.local_rows(), lc = src.local_cols();
+  vector<size_t> row_r(lr), row_c(lr), col_r(lc), col_c(lc);
+  for(size_t i = 0; i < lr; ++i)
+    split_index(t.dims, 0, t.split, src.global_row(i), m, row_r[i], row_c[i]);
+  for(size_t j = 0; j < lc; ++j)
+    split_index(t.dims, t.split, t.dims.size(), src.global_col(j), m,
+		col_r[j], col_c[j]);
+
+  vector<size_t> dest_cols(C);
+  for(int c = 0; c < C; ++c)
+    dest_cols[c] = local_extent(ret.cols(), block, c, C);
+
+  // count the entries bound for each process, then fill the buffers
+  vector<size_t> bound(R*C, 0);
+  for(size_t i = 0; i < lr; ++i)
+    for(size_t j = 0; j < lc; ++j)
+      ++bound[owner_coord(row_r[i] + col_r[j], block, R)*C
+	      + owner_coord(row_c[i] + col_c[j], block, C)];
+  vector<int> send_counts, send_displs;
+  mpi_counts(bound, send_counts, send_displs);
+
+  vector<uint64_t> send_index(lr*lc);
+  vector<complex<double>> send_value(lr*lc);
+  vector<size_t> next(send_displs.begin(), send_displs.end());
+  for(size_t i = 0; i < lr; ++i)
+    for(size_t j = 0; j < lc; ++j)
+      {
+	const size_t r = row_r[i] + col_r[j], c = row_c[i] + col_c[j];
+	const int pc = owner_coord(c, block, C),
+	  p = owner_coord(r, block, R)*C + pc;
+	send_index[next[p]] = local_index(r, block, R)*dest_cols[pc]
+	  + local_index(c, block, C);
+	send_value[next[p]++] = src.data()[i*lc + j];
+      }
+
+  vector<int> recv_counts(R*C), recv_displs;
+  MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1,
+	       MPI_INT, grid.comm());
+  const size_t total = mpi_counts(vector<size_t>(recv_counts.begin(),
+						 recv_counts.end()),
+				  recv_counts, recv_displs);
+
+  vector<uint64_t> recv_index(total);
+  vector<complex<double>> recv_value(total);
+  MPI_Alltoallv(send_index.data(), send_counts.data(), send_displs.data(),
+		MPI_UINT64_T, recv_index.data(), recv_counts.data(),
+		recv_displs.data(), MPI_UINT64_T, grid.comm());
+  MPI_Alltoallv(send_value.data(), send_counts.data(), send_displs.data(),
+		MPI_C_DOUBLE_COMPLEX, recv_value.data(), recv_counts.data(),
+		recv_displs.data(), MPI_C_DOUBLE_COMPLEX, grid.comm());
+
+  for(size_t e = 0; e < total; ++e)
+    ret.data()[recv_index[e]] = recv_value[e];
+  return ret;
+}
+
+// ########################### operand_matrix ########################
+// The matrix of operand x with the given row and column legs.  It is
+// built in store unless x is already distributed that way.
+static const DistributedMatrix&
+operand_matrix(const ProcessGrid& grid, const DistributedOperand& x,
+	       const vector<size_t>& rows, const vector<size_t>& cols,
+	       size_t block, unique_ptr<DistributedMatrix>& store)
+{
+  if(nullptr != x.tensor && in_layout(*x.tensor, rows, cols, block))
+    return x.tensor->matrix;
+  store.reset(new DistributedMatrix(nullptr != x.tensor ?
+				    repack(*x.tensor, rows, cols, block)
+				    : pack(grid, *x.view, rows, cols, block)));
+  return *store;
+}
+
+// ########################### classify_legs #########################
+static DistributedLegs classify_legs(const DistributedOperand& a,
+				     const DistributedOperand& b)
+{
+  DistributedLegs legs;
+  vector<bool> bsummed(b.labels->size(), false);
+  for(size_t i = 0; i < a.labels->size(); ++i)
+    {
+      size_t j = 0;
+      while(j < b.labels->size() && (*b.labels)[j] != (*a.labels)[i]) ++j;
+      if(j == b.labels->size())
+	{
+	  legs.afree.push_back(i);
+	  continue;
+	}
+#ifndef NO_ERROR_CHECKING
+      if((*a.dims)[i] != (*b.dims)[j])
+	LOG_MSG_(FATAL) << kErrIncompatible << "label " << (*a.labels)[i] <<
+	  " joins legs of differing dimension in a distributed contraction: "
+	  << (*a.dims)[i] << " and " << (*b.dims)[j];
+#endif // NO_ERROR_CHECKING
+      legs.asum.push_back(i);
+      legs.bsum.push_back(j);
+      bsummed[j] = true;
+    }
+  for(size_t j = 0; j < b.labels->size(); ++j)
+    if(!bsummed[j]) legs.bfree.push_back(j);
+  return legs;
+}
+
+// ########################### contract_operands #####################
+static DistributedTensor contract_operands(const ProcessGrid& grid,
+					   const DistributedOperand& a,
+					   const DistributedOperand& b,
+					   size_t block)
+{
+  const DistributedLegs legs = classify_legs(a, b);
+  vector<size_t> dims, labels;
+  for(size_t l : legs.afree)
+    {
+      dims.push_back((*a.dims)[l]);
+      labels.push_back((*a.labels)[l]);
+    }
+  for(size_t l : legs.bfree)
+    {
+      dims.push_back((*b.dims)[l]);
+      labels.push_back((*b.labels)[l]);
+    }
+
+  // As in contract_gemm(), the result is the product of a with its
+  // free legs as rows and b with its free legs as columns.
+  unique_ptr<DistributedMatrix> astore, bstore;
+  const DistributedMatrix &am = operand_matrix(grid, a, legs.afree,
+					       legs.asum, block, astore);
+  const DistributedMatrix &bm = operand_matrix(grid, b, legs.bsum,
+					       legs.bfree, block, bstore);
+  DistributedTensor ret{dims, labels, legs.afree.size(),
+      DistributedMatrix{grid, am.rows(), bm.cols(), block}};
+  summa(am, bm, ret.matrix);
+  return ret;
+}
+
+// ########################### post_panels ###########################
+// Start broadcasting block column kb of a along process rows and
+// block row kb of b along process columns.
+static void post_panels(const DistributedMatrix& a,
+			const DistributedMatrix& b, size_t kb,
+			SummaPanels& p)
+{
+  const ProcessGrid &grid = a.grid();
+  const size_t nb = a.block(), width = std::min(nb, a.cols() - kb*nb);
+  const int root_col = owner_coord(kb*nb, nb, grid.cols()),
+    root_row = owner_coord(kb*nb, nb, grid.rows());
+
+  p.a.resize(a.local_rows()*width);
+  if(grid.col() == root_col)
+    {
+      const size_t off = local_index(kb*nb, nb, grid.cols());
+      for(size_t i = 0; i < a.local_rows(); ++i)
+	std::copy(a.data() + i*a.local_cols() + off,
+		  a.data() + i*a.local_cols() + off + width,
+		  p.a.data() + i*width);
+    }
+
+  p.b.resize(width*b.local_cols());
+  if(grid.row() == root_row)
+    {
+      const size_t off = local_index(kb*nb, nb, grid.rows());
+      std::copy(b.data() + off*b.local_cols(),
+		b.data() + (off + width)*b.local_cols(), p.b.data());
+    }
+
+  MPI_Ibcast(p.a.data(), mpi_count(p.a.size()), MPI_C_DOUBLE_COMPLEX,
+	     root_col, grid.row_comm(), &p.requests[0]);
+  MPI_Ibcast(p.b.data(), mpi_count(p.b.size()), MPI_C_DOUBLE_COMPLEX,
+	     root_row, grid.col_comm(), &p.requests[1]);
+}
+
+// ########################### execute_steps #########################
+// Execute plan as execute_distributed(), leaving the result in dense if
+// it is replicated and in tensor if it is distributed.
+static void execute_steps(const ProcessGrid& grid, const ContractionPlan& plan,
+			  const vector<TensorView>& operands,
+			  const vector<const DistributedTensor*>& distributed,
+			  size_t threshold, DenseTensor& dense,
+			  unique_ptr<DistributedTensor>& tensor)
+{
+  const size_t n = operands.size();
+
+#ifndef NO_ERROR_CHECKING
+  if(operands.empty() || plan.steps.size() + 1 != n)
+    LOG_MSG_(FATAL) << kErrListLength << "plan passed to "
+      "execute_distributed() has " << plan.steps.size() << " steps for " <<
+      n << " operands";
+  if(!distributed.empty() && distributed.size() != n)
+    LOG_MSG_(FATAL) << kErrListLength << "execute_distributed() given " <<
+      distributed.size() << " distributed tensors for " << n << " operands";
+  for(const DistributedTensor *t : distributed)
+    if(nullptr != t && &t->matrix.grid() != &grid)
+      LOG_MSG_(FATAL) << kErrIncompatible << "operand passed to "
+	"execute_distributed() is distributed over another grid";
+#endif // NO_ERROR_CHECKING
+
+  auto leaf = [&](size_t op)
+    {
+      return distributed.empty() ? nullptr : distributed[op];
+    };
+  if(plan.steps.empty())
+    {
+      if(nullptr != leaf(0))
+	tensor.reset(new DistributedTensor(*leaf(0)));
+      else
+	dense = to_dense(operands[0]);
+      return;
+    }
+
+  // Each intermediate is either replicated (dense and views) or
+  // distributed (tensors), as is each operand.
+  vector<DenseTensor> dense_steps(plan.steps.size());
+  vector<TensorView> views(plan.steps.size());
+  vector<unique_ptr<DistributedTensor>> tensors(plan.steps.size());
+  vector<bool> used(n + plan.steps.size(), false);
+  for(size_t i = 0; i < plan.steps.size(); ++i)
+    {
+      const size_t a = plan.steps[i].first, b = plan.steps[i].second;
+#ifndef NO_ERROR_CHECKING
+      if(a >= n + i || b >= n + i || a == b || used[a] || used[b])
+	LOG_MSG_(FATAL) << kErrBounds << "step " << i << " of plan passed "
+	  "to execute_distributed() uses operands " << a << " and " << b;
+#endif // NO_ERROR_CHECKING
+      used[a] = used[b] = true;
+
+      DistributedOperand x[2];
+      for(size_t k = 0; k < 2; ++k)
+	{
+	  const size_t op = 0 == k ? a : b;
+	  const DistributedTensor *t = op < n ? leaf(op)
+	    : tensors[op - n].get();
+	  const TensorView *v = op < n ? &operands[op] : &views[op - n];
+	  if(nullptr != t)
+	    x[k] = DistributedOperand{&t->dims, &t->labels, nullptr, t};
+	  else
+	    x[k] = DistributedOperand{&v->dims, &v->labels, v, nullptr};
+	}
+
+      // work is the size of a times the free dimensions of b
+      size_t work = 1;
+      for(size_t d : *x[0].dims) work *= d;
+      for(size_t j = 0; j < x[1].labels->size(); ++j)
+	if(!std::count(x[0].labels->begin(), x[0].labels->end(),
+		       (*x[1].labels)[j]))
+	  work *= (*x[1].dims)[j];
+
+      if(nullptr != x[0].view && nullptr != x[1].view && work <= threshold)
+	{
+	  dense_steps[i] = contract(*x[0].view, *x[1].view);
+	  views[i] = dense_steps[i].view();
+	}
+      else
+	tensors[i].reset(new DistributedTensor(contract_operands
+					       (grid, x[0], x[1],
+						kDistributedBlock)));
+
+      // intermediates are used only once, so release them immediately
+      for(size_t op : {a, b})
+	if(op >= n)
+	  {
+	    vector<complex<double>>{}.swap(dense_steps[op - n].data);
+	    tensors[op - n].reset();
+	  }
+    }
+
+  tensor = std::move(tensors.back());
+  if(!tensor) dense = std::move(dense_steps.back());
+}
+
+// ########################### ProcessGrid ###########################
+// ########################### constructor ###########################
+ProcessGrid::ProcessGrid(MPI_Comm comm)
+  : _rows{1}
+{
+  // a private communicator keeps our messages apart from the caller's
+  MPI_Comm_dup(comm, &_comm);
+  int rank = 0, size = 0;
+  MPI_Comm_rank(_comm, &rank);
+  MPI_Comm_size(_comm, &size);
+
+  // the most square grid has the largest divisor not above sqrt(size)
+  for(int r = 1; r*r <= size; ++r)
+    if(0 == size % r) _rows = r;
+  _cols = size / _rows;
+  _row = rank / _cols;
+  _col = rank % _cols;
+  MPI_Comm_split(_comm, _row, _col, &_row_comm);
+  MPI_Comm_split(_comm, _col, _row, &_col_comm);
+}
+
+// ########################### destructor ############################
+ProcessGrid::~ProcessGrid()
+{
+  MPI_Comm_free(&_col_comm);
+  MPI_Comm_free(&_row_comm);
+  MPI_Comm_free(&_comm);
+}
+
+// ########################### rows ##################################
+int ProcessGrid::rows() const
+{
+  return _rows;
+}
+
+// ########################### cols ##################################
+int ProcessGrid::cols() const
+{
+  return _cols;
+}
+
+// ########################### row ###################################
+int ProcessGrid::row() const
+{
+  return _row;
+}
+
+// ########################### col ###################################
+int ProcessGrid::col() const
+{
+  return _col;
+}
+
+// ########################### comm ##################################
+MPI_Comm ProcessGrid::comm() const
+{
+  return _comm;
+}
+
+// ########################### row_comm ##############################
+MPI_Comm ProcessGrid::row_comm() const
+{
+  return _row_comm;
+}
+
+// ########################### col_comm ##############################
+MPI_Comm ProcessGrid::col_comm() const
+{
+  return _col_comm;
+}
+
+// ########################### DistributedMatrix #####################
+// ########################### constructor ###########################
+DistributedMatrix::DistributedMatrix(const ProcessGrid& grid, size_t rows,
+				     size_t cols, size_t block)
+  : _grid{&grid}, _rows{rows}, _cols{cols}, _block{block},
+    _local_rows{local_extent(rows, block, grid.row(), grid.rows())},
+    _local_cols{local_extent(cols, block, grid.col(), grid.cols())},
+    _data(_local_rows*_local_cols)
+{
+#ifndef NO_ERROR_CHECKING
+  if(0 == block)
+    LOG_MSG_(FATAL) << kErrBounds << "DistributedMatrix given a block "
+      "size of zero";
+#endif // NO_ERROR_CHECKING
+}
+
+// ########################### grid ##################################
+const ProcessGrid& DistributedMatrix::grid() const
+{
+  return *_grid;
+}
+
+// ########################### rows ##################################
+size_t DistributedMatrix::rows() const
+{
+  return _rows;
+}
+
+// ########################### cols ##################################
+size_t DistributedMatrix::cols() const
+{
+  return _cols;
+}
+
+// ########################### block #################################
+size_t DistributedMatrix::block() const
+{
+  return _block;
+}
+
+// ########################### local_rows ############################
+size_t DistributedMatrix::local_rows() const
+{
+  return _local_rows;
+}
+
+// ########################### local_cols ############################
+size_t DistributedMatrix::local_cols() const
+{
+  return _local_cols;
+}
+
+// ########################### global_row ############################
+size_t DistributedMatrix::global_row(size_t i) const
+{
+  return global_index(i, _block, _grid->row(), _grid->rows());
+}
+
+// ########################### global_col ############################
+size_t DistributedMatrix::global_col(size_t j) const
+{
+  return global_index(j, _block, _grid->col(), _grid->cols());
+}
+
+// ########################### data ##################################
+complex<double>* DistributedMatrix::data()
+{
+  return _data.data();
+}
+
+const complex<double>* DistributedMatrix::data() const
+{
+  return _data.data();
+}
+
+// ###################################################################
+
+// ########################### summa #################################
+void summa(const DistributedMatrix& a, const DistributedMatrix& b,
+	   DistributedMatrix& c)
+{
+#ifndef NO_ERROR_CHECKING
+  if(&a.grid() != &b.grid() || &a.grid() != &c.grid()
+     || a.block() != b.block() || a.block() != c.block())
+    LOG_MSG_(FATAL) << kErrIncompatible << "matrices passed to summa() "
+      "are not distributed alike";
+  if(a.cols() != b.rows() || a.rows() != c.rows() || b.cols() != c.cols())
+    LOG_MSG_(FATAL) << kErrIncompatible << "cannot multiply " << a.rows()
+      << "x" << a.cols() << " and " << b.rows() << "x" << b.cols() <<
+      " matrices into a " << c.rows() << "x" << c.cols() << " matrix";
+#endif // NO_ERROR_CHECKING
+
+  const size_t nb = a.block(), panels = (a.cols() + nb - 1) / nb;
+  if(0 == panels) return;
+
+  // While one pair of panels is multiplied, the next is in flight.
+  SummaPanels p[2];
+  post_panels(a, b, 0, p[0]);
+  for(size_t kb = 0; kb < panels; ++kb)
+    {
+      SummaPanels &cur = p[kb % 2];
+      if(kb + 1 < panels) post_panels(a, b, kb + 1, p[(kb + 1) % 2]);
+      MPI_Waitall(2, cur.requests, MPI_STATUSES_IGNORE);
+
+      const size_t m = c.local_rows(), n = c.local_cols(),
+	width = std::min(nb, a.cols() - kb*nb);
+      if(0 == m || 0 == n) continue;
+      gsl_matrix_complex_view av = gsl_matrix_complex_view_array
+	(reinterpret_cast<double*>(cur.a.data()), m, width);
+      gsl_matrix_complex_view bv = gsl_matrix_complex_view_array
+	(reinterpret_cast<double*>(cur.b.data()), width, n);
+      gsl_matrix_complex_view cv = gsl_matrix_complex_view_array
+	(reinterpret_cast<double*>(c.data()), m, n);
+      gsl_blas_zgemm(CblasNoTrans, CblasNoTrans, GSL_COMPLEX_ONE,
+		     &av.matrix, &bv.matrix, GSL_COMPLEX_ONE, &cv.matrix);
+    }
+}
+
+// ########################### distribute ############################
+DistributedTensor distribute(const ProcessGrid& grid, const TensorView& v,
+			     size_t split, size_t block)
+{
+#ifndef NO_ERROR_CHECKING
+  if(split > v.dims.size())
+    LOG_MSG_(FATAL) << kErrBounds << "cannot split a tensor with " <<
+      v.dims.size() << " legs after leg " << split;
+#endif // NO_ERROR_CHECKING
+
+  vector<size_t> rows(split), cols(v.dims.size() - split);
+  for(size_t i = 0; i < rows.size(); ++i) rows[i] = i;
+  for(size_t i = 0; i < cols.size(); ++i) cols[i] = split + i;
+  return DistributedTensor{v.dims, v.labels, split,
+      pack(grid, v, rows, cols, block)};
+}
+
+// ########################### gather ################################
+DenseTensor gather(const DistributedTensor& t, int root)
+{
+  const DistributedMatrix &m = t.matrix;
+  const ProcessGrid &grid = m.grid();
+  const int R = grid.rows(), C = grid.cols(), rank = grid.row()*C + grid.col();
+  const size_t nb = m.block();
+
+#ifndef NO_ERROR_CHECKING
+  if(kAllProcesses != root && (root < 0 || root >= R*C))
+    LOG_MSG_(FATAL) << kErrBounds << "gather() to rank " << root <<
+      " of a grid of " << R*C << " processes";
+#endif // NO_ERROR_CHECKING
+
+  // every process can work out the shape of every other's blocks
+  vector<size_t> held(R*C);
+  for(int p = 0; p < R*C; ++p)
+    held[p] = local_extent(m.rows(), nb, p / C, R)
+      * local_extent(m.cols(), nb, p % C, C);
+  vector<int> counts, displs;
+  const size_t total = mpi_counts(held, counts, displs);
+
+  // only the processes receiving the result need room for it
+  const bool receive = kAllProcesses == root || rank == root;
+  vector<complex<double>> all(receive ? total : 0);
+  if(kAllProcesses == root)
+    MPI_Allgatherv(m.data(), counts[rank], MPI_C_DOUBLE_COMPLEX, all.data(),
+		   counts.data(), displs.data(), MPI_C_DOUBLE_COMPLEX,
+		   grid.comm());
+  else
+    MPI_Gatherv(m.data(), counts[rank], MPI_C_DOUBLE_COMPLEX, all.data(),
+		counts.data(), displs.data(), MPI_C_DOUBLE_COMPLEX, root,
+		grid.comm());
+  if(!receive) return DenseTensor{};
+
+  DenseTensor ret{t.dims, t.labels};
+  for(int p = 0; p < R*C; ++p)
+    {
+      const size_t lr = local_extent(m.rows(), nb, p / C, R),
+	lc = local_extent(m.cols(), nb, p % C, C);
+      for(size_t i = 0; i < lr; ++i)
+	{
+	  const size_t gi = global_index(i, nb, p / C, R);
+	  for(size_t j = 0; j < lc; ++j)
+	    ret.data[gi*m.cols() + global_index(j, nb, p % C, C)] =
+	      all[displs[p] + i*lc + j];
+	}
+    }
+  return ret;
+}
+
+// ########################### contract ##############################
+DistributedTensor contract(const DistributedTensor& a,
+			   const DistributedTensor& b)
+{
+  return contract_operands(a.matrix.grid(),
+			   DistributedOperand{&a.dims, &a.labels, nullptr, &a},
+			   DistributedOperand{&b.dims, &b.labels, nullptr, &b},
+			   a.matrix.block());
+}
+
+// ########################### execute_distributed ###################
+DistributedTensor
+execute_distributed(const ProcessGrid& grid, const ContractionPlan& plan,
+		    const vector<TensorView>& operands,
+		    const vector<const DistributedTensor*>& distributed,
+		    size_t threshold)
+{
+  DenseTensor dense;
+  unique_ptr<DistributedTensor> tensor;
+  execute_steps(grid, plan, operands, distributed, threshold, dense, tensor);
+  if(tensor) return std::move(*tensor);
+
+  // a replicated result is distributed without communication
+  return distribute(grid, dense.view(), dense.dims.size() / 2);
+}
+
+DenseTensor execute_distributed(const ProcessGrid& grid,
+				const ContractionPlan& plan,
+				const vector<TensorView>& operands,
+				size_t threshold, int root)
+{
+  DenseTensor dense;
+  unique_ptr<DistributedTensor> tensor;
+  execute_steps(grid, plan, operands, {}, threshold, dense, tensor);
+  if(tensor) return gather(*tensor, root);
+
+#ifndef NO_ERROR_CHECKING
+  if(kAllProcesses != root && (root < 0 || root >= grid.rows()*grid.cols()))
+    LOG_MSG_(FATAL) << kErrBounds << "execute_distributed() gathering to "
+      "rank " << root << " of a grid of " << grid.rows()*grid.cols() <<
+      " processes";
+#endif // NO_ERROR_CHECKING
+
+  // a replicated result is already on every process
+  if(kAllProcesses == root || grid.row()*grid.cols() + grid.col() == root)
+    return dense;
+  return DenseTensor{};
+}
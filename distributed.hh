@@ -0,0 +1,154 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// contraction of tensor networks distributed over MPI processes
+
+#pragma once
+
+#include <complex>
+#include <mpi.h>
+#include <vector>
+#include "plan.hh"
+
+// Edge length of the square blocks in which matrices are distributed.
+const size_t kDistributedBlock = 64;
+// Pairwise contractions of replicated operands doing at most this
+// much work are repeated on every process rather than distributed.
+const size_t kDistributedContraction = 1 << 20;
+// Root passed to gather() and execute_distributed() to collect a
+// result onto every process.
+const int kAllProcesses = -1;
+
+// The processes of a communicator, arranged in a grid which is as
+// close to square as their number allows.  Process (r, c) is the one
+// with rank r*cols() + c.  MPI must be initialized for the lifetime
+// of the grid.
+class ProcessGrid
+{
+public:
+  explicit ProcessGrid(MPI_Comm comm = MPI_COMM_WORLD);
+  ProcessGrid(const ProcessGrid&) = delete;
+  ProcessGrid& operator=(const ProcessGrid&) = delete;
+  ~ProcessGrid();
+  // Shape of the grid, and the position of this process in it.
+  int rows() const;
+  int cols() const;
+  int row() const;
+  int col() const;
+  // Communicators spanning the whole grid, the row of this process
+  // (ranked by column) and its column (ranked by row).
+  MPI_Comm comm() const;
+  MPI_Comm row_comm() const;
+  MPI_Comm col_comm() const;
+private:
+  MPI_Comm _comm;
+  MPI_Comm _row_comm;
+  MPI_Comm _col_comm;
+  int _rows;
+  int _cols;
+  int _row;
+  int _col;
+};
+
+// A matrix distributed block-cyclically over a process grid: the
+// block in block row I and block column J is held by process (I mod
+// grid.rows(), J mod grid.cols()).  Each process stores its blocks as
+// one dense row-major matrix, in order of their global position.
+class DistributedMatrix
+{
+public:
+  // Create a zeroed matrix.
+  DistributedMatrix(const ProcessGrid& grid, size_t rows, size_t cols,
+		    size_t block = kDistributedBlock);
+  const ProcessGrid& grid() const;
+  // Global shape and block size.
+  size_t rows() const;
+  size_t cols() const;
+  size_t block() const;
+  // Shape of the part held by this process.
+  size_t local_rows() const;
+  size_t local_cols() const;
+  // Global row or column of a local row or column.
+  size_t global_row(size_t i) const;
+  size_t global_col(size_t j) const;
+  // Local entries, row-major.
+  std::complex<double>* data();
+  const std::complex<double>* data() const;
+private:
+  const ProcessGrid *_grid;
+  size_t _rows;
+  size_t _cols;
+  size_t _block;
+  size_t _local_rows;
+  size_t _local_cols;
+  std::vector<std::complex<double>> _data;
+};
+
+// Compute c += a*b by the SUMMA algorithm.  The matrices must share a
+// grid and block size.  Panels of a and b are broadcast along process
+// rows and columns, with the broadcast of each panel overlapping the
+// multiplication of the one before.
+void summa(const DistributedMatrix& a, const DistributedMatrix& b,
+	   DistributedMatrix& c);
+
+// A tensor stored as a distributed matrix, whose rows are indexed by
+// legs [0, split) and columns by the remaining legs, each in
+// row-major order.
+struct DistributedTensor
+{
+  std::vector<size_t> dims;
+  std::vector<size_t> labels;
+  size_t split;
+  DistributedMatrix matrix;
+};
+
+// Distribute a tensor held by every process, which requires no
+// communication.
+DistributedTensor distribute(const ProcessGrid& grid, const TensorView& v,
+			     size_t split, size_t block = kDistributedBlock);
+// Collect a distributed tensor onto the process of rank root in the
+// grid, or onto every process for kAllProcesses.  Processes other than
+// the root receive an empty tensor.
+DenseTensor gather(const DistributedTensor& t, int root = kAllProcesses);
+// Contract two distributed tensors, with the same conventions for
+// labels and the legs of the result as contract().  Operands are
+// redistributed as needed so that the result is a single product.
+DistributedTensor contract(const DistributedTensor& a,
+			   const DistributedTensor& b);
+// Execute a plan collectively over grid, leaving the result
+// distributed.  Operand i is *distributed[i] if that is given and not
+// null, when it must be distributed over grid and operands[i] is
+// ignored; otherwise it is operands[i], which every process must hold
+// in full (as when each builds the network itself).  Every process
+// must pass the same plan, and operands of the same shape and labels.
+// Steps on replicated operands doing at most threshold work are
+// repeated by every process; all other steps are distributed, and
+// their results stay distributed.
+DistributedTensor
+execute_distributed(const ProcessGrid& grid, const ContractionPlan& plan,
+		    const std::vector<TensorView>& operands,
+		    const std::vector<const DistributedTensor*>& distributed,
+		    size_t threshold = kDistributedContraction);
+// Execute a plan on replicated operands as above, and gather the
+// result onto the process of rank root, or onto every process for
+// kAllProcesses.  Processes other than the root receive an empty
+// tensor.
+DenseTensor execute_distributed(const ProcessGrid& grid,
+				const ContractionPlan& plan,
+				const std::vector<TensorView>& operands,
+				size_t threshold = kDistributedContraction,
+				int root = kAllProcesses);
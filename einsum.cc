@@ -0,0 +1,303 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include "einsum.hh"
+#include "log_msg.hh"
+#include "matrix.hh"
+#include "plan.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// ########################### index_labels ##########################
+// Labels of the legs indexed by indices, one per character.
+static vector<size_t> index_labels(const string& indices)
+{
+  vector<size_t> ret;
+  for(char c : indices) ret.push_back(static_cast<unsigned char>(c));
+
+#ifndef NO_ERROR_CHECKING
+  // traces over two legs of one tensor are not supported
+  vector<size_t> sorted = ret;
+  std::sort(sorted.begin(), sorted.end());
+  if(std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+    LOG_MSG_(FATAL) << kErrIncompatible << "index repeated on one tensor "
+      "in \"" << indices << "\"";
+#endif // NO_ERROR_CHECKING
+
+  return ret;
+}
+
+// ########################### accumulate_view #######################
+// Add s times the entries of v to d, whose legs carry the labels of v
+// in any order.
+static void accumulate_view(const TensorView& v, complex<double> s,
+			    DenseTensor& d)
+{
+  if(v.identity)
+    {
+      const DenseTensor x = to_dense(v);
+      accumulate_view(x.view(), s, d);
+      return;
+    }
+
+  // Walk d in order, stepping through v with the strides of the
+  // matching legs; the last leg of d is the inner loop.
+  const size_t rank = d.dims.size();
+  vector<size_t> stride(rank);
+  for(size_t i = 0; i < rank; ++i)
+    stride[i] = v.strides[std::find(v.labels.begin(), v.labels.end(),
+				    d.labels[i]) - v.labels.begin()];
+  const size_t inner = 0 == rank ? 1 : d.dims[rank - 1],
+    step = 0 == rank ? 0 : stride[rank - 1];
+  vector<size_t> index(rank, 0);
+  size_t offset = 0;
+  for(size_t base = 0; base < d.data.size(); base += inner)
+    {
+      for(size_t j = 0; j < inner; ++j)
+	{
+	  const complex<double> x = v.data[offset + j*step];
+	  d.data[base + j] += s * (v.conjugate ? std::conj(x) : x);
+	}
+      for(size_t k = 0 == rank ? 0 : rank - 1; k-- > 0;)
+	{
+	  offset += stride[k];
+	  if(++index[k] < d.dims[k]) break;
+	  offset -= stride[k] * d.dims[k];
+	  index[k] = 0;
+	}
+    }
+}
+
+// ########################### IndexedTensor #########################
+// ########################### constructors ##########################
+IndexedTensor::IndexedTensor(Tensor *t, const string& indices)
+  : _tensor{t}, _source{nullptr}, _dense{nullptr},
+    _labels(index_labels(indices))
+{
+#ifndef NO_ERROR_CHECKING
+  if(_labels.size() != t->inputs() + t->outputs())
+    LOG_MSG_(FATAL) << kErrListLength << "indices \"" << indices <<
+      "\" given for a tensor with " << t->inputs() + t->outputs() <<
+      " legs";
+#endif // NO_ERROR_CHECKING
+}
+
+// an unassigned destination need not have its final shape until read
+IndexedTensor::IndexedTensor(DenseTensor *d, const string& indices)
+  : _tensor{nullptr}, _source{d}, _dense{d}, _labels(index_labels(indices))
+{
+}
+
+IndexedTensor::IndexedTensor(const DenseTensor& d, const string& indices)
+  : _tensor{nullptr}, _source{&d}, _dense{nullptr},
+    _labels(index_labels(indices))
+{
+#ifndef NO_ERROR_CHECKING
+  if(_labels.size() != d.dims.size())
+    LOG_MSG_(FATAL) << kErrListLength << "indices \"" << indices <<
+      "\" given for a DenseTensor with " << d.dims.size() << " legs";
+#endif // NO_ERROR_CHECKING
+}
+
+// ########################### operator= #############################
+IndexedTensor& IndexedTensor::operator=(const IndexedTensor& e)
+{
+  _assign(e.terms(), false);
+  return *this;
+}
+
+// ########################### terms #################################
+// The view is taken now rather than on construction, since set_matrix()
+// or copy-on-write may since have replaced the storage.
+vector<EinsumTerm> IndexedTensor::terms() const
+{
+  TensorView v;
+  if(nullptr != _tensor)
+    {
+      const size_t nin = _tensor->inputs();
+      v = tensor_view(_tensor, vector<size_t>(_labels.begin(),
+					      _labels.begin() + nin),
+		      vector<size_t>(_labels.begin() + nin, _labels.end()));
+    }
+  else
+    {
+#ifndef NO_ERROR_CHECKING
+      if(_source->dims.size() != _labels.size())
+	LOG_MSG_(FATAL) << kErrListLength << "DenseTensor of " <<
+	  _source->dims.size() << " legs read with " << _labels.size() <<
+	  " indices";
+#endif // NO_ERROR_CHECKING
+
+      v = _source->view();
+      v.labels = _labels;
+    }
+  return vector<EinsumTerm>{EinsumTerm{1, vector<TensorView>{v}}};
+}
+
+// ########################### _assign ###############################
+void IndexedTensor::_assign(const vector<EinsumTerm>& terms, bool accumulate)
+{
+  vector<EinsumTerm> all = terms;
+  if(accumulate) all.push_back(this->terms().front());
+  DenseTensor r = evaluate(all, _labels);
+
+  if(nullptr != _dense)
+    {
+      *_dense = std::move(r);
+      return;
+    }
+
+#ifndef NO_ERROR_CHECKING
+  if(nullptr == _tensor)
+    LOG_MSG_(FATAL) << kErrIncompatible << "expression assigned to a "
+      "DenseTensor indexed as const";
+#endif // NO_ERROR_CHECKING
+
+  MatrixStruct m = _tensor->matrix();
+#ifndef NO_ERROR_CHECKING
+  vector<size_t> legs(m.nin, m.inrank);
+  legs.insert(legs.end(), m.nout, m.outrank);
+  if(r.dims != legs)
+    LOG_MSG_(FATAL) << kErrIncompatible << "expression assigned to a "
+      "tensor whose legs differ in dimension from its result";
+#endif // NO_ERROR_CHECKING
+
+  // The result is in the orientation of the tensor (inputs by
+  // outputs), which the storage of a conjugate tensor transposes.
+  std::shared_ptr<Matrix> s = std::make_shared<GSLMatrix>(m.matrix->rows(),
+							  m.matrix->cols());
+  complex<double> *data = s->data();
+  if(!m.conjugate)
+    std::copy(r.data.begin(), r.data.end(), data);
+  else
+    {
+      const size_t rows = m.matrix->cols(), cols = m.matrix->rows();
+      for(size_t i = 0; i < rows; ++i)
+	for(size_t j = 0; j < cols; ++j)
+	  data[j*rows + i] = std::conj(r.data[i*cols + j]);
+    }
+  _tensor->set_matrix(s);
+}
+
+// ########################### indexed ###############################
+IndexedTensor indexed(Tensor *t, const string& indices)
+{
+  return IndexedTensor(t, indices);
+}
+
+// ########################### DenseTensor ###########################
+// ########################### operator() ############################
+IndexedTensor DenseTensor::operator()(const string& indices)
+{
+  return IndexedTensor(this, indices);
+}
+
+IndexedTensor DenseTensor::operator()(const string& indices) const
+{
+  return IndexedTensor(*this, indices);
+}
+
+// ########################### multiply ##############################
+vector<EinsumTerm> multiply(const vector<EinsumTerm>& a,
+			    const vector<EinsumTerm>& b)
+{
+  vector<EinsumTerm> ret;
+  ret.reserve(a.size() * b.size());
+  for(const EinsumTerm &x : a)
+    for(const EinsumTerm &y : b)
+      {
+	ret.push_back(EinsumTerm{x.scale * y.scale, x.operands});
+	ret.back().operands.insert(ret.back().operands.end(),
+				   y.operands.begin(), y.operands.end());
+      }
+  return ret;
+}
+
+// ########################### evaluate ##############################
+DenseTensor evaluate(const vector<EinsumTerm>& terms,
+		     const vector<size_t>& labels)
+{
+#ifndef NO_ERROR_CHECKING
+  if(terms.empty())
+    LOG_MSG_(FATAL) << kErrListLength << "evaluate() called with no terms";
+#endif // NO_ERROR_CHECKING
+
+  // The open labels of every term must be labels, with dimensions
+  // agreeing between terms.
+  vector<size_t> dims(labels.size(), 0);
+  for(const EinsumTerm &t : terms)
+    {
+      unordered_map<size_t, size_t> uses, dim;
+      for(const TensorView &v : t.operands)
+	for(size_t i = 0; i < v.labels.size(); ++i)
+	  {
+	    ++uses[v.labels[i]];
+	    const size_t d = dim.emplace(v.labels[i], v.dims[i]).first->second;
+#ifndef NO_ERROR_CHECKING
+	    if(d != v.dims[i])
+	      LOG_MSG_(FATAL) << kErrIncompatible << "index '" <<
+		static_cast<char>(v.labels[i]) << "' joins legs of "
+		"dimensions " << d << " and " << v.dims[i];
+#endif // NO_ERROR_CHECKING
+	  }
+
+      size_t open = 0;
+      for(const auto &u : uses)
+	{
+#ifndef NO_ERROR_CHECKING
+	  if(u.second > 2)
+	    LOG_MSG_(FATAL) << kErrIncompatible << "index '" <<
+	      static_cast<char>(u.first) << "' appears " << u.second <<
+	      " times in one product";
+#endif // NO_ERROR_CHECKING
+	  if(1 != u.second) continue;
+	  ++open;
+	  const size_t p = std::find(labels.begin(), labels.end(), u.first)
+	    - labels.begin();
+#ifndef NO_ERROR_CHECKING
+	  if(p == labels.size() || (0 != dims[p] && dims[p] != dim[u.first]))
+	    LOG_MSG_(FATAL) << kErrIncompatible << "open index '" <<
+	      static_cast<char>(u.first) << "' of a term is not an index of "
+	      "the result, or has another dimension";
+#endif // NO_ERROR_CHECKING
+	  dims[p] = dim[u.first];
+	}
+#ifndef NO_ERROR_CHECKING
+      if(open != labels.size())
+	LOG_MSG_(FATAL) << kErrIncompatible << "a term has " << open <<
+	  " open indices where the result has " << labels.size();
+#endif // NO_ERROR_CHECKING
+    }
+
+  DenseTensor ret{dims, labels};
+  for(const EinsumTerm &t : terms)
+    if(1 == t.operands.size())
+      accumulate_view(t.operands.front(), t.scale, ret);
+    else
+      {
+	const DenseTensor r = execute(greedy_plan(t.operands), t.operands);
+	accumulate_view(r.view(), t.scale, ret);
+      }
+  return ret;
+}
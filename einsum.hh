@@ -0,0 +1,219 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// einsum-style tensor expressions built with expression templates
+
+#pragma once
+
+#include <complex>
+#include <string>
+#include <vector>
+#include "contract.hh"
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+
+// Expressions index the legs of tensors with one character each, as
+// in C("ab") = A("aic") * B("icb") + 2.0 * D("ba").  A product
+// contracts every index appearing on two of its factors and leaves the
+// others open; an index may not appear more than twice in a product,
+// nor twice on one tensor.  The open indices of every term of a sum
+// must be those of the destination, in any order.
+//
+// Building an expression does no arithmetic: its type records the
+// shape of the expression, and assignment lowers it to a list of
+// terms, each a scale times a network of tensor views.  Products are
+// distributed over sums, so each term is a single network contracted
+// by one plan from greedy_plan() and execute(), the kernels used for
+// whole graphs, however the products were nested.  Scalar factors
+// only change the scale of terms, and a term of a single tensor is
+// added straight from that tensor's storage, so neither scaling nor
+// addition allocates intermediate tensors.  The destination may
+// appear in the expression: the result is assembled in new storage.
+
+// One term of an expression: scale times the contraction of operands,
+// labelled by the characters indexing them.
+struct EinsumTerm
+{
+  std::complex<double> scale;
+  std::vector<TensorView> operands;
+};
+
+// Base of every expression, giving access to the derived type.
+template <typename E>
+class TensorExpr
+{
+public:
+  const E& self() const
+  {
+    return static_cast<const E&>(*this);
+  }
+};
+
+// The legs of a tensor, indexed.  A tensor is indexed with inputs
+// before outputs; a DenseTensor with its legs in order.  Assigning an
+// expression evaluates it into the tensor: a Tensor receives a new
+// matrix through set_matrix() and must have the legs of the result,
+// while a DenseTensor takes the shape of the result.  Indexed tensors
+// and the expressions made from them refer to the tensors, which must
+// outlive them; their entries are viewed only when evaluated, so may
+// change in between.
+class IndexedTensor : public TensorExpr<IndexedTensor>
+{
+public:
+  IndexedTensor(Tensor *t, const std::string& indices);
+  IndexedTensor(DenseTensor *d, const std::string& indices);
+  // A DenseTensor which may only be read.
+  IndexedTensor(const DenseTensor& d, const std::string& indices);
+  IndexedTensor(const IndexedTensor&) = default;
+  // Assignment evaluates, even from another indexed tensor.
+  IndexedTensor& operator=(const IndexedTensor& e);
+  template <typename E>
+  IndexedTensor& operator=(const TensorExpr<E>& e)
+  {
+    _assign(e.self().terms(), false);
+    return *this;
+  }
+  template <typename E>
+  IndexedTensor& operator+=(const TensorExpr<E>& e)
+  {
+    _assign(e.self().terms(), true);
+    return *this;
+  }
+  std::vector<EinsumTerm> terms() const;
+protected:
+  // Evaluate terms into the tensor, adding its current entries if
+  // accumulate is set.
+  void _assign(const std::vector<EinsumTerm>& terms, bool accumulate);
+private:
+  Tensor *_tensor;
+  // The DenseTensor read, and the same if it may be assigned.
+  const DenseTensor *_source;
+  DenseTensor *_dense;
+  std::vector<size_t> _labels;
+};
+
+// Index a tensor, as IndexedTensor.  DenseTensor is indexed by its
+// operator(), as d("ab").
+IndexedTensor indexed(Tensor *t, const std::string& indices);
+
+// The product of two expressions.
+template <typename L, typename R>
+class ProductExpr : public TensorExpr<ProductExpr<L, R>>
+{
+public:
+  ProductExpr(const L& l, const R& r) : _l(l), _r(r) {}
+  std::vector<EinsumTerm> terms() const;
+private:
+  L _l;
+  R _r;
+};
+
+// A scalar multiple of an expression.
+template <typename E>
+class ScaledExpr : public TensorExpr<ScaledExpr<E>>
+{
+public:
+  ScaledExpr(std::complex<double> s, const E& e) : _s(s), _e(e) {}
+  std::vector<EinsumTerm> terms() const;
+private:
+  std::complex<double> _s;
+  E _e;
+};
+
+// The sum of two expressions.
+template <typename L, typename R>
+class SumExpr : public TensorExpr<SumExpr<L, R>>
+{
+public:
+  SumExpr(const L& l, const R& r) : _l(l), _r(r) {}
+  std::vector<EinsumTerm> terms() const;
+private:
+  L _l;
+  R _r;
+};
+
+// The terms of the product of sums of terms a and b, one for each pair.
+std::vector<EinsumTerm> multiply(const std::vector<EinsumTerm>& a,
+				 const std::vector<EinsumTerm>& b);
+// Evaluate the sum of terms, with legs ordered by labels.  Each term
+// of several operands is contracted by the plan of greedy_plan().
+DenseTensor evaluate(const std::vector<EinsumTerm>& terms,
+		     const std::vector<size_t>& labels);
+
+// ########################### ProductExpr ###########################
+template <typename L, typename R>
+std::vector<EinsumTerm> ProductExpr<L, R>::terms() const
+{
+  return multiply(_l.terms(), _r.terms());
+}
+
+// ########################### ScaledExpr ############################
+template <typename E>
+std::vector<EinsumTerm> ScaledExpr<E>::terms() const
+{
+  std::vector<EinsumTerm> ret = _e.terms();
+  for(EinsumTerm &t : ret) t.scale *= _s;
+  return ret;
+}
+
+// ########################### SumExpr ###############################
+template <typename L, typename R>
+std::vector<EinsumTerm> SumExpr<L, R>::terms() const
+{
+  std::vector<EinsumTerm> ret = _l.terms(), r = _r.terms();
+  ret.insert(ret.end(), r.begin(), r.end());
+  return ret;
+}
+
+// ########################### operators #############################
+template <typename L, typename R>
+ProductExpr<L, R> operator*(const TensorExpr<L>& l, const TensorExpr<R>& r)
+{
+  return ProductExpr<L, R>(l.self(), r.self());
+}
+
+template <typename E>
+ScaledExpr<E> operator*(std::complex<double> s, const TensorExpr<E>& e)
+{
+  return ScaledExpr<E>(s, e.self());
+}
+
+template <typename E>
+ScaledExpr<E> operator*(const TensorExpr<E>& e, std::complex<double> s)
+{
+  return ScaledExpr<E>(s, e.self());
+}
+
+template <typename E>
+ScaledExpr<E> operator-(const TensorExpr<E>& e)
+{
+  return ScaledExpr<E>(-1, e.self());
+}
+
+template <typename L, typename R>
+SumExpr<L, R> operator+(const TensorExpr<L>& l, const TensorExpr<R>& r)
+{
+  return SumExpr<L, R>(l.self(), r.self());
+}
+
+template <typename L, typename R>
+SumExpr<L, ScaledExpr<R>> operator-(const TensorExpr<L>& l,
+				    const TensorExpr<R>& r)
+{
+  return SumExpr<L, ScaledExpr<R>>(l.self(), ScaledExpr<R>(-1, r.self()));
+}
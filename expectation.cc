@@ -0,0 +1,263 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <unordered_map>
+#include "dag.hh"
+#include "expectation.hh"
+#include "log_msg.hh"
+#include "plan.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::unordered_map;
+using std::vector;
+
+// The ket and bra layers of the causal cone of some sites, with a
+// label for every leg.  Legs joined between the layers share a label,
+// and the sites themselves are left open.
+struct DoubleLayer
+{
+  vector<Tensor*> tensors;
+  unordered_map<Tensor*, size_t> index;
+  vector<vector<size_t>> ket_in;
+  vector<vector<size_t>> ket_out;
+  vector<vector<size_t>> bra_in;
+  vector<vector<size_t>> bra_out;
+  // Labels of the ket and then the bra index of each site.
+  vector<size_t> open;
+  // One more than the largest label used.
+  size_t labels;
+};
+
+// ########################### double_layer ##########################
+static DoubleLayer double_layer(Tensor *top, const vector<GraphEdge>& sites,
+				const char *caller)
+{
+  CausalConeGraph cone{sites};
+
+#ifndef NO_ERROR_CHECKING
+  if(!std::count(cone.vertex_begin(), cone.vertex_end(), top))
+    LOG_MSG_(FATAL) << kErrIncompatible << "top tensor passed to " <<
+      caller << "() does not lie in the causal cone of the sites";
+#else
+  (void)top;
+  (void)caller;
+#endif // NO_ERROR_CHECKING
+
+  DoubleLayer d;
+  d.tensors.assign(cone.vertex_begin(), cone.vertex_end());
+  const size_t m = d.tensors.size(), k = sites.size();
+  d.ket_in.resize(m);
+  d.ket_out.resize(m);
+  d.bra_in.resize(m);
+  d.bra_out.resize(m);
+  for(size_t i = 0; i < m; ++i)
+    {
+      d.index[d.tensors[i]] = i;
+      d.ket_in[i].resize(d.tensors[i]->inputs());
+      d.bra_in[i].resize(d.tensors[i]->inputs());
+      d.ket_out[i].resize(d.tensors[i]->outputs());
+      d.bra_out[i].resize(d.tensors[i]->outputs());
+    }
+
+  // Links inside the cone get separate ket and bra labels.
+  size_t label = 0;
+  for(auto e = cone.edge_begin(); e != cone.edge_end(); ++e)
+    {
+      const size_t in = d.index[e->input_tensor],
+	out = d.index[e->output_tensor];
+      d.ket_in[in][e->input_num] = d.ket_out[out][e->output_num] = label++;
+      d.bra_in[in][e->input_num] = d.bra_out[out][e->output_num] = label++;
+    }
+
+  // Cancelled outputs and unlinked inputs at the top are joined
+  // directly between the layers.
+  for(auto e = cone.cancelled_begin(); e != cone.cancelled_end(); ++e)
+    {
+      const size_t out = d.index[e->output_tensor];
+      d.ket_out[out][e->output_num] = d.bra_out[out][e->output_num] = label++;
+    }
+  for(auto e = cone.endpt_begin(); e != cone.endpt_end(); ++e)
+    if(nullptr != e->input_tensor)
+      {
+	const size_t in = d.index[e->input_tensor];
+	d.ket_in[in][e->input_num] = d.bra_in[in][e->input_num] = label++;
+      }
+
+  // The sites are left open, in the requested order.
+  d.open.resize(2*k);
+  for(size_t s = 0; s < k; ++s)
+    {
+      const size_t out = d.index[sites[s].output_tensor];
+      d.open[s] = d.ket_out[out][sites[s].output_num] = label++;
+      d.open[s + k] = d.bra_out[out][sites[s].output_num] = label++;
+    }
+  d.labels = label;
+  return d;
+}
+
+// ########################### layer_operands ########################
+// Views of every tensor of both layers, leaving out the bra copy of
+// skip (which may be null), and the tensor of each view in tensors.
+// The bra layer is the Hermitian conjugate of the ket layer, which
+// exchanges the roles of inputs and outputs.
+static vector<TensorView> layer_operands(const DoubleLayer& d, Tensor *skip,
+					 vector<Tensor*>& tensors)
+{
+  const size_t m = d.tensors.size();
+  vector<TensorView> operands;
+  operands.reserve(2*m);
+  tensors.clear();
+  for(size_t i = 0; i < m; ++i)
+    {
+      operands.push_back(tensor_view(d.tensors[i], d.ket_in[i],
+				     d.ket_out[i]));
+      tensors.push_back(d.tensors[i]);
+    }
+  for(size_t i = 0; i < m; ++i)
+    if(d.tensors[i] != skip)
+      {
+	operands.push_back(tensor_view(d.tensors[i]->matrix(true),
+				       d.bra_out[i], d.bra_in[i]));
+	tensors.push_back(d.tensors[i]);
+      }
+  return operands;
+}
+
+// ########################### reduced_density_matrix ################
+DenseTensor reduced_density_matrix(Tensor *top, const vector<GraphEdge>& sites)
+{
+  DoubleLayer d = double_layer(top, sites, "reduced_density_matrix");
+  vector<Tensor*> tensors;
+  vector<TensorView> operands = layer_operands(d, nullptr, tensors);
+  DenseTensor rho = execute(greedy_plan(operands), operands).permuted(d.open);
+  for(size_t i = 0; i < rho.labels.size(); ++i) rho.labels[i] = i;
+  return rho;
+}
+
+// ########################### environment_operands ##################
+// Operands for the environment of t, the tensor at position i of the
+// causal cone, with their tensors, and the legs of the missing bra
+// copy of t in order.
+static vector<TensorView> environment_operands(const DoubleLayer& d,
+					       const LocalOperator& op,
+					       size_t i,
+					       vector<Tensor*>& tensors,
+					       vector<size_t>& order)
+{
+  const size_t k = op.sites.size();
+  vector<size_t> in(d.open.begin() + k, d.open.end()),
+    out(d.open.begin(), d.open.begin() + k);
+  vector<TensorView> operands = layer_operands(d, d.tensors[i], tensors);
+  operands.push_back(tensor_view(op.op, in, out));
+  tensors.push_back(op.op);
+
+  order = d.bra_in[i];
+  order.insert(order.end(), d.bra_out[i].begin(), d.bra_out[i].end());
+  return operands;
+}
+
+// ########################### environment ###########################
+DenseTensor environment(Tensor *top, const LocalOperator& op, Tensor *t)
+{
+  return environment(top, vector<LocalOperator>{op}, t);
+}
+
+DenseTensor environment(Tensor *top, const vector<LocalOperator>& ops,
+			Tensor *t, ContractionDag *cache)
+{
+  const size_t nin = t->inputs(), nout = t->outputs();
+  vector<size_t> dims(nin, t->input_rank()), labels(nin + nout);
+  dims.insert(dims.end(), nout, t->output_rank());
+  for(size_t i = 0; i < labels.size(); ++i) labels[i] = i;
+  DenseTensor ret{dims, labels};
+
+  // Away from the causal cone, the isometric constraint leaves the
+  // expectation value independent of t.
+  ContractionDag local;
+  ContractionDag &dag = nullptr == cache ? local : *cache;
+  const size_t first = dag.outputs();
+  vector<vector<size_t>> orders;
+  for(const LocalOperator &op : ops)
+    {
+      DoubleLayer d = double_layer(top, op.sites, "environment");
+      auto it = d.index.find(t);
+      if(it == d.index.end()) continue;
+      vector<Tensor*> tensors;
+      orders.emplace_back();
+      vector<TensorView> operands = environment_operands(d, op, it->second,
+							 tensors,
+							 orders.back());
+      dag.add(operands, greedy_plan(operands), tensors);
+    }
+
+  vector<DenseTensor> envs = dag.evaluate(first);
+  for(size_t j = 0; j < envs.size(); ++j)
+    {
+      DenseTensor env = envs[j].permuted(orders[j]);
+      for(size_t i = 0; i < env.data.size(); ++i)
+	ret.data[i] += env.data[i];
+    }
+  return ret;
+}
+
+// ########################### expectation ###########################
+complex<double> expectation(Tensor *top, const LocalOperator& op)
+{
+  return expectation(top, vector<LocalOperator>{op})[0];
+}
+
+vector<complex<double>> expectation(Tensor *top,
+				    const vector<LocalOperator>& ops)
+{
+  // Each set of sites needs one reduced density matrix, and partial
+  // contractions common to their causal cones are shared.
+  vector<size_t> rho_of(ops.size());
+  vector<const vector<GraphEdge>*> sites;
+  vector<DoubleLayer> layers;
+  ContractionDag dag;
+  for(size_t i = 0; i < ops.size(); ++i)
+    {
+      size_t r = 0;
+      while(r < sites.size() && *sites[r] != ops[i].sites) ++r;
+      rho_of[i] = r;
+      if(r < sites.size()) continue;
+      sites.push_back(&ops[i].sites);
+      layers.push_back(double_layer(top, ops[i].sites, "expectation"));
+      vector<Tensor*> tensors;
+      vector<TensorView> operands = layer_operands(layers.back(), nullptr,
+						   tensors);
+      dag.add(operands, greedy_plan(operands), tensors);
+    }
+  vector<DenseTensor> rho = dag.evaluate();
+
+  vector<complex<double>> ret(ops.size());
+  for(size_t i = 0; i < ops.size(); ++i)
+    {
+      // Operator inputs meet the bra indices of rho and outputs meet
+      // the ket indices, giving Tr(op rho).
+      const vector<size_t> &open = layers[rho_of[i]].open;
+      const size_t k = ops[i].sites.size();
+      vector<size_t> in(open.begin() + k, open.end()),
+	out(open.begin(), open.begin() + k);
+      ret[i] = contract(rho[rho_of[i]].view(), tensor_view(ops[i].op, in, out))
+	.data[0];
+    }
+
+  return ret;
+}
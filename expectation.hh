@@ -0,0 +1,71 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// expectation values of local operators on a MERA
+
+#pragma once
+
+#include <complex>
+#include <vector>
+#include "contract.hh"
+#include "graph.hh"
+
+// forward declare to avoid dependencies between headers
+class ContractionDag;
+
+// An operator acting on a few sites at the bottom of a MERA.  Sites
+// are unlinked outputs, written as graph endpoints GraphEdge{nullptr,
+// 0, t, n}.  Input k and output k of op both act on sites[k], with
+// op->entry(i, j) = <i|op|j>.
+struct LocalOperator
+{
+  Tensor *op;
+  std::vector<GraphEdge> sites;
+};
+
+// The reduced density matrix of the state described by the MERA
+// below top on the given sites.  The result has 2k legs for k sites:
+// first the ket index of each site, then the bra index, so that
+// rho[j][i] = <j|rho|i>.
+//
+// Only the past causal cone of the sites is contracted, which relies
+// on every tensor being an isometry (contracting a tensor with its
+// conjugate over all outputs yields the identity on its inputs).
+// The state is assumed to be normalized.
+DenseTensor reduced_density_matrix(Tensor *top,
+				   const std::vector<GraphEdge>& sites);
+// The environment of t for the expectation value of op: the
+// derivative of <psi|op|psi> with respect to the complex conjugate of
+// t, with the legs of t (inputs, then outputs, labelled in order).
+// Summing its product with the conjugate of t gives <psi|op|psi>.  It
+// vanishes when t lies outside the causal cone of op.
+DenseTensor environment(Tensor *top, const LocalOperator& op, Tensor *t);
+// The sum of the environments of t for every operator in ops, with
+// partial contractions common to several of them computed once.  If
+// cache is given, the contractions are added to it instead, so that a
+// retaining graph reused between calls recomputes only the partial
+// contractions depending on tensors changed since.
+DenseTensor environment(Tensor *top, const std::vector<LocalOperator>& ops,
+			Tensor *t, ContractionDag *cache = nullptr);
+// Compute <psi|op|psi> for a single local operator.
+std::complex<double> expectation(Tensor *top, const LocalOperator& op);
+// Compute the expectation values of many operators.  Operators acting
+// on the same sites share a single reduced density matrix, and partial
+// contractions common to the causal cones of different sites are
+// computed once.
+std::vector<std::complex<double>>
+expectation(Tensor *top, const std::vector<LocalOperator>& ops);
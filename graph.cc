@@ -15,13 +15,31 @@
 // along with Tensor Network.  If not, see
 // <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <functional>
+#include <map>
+#include <utility>
 #include "graph.hh"
+#include "log_msg.hh"
 #include "tensor.hh"
 
 using std::hash;
 using std::iterator;
+using std::map;
+using std::pair;
 using std::unordered_set;
+using std::vector;
+
+// ########################### leg_position ##########################
+// Position of a leg of t in the storage of its matrix, which holds the
+// inputs and then the outputs in row-major order, or the reverse for a
+// conjugate tensor.
+static size_t leg_position(Tensor *t, bool input, size_t n)
+{
+  const bool conjugate = t->matrix().conjugate;
+  if(input) return conjugate ? t->outputs() + n : n;
+  return conjugate ? n : t->inputs() + n;
+}
 
 // ########################### GraphEdge ################################
 // ########################### operator== ############################
@@ -127,3 +145,164 @@ void DFSGraph::_dfs(Tensor *t)
       else _endpts.insert(GraphEdge{nullptr, 0, t, i});
     }
 }
+
+
+// ########################### CausalConeGraph #######################
+// ########################### constructor ###########################
+CausalConeGraph::CausalConeGraph(const vector<GraphEdge>& sites)
+{
+  // cone doubles as the queue of a breadth-first search upward
+  vector<Tensor*> cone;
+  for(const GraphEdge &s : sites)
+    {
+      Tensor *t = s.output_tensor;
+#ifndef NO_ERROR_CHECKING
+      // sites must be unlinked outputs
+      if(nullptr == t || nullptr != s.input_tensor
+	 || s.output_num >= t->outputs()
+	 || nullptr != t->output_tensor(s.output_num))
+	LOG_MSG_(FATAL) << kErrIncompatible << "site passed to "
+	  "CausalConeGraph::CausalConeGraph() is not an unlinked output";
+#endif // NO_ERROR_CHECKING
+      _endpts.insert(GraphEdge{nullptr, 0, t, s.output_num});
+      if(_vertices.insert(t).second) cone.push_back(t);
+    }
+
+  for(size_t i = 0; i < cone.size(); ++i)
+    for(size_t j = 0; j < cone[i]->inputs(); ++j)
+      {
+	Tensor *p = cone[i]->input_tensor(j);
+	if(nullptr == p)
+	  _endpts.insert(GraphEdge{cone[i], j, nullptr, 0});
+	else
+	  {
+	    _edges.insert(GraphEdge{cone[i], j, p, cone[i]->input_num(j)});
+	    if(_vertices.insert(p).second) cone.push_back(p);
+	  }
+      }
+
+  // Any output not accounted for as an edge or a site leaves the cone.
+  for(Tensor *t : cone)
+    for(size_t j = 0; j < t->outputs(); ++j)
+      {
+	Tensor *c = t->output_tensor(j);
+	if(nullptr == c)
+	  {
+	    if(!_endpts.count(GraphEdge{nullptr, 0, t, j}))
+	      _cancelled.insert(GraphEdge{nullptr, 0, t, j});
+	  }
+	else if(!_vertices.count(c))
+	  _cancelled.insert(GraphEdge{c, t->output_num(j), t, j});
+      }
+}
+
+// ########################### vertices ##############################
+size_t CausalConeGraph::vertices()
+{
+  return _vertices.size();
+}
+
+// ########################### edges #################################
+size_t CausalConeGraph::edges()
+{
+  return _edges.size();
+}
+
+// ########################### vertex_begin ##########################
+unordered_set<Tensor*>::const_iterator CausalConeGraph::vertex_begin()
+{
+  return _vertices.cbegin();
+}
+
+// ########################### vertex_end ############################
+unordered_set<Tensor*>::const_iterator CausalConeGraph::vertex_end()
+{
+  return _vertices.cend();
+}
+
+// ########################### edge_begin ############################
+unordered_set<GraphEdge>::const_iterator CausalConeGraph::edge_begin()
+{
+  return _edges.cbegin();
+}
+
+// ########################### edge_end ##############################
+unordered_set<GraphEdge>::const_iterator CausalConeGraph::edge_end()
+{
+  return _edges.cend();
+}
+
+// ########################### endpt_begin ###########################
+unordered_set<GraphEdge>::const_iterator CausalConeGraph::endpt_begin()
+{
+  return _endpts.cbegin();
+}
+
+// ########################### endpt_end #############################
+unordered_set<GraphEdge>::const_iterator CausalConeGraph::endpt_end()
+{
+  return _endpts.cend();
+}
+
+// ########################### cancellations #########################
+size_t CausalConeGraph::cancellations()
+{
+  return _cancelled.size();
+}
+
+// ########################### cancelled_begin #######################
+unordered_set<GraphEdge>::const_iterator CausalConeGraph::cancelled_begin()
+{
+  return _cancelled.cbegin();
+}
+
+// ########################### cancelled_end #########################
+unordered_set<GraphEdge>::const_iterator CausalConeGraph::cancelled_end()
+{
+  return _cancelled.cend();
+}
+
+// ###################################################################
+// ########################### parallel_edges ########################
+vector<EdgeBundle> parallel_edges(Graph& g)
+{
+  // group edges by the pair of tensors they join
+  map<pair<Tensor*, Tensor*>, vector<GraphEdge>> pairs;
+  for(auto e = g.edge_begin(); e != g.edge_end(); ++e)
+    if(e->input_tensor != e->output_tensor)
+      pairs[std::minmax(e->input_tensor, e->output_tensor)].push_back(*e);
+
+  vector<EdgeBundle> ret;
+  for(auto &p : pairs)
+    {
+      if(p.second.size() < 2) continue;
+      Tensor *first = p.first.first, *second = p.first.second;
+
+      // the positions of each edge on the two tensors
+      vector<pair<size_t, size_t>> pos;
+      for(const GraphEdge &e : p.second)
+	pos.push_back(first == e.input_tensor
+		      ? std::make_pair(leg_position(first, true, e.input_num),
+				       leg_position(second, false,
+						    e.output_num))
+		      : std::make_pair(leg_position(first, false,
+						    e.output_num),
+				       leg_position(second, true, e.input_num)));
+      vector<size_t> order(pos.size());
+      for(size_t i = 0; i < order.size(); ++i) order[i] = i;
+      std::sort(order.begin(), order.end(), [&pos](size_t i, size_t j)
+		{ return pos[i].first < pos[j].first; });
+
+      // an edge fuses with its predecessor if it follows it on both
+      EdgeBundle b{first, second, {}, 0};
+      for(size_t k = 0; k < order.size(); ++k)
+	{
+	  b.edges.push_back(p.second[order[k]]);
+	  if(0 == k || pos[order[k]].first != pos[order[k - 1]].first + 1
+	     || pos[order[k]].second != pos[order[k - 1]].second + 1)
+	    ++b.fused_legs;
+	}
+      ret.push_back(b);
+    }
+  return ret;
+}
@@ -19,6 +19,7 @@
 
 #include <iterator>
 #include <unordered_set>
+#include <vector>
 
 // Forward declare to avoid dependencies between headers.
 class Tensor;
@@ -102,3 +103,68 @@ private:
   // Tensors with detached inputs or outputs.
   std::unordered_set<GraphEdge> _endpts;
 };
+
+// The past causal cone of a set of sites at the bottom of a MERA: the
+// tensors owning the sites and every tensor reachable from them
+// through inputs.  Edges are the links between tensors in the cone,
+// and endpoints are the sites themselves together with any unlinked
+// inputs at the top of the cone.  Only the cone is visited, so
+// construction takes time proportional to its size rather than that
+// of the network.
+class CausalConeGraph : public Graph
+{
+public:
+  // Create the causal cone of sites, which must be unlinked outputs
+  // written as endpoints GraphEdge{nullptr, 0, t, n}.
+  explicit CausalConeGraph(const std::vector<GraphEdge>& sites);
+  CausalConeGraph& operator=(const CausalConeGraph&) = default;
+  CausalConeGraph(const CausalConeGraph&) = default;
+  CausalConeGraph& operator=(CausalConeGraph&&) = default;
+  CausalConeGraph(CausalConeGraph&&) = default;
+  // From interface Graph.
+  size_t vertices() override;
+  size_t edges() override;
+  std::unordered_set<Tensor*>::const_iterator vertex_begin() override;
+  std::unordered_set<Tensor*>::const_iterator vertex_end() override;
+  std::unordered_set<GraphEdge>::const_iterator edge_begin() override;
+  std::unordered_set<GraphEdge>::const_iterator edge_end() override;
+  std::unordered_set<GraphEdge>::const_iterator endpt_begin() override;
+  std::unordered_set<GraphEdge>::const_iterator endpt_end() override;
+  // Outputs of tensors in the cone which do not lead to another
+  // tensor in the cone or to a site.  Every tensor below such an
+  // output is outside the cone, and when the cone is contracted with
+  // its Hermitian conjugate those tensors cancel (U U^dagger = 1).
+  // These legs may therefore be joined directly between the two
+  // layers, and the tensors below them need never be contracted.
+  // Unlinked outputs are recorded as GraphEdge{nullptr, 0, t, n}.
+  size_t cancellations();
+  std::unordered_set<GraphEdge>::const_iterator cancelled_begin();
+  std::unordered_set<GraphEdge>::const_iterator cancelled_end();
+private:
+  // Tensors which belong to the cone.
+  std::unordered_set<Tensor*> _vertices;
+  // Edges connecting tensors within the cone.
+  std::unordered_set<GraphEdge> _edges;
+  // Sites and unlinked inputs.
+  std::unordered_set<GraphEdge> _endpts;
+  // Outputs leaving the cone.
+  std::unordered_set<GraphEdge> _cancelled;
+};
+
+// Parallel edges between one pair of tensors.  Contracting the pair
+// sums over all of them at once, and edges which are adjacent in the
+// storage of both tensors can be fused into a single leg of the
+// product of their dimensions, as contract() does.
+struct EdgeBundle
+{
+  Tensor *first;
+  Tensor *second;
+  // The edges, ordered by their position in the storage of first.
+  std::vector<GraphEdge> edges;
+  // Number of legs left after fusing adjacent edges.
+  size_t fused_legs;
+};
+
+// Find every pair of distinct tensors joined by more than one edge of
+// g, ordered by the addresses of the tensors (first < second).
+std::vector<EdgeBundle> parallel_edges(Graph& g);
@@ -0,0 +1,96 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <sstream>
+#include "hamiltonian.hh"
+#include "matrix.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::ostringstream;
+using std::vector;
+
+// Pauli matrices and the identity, row-major.
+static const vector<complex<double>> kPauliX{0, 1, 1, 0};
+static const vector<complex<double>> kPauliY{0, complex<double>{0, -1},
+    complex<double>{0, 1}, 0};
+static const vector<complex<double>> kPauliZ{1, 0, 0, -1};
+static const vector<complex<double>> kIdentity2{1, 0, 0, 1};
+
+// ########################### add_product ###########################
+// Add c (a x b) to the 4 x 4 matrix h, for 2 x 2 matrices a and b.
+static void add_product(vector<complex<double>>& h, complex<double> c,
+			const vector<complex<double>>& a,
+			const vector<complex<double>>& b)
+{
+  for(size_t i = 0; i < 4; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      h[i*4 + j] += c * a[(i >> 1)*2 + (j >> 1)] * b[(i & 1)*2 + (j & 1)];
+}
+
+// ########################### ising_hamiltonian #####################
+BondHamiltonian ising_hamiltonian(double field)
+{
+  ostringstream name;
+  name << "ising(field=" << field << ")";
+  BondHamiltonian h{name.str(), 2, vector<complex<double>>(16)};
+  add_product(h.term, -1, kPauliZ, kPauliZ);
+  add_product(h.term, -field / 2, kPauliX, kIdentity2);
+  add_product(h.term, -field / 2, kIdentity2, kPauliX);
+  return h;
+}
+
+// ########################### xxz_hamiltonian #######################
+BondHamiltonian xxz_hamiltonian(double delta)
+{
+  ostringstream name;
+  name << "xxz(delta=" << delta << ")";
+  BondHamiltonian h{name.str(), 2, vector<complex<double>>(16)};
+  add_product(h.term, 1, kPauliX, kPauliX);
+  add_product(h.term, 1, kPauliY, kPauliY);
+  add_product(h.term, delta, kPauliZ, kPauliZ);
+  return h;
+}
+
+// ########################### bond_bound ############################
+double bond_bound(const BondHamiltonian& h)
+{
+  // Gershgorin: every eigenvalue lies within some row's disc
+  const size_t n = h.dim * h.dim;
+  double bound = 0;
+  for(size_t i = 0; i < n; ++i)
+    {
+      double r = h.term[i*n + i].real();
+      for(size_t j = 0; j < n; ++j)
+	if(j != i) r += std::abs(h.term[i*n + j]);
+      bound = 0 == i ? r : std::max(bound, r);
+    }
+  return bound;
+}
+
+// ########################### bond_operator #########################
+Tensor* bond_operator(const BondHamiltonian& h, double shift)
+{
+  const size_t n = h.dim * h.dim;
+  Tensor *t = new ConcreteTensor(2, 2, h.dim);
+  MatrixStruct m = t->matrix();
+  for(size_t i = 0; i < n; ++i)
+    for(size_t j = 0; j < n; ++j)
+      m.matrix->set(i, j, h.term[i*n + j] - (i == j ? shift : 0.0));
+  return t;
+}
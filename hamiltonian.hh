@@ -0,0 +1,49 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// translation-invariant nearest-neighbour Hamiltonians on a chain
+
+#pragma once
+
+#include <complex>
+#include <string>
+#include <vector>
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+
+// A Hamiltonian sum_j h_{j,j+1} on a chain of sites of dimension dim.
+// The bond term is a dim^2 x dim^2 row-major matrix, with rows and
+// columns indexed by (left site)*dim + (right site).
+struct BondHamiltonian
+{
+  std::string name;
+  size_t dim;
+  std::vector<std::complex<double>> term;
+};
+
+// Transverse-field Ising model, h = -Z Z - field (X 1 + 1 X) / 2.
+BondHamiltonian ising_hamiltonian(double field);
+// XXZ model, h = X X + Y Y + delta Z Z (delta = 1 is the Heisenberg
+// antiferromagnet).
+BondHamiltonian xxz_hamiltonian(double delta);
+// An upper bound on the largest eigenvalue of the bond term.
+double bond_bound(const BondHamiltonian& h);
+// The bond term minus shift times the identity, as a tensor with two
+// inputs and two outputs suitable for a LocalOperator.  The caller
+// owns the result.
+Tensor* bond_operator(const BondHamiltonian& h, double shift = 0);
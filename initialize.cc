@@ -0,0 +1,141 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include "initialize.hh"
+#include "linalg.hh"
+#include "matrix.hh"
+#include "tensor.hh"
+
+using std::array;
+using std::complex;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+// Multipliers and key increments of Philox4x32.
+const uint32_t kPhiloxM0 = 0xD2511F53, kPhiloxM1 = 0xCD9E8D57;
+const uint32_t kPhiloxW0 = 0x9E3779B9, kPhiloxW1 = 0xBB67AE85;
+const size_t kPhiloxRounds = 10;
+
+// ########################### uniform ###############################
+// A double in (0, 1] from the top 53 bits of hi and lo.
+static double uniform(uint32_t hi, uint32_t lo)
+{
+  const uint64_t bits = (static_cast<uint64_t>(hi) << 32 | lo) >> 11;
+  return (bits + 1) * (1.0 / 9007199254740992.0);
+}
+
+// ########################### fill ##################################
+// Write the matrix for tensor number stream into m.
+static void fill(Matrix& m, TensorInit kind, uint64_t seed, uint64_t stream,
+		 double noise)
+{
+  const size_t rows = m.rows(), cols = m.cols();
+  complex<double> *data = m.data();
+  switch(kind)
+    {
+    case INIT_GAUSSIAN:
+      for(size_t i = 0; i < rows*cols; ++i)
+	data[i] = gaussian(seed, stream, i);
+      break;
+    case INIT_HAAR:
+      for(size_t i = 0; i < rows*cols; ++i)
+	data[i] = gaussian(seed, stream, i);
+      orthonormalize(data, rows, cols);
+      break;
+    case INIT_IDENTITY:
+      // GSLMatrix starts as the identity
+      for(size_t i = 0; i < rows*cols; ++i)
+	data[i] += noise * gaussian(seed, stream, i);
+      break;
+    }
+}
+
+// ###################################################################
+// ########################### philox ################################
+array<uint32_t, 4> philox(array<uint32_t, 4> counter,
+			  array<uint32_t, 2> key)
+{
+  array<uint32_t, 4> &c = counter;
+  for(size_t r = 0; r < kPhiloxRounds; ++r)
+    {
+      const uint64_t p0 = static_cast<uint64_t>(kPhiloxM0) * c[0],
+	p1 = static_cast<uint64_t>(kPhiloxM1) * c[2];
+      c = array<uint32_t, 4>{{
+	  static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ key[0],
+	  static_cast<uint32_t>(p1),
+	  static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ key[1],
+	  static_cast<uint32_t>(p0)}};
+      key[0] += kPhiloxW0;
+      key[1] += kPhiloxW1;
+    }
+  return c;
+}
+
+// ########################### gaussian ##############################
+complex<double> gaussian(uint64_t seed, uint64_t stream, uint64_t n)
+{
+  const array<uint32_t, 4> x = philox(
+    array<uint32_t, 4>{{static_cast<uint32_t>(n),
+	  static_cast<uint32_t>(n >> 32), static_cast<uint32_t>(stream),
+	  static_cast<uint32_t>(stream >> 32)}},
+    array<uint32_t, 2>{{static_cast<uint32_t>(seed),
+	  static_cast<uint32_t>(seed >> 32)}});
+
+  // Box-Muller transform of two uniforms gives two normals
+  const double r = std::sqrt(-2 * std::log(uniform(x[0], x[1]))),
+    theta = 2 * M_PI * uniform(x[2], x[3]);
+  return complex<double>{r * std::cos(theta), r * std::sin(theta)};
+}
+
+// ########################### initialize ############################
+void initialize(const vector<Tensor*>& tensors, TensorInit kind,
+		uint64_t seed, double noise, size_t threads)
+{
+  if(0 == threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, tensors.size());
+
+  // Threads claim tensors one at a time, so uneven sizes balance out.
+  std::atomic<size_t> next{0};
+  auto work = [&]()
+    {
+      for(size_t i = next++; i < tensors.size(); i = next++)
+	{
+	  Tensor *t = tensors[i];
+	  shared_ptr<Matrix> old = t->matrix().matrix;
+	  shared_ptr<Matrix> m;
+	  if(INIT_IDENTITY == kind && 0 == noise)
+	    m = make_shared<ScaledIdentityMatrix>(old->rows(), old->cols());
+	  else
+	    {
+	      m = make_shared<GSLMatrix>(old->rows(), old->cols());
+	      fill(*m, kind, seed, i, noise);
+	    }
+	  t->set_matrix(m);
+	}
+    };
+
+  vector<std::thread> pool;
+  for(size_t i = 1; i < threads; ++i) pool.emplace_back(work);
+  work();
+  for(std::thread &p : pool) p.join();
+}
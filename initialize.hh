@@ -0,0 +1,60 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// bulk initialization of tensors from a counter-based generator
+
+#pragma once
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+
+// Initial states produced by initialize().
+enum TensorInit
+{
+  // independent complex Gaussian entries, of unit variance in both
+  // the real and imaginary parts
+  INIT_GAUSSIAN,
+  // a Haar-random unitary, or isometry if the matrix is not square
+  INIT_HAAR,
+  // the identity plus noise times Gaussian entries (an implicit
+  // ScaledIdentityMatrix if noise is zero)
+  INIT_IDENTITY
+};
+
+// The Philox4x32-10 block function: a bijection of the 128-bit counter
+// keyed by key, whose outputs for distinct counters are statistically
+// independent.  Since every output is computed from its counter alone,
+// random numbers can be drawn in any order or in parallel and still
+// reproduce the same values.
+std::array<uint32_t, 4> philox(std::array<uint32_t, 4> counter,
+			       std::array<uint32_t, 2> key);
+// Complex Gaussian number n of stream stream, for the generator seeded
+// with seed.
+std::complex<double> gaussian(uint64_t seed, uint64_t stream, uint64_t n);
+
+// Replace the matrix of every tensor with a new one initialized as
+// kind.  Tensor i draws its entries from stream i, so the result
+// depends only on seed and the order of tensors, and not on the number
+// of threads, which is taken from the hardware if zero.  Tensors are
+// published with set_matrix(), and must be distinct.
+void initialize(const std::vector<Tensor*>& tensors, TensorInit kind,
+		uint64_t seed, double noise = 0, size_t threads = 0);
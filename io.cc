@@ -0,0 +1,693 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+#include "io.hh"
+#include "matrix.hh"
+#include "network.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::ifstream;
+using std::istream;
+using std::make_shared;
+using std::ofstream;
+using std::ostream;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// Magic string opening a .npy file, and the alignment of its header.
+const char kNpyMagic[] = "\x93NUMPY";
+const size_t kNpyAlign = 64;
+// Signatures of the records of a zip archive, the value of a field
+// whose true value is held in a zip64 extra field, and the sizes of
+// the fixed parts of records.
+const uint64_t kZipLocal = 0x04034b50;
+const uint64_t kZipCentral = 0x02014b50;
+const uint64_t kZipEnd = 0x06054b50;
+const uint64_t kZip64End = 0x06064b50;
+const uint64_t kZip64Locator = 0x07064b50;
+const uint64_t kZip64Mark = 0xffffffff;
+const size_t kZipLocalSize = 30;
+const size_t kZipCentralSize = 46;
+const size_t kZipEndSize = 22;
+const size_t kZip64EndSize = 56;
+const size_t kZip64LocatorSize = 20;
+// DOS date of the entries written, 1 January 1980.
+const uint64_t kZipDate = 0x21;
+
+// The header of a .npy array.
+struct NpyHeader
+{
+  string descr;
+  bool fortran_order;
+  vector<size_t> shape;
+};
+
+// An array in a zip archive: the offset of its local header, its size
+// and its compression method.
+struct ZipEntry
+{
+  uint64_t offset;
+  uint64_t size;
+  uint64_t method;
+};
+
+// ########################### get_le ################################
+// The little-endian integer of n bytes at p.
+static uint64_t get_le(const unsigned char *p, size_t n)
+{
+  uint64_t ret = 0;
+  for(size_t i = n; i-- > 0;) ret = ret << 8 | p[i];
+  return ret;
+}
+
+// ########################### put_le ################################
+// Append v to s as a little-endian integer of n bytes.
+static void put_le(string& s, uint64_t v, size_t n)
+{
+  for(size_t i = 0; i < n; ++i, v >>= 8)
+    s.push_back(static_cast<char>(v & 0xff));
+}
+
+// ########################### crc32 #################################
+// Update the CRC-32 of a zip entry with n bytes at p, eight bytes at a
+// time through tables of the contributions of each byte position.
+static uint32_t crc32(uint32_t crc, const void *p, size_t n)
+{
+  static const vector<vector<uint32_t>> table = []()
+    {
+      vector<vector<uint32_t>> t(8, vector<uint32_t>(256));
+      for(uint32_t i = 0; i < 256; ++i)
+	{
+	  uint32_t c = i;
+	  for(size_t k = 0; k < 8; ++k)
+	    c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+	  t[0][i] = c;
+	}
+      for(size_t k = 1; k < 8; ++k)
+	for(size_t i = 0; i < 256; ++i)
+	  t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xff];
+      return t;
+    }();
+  const unsigned char *b = static_cast<const unsigned char*>(p);
+  crc = ~crc;
+  for(; n >= 8; n -= 8, b += 8)
+    {
+      crc ^= static_cast<uint32_t>(get_le(b, 4));
+      crc = table[7][crc & 0xff] ^ table[6][(crc >> 8) & 0xff]
+	^ table[5][(crc >> 16) & 0xff] ^ table[4][crc >> 24]
+	^ table[3][b[4]] ^ table[2][b[5]] ^ table[1][b[6]] ^ table[0][b[7]];
+    }
+  for(; n > 0; --n, ++b) crc = table[0][(crc ^ *b) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+// ########################### write_block ###########################
+// Write n bytes at p to f, updating crc if it is not null.
+static void write_block(ostream& f, const void *p, size_t n, uint32_t *crc)
+{
+  f.write(static_cast<const char*>(p), n);
+  if(nullptr != crc) *crc = crc32(*crc, p, n);
+}
+
+// ########################### tensor_shape ##########################
+// The shape of the array of the tensor whose matrix is m, and the
+// numbers of rows and columns of its matrix in the orientation of the
+// tensor (inputs by outputs).
+static vector<size_t> tensor_shape(const MatrixStruct& m, size_t& rows,
+				   size_t& cols)
+{
+  vector<size_t> ret(m.nin, m.inrank);
+  ret.insert(ret.end(), m.nout, m.outrank);
+  rows = m.conjugate ? m.matrix->cols() : m.matrix->rows();
+  cols = m.conjugate ? m.matrix->rows() : m.matrix->cols();
+  return ret;
+}
+
+// ########################### npy_header ############################
+// The header of a complex128 .npy array of the given shape, including
+// the magic string, padded so that the data is aligned.
+static string npy_header(const vector<size_t>& shape)
+{
+  std::ostringstream s;
+  s << "{'descr': '<c16', 'fortran_order': False, 'shape': (";
+  for(size_t i = 0; i < shape.size(); ++i)
+    s << (0 == i ? "" : ", ") << shape[i];
+  s << (1 == shape.size() ? ",), }" : "), }");
+  string text = s.str();
+
+  // version 1.0 has a two-byte length, and 2.0 a four-byte one
+  const size_t prefix = sizeof(kNpyMagic) - 1 + 2;
+  const size_t length = text.size() + 1 + prefix + 2 < 65536 ? 2 : 4;
+  const size_t total = (prefix + length + text.size() + 1 + kNpyAlign - 1)
+    / kNpyAlign * kNpyAlign;
+  text.append(total - prefix - length - text.size() - 1, ' ');
+  text.push_back('\n');
+
+  string ret{kNpyMagic};
+  ret.push_back(static_cast<char>(2 == length ? 1 : 2));
+  ret.push_back(0);
+  put_le(ret, text.size(), length);
+  return ret + text;
+}
+
+// ########################### value_of ##############################
+// Position just after the colon following key in the header text of
+// a .npy array, or npos.
+static size_t value_of(const string& text, const string& key)
+{
+  size_t p = text.find("'" + key + "'");
+  if(string::npos == p) p = text.find("\"" + key + "\"");
+  if(string::npos == p) return p;
+  p = text.find(':', p + key.size() + 2);
+  return string::npos == p ? p : p + 1;
+}
+
+// ########################### read_npy_header #######################
+// Read the header of a .npy array from f, leaving f at its data.
+static bool read_npy_header(istream& f, NpyHeader& h)
+{
+  char magic[8];
+  if(!f.read(magic, 8)
+     || 0 != string(magic, 6).compare(string(kNpyMagic)))
+    return false;
+  const size_t major = static_cast<unsigned char>(magic[6]);
+  if(major < 1 || major > 3) return false;
+  const size_t bytes = 1 == major ? 2 : 4;
+  unsigned char length[4];
+  if(!f.read(reinterpret_cast<char*>(length), bytes)) return false;
+  string text(get_le(length, bytes), '\0');
+  if(!f.read(&text[0], text.size())) return false;
+
+  // The header is a Python dictionary literal, as written by NumPy.
+  size_t p = value_of(text, "descr");
+  if(string::npos == p) return false;
+  const size_t open = text.find_first_of("'\"", p);
+  const size_t close = string::npos == open ? open
+    : text.find(text[open], open + 1);
+  if(string::npos == close) return false;
+  h.descr = text.substr(open + 1, close - open - 1);
+
+  p = value_of(text, "fortran_order");
+  if(string::npos == p) return false;
+  p = text.find_first_not_of(' ', p);
+  h.fortran_order = string::npos != p && 0 == text.compare(p, 4, "True");
+
+  p = value_of(text, "shape");
+  const size_t first = string::npos == p ? p : text.find('(', p);
+  const size_t last = string::npos == first ? first : text.find(')', first);
+  if(string::npos == last) return false;
+  string dims = text.substr(first + 1, last - first - 1);
+  for(char &c : dims) if(',' == c) c = ' ';
+  std::istringstream s{dims};
+  h.shape.clear();
+  size_t d;
+  while(s >> d) h.shape.push_back(d);
+  return s.eof();
+}
+
+// ########################### matches ###############################
+// Whether an array with header h can be read into t.
+static bool matches(const NpyHeader& h, Tensor *t)
+{
+  size_t rows, cols;
+  const vector<size_t> shape = tensor_shape(t->matrix(), rows, cols);
+  return ("<c16" == h.descr || "<f8" == h.descr) && !h.fortran_order
+    && (h.shape == shape || h.shape == vector<size_t>{rows, cols});
+}
+
+// ########################### read_npy_data #########################
+// Read the data of an array with header h from f into t, which it
+// matches, replacing the matrix of t.
+static bool read_npy_data(istream& f, const NpyHeader& h, Tensor *t)
+{
+  MatrixStruct m = t->matrix();
+  size_t rows, cols;
+  tensor_shape(m, rows, cols);
+  shared_ptr<Matrix> s = make_shared<GSLMatrix>(m.matrix->rows(),
+						m.matrix->cols());
+  complex<double> *data = s->data();
+
+  if("<c16" == h.descr && !m.conjugate)
+    {
+      // the common case: straight from the file into storage
+      if(!f.read(reinterpret_cast<char*>(data),
+		 rows * cols * sizeof(complex<double>)))
+	return false;
+    }
+  else
+    {
+      // Convert a row at a time.  The storage of a conjugate tensor is
+      // the Hermitian conjugate of its array.
+      const bool real = "<f8" == h.descr;
+      vector<complex<double>> row(cols);
+      vector<double> re(real ? cols : 0);
+      for(size_t i = 0; i < rows; ++i)
+	{
+	  if(real)
+	    {
+	      if(!f.read(reinterpret_cast<char*>(re.data()),
+			 cols * sizeof(double)))
+		return false;
+	      std::copy(re.begin(), re.end(), row.begin());
+	    }
+	  else if(!f.read(reinterpret_cast<char*>(row.data()),
+			  cols * sizeof(complex<double>)))
+	    return false;
+	  for(size_t j = 0; j < cols; ++j)
+	    if(m.conjugate) data[j*rows + i] = std::conj(row[j]);
+	    else data[i*cols + j] = row[j];
+	}
+    }
+
+  t->set_matrix(s);
+  return true;
+}
+
+// ########################### npy_size ##############################
+// Number of bytes of the .npy array of t.
+static uint64_t npy_size(Tensor *t)
+{
+  size_t rows, cols;
+  const vector<size_t> shape = tensor_shape(t->matrix(), rows, cols);
+  return npy_header(shape).size()
+    + static_cast<uint64_t>(rows) * cols * sizeof(complex<double>);
+}
+
+// ########################### write_npy_data ########################
+// Write t to f as a .npy array, updating crc if it is not null.
+static bool write_npy_data(ostream& f, Tensor *t, uint32_t *crc)
+{
+  MatrixStruct m = t->matrix();
+  size_t rows, cols;
+  const string header = npy_header(tensor_shape(m, rows, cols));
+  write_block(f, header.data(), header.size(), crc);
+
+  // Stored matrices in the orientation of the tensor are written
+  // whole, and others a row at a time without allocating storage.
+  complex<double> scale;
+  const bool identity = m.matrix->scaled_identity(scale);
+  if(!m.conjugate && !identity)
+    write_block(f, m.matrix->data(), rows * cols * sizeof(complex<double>),
+		crc);
+  else
+    {
+      if(m.conjugate) scale = std::conj(scale);
+      const complex<double> *data = identity ? nullptr : m.matrix->data();
+      vector<complex<double>> row(cols);
+      for(size_t i = 0; i < rows; ++i)
+	{
+	  for(size_t j = 0; j < cols; ++j)
+	    row[j] = identity ? (i == j ? scale : complex<double>{})
+	      : std::conj(data[j*rows + i]);
+	  write_block(f, row.data(), cols * sizeof(complex<double>), crc);
+	}
+    }
+  return static_cast<bool>(f);
+}
+
+// ########################### zip_entries ###########################
+// List the entries of the zip archive f by name.
+static bool zip_entries(istream& f, unordered_map<string, ZipEntry>& entries)
+{
+  // The end record lies in the last bytes, before a comment of at most
+  // 65535 bytes.
+  f.seekg(0, std::ios::end);
+  const uint64_t size = f.tellg();
+  const uint64_t tail = std::min<uint64_t>(size, kZipEndSize + 65535);
+  if(tail < kZipEndSize) return false;
+  string buffer(tail, '\0');
+  f.seekg(size - tail);
+  if(!f.read(&buffer[0], tail)) return false;
+  const unsigned char *b = reinterpret_cast<const unsigned char*>
+    (buffer.data());
+  size_t end = tail - kZipEndSize + 1;
+  while(end-- > 0 && kZipEnd != get_le(b + end, 4));
+  if(end > tail) return false;
+
+  uint64_t count = get_le(b + end + 10, 2), cd_size = get_le(b + end + 12, 4),
+    cd_offset = get_le(b + end + 16, 4);
+  if(0xffff == count || kZip64Mark == cd_size || kZip64Mark == cd_offset)
+    {
+      // the zip64 end record, found through the locator before the end
+      if(end < kZip64LocatorSize
+	 || kZip64Locator != get_le(b + end - kZip64LocatorSize, 4))
+	return false;
+      unsigned char r[kZip64EndSize];
+      f.seekg(get_le(b + end - kZip64LocatorSize + 8, 8));
+      if(!f.read(reinterpret_cast<char*>(r), kZip64EndSize)
+	 || kZip64End != get_le(r, 4))
+	return false;
+      count = get_le(r + 32, 8);
+      cd_size = get_le(r + 40, 8);
+      cd_offset = get_le(r + 48, 8);
+    }
+
+  string directory(cd_size, '\0');
+  f.seekg(cd_offset);
+  if(!f.read(&directory[0], cd_size)) return false;
+  const unsigned char *c = reinterpret_cast<const unsigned char*>
+    (directory.data());
+  for(size_t k = 0, p = 0; k < count; ++k)
+    {
+      if(p + kZipCentralSize > cd_size || kZipCentral != get_le(c + p, 4))
+	return false;
+      ZipEntry e{get_le(c + p + 42, 4), get_le(c + p + 20, 4),
+	  get_le(c + p + 10, 2)};
+      uint64_t full = get_le(c + p + 24, 4);
+      const size_t name = get_le(c + p + 28, 2), extra = get_le(c + p + 30, 2),
+	comment = get_le(c + p + 32, 2);
+      const size_t next = p + kZipCentralSize + name + extra + comment;
+      if(next > cd_size) return false;
+
+      // A zip64 extra field holds, in order, those of the full size,
+      // the compressed size and the offset which did not fit.
+      for(size_t x = p + kZipCentralSize + name;
+	  x + 4 <= p + kZipCentralSize + name + extra;
+	  x += 4 + get_le(c + x + 2, 2))
+	if(1 == get_le(c + x, 2))
+	  {
+	    const size_t stop = x + 4 + get_le(c + x + 2, 2);
+	    size_t y = x + 4;
+	    for(uint64_t *v : { &full, &e.size, &e.offset })
+	      if(kZip64Mark == *v && y + 8 <= stop)
+		{
+		  *v = get_le(c + y, 8);
+		  y += 8;
+		}
+	  }
+
+      entries[string(directory, p + kZipCentralSize, name)] = e;
+      p = next;
+    }
+  return true;
+}
+
+// ########################### read_edge_list ########################
+size_t read_edge_list(const string& path, Network& net)
+{
+  ifstream f{path};
+  if(!f) return kNoTensor;
+
+  vector<NetworkShape> shapes;
+  vector<NetworkEdge> edges;
+  string line;
+  while(std::getline(f, line))
+    {
+      line.erase(std::min(line.find('#'), line.size()));
+      std::istringstream s{line};
+      string word;
+      if(!(s >> word)) continue;
+      if("tensor" == word)
+	{
+	  NetworkShape x;
+	  if(!(s >> x.nin >> x.nout >> x.inrank >> x.outrank))
+	    return kNoTensor;
+	  shapes.push_back(x);
+	}
+      else if("link" == word)
+	{
+	  NetworkEdge e;
+	  if(!(s >> e.input_id >> e.input_num >> e.output_id >> e.output_num))
+	    return kNoTensor;
+	  edges.push_back(e);
+	}
+      else return kNoTensor;
+      if(s >> word) return kNoTensor;
+    }
+  if(f.bad()) return kNoTensor;
+
+  // Every matrix must be addressable, and the legs of each tensor
+  // few enough that they can be counted (as there are no more legs
+  // than kEdgeListLegs times the lines read, the totals cannot
+  // overflow).
+  const size_t n = shapes.size();
+  vector<size_t> in_first(n + 1, 0), out_first(n + 1, 0);
+  for(size_t i = 0; i < n; ++i)
+    {
+      const NetworkShape &x = shapes[i];
+      if(x.nin > kEdgeListLegs || x.nout > kEdgeListLegs - x.nin)
+	return kNoTensor;
+      size_t entries = 1;
+      for(size_t l = 0; l < x.nin + x.nout; ++l)
+	{
+	  const size_t r = l < x.nin ? x.inrank : x.outrank;
+	  if(0 == r || entries > std::numeric_limits<size_t>::max()
+	     / sizeof(complex<double>) / r)
+	    return kNoTensor;
+	  entries *= r;
+	}
+      in_first[i + 1] = in_first[i] + x.nin;
+      out_first[i + 1] = out_first[i] + x.nout;
+    }
+
+  // Links must join existing legs of matching ranks, each at most once.
+  vector<bool> in_used(in_first[n], false), out_used(out_first[n], false);
+  for(NetworkEdge &e : edges)
+    {
+      if(e.input_id >= n || e.output_id >= n
+	 || e.input_num >= shapes[e.input_id].nin
+	 || e.output_num >= shapes[e.output_id].nout
+	 || shapes[e.input_id].inrank != shapes[e.output_id].outrank)
+	return kNoTensor;
+      const size_t i = in_first[e.input_id] + e.input_num,
+	o = out_first[e.output_id] + e.output_num;
+      if(in_used[i] || out_used[o]) return kNoTensor;
+      in_used[i] = out_used[o] = true;
+      e.input_id += net.size();
+      e.output_id += net.size();
+    }
+
+  return net.build(shapes, edges);
+}
+
+// ########################### write_edge_list #######################
+bool write_edge_list(const string& path, const Network& net)
+{
+  vector<size_t> number(net.size(), kNoTensor);
+  const vector<Tensor*> tensors = network_tensors(net);
+  for(size_t id = 0, k = 0; id < net.size(); ++id)
+    if(nullptr != net.tensor(id)) number[id] = k++;
+
+  const string tmp = path + ".tmp";
+  {
+    ofstream f{tmp};
+    f << "# tensor <inputs> <outputs> <input rank> <output rank>\n"
+      "# link <tensor> <input> <tensor> <output>\n";
+    for(Tensor *t : tensors)
+      f << "tensor " << t->inputs() << " " << t->outputs() << " " <<
+	t->input_rank() << " " << t->output_rank() << "\n";
+    for(size_t id = 0; id < net.size(); ++id)
+      {
+	if(kNoTensor == number[id]) continue;
+	for(size_t i = 0; i < net.inputs(id); ++i)
+	  {
+	    const size_t j = net.input_id(id, i);
+	    if(kNoTensor != j && kNoTensor != number[j])
+	      f << "link " << number[id] << " " << i << " " << number[j] <<
+		" " << net.input_num(id, i) << "\n";
+	  }
+      }
+    if(!f) return false;
+  }
+  return 0 == std::rename(tmp.c_str(), path.c_str());
+}
+
+// ########################### network_tensors #######################
+vector<Tensor*> network_tensors(const Network& net, size_t first)
+{
+  vector<Tensor*> ret;
+  for(size_t id = first; id < net.size(); ++id)
+    if(nullptr != net.tensor(id)) ret.push_back(net.tensor(id));
+  return ret;
+}
+
+// ########################### read_npz ##############################
+bool read_npz(const string& path, const vector<Tensor*>& tensors)
+{
+  ifstream f{path, std::ios::binary};
+  unordered_map<string, ZipEntry> entries;
+  if(!f || !zip_entries(f, entries)) return false;
+
+  // find and check every array before reading any
+  const size_t n = tensors.size();
+  vector<NpyHeader> headers(n);
+  vector<uint64_t> starts(n);
+  for(size_t i = 0; i < n; ++i)
+    {
+      auto it = entries.find("t" + std::to_string(i) + ".npy");
+      if(entries.end() == it || 0 != it->second.method) return false;
+      unsigned char local[kZipLocalSize];
+      f.seekg(it->second.offset);
+      if(!f.read(reinterpret_cast<char*>(local), kZipLocalSize)
+	 || kZipLocal != get_le(local, 4))
+	return false;
+      f.seekg(it->second.offset + kZipLocalSize + get_le(local + 26, 2)
+	      + get_le(local + 28, 2));
+      if(!read_npy_header(f, headers[i]) || !matches(headers[i], tensors[i]))
+	return false;
+      starts[i] = f.tellg();
+    }
+
+  for(size_t i = 0; i < n; ++i)
+    {
+      f.seekg(starts[i]);
+      if(!read_npy_data(f, headers[i], tensors[i])) return false;
+    }
+  return true;
+}
+
+// ########################### write_npz #############################
+bool write_npz(const string& path, const vector<Tensor*>& tensors)
+{
+  const string tmp = path + ".tmp";
+  {
+    ofstream f{tmp, std::ios::binary};
+    string central;
+    for(size_t i = 0; i < tensors.size(); ++i)
+      {
+	// Entries are stored uncompressed, with zip64 extra fields for
+	// sizes or offsets which do not fit in 32 bits.
+	const string name = "t" + std::to_string(i) + ".npy";
+	const uint64_t offset = f.tellp(), size = npy_size(tensors[i]);
+	const bool large = size >= kZip64Mark, far = offset >= kZip64Mark;
+	const uint64_t version = large || far ? 45 : 20;
+
+	string local;
+	put_le(local, kZipLocal, 4);
+	put_le(local, version, 2);
+	put_le(local, 0, 4);
+	put_le(local, 0, 2);
+	put_le(local, kZipDate, 2);
+	put_le(local, 0, 4);
+	put_le(local, large ? kZip64Mark : size, 4);
+	put_le(local, large ? kZip64Mark : size, 4);
+	put_le(local, name.size(), 2);
+	put_le(local, large ? 20 : 0, 2);
+	local += name;
+	if(large)
+	  {
+	    put_le(local, 1, 2);
+	    put_le(local, 16, 2);
+	    put_le(local, size, 8);
+	    put_le(local, size, 8);
+	  }
+	f.write(local.data(), local.size());
+
+	// the checksum is known only once the data is written
+	uint32_t crc = 0;
+	if(!write_npy_data(f, tensors[i], &crc)) return false;
+	const uint64_t end = f.tellp();
+	string field;
+	put_le(field, crc, 4);
+	f.seekp(offset + 14);
+	f.write(field.data(), field.size());
+	f.seekp(end);
+
+	string extra;
+	if(large)
+	  {
+	    put_le(extra, size, 8);
+	    put_le(extra, size, 8);
+	  }
+	if(far) put_le(extra, offset, 8);
+	put_le(central, kZipCentral, 4);
+	put_le(central, version, 2);
+	put_le(central, version, 2);
+	put_le(central, 0, 4);
+	put_le(central, 0, 2);
+	put_le(central, kZipDate, 2);
+	put_le(central, crc, 4);
+	put_le(central, large ? kZip64Mark : size, 4);
+	put_le(central, large ? kZip64Mark : size, 4);
+	put_le(central, name.size(), 2);
+	put_le(central, extra.empty() ? 0 : 4 + extra.size(), 2);
+	put_le(central, 0, 6);
+	put_le(central, 0, 4);
+	put_le(central, far ? kZip64Mark : offset, 4);
+	central += name;
+	if(!extra.empty())
+	  {
+	    put_le(central, 1, 2);
+	    put_le(central, extra.size(), 2);
+	    central += extra;
+	  }
+      }
+
+    const uint64_t count = tensors.size(), cd_offset = f.tellp(),
+      cd_size = central.size();
+    string end;
+    if(count >= 0xffff || cd_offset >= kZip64Mark || cd_size >= kZip64Mark)
+      {
+	const uint64_t at = cd_offset + cd_size;
+	put_le(end, kZip64End, 4);
+	put_le(end, kZip64EndSize - 12, 8);
+	put_le(end, 45, 2);
+	put_le(end, 45, 2);
+	put_le(end, 0, 8);
+	put_le(end, count, 8);
+	put_le(end, count, 8);
+	put_le(end, cd_size, 8);
+	put_le(end, cd_offset, 8);
+	put_le(end, kZip64Locator, 4);
+	put_le(end, 0, 4);
+	put_le(end, at, 8);
+	put_le(end, 1, 4);
+      }
+    put_le(end, kZipEnd, 4);
+    put_le(end, 0, 4);
+    put_le(end, std::min<uint64_t>(count, 0xffff), 2);
+    put_le(end, std::min<uint64_t>(count, 0xffff), 2);
+    put_le(end, std::min(cd_size, kZip64Mark), 4);
+    put_le(end, std::min(cd_offset, kZip64Mark), 4);
+    put_le(end, 0, 2);
+    f.write(central.data(), central.size());
+    f.write(end.data(), end.size());
+    if(!f) return false;
+  }
+  return 0 == std::rename(tmp.c_str(), path.c_str());
+}
+
+// ########################### read_npy ##############################
+bool read_npy(const string& path, Tensor *t)
+{
+  ifstream f{path, std::ios::binary};
+  NpyHeader h;
+  return f && read_npy_header(f, h) && matches(h, t)
+    && read_npy_data(f, h, t);
+}
+
+// ########################### write_npy #############################
+bool write_npy(const string& path, Tensor *t)
+{
+  const string tmp = path + ".tmp";
+  {
+    ofstream f{tmp, std::ios::binary};
+    if(!write_npy_data(f, t, nullptr)) return false;
+  }
+  return 0 == std::rename(tmp.c_str(), path.c_str());
+}
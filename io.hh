@@ -0,0 +1,89 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// import and export of networks as edge lists and NumPy arrays
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// forward declare to avoid dependencies between headers
+class Network;
+class Tensor;
+
+// Most legs, inputs and outputs together, of a tensor read from an
+// edge list.  Legs of rank 1 add no entries, so the size of a tensor
+// alone does not bound them.
+const size_t kEdgeListLegs = 256;
+
+// Networks are exchanged as two files: an edge list giving the shapes
+// of the tensors and their links, and an archive of NumPy arrays
+// holding their entries.
+//
+// The edge list is text with one record per line, and anything after
+// a '#' ignored:
+//
+//   tensor <inputs> <outputs> <input rank> <output rank>
+//   link <tensor> <input> <tensor> <output>
+//
+// Tensors are numbered from zero in the order of their records, and a
+// link joins the given input of the first tensor to the given output
+// of the second, as a NetworkEdge.  Links may precede the tensors they
+// name.
+//
+// The arrays of an archive (as written by numpy.savez()) are named t0,
+// t1, ..., one per tensor in the same numbering.  The array of a
+// tensor with n inputs and m outputs has shape (input rank, ...,
+// output rank, ...), with n copies of the first and m of the second,
+// in C order, so that its entry [i_1, ..., i_n, o_1, ..., o_m] is
+// entry({i_1, ..., i_n}, {o_1, ..., o_m}) of the tensor; an array of
+// shape (rows, columns) of the matrix is also accepted.  Arrays are
+// read as complex128 or float64, little-endian, and always written as
+// complex128.  Entries are moved in bulk between the file and the
+// storage of a tensor, which is replaced with set_matrix(), so that
+// loading runs at the speed of the disk.  Only uncompressed archives
+// are read (numpy.savez(), not numpy.savez_compressed()), and their
+// checksums are not verified.
+
+// Read the edge list at path and build its tensors and links in net.
+// Returns the id of the first tensor created, or kNoTensor if the file
+// cannot be read or describes an invalid network (including a tensor
+// of more than kEdgeListLegs legs), in which case net is left
+// unchanged.
+size_t read_edge_list(const std::string& path, Network& net);
+// Write the tensors of net and the links between them to path as an
+// edge list, returning false on failure.  Tensors are numbered in
+// order of id, skipping those destroyed, as by network_tensors().
+bool write_edge_list(const std::string& path, const Network& net);
+// The tensors of net with ids first onwards, skipping those destroyed:
+// the numbering of write_edge_list(), or with first the result of
+// read_edge_list(), that of the file read.
+std::vector<Tensor*> network_tensors(const Network& net, size_t first = 0);
+
+// Read the entries of tensors[i] from array ti of the .npz archive at
+// path, for every i.  The headers of all the arrays are checked before
+// any tensor is changed, and false is returned if one is missing or
+// does not match its tensor; a read error after that may leave some
+// tensors loaded.
+bool read_npz(const std::string& path, const std::vector<Tensor*>& tensors);
+// Write the entries of tensors[i] to path as array ti of an
+// uncompressed .npz archive, returning false on failure.
+bool write_npz(const std::string& path, const std::vector<Tensor*>& tensors);
+// Read or write the entries of a single tensor as a .npy file.
+bool read_npy(const std::string& path, Tensor *t);
+bool write_npy(const std::string& path, Tensor *t);
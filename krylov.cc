@@ -0,0 +1,165 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include "krylov.hh"
+#include "linalg.hh"
+#include "log_msg.hh"
+
+using std::complex;
+using std::vector;
+
+// ########################### dot ###################################
+static complex<double> dot(const vector<complex<double>>& x,
+			   const complex<double> *y)
+{
+  complex<double> ret;
+  for(size_t i = 0; i < x.size(); ++i) ret += std::conj(x[i]) * y[i];
+  return ret;
+}
+
+// ########################### normalize #############################
+// Scale x to unit norm, returning its former norm.
+static double normalize(vector<complex<double>>& x)
+{
+  double norm = 0;
+  for(const complex<double> &c : x) norm += std::norm(c);
+  norm = std::sqrt(norm);
+  if(0 != norm)
+    for(complex<double> &c : x) c /= norm;
+  return norm;
+}
+
+// ########################### krylov_search #########################
+// Restarted Arnoldi iteration with full reorthogonalization.  For a
+// Hermitian operator the projected matrix is tridiagonal, which is
+// imposed explicitly (the Lanczos method), and the lowest eigenvalue
+// is sought; otherwise the one of largest magnitude.
+static EigenPair krylov_search(const LinearMap& a, size_t n,
+			       const vector<complex<double>>& start,
+			       size_t krylov, double tolerance,
+			       size_t restarts, bool hermitian)
+{
+#ifndef NO_ERROR_CHECKING
+  if(0 == n || krylov < 2 || (!start.empty() && start.size() != n))
+    LOG_MSG_(FATAL) << kErrListLength << "Krylov eigensolver given a "
+      "space of dimension " << n << ", a start vector of length " <<
+      start.size() << " and " << krylov << " Krylov vectors";
+#endif // NO_ERROR_CHECKING
+
+  krylov = std::min(krylov, n);
+  EigenPair ret{0, start, 0, false, 0, 0};
+  // without a usable start vector, begin from a fixed generic one
+  if(0 == normalize(ret.vector) || ret.vector.size() != n)
+    {
+      ret.vector.resize(n);
+      for(size_t i = 0; i < n; ++i)
+	ret.vector[i] = complex<double>{1.0 + std::sin(1.0 + i), std::cos(i)};
+      normalize(ret.vector);
+    }
+
+  vector<vector<complex<double>>> basis;
+  vector<complex<double>> h(krylov*krylov), w(n);
+  for(ret.restarts = 0; ; ++ret.restarts)
+    {
+      basis.assign(1, ret.vector);
+      std::fill(h.begin(), h.end(), complex<double>{});
+      double beta = 0;
+      size_t m = 0;
+      while(m < krylov)
+	{
+	  a(basis[m].data(), w.data());
+	  ++ret.applications;
+	  // orthogonalize twice against the whole basis
+	  for(size_t pass = 0; pass < 2; ++pass)
+	    for(size_t j = 0; j <= m; ++j)
+	      {
+		const complex<double> c = dot(basis[j], w.data());
+		h[j*krylov + m] += c;
+		for(size_t i = 0; i < n; ++i) w[i] -= c * basis[j][i];
+	      }
+	  ++m;
+	  beta = normalize(w);
+	  // an invariant subspace has been found
+	  if(beta <= 1e-14 * std::abs(h[(m - 1)*krylov + m - 1]) || 0 == beta)
+	    {
+	      beta = 0;
+	      break;
+	    }
+	  if(m < krylov)
+	    {
+	      h[m*krylov + m - 1] = beta;
+	      basis.push_back(w);
+	    }
+	}
+
+      // the projected matrix, of size m
+      vector<complex<double>> p(m*m);
+      for(size_t i = 0; i < m; ++i)
+	for(size_t j = 0; j < m; ++j)
+	  p[i*m + j] = h[i*krylov + j];
+      if(hermitian)
+	{
+	  for(size_t i = 0; i < m; ++i)
+	    for(size_t j = 0; j < m; ++j)
+	      if(i == j)
+		p[i*m + j] = p[i*m + j].real();
+	      else if(j == i + 1)
+		p[i*m + j] = std::conj(p[j*m + i]);
+	      else if(i != j + 1)
+		p[i*m + j] = 0;
+	}
+
+      Eigensystem e = hessenberg_eigensystem(p.data(), m);
+      size_t best = 0;
+      for(size_t k = 1; k < m; ++k)
+	if(hermitian ? e.values[k].real() < e.values[best].real()
+	   : std::abs(e.values[k]) > std::abs(e.values[best]))
+	  best = k;
+
+      // Ritz vector, and its residual from the Arnoldi relation
+      ret.value = hermitian ? e.values[best].real() : e.values[best];
+      std::fill(ret.vector.begin(), ret.vector.end(), complex<double>{});
+      for(size_t k = 0; k < m; ++k)
+	for(size_t i = 0; i < n; ++i)
+	  ret.vector[i] += e.vectors[k*m + best] * basis[k][i];
+      normalize(ret.vector);
+      ret.residual = beta * std::abs(e.vectors[(m - 1)*m + best]);
+      ret.converged = ret.residual <= tolerance
+	* std::max(1.0, std::abs(ret.value));
+      if(ret.converged || ret.restarts >= restarts) break;
+    }
+
+  return ret;
+}
+
+// ########################### lanczos ###############################
+EigenPair lanczos(const LinearMap& a, size_t n,
+		  const vector<complex<double>>& start, size_t krylov,
+		  double tolerance, size_t restarts)
+{
+  return krylov_search(a, n, start, krylov, tolerance, restarts, true);
+}
+
+// ########################### arnoldi ###############################
+EigenPair arnoldi(const LinearMap& a, size_t n,
+		  const vector<complex<double>>& start, size_t krylov,
+		  double tolerance, size_t restarts)
+{
+  return krylov_search(a, n, start, krylov, tolerance, restarts, false);
+}
@@ -0,0 +1,67 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// matrix-free Krylov eigensolvers
+
+#pragma once
+
+#include <complex>
+#include <functional>
+#include <vector>
+
+// Defaults for the solvers below.
+const size_t kKrylovDimension = 20;
+const double kKrylovTolerance = 1e-10;
+const size_t kKrylovRestarts = 100;
+
+// A linear operator on vectors of length n, given only by its action
+// y = A x.  The operator is never formed as a matrix.
+typedef std::function<void(const std::complex<double> *x,
+			   std::complex<double> *y)> LinearMap;
+
+// An eigenvalue and its eigenvector, with statistics of the search.
+struct EigenPair
+{
+  std::complex<double> value;
+  // Of unit norm.
+  std::vector<std::complex<double>> vector;
+  // Norm of A x - value x.
+  double residual;
+  bool converged;
+  // Number of applications of the operator, and of restarts.
+  size_t applications;
+  size_t restarts;
+};
+
+// Find the lowest eigenvalue of the Hermitian operator a on vectors of
+// length n by the Lanczos method, restarting from the best Ritz vector
+// whenever krylov vectors have been built.  The search starts from
+// start when it is nonzero, so that a previous solution may be reused
+// as a warm start.  Converges once the residual is below tolerance
+// times the magnitude of the eigenvalue (or one, if larger).
+EigenPair lanczos(const LinearMap& a, size_t n,
+		  const std::vector<std::complex<double>>& start,
+		  size_t krylov = kKrylovDimension,
+		  double tolerance = kKrylovTolerance,
+		  size_t restarts = kKrylovRestarts);
+// Find the eigenvalue of largest magnitude of the general operator a
+// by the Arnoldi method, with the same conventions as lanczos().
+EigenPair arnoldi(const LinearMap& a, size_t n,
+		  const std::vector<std::complex<double>>& start,
+		  size_t krylov = kKrylovDimension,
+		  double tolerance = kKrylovTolerance,
+		  size_t restarts = kKrylovRestarts);
@@ -0,0 +1,348 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "linalg.hh"
+
+using std::complex;
+using std::vector;
+
+// Sweeps of Jacobi rotations after which the decomposition is
+// accepted even if not fully converged.
+const size_t kMaxJacobiSweeps = 64;
+
+// ########################### column_dot ############################
+// Inner product <x|y> of columns of an m-row column-major matrix.
+static complex<double> column_dot(const complex<double> *x,
+				  const complex<double> *y, size_t m)
+{
+  complex<double> ret;
+  for(size_t i = 0; i < m; ++i) ret += std::conj(x[i]) * y[i];
+  return ret;
+}
+
+// ########################### rotate ################################
+// Apply the rotation [x y] <- [c x - s e y, s x + c e y] to a pair of
+// columns, where e is a phase.
+static void rotate(complex<double> *x, complex<double> *y, size_t m,
+		   double c, double s, complex<double> e)
+{
+  for(size_t i = 0; i < m; ++i)
+    {
+      const complex<double> xi = x[i], yi = e * y[i];
+      x[i] = c*xi - s*yi;
+      y[i] = s*xi + c*yi;
+    }
+}
+
+// ########################### complete ##############################
+// Replace columns [r, k) of the m-row column-major matrix u, whose
+// first r columns are orthonormal, so that all k are.  Unit vectors
+// are orthogonalized against the columns already present.
+static void complete(vector<complex<double>>& u, size_t m, size_t k,
+		     size_t r)
+{
+  for(size_t j = r, e = 0; j < k && e < m; ++e)
+    {
+      complex<double> *c = &u[j*m];
+      std::fill(c, c + m, complex<double>{});
+      c[e] = 1;
+      // orthogonalize twice for numerical safety
+      for(size_t pass = 0; pass < 2; ++pass)
+	for(size_t l = 0; l < j; ++l)
+	  {
+	    const complex<double> d = column_dot(&u[l*m], c, m);
+	    for(size_t i = 0; i < m; ++i) c[i] -= d * u[l*m + i];
+	  }
+      const double norm = std::sqrt(std::real(column_dot(c, c, m)));
+      if(norm < 0.5) continue;
+      for(size_t i = 0; i < m; ++i) c[i] /= norm;
+      ++j;
+    }
+}
+
+// ########################### jacobi_svd ############################
+// Decompose a tall (m >= n) matrix given column-major in w, which is
+// overwritten.
+static SVD jacobi_svd(vector<complex<double>>& w, size_t m, size_t n)
+{
+  vector<complex<double>> v(n*n);
+  for(size_t j = 0; j < n; ++j) v[j*n + j] = 1;
+
+  // Rotate pairs of columns until all are mutually orthogonal.  Each
+  // rotation first removes the phase of their overlap and then acts
+  // as a real Jacobi rotation.
+  const double eps = std::numeric_limits<double>::epsilon();
+  for(size_t sweep = 0; sweep < kMaxJacobiSweeps; ++sweep)
+    {
+      bool rotated = false;
+      for(size_t p = 0; p + 1 < n; ++p)
+	for(size_t q = p + 1; q < n; ++q)
+	  {
+	    complex<double> *wp = &w[p*m], *wq = &w[q*m];
+	    const double alpha = std::real(column_dot(wp, wp, m)),
+	      beta = std::real(column_dot(wq, wq, m));
+	    const complex<double> gamma = column_dot(wp, wq, m);
+	    const double g = std::abs(gamma);
+	    if(g <= eps * std::sqrt(alpha * beta) || 0 == g) continue;
+	    rotated = true;
+
+	    const complex<double> e = std::conj(gamma) / g;
+	    const double zeta = (beta - alpha) / (2*g),
+	      t = (zeta < 0 ? -1.0 : 1.0)
+	      / (std::abs(zeta) + std::sqrt(1 + zeta*zeta)),
+	      c = 1 / std::sqrt(1 + t*t), s = c*t;
+	    rotate(wp, wq, m, c, s, e);
+	    rotate(&v[p*n], &v[q*n], n, c, s, e);
+	  }
+      if(!rotated) break;
+    }
+
+  // The singular values are the norms of the columns, sorted.
+  vector<double> norms(n);
+  vector<size_t> order(n);
+  for(size_t j = 0; j < n; ++j)
+    {
+      norms[j] = std::sqrt(std::real(column_dot(&w[j*m], &w[j*m], m)));
+      order[j] = j;
+    }
+  std::stable_sort(order.begin(), order.end(),
+		   [&norms](size_t x, size_t y) { return norms[x] > norms[y]; });
+
+  // Work column-major, converting to row-major at the end.
+  const double cutoff = eps * std::max<double>(m, 1) *
+    (0 == n ? 0 : norms[order[0]]);
+  vector<complex<double>> u(m*n), vc(n*n);
+  SVD ret{m, n, {}, vector<double>(n), {}};
+  size_t r = 0;
+  for(size_t j = 0; j < n; ++j)
+    {
+      const size_t o = order[j];
+      ret.s[j] = norms[o];
+      std::copy(&v[o*n], &v[o*n] + n, &vc[j*n]);
+      if(norms[o] > cutoff && 0 != norms[o])
+	{
+	  for(size_t i = 0; i < m; ++i) u[j*m + i] = w[o*m + i] / norms[o];
+	  ++r;
+	}
+      else
+	ret.s[j] = 0;
+    }
+  complete(u, m, n, r);
+
+  ret.u.resize(m*n);
+  ret.v.resize(n*n);
+  for(size_t j = 0; j < n; ++j)
+    {
+      for(size_t i = 0; i < m; ++i) ret.u[i*n + j] = u[j*m + i];
+      for(size_t i = 0; i < n; ++i) ret.v[i*n + j] = vc[j*n + i];
+    }
+  return ret;
+}
+
+// ########################### svd ###################################
+SVD svd(const complex<double> *a, size_t m, size_t n)
+{
+  // A wide matrix is handled through its conjugate transpose, whose
+  // factors are those of a with u and v exchanged.
+  const bool wide = m < n;
+  const size_t rows = wide ? n : m, cols = wide ? m : n;
+  vector<complex<double>> w(rows*cols);
+  for(size_t i = 0; i < m; ++i)
+    for(size_t j = 0; j < n; ++j)
+      if(wide)
+	w[i*n + j] = std::conj(a[i*n + j]);
+      else
+	w[j*m + i] = a[i*n + j];
+
+  SVD ret = jacobi_svd(w, rows, cols);
+  if(wide)
+    {
+      ret.u.swap(ret.v);
+      ret.rows = m;
+      ret.cols = n;
+    }
+  return ret;
+}
+
+// ########################### polar #################################
+vector<complex<double>> polar(const complex<double> *a, size_t m, size_t n)
+{
+  SVD d = svd(a, m, n);
+  const size_t k = std::min(m, n);
+  vector<complex<double>> ret(m*n);
+  for(size_t i = 0; i < m; ++i)
+    for(size_t j = 0; j < n; ++j)
+      {
+	complex<double> sum;
+	for(size_t l = 0; l < k; ++l)
+	  sum += d.u[i*k + l] * std::conj(d.v[j*k + l]);
+	ret[i*n + j] = sum;
+      }
+  return ret;
+}
+
+// ########################### orthonormalize ########################
+void orthonormalize(complex<double> *a, size_t m, size_t n)
+{
+  // as in svd(), work on the columns of a tall column-major matrix
+  const bool wide = m < n;
+  const size_t rows = wide ? n : m, cols = wide ? m : n;
+  vector<complex<double>> w(rows*cols);
+  for(size_t i = 0; i < m; ++i)
+    for(size_t j = 0; j < n; ++j)
+      if(wide)
+	w[i*n + j] = std::conj(a[i*n + j]);
+      else
+	w[j*m + i] = a[i*n + j];
+
+  // Modified Gram-Schmidt, orthogonalizing twice.  Dividing by the
+  // norm leaves the diagonal of R positive.  Columns which vanish are
+  // dropped and the set completed afterwards.
+  const double eps = std::numeric_limits<double>::epsilon();
+  size_t r = 0;
+  for(size_t j = 0; j < cols; ++j)
+    {
+      complex<double> *c = &w[r*rows];
+      if(r != j) std::copy(&w[j*rows], &w[j*rows] + rows, c);
+      const double before = std::sqrt(std::real(column_dot(c, c, rows)));
+      for(size_t pass = 0; pass < 2; ++pass)
+	for(size_t l = 0; l < r; ++l)
+	  {
+	    const complex<double> d = column_dot(&w[l*rows], c, rows);
+	    for(size_t i = 0; i < rows; ++i) c[i] -= d * w[l*rows + i];
+	  }
+      const double norm = std::sqrt(std::real(column_dot(c, c, rows)));
+      if(0 == norm || norm <= eps * rows * before) continue;
+      for(size_t i = 0; i < rows; ++i) c[i] /= norm;
+      ++r;
+    }
+  complete(w, rows, cols, r);
+
+  for(size_t i = 0; i < m; ++i)
+    for(size_t j = 0; j < n; ++j)
+      a[i*n + j] = wide ? std::conj(w[i*n + j]) : w[j*m + i];
+}
+
+// ########################### hessenberg_eigensystem ################
+Eigensystem hessenberg_eigensystem(const complex<double> *h, size_t m)
+{
+  // Reduce a copy of h to upper triangular (Schur) form t = q^dagger h
+  // q by Givens rotations, one shifted QR step at a time.
+  vector<complex<double>> t(m*m), q(m*m);
+  for(size_t i = 0; i < m; ++i)
+    {
+      q[i*m + i] = 1;
+      for(size_t j = (i ? i - 1 : 0); j < m; ++j) t[i*m + j] = h[i*m + j];
+    }
+
+  const double eps = std::numeric_limits<double>::epsilon();
+  vector<complex<double>> rot(2*m);
+  for(size_t hi = m ? m - 1 : 0, iter = 0; hi > 0 && iter < 64*m; ++iter)
+    {
+      // find the start of the unreduced block ending at hi
+      size_t lo = hi;
+      while(lo > 0 && std::abs(t[lo*m + lo - 1]) > eps *
+	    (std::abs(t[lo*m + lo]) + std::abs(t[(lo - 1)*m + lo - 1])))
+	--lo;
+      if(lo > 0) t[lo*m + lo - 1] = 0;
+      if(lo == hi)
+	{
+	  --hi;
+	  continue;
+	}
+
+      // Wilkinson shift from the trailing 2 x 2 block, perturbed
+      // every so often to escape cycles
+      const complex<double> a = t[(hi - 1)*m + hi - 1], b = t[(hi - 1)*m + hi],
+	c = t[hi*m + hi - 1], d = t[hi*m + hi];
+      const complex<double> tr = (a + d) / 2.0,
+	disc = std::sqrt((a - d) * (a - d) / 4.0 + b*c);
+      complex<double> mu = std::abs(tr + disc - d) < std::abs(tr - disc - d)
+	? tr + disc : tr - disc;
+      if(9 == iter % 10) mu = d + std::abs(c);
+
+      // QR factorize t - mu on the block, then multiply back as R Q
+      for(size_t k = lo; k <= hi; ++k) t[k*m + k] -= mu;
+      for(size_t k = lo; k < hi; ++k)
+	{
+	  const complex<double> x = t[k*m + k], y = t[(k + 1)*m + k];
+	  const double r = std::sqrt(std::norm(x) + std::norm(y));
+	  const complex<double> g0 = 0 == r ? 1.0 : x / r,
+	    g1 = 0 == r ? 0.0 : y / r;
+	  rot[2*k] = g0;
+	  rot[2*k + 1] = g1;
+	  for(size_t j = k; j < m; ++j)
+	    {
+	      const complex<double> u = t[k*m + j], v = t[(k + 1)*m + j];
+	      t[k*m + j] = std::conj(g0)*u + std::conj(g1)*v;
+	      t[(k + 1)*m + j] = -g1*u + g0*v;
+	    }
+	}
+      for(size_t k = lo; k < hi; ++k)
+	{
+	  const complex<double> g0 = rot[2*k], g1 = rot[2*k + 1];
+	  for(size_t i = 0; i <= std::min(k + 1, hi); ++i)
+	    {
+	      const complex<double> u = t[i*m + k], v = t[i*m + k + 1];
+	      t[i*m + k] = u*g0 + v*g1;
+	      t[i*m + k + 1] = -u*std::conj(g1) + v*std::conj(g0);
+	    }
+	  for(size_t i = 0; i < m; ++i)
+	    {
+	      const complex<double> u = q[i*m + k], v = q[i*m + k + 1];
+	      q[i*m + k] = u*g0 + v*g1;
+	      q[i*m + k + 1] = -u*std::conj(g1) + v*std::conj(g0);
+	    }
+	}
+      for(size_t k = lo; k <= hi; ++k) t[k*m + k] += mu;
+    }
+
+  // Eigenvectors of t by back substitution, transformed by q.
+  Eigensystem ret{vector<complex<double>>(m), vector<complex<double>>(m*m)};
+  vector<complex<double>> z(m);
+  for(size_t k = 0; k < m; ++k)
+    {
+      const complex<double> lambda = t[k*m + k];
+      ret.values[k] = lambda;
+      std::fill(z.begin(), z.end(), complex<double>{});
+      z[k] = 1;
+      for(size_t j = k; j-- > 0; )
+	{
+	  complex<double> sum;
+	  for(size_t l = j + 1; l <= k; ++l) sum += t[j*m + l] * z[l];
+	  complex<double> denom = t[j*m + j] - lambda;
+	  if(std::abs(denom) < eps * std::abs(lambda) || 0 == std::abs(denom))
+	    denom = eps * std::max(std::abs(lambda), 1.0);
+	  z[j] = -sum / denom;
+	}
+
+      double norm = 0;
+      for(size_t i = 0; i < m; ++i)
+	{
+	  complex<double> x;
+	  for(size_t l = 0; l <= k; ++l) x += q[i*m + l] * z[l];
+	  ret.vectors[i*m + k] = x;
+	  norm += std::norm(x);
+	}
+      norm = std::sqrt(norm);
+      for(size_t i = 0; i < m; ++i) ret.vectors[i*m + k] /= norm;
+    }
+  return ret;
+}
@@ -0,0 +1,67 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// dense complex linear algebra not provided by GSL
+
+#pragma once
+
+#include <complex>
+#include <vector>
+
+// Thin singular value decomposition a = u diag(s) v^dagger of an m x
+// n matrix, with k = min(m, n).  Matrices are dense and row-major.
+struct SVD
+{
+  size_t rows;
+  size_t cols;
+  // m x k, with orthonormal columns.  Columns whose singular value
+  // vanishes are completed to an orthonormal set.
+  std::vector<std::complex<double>> u;
+  // The k singular values, in decreasing order.
+  std::vector<double> s;
+  // n x k, with orthonormal columns.
+  std::vector<std::complex<double>> v;
+};
+
+// Eigenvalues and right eigenvectors of a square matrix.
+struct Eigensystem
+{
+  std::vector<std::complex<double>> values;
+  // Column k, of unit norm, belongs to values[k].  Row-major.
+  std::vector<std::complex<double>> vectors;
+};
+
+// Compute the singular value decomposition of the m x n row-major
+// matrix a, by one-sided Jacobi rotations.  GSL provides only a real
+// decomposition.
+SVD svd(const std::complex<double> *a, size_t m, size_t n);
+// The unitary polar factor u v^dagger of a: the m x n matrix with
+// orthonormal rows or columns (whichever are fewer) nearest to a.
+std::vector<std::complex<double>> polar(const std::complex<double> *a,
+					size_t m, size_t n);
+// Replace the m x n row-major matrix a by the Q factor of its QR
+// decomposition (of its conjugate transpose if m < n), taking the
+// diagonal of R real and positive.  The rows or columns of a,
+// whichever are fewer, become orthonormal.  Applied to a matrix of
+// independent complex Gaussians the result is Haar-distributed, at a
+// fraction of the cost of polar().
+void orthonormalize(std::complex<double> *a, size_t m, size_t n);
+// Compute the eigensystem of the m x m row-major upper Hessenberg
+// matrix h (entries below the subdiagonal are ignored) by shifted QR
+// iteration.  This is meant for the small projected matrices of
+// Krylov methods.
+Eigensystem hessenberg_eigensystem(const std::complex<double> *h, size_t m);
@@ -24,6 +24,7 @@ const char* kUnknownFile = "unknown file";
 const char* kErrBounds = "argument out of bounds: ";
 const char* kErrIncompatible = "incompatible objects: ";
 const char* kErrListLength = "list has illegal length: ";
+const char* kErrRace = "data race: ";
 
 LogMsg::LogMsg(LogSeverity severity, const char* file, int line)
     : severity_(severity) {
@@ -24,6 +24,7 @@ extern const char* kUnknownFile;
 extern const char* kErrBounds;
 extern const char* kErrIncompatible;
 extern const char* kErrListLength;
+extern const char* kErrRace;
 
 #define LOG_MSG_(severity) \
   LogMsg(LOG_##severity, __FILE__, __LINE__).GetStream()
@@ -15,10 +15,208 @@
 // along with Tensor Network.  If not, see
 // <http://www.gnu.org/licenses/>.
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
+// Variational MERA ground-state search for a chain Hamiltonian.  Each
+// sweep updates every tensor once; the energy per site and the time
+// taken are reported after each sweep, one line per sweep.
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "hamiltonian.hh"
+#include "mera.hh"
+#include "tensor.hh"
+
+using std::cerr;
+using std::cout;
+using std::string;
+
+// Settings of a run, with their defaults.
+struct DriverOptions
+{
+  string model = "ising";
+  double field = 1.0;
+  double delta = 1.0;
+  size_t layers = 3;
+  size_t chi = 4;
+  size_t sweeps = 100;
+  double tolerance = 1e-9;
+  unsigned seed = 0;
+  string checkpoint;
+  size_t checkpoint_every = 10;
+  string restart;
+  bool rollback = false;
+};
+
+// ########################### usage #################################
+static void usage(const char *name)
+{
+  cerr << "usage: " << name << " [options]\n"
+    "  --model ising|xxz      Hamiltonian (default ising)\n"
+    "  --field G              transverse field of the Ising model (1)\n"
+    "  --delta D              anisotropy of the XXZ model (1)\n"
+    "  --layers T             layers, for 2^(T+1) sites (3)\n"
+    "  --chi X                maximum bond dimension (4)\n"
+    "  --sweeps N             maximum number of sweeps (100)\n"
+    "  --tolerance E          stop once the energy changes by less (1e-9)\n"
+    "  --seed S               seed for the initial tensors (0)\n"
+    "  --checkpoint FILE      save the network to FILE\n"
+    "  --checkpoint-every N   sweeps between checkpoints (10)\n"
+    "  --restart FILE         start from a saved network\n"
+    "  --rollback             undo a sweep raising the energy, then stop\n";
+}
+
+// ########################### parse_count ###########################
+// Read the whole of s as a decimal count of at most max.  Signs are
+// refused, as strtoul() would silently negate a leading '-'.
+static bool parse_count(const char *s, size_t max, size_t& ret)
+{
+  if(*s < '0' || *s > '9')
+    return false;
+  char *end;
+  errno = 0;
+  const unsigned long long x = std::strtoull(s, &end, 10);
+  if('\0' != *end || ERANGE == errno || x > max)
+    return false;
+  ret = x;
+  return true;
+}
+
+// ########################### parse_real ############################
+// Read the whole of s as a finite real number.
+static bool parse_real(const char *s, double& ret)
+{
+  char *end;
+  errno = 0;
+  const double x = std::strtod(s, &end);
+  if(end == s || '\0' != *end || ERANGE == errno || !std::isfinite(x))
+    return false;
+  ret = x;
+  return true;
+}
+
+// ########################### parse_options #########################
+static bool parse_options(int argc, char **argv, DriverOptions& o)
+{
+  static const option long_options[] = {
+    {"model", required_argument, nullptr, 'm'},
+    {"field", required_argument, nullptr, 'g'},
+    {"delta", required_argument, nullptr, 'd'},
+    {"layers", required_argument, nullptr, 'l'},
+    {"chi", required_argument, nullptr, 'x'},
+    {"sweeps", required_argument, nullptr, 'n'},
+    {"tolerance", required_argument, nullptr, 't'},
+    {"seed", required_argument, nullptr, 's'},
+    {"checkpoint", required_argument, nullptr, 'c'},
+    {"checkpoint-every", required_argument, nullptr, 'e'},
+    {"restart", required_argument, nullptr, 'r'},
+    {"rollback", no_argument, nullptr, 'b'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  // 2^(layers+1) sites must be countable
+  const size_t max_layers = std::numeric_limits<size_t>::digits - 2,
+    max_size = std::numeric_limits<size_t>::max();
+  size_t seed = 0;
+  for(int c; -1 != (c = getopt_long(argc, argv, "", long_options, nullptr)); )
+    {
+      bool ok = true;
+      switch(c)
+	{
+	case 'm': o.model = optarg; break;
+	case 'g': ok = parse_real(optarg, o.field); break;
+	case 'd': ok = parse_real(optarg, o.delta); break;
+	case 'l': ok = parse_count(optarg, max_layers, o.layers); break;
+	case 'x': ok = parse_count(optarg, max_size, o.chi); break;
+	case 'n': ok = parse_count(optarg, max_size, o.sweeps); break;
+	case 't': ok = parse_real(optarg, o.tolerance); break;
+	case 's':
+	  ok = parse_count(optarg, std::numeric_limits<unsigned>::max(),
+			   seed);
+	  o.seed = seed;
+	  break;
+	case 'c': o.checkpoint = optarg; break;
+	case 'e':
+	  ok = parse_count(optarg, max_size, o.checkpoint_every);
+	  break;
+	case 'r': o.restart = optarg; break;
+	case 'b': o.rollback = true; break;
+	default: return false;
+	}
+      if(!ok)
+	return false;
+    }
+  return optind == argc && (o.model == "ising" || o.model == "xxz")
+    && o.layers > 0 && o.chi > 0;
+}
+
+// ########################### main ##################################
 int main(int argc, char **argv)
-#pragma clang diagnostic pop
 {
+  DriverOptions o;
+  if(!parse_options(argc, argv, o))
+    {
+      usage(argv[0]);
+      return 1;
+    }
+
+  const BondHamiltonian h = o.model == "ising" ? ising_hamiltonian(o.field)
+    : xxz_hamiltonian(o.delta);
+  BinaryMera mera{o.layers, h.dim, o.chi, o.seed};
+  if(!o.restart.empty() && !mera.load(o.restart))
+    {
+      cerr << "unable to restart from " << o.restart << "\n";
+      return 1;
+    }
+
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point start = Clock::now();
+  double e = energy(mera, h);
+  cout << "# model " << h.name << " sites " << mera.length() << " chi " <<
+    o.chi << " tensors " << mera.tensors().size() << "\n"
+    "# sweep energy change seconds updates/s total_seconds\n"
+    << std::setprecision(12) << 0 << " " << e << " 0 0 0 0" << std::endl;
+
+  for(size_t s = 1; s <= o.sweeps; ++s)
+    {
+      // sweeps publish new matrices, so the snapshot copies no data
+      std::vector<std::shared_ptr<Matrix>> saved;
+      if(o.rollback) saved = snapshot(mera.tensors());
+
+      const Clock::time_point t0 = Clock::now();
+      const size_t updates = sweep(mera, h);
+      double next = energy(mera, h);
+      const Clock::time_point t1 = Clock::now();
+      const double seconds = std::chrono::duration<double>(t1 - t0).count();
+
+      cout << s << " " << next << " " << next - e << " " << seconds << " "
+	   << updates / seconds << " "
+	   << std::chrono::duration<double>(t1 - start).count() << std::endl;
+
+      bool converged = std::abs(next - e) < o.tolerance;
+      if(o.rollback && next > e)
+	{
+	  restore(mera.tensors(), saved);
+	  cout << "# sweep " << s << " raised the energy; rolled back" <<
+	    std::endl;
+	  next = e;
+	  converged = true;
+	}
+      e = next;
+      if(!o.checkpoint.empty() && (converged || s == o.sweeps
+				   || (o.checkpoint_every > 0
+				       && 0 == s % o.checkpoint_every))
+	 && !mera.save(o.checkpoint))
+	cerr << "unable to write checkpoint " << o.checkpoint << "\n";
+      if(converged) break;
+    }
+
   return 0;
 }
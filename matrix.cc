@@ -24,6 +24,7 @@
 
 using std::complex;
 
+// ########################### GSLMatrix #############################
 // ########################### constructor ###########################
 GSLMatrix::GSLMatrix(size_t n1, size_t n2)
 {
@@ -49,6 +50,41 @@ void GSLMatrix::set(size_t i, size_t j, const complex<double>& c)
     gsl_matrix_complex_set( _matrix, i, j, _complex_to_gsl(c) );
 }
 
+// ########################### rows ##################################
+size_t GSLMatrix::rows()
+{
+  return _matrix->size1;
+}
+
+// ########################### cols ##################################
+size_t GSLMatrix::cols()
+{
+  return _matrix->size2;
+}
+
+// ########################### data ##################################
+complex<double>* GSLMatrix::data()
+{
+  // gsl_matrix_complex_alloc() always produces a matrix without
+  // padding (tda == size2), and gsl stores each entry as a pair of
+  // doubles, which is layout-compatible with std::complex<double>.
+  return reinterpret_cast<complex<double>*>(_matrix->data);
+}
+
+// ########################### clone #################################
+Matrix* GSLMatrix::clone()
+{
+  GSLMatrix *m = new GSLMatrix{_matrix->size1, _matrix->size2};
+  gsl_matrix_complex_memcpy(m->_matrix, _matrix);
+  return m;
+}
+
+// ########################### scaled_identity #######################
+bool GSLMatrix::scaled_identity(complex<double>&)
+{
+  return false;
+}
+
 // ########################### complex_from_gsl ######################
 complex<double> GSLMatrix::_complex_from_gsl(const gsl_complex& c)
 {
@@ -62,3 +98,81 @@ gsl_complex GSLMatrix::_complex_to_gsl(const complex<double>& c)
   GSL_SET_COMPLEX(&cc, c.real(), c.imag());
   return cc;
 }
+
+// ########################### ScaledIdentityMatrix ##################
+// ########################### constructor ###########################
+ScaledIdentityMatrix::ScaledIdentityMatrix(size_t n1, size_t n2,
+					   const complex<double>& scale)
+  : _rows{n1}, _cols{n2}, _scale{scale}, _matrix{nullptr}
+{
+}
+
+// ########################### destructor ############################
+ScaledIdentityMatrix::~ScaledIdentityMatrix()
+{
+  delete _matrix.load();
+}
+
+// ########################### get ###################################
+complex<double> ScaledIdentityMatrix::get(size_t i, size_t j)
+{
+  GSLMatrix *m = _matrix.load();
+  if(nullptr != m) return m->get(i, j);
+  return i == j ? _scale : complex<double>{};
+}
+
+// ########################### set ###################################
+void ScaledIdentityMatrix::set(size_t i, size_t j, const complex<double>& c)
+{
+  _stored()->set(i, j, c);
+}
+
+// ########################### rows ##################################
+size_t ScaledIdentityMatrix::rows()
+{
+  return _rows;
+}
+
+// ########################### cols ##################################
+size_t ScaledIdentityMatrix::cols()
+{
+  return _cols;
+}
+
+// ########################### data ##################################
+complex<double>* ScaledIdentityMatrix::data()
+{
+  return _stored()->data();
+}
+
+// ########################### clone #################################
+Matrix* ScaledIdentityMatrix::clone()
+{
+  GSLMatrix *m = _matrix.load();
+  if(nullptr != m) return m->clone();
+  return new ScaledIdentityMatrix{_rows, _cols, _scale};
+}
+
+// ########################### scaled_identity #######################
+bool ScaledIdentityMatrix::scaled_identity(complex<double>& scale)
+{
+  // once stored, the entries may have been written
+  if(nullptr != _matrix.load()) return false;
+  scale = _scale;
+  return true;
+}
+
+// ########################### _stored ###############################
+GSLMatrix* ScaledIdentityMatrix::_stored()
+{
+  std::call_once(_allocated, [this]()
+		 {
+		   // GSLMatrix starts as the identity
+		   GSLMatrix *m = new GSLMatrix{_rows, _cols};
+		   if(complex<double>{1} != _scale)
+		     for(size_t i = 0; i < _rows && i < _cols; ++i)
+		       m->data()[i*_cols + i] = _scale;
+		   _matrix.store(m);
+		 });
+  return _matrix.load();
+}
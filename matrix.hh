@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <complex>
+#include <mutex>
 #include <gsl/gsl_complex.h>
 #include <gsl/gsl_matrix_complex_double.h>
 
@@ -27,6 +29,19 @@ public:
   virtual ~Matrix() {};
   virtual std::complex<double> get(size_t i, size_t j) = 0;
   virtual void set(size_t i, size_t j, const std::complex<double>& c) = 0;
+  // Dimensions of the matrix.
+  virtual size_t rows() = 0;
+  virtual size_t cols() = 0;
+  // Expose the underlying storage, which must be contiguous and
+  // row-major.  This allows the contraction kernels to bypass the
+  // per-entry interface.
+  virtual std::complex<double>* data() = 0;
+  // A new matrix holding a copy of the entries, owned by the caller.
+  virtual Matrix* clone() = 0;
+  // Whether the matrix is known to be scale times the identity (ones
+  // on the diagonal i == j) without reading its entries, and if so
+  // set scale.  Callers may then avoid data().
+  virtual bool scaled_identity(std::complex<double>& scale) = 0;
 };
 
 class GSLMatrix : public Matrix
@@ -38,6 +53,11 @@ public:
   ~GSLMatrix();
   std::complex<double> get(size_t i, size_t j) override;
   void set(size_t i, size_t j, const std::complex<double>& c) override;
+  size_t rows() override;
+  size_t cols() override;
+  std::complex<double>* data() override;
+  Matrix* clone() override;
+  bool scaled_identity(std::complex<double>& scale) override;
 protected:
   // Convert between C++ and GSL representations of complex numbers.
   std::complex<double> _complex_from_gsl(const gsl_complex& c);
@@ -45,3 +65,34 @@ protected:
 private:
   gsl_matrix_complex* _matrix;
 };
+
+// A multiple of the identity, including the zero matrix, which is not
+// stored until needed.  Entries are computed by get() until the first
+// call to set() or data(), which allocates a GSLMatrix holding them;
+// the matrix then behaves as that one.  As data() may be called by
+// concurrent readers, allocation happens once under a lock.
+class ScaledIdentityMatrix : public Matrix
+{
+public:
+  ScaledIdentityMatrix(size_t n1, size_t n2,
+		       const std::complex<double>& scale = 1);
+  ScaledIdentityMatrix(const ScaledIdentityMatrix&) = delete;
+  ScaledIdentityMatrix operator= (const ScaledIdentityMatrix&) = delete;
+  ~ScaledIdentityMatrix();
+  std::complex<double> get(size_t i, size_t j) override;
+  void set(size_t i, size_t j, const std::complex<double>& c) override;
+  size_t rows() override;
+  size_t cols() override;
+  std::complex<double>* data() override;
+  Matrix* clone() override;
+  bool scaled_identity(std::complex<double>& scale) override;
+protected:
+  // The stored matrix, allocated on first use.
+  GSLMatrix* _stored();
+private:
+  size_t _rows;
+  size_t _cols;
+  std::complex<double> _scale;
+  std::atomic<GSLMatrix*> _matrix;
+  std::once_flag _allocated;
+};
@@ -0,0 +1,392 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include "dag.hh"
+#include "expectation.hh"
+#include "initialize.hh"
+#include "krylov.hh"
+#include "linalg.hh"
+#include "log_msg.hh"
+#include "matrix.hh"
+#include "mera.hh"
+#include "plan.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::ifstream;
+using std::make_shared;
+using std::ofstream;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+// Tag and version written at the head of every checkpoint.
+const char* const kMeraFileTag = "tensor-network-mera";
+const int kMeraFileVersion = 1;
+
+// ########################### publish ###############################
+// Publish data, laid out as t->matrix().matrix, as the new matrix of t
+// so that threads reading t meanwhile see either the old or new data.
+static void publish(Tensor *t, const vector<complex<double>>& data)
+{
+  shared_ptr<Matrix> old = t->matrix().matrix;
+  shared_ptr<Matrix> m = make_shared<GSLMatrix>(old->rows(), old->cols());
+  std::copy(data.begin(), data.end(), m->data());
+  t->set_matrix(m);
+}
+
+// ########################### bond_operators ########################
+// One operator for every bond of the chain, all sharing op.
+static vector<LocalOperator> bond_operators(BinaryMera& m, Tensor *op)
+{
+  vector<LocalOperator> ops;
+  for(size_t j = 0; j < m.length(); ++j)
+    ops.push_back(LocalOperator{op, {m.site(j), m.site((j + 1) % m.length())}});
+  return ops;
+}
+
+// ########################### descending_operands ###################
+// Operands of the descending superoperator, labelled as in descend():
+// the density matrix takes labels 0-3, and the result 8, 9, 12, 13.
+static vector<TensorView> descending_operands(const DenseTensor& rho,
+					      Tensor *w, Tensor *u)
+{
+  TensorView r = rho.view();
+  r.labels = {0, 1, 2, 3};
+  return vector<TensorView>{
+    r,
+    tensor_view(w, {0}, {4, 5}), tensor_view(w, {1}, {6, 7}),
+    tensor_view(u, {5, 6}, {8, 9}),
+    tensor_view(w->matrix(true), {4, 10}, {2}),
+    tensor_view(w->matrix(true), {11, 7}, {3}),
+    tensor_view(u->matrix(true), {12, 13}, {10, 11}) };
+}
+
+// ########################### BinaryMera ############################
+// ########################### constructor ###########################
+BinaryMera::BinaryMera(size_t layers, size_t dim, size_t chi, unsigned seed)
+  : _layers{layers}, _dim{dim}, _chi{chi}, _top{nullptr},
+    _isometries(layers), _disentanglers(layers)
+{
+#ifndef NO_ERROR_CHECKING
+  if(0 == layers || 0 == dim || 0 == chi)
+    LOG_MSG_(FATAL) << kErrBounds << "BinaryMera needs at least one layer "
+      "and nonzero dimensions, given " << layers << " layers, site "
+      "dimension " << dim << " and bond dimension " << chi;
+#endif // NO_ERROR_CHECKING
+
+  // Tensors are created layer by layer from the bottom, disentanglers
+  // before isometries, and the top last, which is also the order of
+  // _tensors.  first[t] is the id of the first tensor of layer t.
+  vector<NetworkShape> shapes;
+  vector<size_t> first(layers);
+  // rank is the bond dimension below the current layer
+  size_t rank = dim;
+  for(size_t t = 0; t < layers; ++t)
+    {
+      const size_t n = length() >> t, up = std::min(chi, rank*rank);
+      first[t] = shapes.size();
+      shapes.insert(shapes.end(), n/2, NetworkShape{2, 2, rank, rank});
+      shapes.insert(shapes.end(), n/2, NetworkShape{1, 2, up, rank});
+      rank = up;
+    }
+  shapes.push_back(NetworkShape{0, 2, 0, rank});
+
+  auto dis = [&](size_t t, size_t i) { return first[t] + i; };
+  auto iso = [&](size_t t, size_t i)
+    { return first[t] + (length() >> t)/2 + i; };
+  vector<NetworkEdge> edges;
+  for(size_t t = 0; t < layers; ++t)
+    {
+      const size_t n = length() >> t;
+      for(size_t i = 0; i < n/2; ++i)
+	{
+	  const size_t u = dis(t, i);
+	  edges.push_back(NetworkEdge{u, 0, iso(t, i), 1});
+	  edges.push_back(NetworkEdge{u, 1, iso(t, (i + 1) % (n/2)), 0});
+	  if(0 == t) continue;
+	  edges.push_back(NetworkEdge{iso(t - 1, 2*i + 1), 0, u, 0});
+	  edges.push_back(NetworkEdge{iso(t - 1, (2*i + 2) % n), 0, u, 1});
+	}
+    }
+  const size_t top = shapes.size() - 1;
+  edges.push_back(NetworkEdge{iso(layers - 1, 0), 0, top, 0});
+  edges.push_back(NetworkEdge{iso(layers - 1, 1), 0, top, 1});
+
+  // the network is empty, so ids index _tensors
+  _network.build(shapes, edges);
+  for(size_t k = 0; k < shapes.size(); ++k)
+    _tensors.push_back(_network.tensor(k));
+  for(size_t t = 0; t < layers; ++t)
+    for(size_t i = 0; i < (length() >> t)/2; ++i)
+      {
+	_disentanglers[t].push_back(_tensors[dis(t, i)]);
+	_isometries[t].push_back(_tensors[iso(t, i)]);
+      }
+  _top = _tensors[top];
+
+  initialize(_tensors, INIT_HAAR, seed);
+}
+
+// ########################### layers ################################
+size_t BinaryMera::layers()
+{
+  return _layers;
+}
+
+// ########################### dim ###################################
+size_t BinaryMera::dim()
+{
+  return _dim;
+}
+
+// ########################### chi ###################################
+size_t BinaryMera::chi()
+{
+  return _chi;
+}
+
+// ########################### length ################################
+size_t BinaryMera::length()
+{
+  return static_cast<size_t>(2) << _layers;
+}
+
+// ########################### top ###################################
+Tensor* BinaryMera::top()
+{
+  return _top;
+}
+
+// ########################### isometry ##############################
+Tensor* BinaryMera::isometry(size_t layer, size_t i)
+{
+  return _isometries.at(layer).at(i);
+}
+
+// ########################### disentangler ##########################
+Tensor* BinaryMera::disentangler(size_t layer, size_t i)
+{
+  return _disentanglers.at(layer).at(i);
+}
+
+// ########################### site ##################################
+GraphEdge BinaryMera::site(size_t n)
+{
+  // odd sites are the first output of a disentangler, even sites the
+  // second output of the one to their left
+  const size_t half = length() / 2;
+  if(n % 2)
+    return GraphEdge{nullptr, 0, _disentanglers[0].at(n / 2), 0};
+  return GraphEdge{nullptr, 0, _disentanglers[0].at((n / 2 + half - 1) % half),
+      1};
+}
+
+// ########################### tensors ###############################
+const vector<Tensor*>& BinaryMera::tensors()
+{
+  return _tensors;
+}
+
+// ########################### save ##################################
+bool BinaryMera::save(const string& path)
+{
+  // Write to a temporary file and rename it into place, so that an
+  // interrupted run never leaves a truncated checkpoint.
+  const string tmp = path + ".tmp";
+  {
+    ofstream f{tmp};
+    f << kMeraFileTag << " " << kMeraFileVersion << "\n" << _layers << " "
+      << _dim << " " << _chi << " " << _tensors.size() << "\n"
+      << std::setprecision(17);
+    for(Tensor *t : _tensors)
+      {
+	MatrixStruct m = t->matrix();
+	const size_t n = m.matrix->rows() * m.matrix->cols();
+	f << m.matrix->rows() << " " << m.matrix->cols();
+	for(size_t i = 0; i < n; ++i)
+	  f << " " << m.matrix->data()[i].real() << " "
+	    << m.matrix->data()[i].imag();
+	f << "\n";
+      }
+    if(!f) return false;
+  }
+  return 0 == std::rename(tmp.c_str(), path.c_str());
+}
+
+// ########################### load ##################################
+bool BinaryMera::load(const string& path)
+{
+  ifstream f{path};
+  string tag;
+  int version = 0;
+  size_t layers = 0, dim = 0, chi = 0, count = 0;
+  f >> tag >> version >> layers >> dim >> chi >> count;
+  if(!f || tag != kMeraFileTag || version != kMeraFileVersion
+     || layers != _layers || dim != _dim || chi != _chi
+     || count != _tensors.size())
+    return false;
+
+  // read everything before touching the network
+  vector<vector<complex<double>>> data(count);
+  for(size_t k = 0; k < count; ++k)
+    {
+      MatrixStruct m = _tensors[k]->matrix();
+      size_t rows = 0, cols = 0;
+      f >> rows >> cols;
+      if(!f || rows != m.matrix->rows() || cols != m.matrix->cols())
+	return false;
+      data[k].resize(rows*cols);
+      for(complex<double> &x : data[k])
+	{
+	  double re = 0, im = 0;
+	  f >> re >> im;
+	  x = complex<double>{re, im};
+	}
+    }
+  if(!f) return false;
+
+  for(size_t k = 0; k < count; ++k)
+    publish(_tensors[k], data[k]);
+  return true;
+}
+
+// ###################################################################
+
+// ########################### energy ################################
+double energy(BinaryMera& m, const BondHamiltonian& h)
+{
+  Tensor *op = bond_operator(h);
+  double e = 0;
+  for(const complex<double> &x : expectation(m.top(), bond_operators(m, op)))
+    e += x.real();
+  delete op;
+  return e / m.length();
+}
+
+// ########################### sweep #################################
+size_t sweep(BinaryMera& m, const BondHamiltonian& h)
+{
+  Tensor *op = bond_operator(h, bond_bound(h));
+  vector<LocalOperator> ops = bond_operators(m, op);
+  // Partial contractions are kept across the sweep, so that each
+  // environment recomputes only those depending on updated tensors.
+  ContractionDag cache{true};
+
+  size_t updated = 0;
+  for(Tensor *t : m.tensors())
+    {
+      MatrixStruct mat = t->matrix();
+      const size_t rows = mat.matrix->rows(), cols = mat.matrix->cols();
+      const complex<double> *data = mat.matrix->data();
+
+      // The energy is quadratic in the top tensor, which is therefore
+      // the lowest eigenvector of its environment regarded as a linear
+      // map.  The map is applied by contraction, starting from the
+      // current top.
+      if(t == m.top())
+	{
+	  LinearMap heff = [&](const complex<double> *x, complex<double> *y)
+	    {
+	      publish(t, vector<complex<double>>(x, x + cols));
+	      DenseTensor e = environment(m.top(), ops, t, &cache);
+	      std::copy(e.data.begin(), e.data.end(), y);
+	    };
+	  EigenPair p = lanczos(heff, cols,
+				vector<complex<double>>(data, data + cols));
+	  publish(t, p.vector);
+	  ++updated;
+	  continue;
+	}
+
+      DenseTensor env = environment(m.top(), ops, t, &cache);
+      vector<complex<double>> p = polar(env.data.data(), rows, cols);
+      for(complex<double> &x : p) x = -x;
+      publish(t, p);
+      ++updated;
+    }
+
+  delete op;
+  return updated;
+}
+
+// ########################### descend ###############################
+DenseTensor descend(const DenseTensor& rho, Tensor *w, Tensor *u)
+{
+#ifndef NO_ERROR_CHECKING
+  if(w->inputs() != 1 || w->outputs() != 2 || u->inputs() != 2
+     || u->outputs() != 2 || rho.dims.size() != 4)
+    LOG_MSG_(FATAL) << kErrIncompatible << "descend() needs a two-site "
+      "density matrix, an isometry with one input and two outputs, and a "
+      "disentangler with two of each";
+#endif // NO_ERROR_CHECKING
+
+  vector<TensorView> operands = descending_operands(rho, w, u);
+  DenseTensor ret = execute(greedy_plan(operands), operands)
+    .permuted({8, 9, 12, 13});
+  ret.labels = {0, 1, 2, 3};
+  return ret;
+}
+
+// ########################### scale_invariant_density_matrix ########
+DenseTensor scale_invariant_density_matrix(Tensor *w, Tensor *u,
+					   const DenseTensor& start)
+{
+  const size_t chi = u->output_rank(), n = chi*chi*chi*chi;
+  DenseTensor rho{{chi, chi, chi, chi}, {0, 1, 2, 3}};
+
+#ifndef NO_ERROR_CHECKING
+  if(w->input_rank() != chi || w->output_rank() != chi
+     || u->input_rank() != chi)
+    LOG_MSG_(FATAL) << kErrIncompatible << "a scale-invariant layer needs "
+      "equal ranks on every leg";
+  if(!start.data.empty() && start.data.size() != n)
+    LOG_MSG_(FATAL) << kErrListLength << "start passed to "
+      "scale_invariant_density_matrix() has " << start.data.size() <<
+      " entries, but " << n << " were expected";
+#endif // NO_ERROR_CHECKING
+
+  // The plan depends only on the shapes of the operands, so it is
+  // made once and reused for every application of the superoperator.
+  const ContractionPlan plan = greedy_plan(descending_operands(rho, w, u));
+  LinearMap down = [&](const complex<double> *x, complex<double> *y)
+    {
+      std::copy(x, x + n, rho.data.begin());
+      vector<TensorView> operands = descending_operands(rho, w, u);
+      DenseTensor r = execute(plan, operands).permuted({8, 9, 12, 13});
+      std::copy(r.data.begin(), r.data.end(), y);
+    };
+
+  // start from the maximally mixed state unless told otherwise
+  vector<complex<double>> x0 = start.data;
+  if(x0.empty())
+    {
+      x0.resize(n);
+      for(size_t i = 0; i < chi*chi; ++i) x0[i*chi*chi + i] = 1;
+    }
+  EigenPair p = arnoldi(down, n, x0);
+
+  // fix the normalization and phase by making the trace one
+  complex<double> trace;
+  for(size_t i = 0; i < chi*chi; ++i) trace += p.vector[i*chi*chi + i];
+  for(size_t i = 0; i < n; ++i) rho.data[i] = p.vector[i] / trace;
+  return rho;
+}
@@ -0,0 +1,101 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// binary MERA on a periodic chain and its variational optimization
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "contract.hh"
+#include "graph.hh"
+#include "hamiltonian.hh"
+#include "network.hh"
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+
+// A binary MERA on a periodic chain of 2^(layers+1) sites.  Layer 0 is
+// at the bottom.  Layer t acts on n = 2^(layers+1-t) sites: isometry i
+// maps site i of the layer above to sites 2i and 2i+1, after which
+// disentangler i acts on sites 2i+1 and 2i+2 (mod n).  A top tensor
+// with two outputs sits above the last layer.  Bond dimensions grow
+// from the site dimension by squaring until they reach chi.
+class BinaryMera
+{
+public:
+  // Build the network with every tensor a Haar-random isometry, as
+  // initialize() with INIT_HAAR and seed.
+  BinaryMera(size_t layers, size_t dim, size_t chi, unsigned seed = 0);
+  BinaryMera(const BinaryMera&) = delete;
+  BinaryMera& operator=(const BinaryMera&) = delete;
+  size_t layers();
+  size_t dim();
+  size_t chi();
+  // Number of sites at the bottom.
+  size_t length();
+  Tensor* top();
+  Tensor* isometry(size_t layer, size_t i);
+  Tensor* disentangler(size_t layer, size_t i);
+  // Site n at the bottom, as a graph endpoint.
+  GraphEdge site(size_t n);
+  // Every tensor, layer by layer from the bottom (disentanglers, then
+  // isometries) and finally the top.  Sweeps update in this order.
+  const std::vector<Tensor*>& tensors();
+  // Write the tensors to path, or replace them with those read from
+  // path, returning false on failure.  A checkpoint can only be
+  // loaded into a network of the same shape.
+  bool save(const std::string& path);
+  bool load(const std::string& path);
+private:
+  size_t _layers;
+  size_t _dim;
+  size_t _chi;
+  // Owns every tensor.
+  Network _network;
+  Tensor *_top;
+  std::vector<std::vector<Tensor*>> _isometries;
+  std::vector<std::vector<Tensor*>> _disentanglers;
+  std::vector<Tensor*> _tensors;
+};
+
+// Energy per site of the state described by m.
+double energy(BinaryMera& m, const BondHamiltonian& h);
+// Replace every tensor of m in turn by the isometry minimizing the
+// energy linearized about the current state: minus the polar factor
+// of its environment, computed for the Hamiltonian shifted to be
+// negative so that each update lowers the energy.  The top tensor is
+// instead replaced by the lowest eigenvector of its environment, found
+// by the Lanczos method starting from the current top.  Returns the
+// number of tensors updated.
+size_t sweep(BinaryMera& m, const BondHamiltonian& h);
+
+// Apply the descending superoperator of a scale-invariant binary MERA
+// layer with isometry w and disentangler u (all legs of one rank) to
+// the density matrix rho of two neighbouring sites, giving that of
+// the two sites below the disentangler joining them.  Density
+// matrices have legs as for reduced_density_matrix().
+DenseTensor descend(const DenseTensor& rho, Tensor *w, Tensor *u);
+// The density matrix of the two sites below any disentangler of a
+// scale-invariant MERA built from w and u at every scale: the fixed
+// point of descend().  It is found by the Arnoldi method, applying
+// the superoperator only through contractions, starting from start
+// (for instance the previous solution) or if that is empty from the
+// maximally mixed state.  The result has unit trace.
+DenseTensor scale_invariant_density_matrix(Tensor *w, Tensor *u,
+					   const DenseTensor& start
+					   = DenseTensor{});
@@ -0,0 +1,528 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <cmath>
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_complex_math.h>
+#include "initialize.hh"
+#include "krylov.hh"
+#include "linalg.hh"
+#include "log_msg.hh"
+#include "matrix.hh"
+#include "mps.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+// Terms of the operator-Schmidt decomposition of a bond term whose
+// singular values are below this fraction of the largest are dropped.
+const double kSchmidtTolerance = 1e-12;
+
+// ########################### publish ###############################
+// Publish data, laid out as t->matrix().matrix, as the new matrix of t.
+static void publish(Tensor *t, const vector<complex<double>>& data)
+{
+  shared_ptr<Matrix> old = t->matrix().matrix;
+  shared_ptr<Matrix> m = make_shared<GSLMatrix>(old->rows(), old->cols());
+  std::copy(data.begin(), data.end(), m->data());
+  t->set_matrix(m);
+}
+
+// ########################### gemm ##################################
+// c = op(a) op(b) for row-major matrices, where op(a) is m x k and
+// op(b) is k x n, and a and b are stored with leading dimensions lda
+// and ldb.
+static void gemm(CBLAS_TRANSPOSE_t ta, CBLAS_TRANSPOSE_t tb, size_t m,
+		 size_t n, size_t k, const complex<double> *a, size_t lda,
+		 const complex<double> *b, size_t ldb, complex<double> *c)
+{
+  gsl_matrix_complex_const_view av =
+    gsl_matrix_complex_const_view_array_with_tda
+    (reinterpret_cast<const double*>(a), CblasNoTrans == ta ? m : k,
+     CblasNoTrans == ta ? k : m, lda);
+  gsl_matrix_complex_const_view bv =
+    gsl_matrix_complex_const_view_array_with_tda
+    (reinterpret_cast<const double*>(b), CblasNoTrans == tb ? k : n,
+     CblasNoTrans == tb ? n : k, ldb);
+  gsl_matrix_complex_view cv = gsl_matrix_complex_view_array
+    (reinterpret_cast<double*>(c), m, n);
+  gsl_blas_zgemm(ta, tb, GSL_COMPLEX_ONE, &av.matrix, &bv.matrix,
+		 GSL_COMPLEX_ZERO, &cv.matrix);
+}
+
+// ########################### operator_block ########################
+// The tensor w of a matrix product operator, with physical dimension
+// dim and bonds of dimension ml (left) and mr (right) in use,
+// rearranged as a matrix for the kernels below: for a left
+// environment [bra][right][left][ket], and otherwise
+// [left][bra][ket][right].
+static vector<complex<double>> operator_block(Tensor *w, size_t dim,
+					      size_t ml, size_t mr, bool left)
+{
+  MatrixStruct m = w->matrix();
+  const complex<double> *p = m.matrix->data();
+  const size_t pl = m.matrix->rows() / dim, pr = m.matrix->cols() / dim;
+  vector<complex<double>> ret(dim*dim*ml*mr);
+  for(size_t s = 0; s < dim; ++s)
+    for(size_t a = 0; a < ml; ++a)
+      for(size_t t = 0; t < dim; ++t)
+	for(size_t b = 0; b < mr; ++b)
+	  {
+	    const complex<double> x = p[(s*pl + a)*dim*pr + t*pr + b];
+	    if(left)
+	      ret[((s*mr + b)*ml + a)*dim + t] = x;
+	    else
+	      ret[((a*dim + s)*dim + t)*mr + b] = x;
+	  }
+  return ret;
+}
+
+// ########################### extend_left ###########################
+// Contract the site tensor a[left][dim][right] and the block w of the
+// operator on that site into env[left][ml][left], the environment of
+// the sites to its left, giving that of the next site.  Each step is
+// a single matrix product, or one per left index.
+static vector<complex<double>> extend_left(const vector<complex<double>>& env,
+					   const complex<double> *a,
+					   const vector<complex<double>>& w,
+					   size_t left, size_t dim,
+					   size_t right, size_t ml, size_t mr)
+{
+  // x[bra][ml][ket][right], then y[bra][bra'][mr][right]
+  vector<complex<double>> x(left*ml*dim*right), y(left*dim*mr*right),
+    ret(right*mr*right);
+  gemm(CblasNoTrans, CblasNoTrans, left*ml, dim*right, left, env.data(),
+       left, a, dim*right, x.data());
+  for(size_t i = 0; i < left; ++i)
+    gemm(CblasNoTrans, CblasNoTrans, dim*mr, right, ml*dim, w.data(),
+	 ml*dim, x.data() + i*ml*dim*right, right,
+	 y.data() + i*dim*mr*right);
+  gemm(CblasConjTrans, CblasNoTrans, right, mr*right, left*dim, a, right,
+       y.data(), mr*right, ret.data());
+  return ret;
+}
+
+// ########################### extend_right ##########################
+// As extend_left(), for env[right][mr][right] the environment of the
+// sites to the right of a, giving that of the previous site.
+static vector<complex<double>> extend_right(const vector<complex<double>>& env,
+					    const complex<double> *a,
+					    const vector<complex<double>>& w,
+					    size_t left, size_t dim,
+					    size_t right, size_t ml, size_t mr)
+{
+  // x[ket][ket'][mr][bra], then y[ket][ml][bra'][bra]
+  vector<complex<double>> x(left*dim*mr*right), y(left*ml*dim*right),
+    ret(left*ml*left);
+  gemm(CblasNoTrans, CblasNoTrans, left*dim, mr*right, right, a, right,
+       env.data(), mr*right, x.data());
+  for(size_t i = 0; i < left; ++i)
+    gemm(CblasNoTrans, CblasNoTrans, ml*dim, right, dim*mr, w.data(),
+	 dim*mr, x.data() + i*dim*mr*right, right,
+	 y.data() + i*ml*dim*right);
+  gemm(CblasNoTrans, CblasConjTrans, left*ml, left, dim*right, y.data(),
+       dim*right, a, dim*right, ret.data());
+  return ret;
+}
+
+// ########################### squared_norm ##########################
+static double squared_norm(MatrixProductState& psi)
+{
+  const size_t dim = psi.dim();
+  vector<complex<double>> env{1}, identity(dim*dim);
+  for(size_t s = 0; s < dim; ++s) identity[s*dim + s] = 1;
+  for(Tensor *t : psi.tensors())
+    {
+      MatrixStruct m = t->matrix();
+      const size_t left = m.matrix->rows(), right = m.matrix->cols() / dim;
+      env = extend_left(env, m.matrix->data(), identity, left, dim, right,
+			1, 1);
+    }
+  return env[0].real();
+}
+
+// ########################### MatrixProductState ####################
+// ########################### constructor ###########################
+MatrixProductState::MatrixProductState(size_t length, size_t dim,
+				       size_t legs, unsigned seed)
+  : _dim{dim}, _legs{legs}
+{
+#ifndef NO_ERROR_CHECKING
+  if(0 == length || 0 == dim || 0 == legs)
+    LOG_MSG_(FATAL) << kErrBounds << "MatrixProductState needs nonzero "
+      "sizes, given length " << length << ", site dimension " << dim <<
+      " and " << legs << " legs";
+#endif // NO_ERROR_CHECKING
+
+  const size_t first = _network.mps(length, legs, dim);
+  for(size_t j = 0; j < length; ++j)
+    _tensors.push_back(_network.tensor(first + j));
+  initialize(_tensors, INIT_HAAR, seed);
+}
+
+// ########################### length ################################
+size_t MatrixProductState::length()
+{
+  return _tensors.size();
+}
+
+// ########################### dim ###################################
+size_t MatrixProductState::dim()
+{
+  return _dim;
+}
+
+// ########################### legs ##################################
+size_t MatrixProductState::legs()
+{
+  return _legs;
+}
+
+// ########################### bond ##################################
+size_t MatrixProductState::bond(size_t j)
+{
+  size_t ret = 1;
+  for(size_t k = std::min(std::min(j + 1, length() - 1 - j), _legs); k > 0;
+      --k)
+    ret *= _dim;
+  return ret;
+}
+
+// ########################### tensor ################################
+Tensor* MatrixProductState::tensor(size_t j)
+{
+  return _tensors.at(j);
+}
+
+// ########################### site ##################################
+GraphEdge MatrixProductState::site(size_t n)
+{
+  return GraphEdge{nullptr, 0, _tensors.at(n), 0};
+}
+
+// ########################### tensors ###############################
+const vector<Tensor*>& MatrixProductState::tensors()
+{
+  return _tensors;
+}
+
+// ########################### MatrixProductOperator #################
+// ########################### constructor ###########################
+MatrixProductOperator::MatrixProductOperator(const BondHamiltonian& h,
+					     size_t length)
+  : _dim{h.dim}
+{
+  const size_t d = h.dim, d2 = d*d;
+
+#ifndef NO_ERROR_CHECKING
+  if(0 == length || d < 2)
+    LOG_MSG_(FATAL) << kErrBounds << "MatrixProductOperator needs a chain "
+      "of sites of dimension at least 2, given length " << length <<
+      " and site dimension " << d;
+  if(h.term.size() != d2*d2)
+    LOG_MSG_(FATAL) << kErrListLength << "bond term of " << h.name <<
+      " has " << h.term.size() << " entries, but " << d2*d2 <<
+      " were expected";
+#endif // NO_ERROR_CHECKING
+
+  // Regroup the bond term as m[(s1 t1)][(s2 t2)] = <s1 s2|h|t1 t2>, so
+  // that its singular value decomposition gives h = sum_a A_a (x) B_a.
+  vector<complex<double>> m(d2*d2);
+  for(size_t s1 = 0; s1 < d; ++s1)
+    for(size_t s2 = 0; s2 < d; ++s2)
+      for(size_t t1 = 0; t1 < d; ++t1)
+	for(size_t t2 = 0; t2 < d; ++t2)
+	  m[(s1*d + t1)*d2 + s2*d + t2] = h.term[(s1*d + s2)*d2 + t1*d + t2];
+  const SVD schmidt = svd(m.data(), d2, d2);
+  const size_t k = schmidt.s.size();
+  size_t r = 0;
+  while(r < k && schmidt.s[r] > kSchmidtTolerance * schmidt.s[0]) ++r;
+
+  // The bond states of the bulk tensor W[left][right][bra][ket] are 0
+  // once the term has been completed, 1 + a after A_a, and r + 1 before
+  // any term, so that the chain of tensors sums every bond term once.
+  _bond = r + 2;
+  const size_t done = 0, start = r + 1, D = _bond;
+  vector<complex<double>> w(D*D*d2);
+  for(size_t s = 0; s < d; ++s)
+    {
+      w[(start*D + start)*d2 + s*d + s] = 1;
+      w[(done*D + done)*d2 + s*d + s] = 1;
+    }
+  for(size_t a = 0; a < r; ++a)
+    for(size_t x = 0; x < d2; ++x)
+      {
+	w[(start*D + 1 + a)*d2 + x] = schmidt.s[a] * schmidt.u[x*k + a];
+	w[((1 + a)*D + done)*d2 + x] = std::conj(schmidt.v[x*k + a]);
+      }
+
+  size_t legs = 0;
+  for(size_t p = 1; p < D; p *= d) ++legs;
+  const size_t first = _network.mpo(length, legs, d);
+  for(size_t j = 0; j < length; ++j)
+    _tensors.push_back(_network.tensor(first + j));
+
+  // The end tensors keep only the row (column) of W for the state
+  // before (after) every term.
+  for(size_t j = 0; j < length; ++j)
+    {
+      MatrixStruct ms = _tensors[j]->matrix();
+      const size_t pl = ms.matrix->rows() / d, pr = ms.matrix->cols() / d;
+      const size_t ml = 0 == j ? 1 : D, mr = j + 1 == length ? 1 : D;
+      vector<complex<double>> data(pl*pr*d2);
+      for(size_t a = 0; a < ml; ++a)
+	for(size_t b = 0; b < mr; ++b)
+	  {
+	    const complex<double> *x = &w[((0 == j ? start : a)*D
+					  + (j + 1 == length ? done : b))*d2];
+	    for(size_t s = 0; s < d; ++s)
+	      for(size_t t = 0; t < d; ++t)
+		data[(s*pl + a)*d*pr + t*pr + b] = x[s*d + t];
+	  }
+      publish(_tensors[j], data);
+    }
+}
+
+// ########################### length ################################
+size_t MatrixProductOperator::length()
+{
+  return _tensors.size();
+}
+
+// ########################### dim ###################################
+size_t MatrixProductOperator::dim()
+{
+  return _dim;
+}
+
+// ########################### bond ##################################
+size_t MatrixProductOperator::bond()
+{
+  return _bond;
+}
+
+// ########################### tensor ################################
+Tensor* MatrixProductOperator::tensor(size_t j)
+{
+  return _tensors.at(j);
+}
+
+// ########################### tensors ###############################
+const vector<Tensor*>& MatrixProductOperator::tensors()
+{
+  return _tensors;
+}
+
+// ########################### Dmrg ##################################
+// ########################### constructor ###########################
+Dmrg::Dmrg(MatrixProductState& psi, MatrixProductOperator& h)
+  : _psi(psi), _h(h), _lefts(psi.length() + 1),
+    _rights(psi.length() + 1), _stamp{0}, _computed{0}, _truncation{0}
+{
+#ifndef NO_ERROR_CHECKING
+  if(psi.length() != h.length() || psi.dim() != h.dim()
+     || psi.length() < 2)
+    LOG_MSG_(FATAL) << kErrIncompatible << "Dmrg needs a state and "
+      "operator on the same chain of at least two sites, given lengths "
+      << psi.length() << " and " << h.length() << " and site dimensions "
+      << psi.dim() << " and " << h.dim();
+#endif // NO_ERROR_CHECKING
+
+  // the environments beyond the ends of the chain are trivial
+  _lefts.front() = Environment{{1}, 0, 0, 0, 0};
+  _rights.back() = Environment{{1}, 0, 0, 0, 0};
+}
+
+// ########################### sweep #################################
+double Dmrg::sweep(double cutoff)
+{
+  const size_t n = _psi.length();
+  _truncation = 0;
+  // The last pair of the forward pass leaves the centre on its left
+  // site, so that the backward pass can start from the pair before.
+  double e = 0;
+  for(size_t j = 0; j + 1 < n; ++j)
+    e = _optimize(j, j + 2 < n, cutoff);
+  for(size_t j = n - 2; j-- > 0; )
+    e = _optimize(j, false, cutoff);
+  return e;
+}
+
+// ########################### energy ################################
+double Dmrg::energy()
+{
+  return _left(_psi.length())[0].real() / squared_norm(_psi);
+}
+
+// ########################### truncation ############################
+double Dmrg::truncation()
+{
+  return _truncation;
+}
+
+// ########################### environments ##########################
+size_t Dmrg::environments()
+{
+  return _computed;
+}
+
+// ########################### _left #################################
+const vector<complex<double>>& Dmrg::_left(size_t j)
+{
+  const size_t n = _psi.length(), dim = _psi.dim();
+  for(size_t i = 1; i <= j; ++i)
+    {
+      Environment &e = _lefts[i];
+      const Environment &prev = _lefts[i - 1];
+      Tensor *a = _psi.tensor(i - 1), *w = _h.tensor(i - 1);
+      if(!e.data.empty() && e.state == a->version() && e.op == w->version()
+	 && e.parent == prev.stamp)
+	continue;
+
+      MatrixStruct m = a->matrix();
+      const size_t left = m.matrix->rows(), right = m.matrix->cols() / dim;
+      const size_t ml = 1 == i ? 1 : _h.bond(), mr = n == i ? 1 : _h.bond();
+      e.data = extend_left(prev.data, m.matrix->data(),
+			   operator_block(w, dim, ml, mr, true), left, dim,
+			   right, ml, mr);
+      e.state = a->version();
+      e.op = w->version();
+      e.parent = prev.stamp;
+      e.stamp = ++_stamp;
+      ++_computed;
+    }
+  return _lefts[j].data;
+}
+
+// ########################### _right ################################
+const vector<complex<double>>& Dmrg::_right(size_t j)
+{
+  const size_t n = _psi.length(), dim = _psi.dim();
+  for(size_t i = n; i-- > j; )
+    {
+      Environment &e = _rights[i];
+      const Environment &next = _rights[i + 1];
+      Tensor *a = _psi.tensor(i), *w = _h.tensor(i);
+      if(!e.data.empty() && e.state == a->version() && e.op == w->version()
+	 && e.parent == next.stamp)
+	continue;
+
+      MatrixStruct m = a->matrix();
+      const size_t left = m.matrix->rows(), right = m.matrix->cols() / dim;
+      const size_t ml = 0 == i ? 1 : _h.bond(),
+	mr = n == i + 1 ? 1 : _h.bond();
+      e.data = extend_right(next.data, m.matrix->data(),
+			    operator_block(w, dim, ml, mr, false), left, dim,
+			    right, ml, mr);
+      e.state = a->version();
+      e.op = w->version();
+      e.parent = next.stamp;
+      e.stamp = ++_stamp;
+      ++_computed;
+    }
+  return _rights[j].data;
+}
+
+// ########################### _optimize #############################
+double Dmrg::_optimize(size_t j, bool right, double cutoff)
+{
+  const size_t n = _psi.length(), dim = _psi.dim(), d2 = dim*dim;
+  const vector<complex<double>> &l = _left(j), &r = _right(j + 2);
+  MatrixStruct ma = _psi.tensor(j)->matrix(),
+    mb = _psi.tensor(j + 1)->matrix();
+  const size_t left = ma.matrix->rows(), bond = ma.matrix->cols() / dim,
+    width = mb.matrix->cols() / dim;
+  const size_t ml = 0 == j ? 1 : _h.bond(), mm = _h.bond(),
+    mr = n == j + 2 ? 1 : _h.bond();
+
+  // the two-site tensor theta[left][dim][dim][width]
+  vector<complex<double>> theta(left*d2*width);
+  gemm(CblasNoTrans, CblasNoTrans, left*dim, dim*width, bond,
+       ma.matrix->data(), bond, mb.matrix->data(), dim*width, theta.data());
+
+  // The effective Hamiltonian is applied as a sequence of matrix
+  // products, with the right environment reordered to [mr][ket][bra]
+  // once so that the last step reads it in place.
+  const vector<complex<double>>
+    w1 = operator_block(_h.tensor(j), dim, ml, mm, true),
+    w2 = operator_block(_h.tensor(j + 1), dim, mm, mr, true);
+  vector<complex<double>> rp(width*mr*width);
+  for(size_t c = 0; c < width; ++c)
+    for(size_t k = 0; k < mr; ++k)
+      std::copy_n(&r[(c*mr + k)*width], width, &rp[(k*width + c)*width]);
+  vector<complex<double>> x(left*ml*d2*width), y(left*dim*mm*dim*width),
+    z(left*d2*mr*width);
+  LinearMap heff = [&](const complex<double> *in, complex<double> *out)
+    {
+      gemm(CblasNoTrans, CblasNoTrans, left*ml, d2*width, left, l.data(),
+	   left, in, d2*width, x.data());
+      for(size_t i = 0; i < left; ++i)
+	gemm(CblasNoTrans, CblasNoTrans, dim*mm, dim*width, ml*dim,
+	     w1.data(), ml*dim, x.data() + i*ml*d2*width, dim*width,
+	     y.data() + i*dim*mm*dim*width);
+      for(size_t i = 0; i < left*dim; ++i)
+	gemm(CblasNoTrans, CblasNoTrans, dim*mr, width, mm*dim, w2.data(),
+	     mm*dim, y.data() + i*mm*dim*width, width,
+	     z.data() + i*dim*mr*width);
+      gemm(CblasNoTrans, CblasNoTrans, left*d2, width, mr*width, z.data(),
+	   mr*width, rp.data(), width, out);
+    };
+  EigenPair p = lanczos(heff, theta.size(), theta);
+
+  // Keep at most bond singular values, dropping the smallest while
+  // their total weight stays below cutoff, and restore the norm.
+  SVD s = svd(p.vector.data(), left*dim, dim*width);
+  const size_t k = s.s.size();
+  size_t keep = std::min(k, bond);
+  double discarded = 0, kept = 0;
+  for(size_t i = keep; i < k; ++i) discarded += s.s[i] * s.s[i];
+  while(keep > 1 && discarded + s.s[keep - 1] * s.s[keep - 1] <= cutoff)
+    {
+      --keep;
+      discarded += s.s[keep] * s.s[keep];
+    }
+  for(size_t i = 0; i < keep; ++i) kept += s.s[i] * s.s[i];
+  _truncation = std::max(_truncation, discarded);
+
+  // The site the centre leaves takes the singular vectors, all of
+  // which are kept so that it remains an isometry; the other takes the
+  // singular values.
+  vector<complex<double>> a(left*dim*bond), b(bond*dim*width);
+  for(size_t c = 0; c < bond; ++c)
+    {
+      const double sv = c < keep ? s.s[c] / std::sqrt(kept) : 0;
+      for(size_t i = 0; i < left*dim; ++i)
+	a[i*bond + c] = s.u[i*k + c] * (right ? 1 : sv);
+      for(size_t i = 0; i < dim*width; ++i)
+	b[c*dim*width + i] = std::conj(s.v[i*k + c]) * (right ? sv : 1);
+    }
+  publish(_psi.tensor(j), a);
+  publish(_psi.tensor(j + 1), b);
+  return p.value.real();
+}
+
+// ###################################################################
+
+// ########################### energy ################################
+double energy(MatrixProductState& psi, MatrixProductOperator& h)
+{
+  Dmrg d{psi, h};
+  return d.energy();
+}
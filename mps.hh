@@ -0,0 +1,153 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+// matrix product states and operators on an open chain, and their
+// optimization by two-site DMRG
+
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+#include "graph.hh"
+#include "hamiltonian.hh"
+#include "network.hh"
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+
+// Default largest weight of the singular values discarded when
+// splitting the two-site tensor in a DMRG sweep.
+const double kDmrgCutoff = 1e-12;
+
+// A matrix product state on an open chain of length sites of dimension
+// dim, built by Network::mps() so that a bond of bond(j) = dim^k is
+// carried by k legs of rank dim, with at most legs legs.  The tensor of
+// site j is stored as a row-major array A[left][physical][right].
+class MatrixProductState
+{
+public:
+  // Build the network with every tensor a Haar-random isometry, as
+  // initialize() with INIT_HAAR and seed.  Since each tensor has no
+  // more rows than columns, the state is normalized and in
+  // right-canonical form.
+  MatrixProductState(size_t length, size_t dim, size_t legs,
+		     unsigned seed = 0);
+  MatrixProductState(const MatrixProductState&) = delete;
+  MatrixProductState& operator=(const MatrixProductState&) = delete;
+  size_t length();
+  size_t dim();
+  size_t legs();
+  // Dimension of the bond between sites j and j + 1 (j + 1 < length()).
+  size_t bond(size_t j);
+  Tensor* tensor(size_t j);
+  // Site n, as a graph endpoint.
+  GraphEdge site(size_t n);
+  const std::vector<Tensor*>& tensors();
+private:
+  size_t _dim;
+  size_t _legs;
+  Network _network;
+  std::vector<Tensor*> _tensors;
+};
+
+// The Hamiltonian sum_j h_{j,j+1} on an open chain, as a matrix product
+// operator built by Network::mpo().  The operator-Schmidt decomposition
+// h = sum_a A_a (x) B_a of the bond term, with r terms, gives bonds of
+// dimension r + 2, carried by as many legs of rank h.dim as needed to
+// hold them.  The tensor of site j is stored as a row-major array
+// W[bra][left][ket][right], as for a LocalOperator; entries of padding
+// beyond bond() are zero.
+class MatrixProductOperator
+{
+public:
+  MatrixProductOperator(const BondHamiltonian& h, size_t length);
+  MatrixProductOperator(const MatrixProductOperator&) = delete;
+  MatrixProductOperator& operator=(const MatrixProductOperator&) = delete;
+  size_t length();
+  size_t dim();
+  // Dimension of the bonds in use, r + 2.
+  size_t bond();
+  Tensor* tensor(size_t j);
+  const std::vector<Tensor*>& tensors();
+private:
+  size_t _dim;
+  size_t _bond;
+  Network _network;
+  std::vector<Tensor*> _tensors;
+};
+
+// Two-site DMRG for the ground state of h, updating psi in place.  The
+// left and right environments of <psi|h|psi> (the contractions of the
+// sites to either side of a pair) are cached between steps and sweeps,
+// and one is recomputed only when version() of a tensor it depends on
+// has changed, so that each step of a sweep contracts a single site
+// into them.  Environments are contracted, and the effective
+// Hamiltonian of a pair applied, by fixed sequences of matrix products
+// suited to the sandwich <psi|h|psi> rather than by general plans.
+class Dmrg
+{
+public:
+  Dmrg(MatrixProductState& psi, MatrixProductOperator& h);
+  Dmrg(const Dmrg&) = delete;
+  Dmrg& operator=(const Dmrg&) = delete;
+  // Optimize each pair of neighbouring sites from left to right and
+  // back: the pair is replaced by the lowest eigenvector of its
+  // effective Hamiltonian, found by the Lanczos method starting from
+  // the current pair, and split by a singular value decomposition.
+  // Singular values beyond the bond dimension are discarded, as are
+  // the smallest ones of total weight below cutoff.  The state must be
+  // normalized and right-canonical, as it is after construction and
+  // after every sweep.  Returns the energy of the last eigenvector.
+  double sweep(double cutoff = kDmrgCutoff);
+  // <psi|h|psi> / <psi|psi> for the current state.
+  double energy();
+  // The largest weight discarded by any step of the last sweep.
+  double truncation();
+  // Number of environments contracted so far.
+  size_t environments();
+private:
+  // A cached environment, with the versions of the tensors of psi and
+  // h contracted into it last, and the stamp of the environment it
+  // was computed from.
+  struct Environment
+  {
+    std::vector<std::complex<double>> data;
+    uint64_t state;
+    uint64_t op;
+    uint64_t parent;
+    uint64_t stamp;
+  };
+  // The environment of sites below j (left) or from j on (right),
+  // recomputing any which are out of date.  Left environments have
+  // legs [bra][mpo][ket], right ones [ket][mpo][bra].
+  const std::vector<std::complex<double>>& _left(size_t j);
+  const std::vector<std::complex<double>>& _right(size_t j);
+  // Optimize sites j and j + 1, leaving the orthogonality centre on
+  // site j + 1 if right is set and on site j otherwise, and return the
+  // energy of the eigenvector found.
+  double _optimize(size_t j, bool right, double cutoff);
+  MatrixProductState& _psi;
+  MatrixProductOperator& _h;
+  std::vector<Environment> _lefts;
+  std::vector<Environment> _rights;
+  uint64_t _stamp;
+  size_t _computed;
+  double _truncation;
+};
+
+// <psi|h|psi> / <psi|psi>.
+double energy(MatrixProductState& psi, MatrixProductOperator& h);
@@ -0,0 +1,384 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <new>
+#include "log_msg.hh"
+#include "network.hh"
+#include "tensor.hh"
+
+using std::vector;
+
+// ########################### Network ###############################
+// ########################### destructor ############################
+Network::~Network()
+{
+  _tearing_down = true;
+  for(ConcreteTensor *t : _owned)
+    t->~ConcreteTensor();
+}
+
+// ########################### reserve ###############################
+void Network::reserve(size_t tensors, size_t inputs, size_t outputs)
+{
+  _tensors.reserve(_tensors.size() + tensors);
+  _owned.reserve(_owned.size() + tensors);
+  _in_first.reserve(_in_first.size() + tensors);
+  _out_first.reserve(_out_first.size() + tensors);
+  _in_tensor.reserve(_in_tensor.size() + inputs);
+  _in_num.reserve(_in_num.size() + inputs);
+  _in_id.reserve(_in_id.size() + inputs);
+  _out_tensor.reserve(_out_tensor.size() + outputs);
+  _out_num.reserve(_out_num.size() + outputs);
+  _out_id.reserve(_out_id.size() + outputs);
+}
+
+// ########################### create ################################
+ConcreteTensor* Network::create(size_t nin, size_t nout, size_t inrank,
+				size_t outrank)
+{
+  // construct in place in the current block, starting a new block when
+  // it is full
+  const size_t slot = _owned.size() % kNetworkBlock;
+  if(0 == slot)
+    _blocks.emplace_back(new unsigned char[kNetworkBlock *
+					   sizeof(ConcreteTensor)]);
+  void *p = _blocks.back().get() + slot * sizeof(ConcreteTensor);
+  ConcreteTensor *t = new(p) ConcreteTensor(*this, nin, nout, inrank,
+					    outrank);
+  _owned.push_back(t);
+  return t;
+}
+
+ConcreteTensor* Network::create(size_t nin, size_t nout, size_t rank)
+{
+  return create(nin, nout, rank, rank);
+}
+
+// ########################### link ##################################
+void Network::link(const vector<NetworkEdge>& edges)
+{
+  for(const NetworkEdge &e : edges)
+    {
+#ifndef NO_ERROR_CHECKING
+      // guard against missing tensors and legs
+      if(e.input_id >= size() || e.output_id >= size()
+	 || nullptr == _tensors[e.input_id]
+	 || nullptr == _tensors[e.output_id])
+	LOG_MSG_(FATAL) << kErrBounds << "edge passed to Network::link() "
+	  "refers to a missing tensor: " << e.input_id << " or " <<
+	  e.output_id << " of " << size();
+      if(e.input_num >= inputs(e.input_id)
+	 || e.output_num >= outputs(e.output_id))
+	LOG_MSG_(FATAL) << kErrBounds << "edge passed to Network::link() "
+	  "refers to a missing leg: input " << e.input_num << " of " <<
+	  e.input_id << " or output " << e.output_num << " of " <<
+	  e.output_id;
+      // ensure tensors are formed from compatible vector spaces
+      if(_tensors[e.input_id]->input_rank()
+	 != _tensors[e.output_id]->output_rank())
+	LOG_MSG_(FATAL) << kErrIncompatible << "tensors linked by "
+	  "Network::link() have differing vector space ranks: " <<
+	  _tensors[e.input_id]->input_rank() << " and " <<
+	  _tensors[e.output_id]->output_rank();
+#endif // NO_ERROR_CHECKING
+
+      const size_t i = _in_first[e.input_id] + e.input_num;
+      const size_t o = _out_first[e.output_id] + e.output_num;
+      if(nullptr == _in_tensor[i] && nullptr == _out_tensor[o])
+	{
+	  _set_input(e.input_id, e.input_num, _tensors[e.output_id],
+		     e.output_num, e.output_id);
+	  _set_output(e.output_id, e.output_num, _tensors[e.input_id],
+		      e.input_num, e.input_id);
+	}
+      else
+	{
+	  // set_output() clears only the old partner of the output
+	  _tensors[e.input_id]->set_input(e.input_num, nullptr, 0);
+	  _tensors[e.output_id]->set_output(e.output_num,
+					    _tensors[e.input_id], e.input_num);
+	}
+    }
+}
+
+// ########################### build #################################
+size_t Network::build(const vector<NetworkShape>& shapes,
+		      const vector<NetworkEdge>& edges)
+{
+  size_t nin = 0, nout = 0;
+  for(const NetworkShape &s : shapes)
+    {
+      nin += s.nin;
+      nout += s.nout;
+    }
+  reserve(shapes.size(), nin, nout);
+
+  const size_t first = size();
+  for(const NetworkShape &s : shapes)
+    create(s.nin, s.nout, s.inrank, s.outrank);
+  link(edges);
+  return first;
+}
+
+// ########################### mera ##################################
+size_t Network::mera(size_t sites, size_t depth, size_t branching,
+		     size_t rank)
+{
+  size_t top = sites;
+  for(size_t t = 0; t < depth && 0 != branching; ++t)
+    top /= branching;
+
+#ifndef NO_ERROR_CHECKING
+  // guard against shapes which do not tile the sites
+  size_t covered = top;
+  for(size_t t = 0; t < depth; ++t)
+    covered *= branching;
+  if(branching < 2 || 0 == top || covered != sites)
+    LOG_MSG_(FATAL) << kErrIncompatible << "arguments of Network::mera(): "
+      << sites << " sites are not a multiple of branching " << branching <<
+      " to the power " << depth;
+#endif // NO_ERROR_CHECKING
+
+  // The tensor and output feeding each site of the current layer,
+  // starting with the outputs of the top tensor.
+  const size_t first = size();
+  vector<NetworkShape> shapes{NetworkShape{0, top, 0, rank}};
+  vector<NetworkEdge> edges;
+  vector<size_t> site_id(top, first), site_num(top);
+  for(size_t s = 0; s < top; ++s)
+    site_num[s] = s;
+
+  size_t id = first + 1;
+  for(size_t m = top; m < sites; m *= branching)
+    {
+      const size_t n = m * branching;
+      vector<size_t> next_id(n), next_num(n);
+      for(size_t i = 0; i < m; ++i, ++id)
+	{
+	  shapes.push_back(NetworkShape{1, branching, rank, rank});
+	  edges.push_back(NetworkEdge{id, 0, site_id[i], site_num[i]});
+	  for(size_t k = 0; k < branching; ++k)
+	    {
+	      next_id[branching * i + k] = id;
+	      next_num[branching * i + k] = k;
+	    }
+	}
+      // disentanglers cover disjoint pairs of sites, so the sites can
+      // be updated in place
+      for(size_t i = 0; i < m; ++i, ++id)
+	{
+	  const size_t l = branching * i + branching - 1;
+	  const size_t r = branching * (i + 1) % n;
+	  shapes.push_back(NetworkShape{2, 2, rank, rank});
+	  edges.push_back(NetworkEdge{id, 0, next_id[l], next_num[l]});
+	  edges.push_back(NetworkEdge{id, 1, next_id[r], next_num[r]});
+	  next_id[l] = next_id[r] = id;
+	  next_num[l] = 0;
+	  next_num[r] = 1;
+	}
+      site_id.swap(next_id);
+      site_num.swap(next_num);
+    }
+
+  return build(shapes, edges);
+}
+
+// ########################### mps ###################################
+size_t Network::mps(size_t sites, size_t legs, size_t rank)
+{
+#ifndef NO_ERROR_CHECKING
+  if(0 == sites || 0 == rank)
+    LOG_MSG_(FATAL) << kErrBounds << "arguments of Network::mps(): " <<
+      sites << " sites of rank " << rank;
+#endif // NO_ERROR_CHECKING
+
+  const size_t first = size();
+  vector<NetworkShape> shapes;
+  vector<NetworkEdge> edges;
+  // left is the number of legs of the bond to the left of site j
+  size_t left = 0;
+  for(size_t j = 0; j < sites; ++j)
+    {
+      const size_t right = j + 1 == sites ? 0
+	: std::min(std::min(j + 1, sites - 1 - j), legs);
+      shapes.push_back(NetworkShape{left, 1 + right, 0 == left ? 0 : rank,
+				    rank});
+      for(size_t k = 0; k < right; ++k)
+	edges.push_back(NetworkEdge{first + j + 1, k, first + j, 1 + k});
+      left = right;
+    }
+
+  return build(shapes, edges);
+}
+
+// ########################### mpo ###################################
+size_t Network::mpo(size_t sites, size_t legs, size_t rank)
+{
+#ifndef NO_ERROR_CHECKING
+  if(0 == sites || 0 == rank)
+    LOG_MSG_(FATAL) << kErrBounds << "arguments of Network::mpo(): " <<
+      sites << " sites of rank " << rank;
+#endif // NO_ERROR_CHECKING
+
+  const size_t first = size();
+  vector<NetworkShape> shapes;
+  vector<NetworkEdge> edges;
+  for(size_t j = 0; j < sites; ++j)
+    {
+      const size_t left = 0 == j ? 0 : legs, right = j + 1 == sites ? 0
+	: legs;
+      shapes.push_back(NetworkShape{1 + left, 1 + right, rank, rank});
+      for(size_t k = 0; k < right; ++k)
+	edges.push_back(NetworkEdge{first + j + 1, 1 + k, first + j, 1 + k});
+    }
+
+  return build(shapes, edges);
+}
+
+// ########################### size ##################################
+size_t Network::size() const
+{
+  return _tensors.size();
+}
+
+// ########################### tensor ################################
+Tensor* Network::tensor(size_t id) const
+{
+#ifndef NO_ERROR_CHECKING
+  if(id >= _tensors.size())
+    LOG_MSG_(FATAL) << kErrBounds << "argument of Network::tensor(): " <<
+      id << " exceeds number of tensors " << _tensors.size();
+#endif // NO_ERROR_CHECKING
+
+  return _tensors[id];
+}
+
+// ########################### inputs ################################
+size_t Network::inputs(size_t id) const
+{
+  return _in_first[id + 1] - _in_first[id];
+}
+
+// ########################### outputs ###############################
+size_t Network::outputs(size_t id) const
+{
+  return _out_first[id + 1] - _out_first[id];
+}
+
+// ########################### input_tensor ##########################
+Tensor* Network::input_tensor(size_t id, size_t n) const
+{
+  return _in_tensor[_in_first[id] + n];
+}
+
+// ########################### output_tensor #########################
+Tensor* Network::output_tensor(size_t id, size_t n) const
+{
+  return _out_tensor[_out_first[id] + n];
+}
+
+// ########################### input_num #############################
+size_t Network::input_num(size_t id, size_t n) const
+{
+  return _in_num[_in_first[id] + n];
+}
+
+// ########################### output_num ############################
+size_t Network::output_num(size_t id, size_t n) const
+{
+  return _out_num[_out_first[id] + n];
+}
+
+// ########################### input_id ##############################
+size_t Network::input_id(size_t id, size_t n) const
+{
+  return _in_id[_in_first[id] + n];
+}
+
+// ########################### output_id #############################
+size_t Network::output_id(size_t id, size_t n) const
+{
+  return _out_id[_out_first[id] + n];
+}
+
+// ########################### component #############################
+vector<size_t> Network::component(size_t id) const
+{
+  // ret doubles as the queue of the search
+  vector<size_t> ret{id};
+  vector<bool> seen(_tensors.size(), false);
+  seen[id] = true;
+  for(size_t i = 0; i < ret.size(); ++i)
+    {
+      const size_t t = ret[i];
+      for(size_t l = _in_first[t]; l < _in_first[t + 1]; ++l)
+	if(kNoTensor != _in_id[l] && !seen[_in_id[l]])
+	  {
+	    seen[_in_id[l]] = true;
+	    ret.push_back(_in_id[l]);
+	  }
+      for(size_t l = _out_first[t]; l < _out_first[t + 1]; ++l)
+	if(kNoTensor != _out_id[l] && !seen[_out_id[l]])
+	  {
+	    seen[_out_id[l]] = true;
+	    ret.push_back(_out_id[l]);
+	  }
+    }
+  return ret;
+}
+
+// ########################### _add ##################################
+size_t Network::_add(Tensor *t, size_t nin, size_t nout)
+{
+  _tensors.push_back(t);
+  _in_first.push_back(_in_first.back() + nin);
+  _out_first.push_back(_out_first.back() + nout);
+  _in_tensor.resize(_in_first.back(), nullptr);
+  _in_num.resize(_in_first.back(), 0);
+  _in_id.resize(_in_first.back(), kNoTensor);
+  _out_tensor.resize(_out_first.back(), nullptr);
+  _out_num.resize(_out_first.back(), 0);
+  _out_id.resize(_out_first.back(), kNoTensor);
+  return _tensors.size() - 1;
+}
+
+// ########################### _remove ###############################
+void Network::_remove(size_t id)
+{
+  _tensors[id] = nullptr;
+}
+
+// ########################### _set_input ############################
+void Network::_set_input(size_t id, size_t n, Tensor *t, size_t m,
+			 size_t tid)
+{
+  const size_t l = _in_first[id] + n;
+  _in_tensor[l] = t;
+  _in_num[l] = m;
+  _in_id[l] = tid;
+}
+
+// ########################### _set_output ###########################
+void Network::_set_output(size_t id, size_t n, Tensor *t, size_t m,
+			  size_t tid)
+{
+  const size_t l = _out_first[id] + n;
+  _out_tensor[l] = t;
+  _out_num[l] = m;
+  _out_id[l] = tid;
+}
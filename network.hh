@@ -0,0 +1,165 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// connectivity of a collection of tensors, stored as flat arrays
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+class ConcreteTensor;
+
+// Id of a tensor which is not part of a network (or of a link which
+// does not lead to one).
+const size_t kNoTensor = static_cast<size_t>(-1);
+
+// Number of tensors in each block of the storage pooled by a network.
+const size_t kNetworkBlock = 1024;
+
+// A link for bulk construction: input input_num of tensor input_id is
+// linked to output output_num of tensor output_id.
+struct NetworkEdge
+{
+  size_t input_id;
+  size_t input_num;
+  size_t output_id;
+  size_t output_num;
+};
+
+// The shape of a tensor for bulk construction.
+struct NetworkShape
+{
+  size_t nin;
+  size_t nout;
+  size_t inrank;
+  size_t outrank;
+};
+
+// The links of a collection of tensors.  Every tensor added to the
+// network receives a dense id, and the links of all tensors are held
+// in contiguous arrays with one entry per input (or output) leg, the
+// legs of each tensor being adjacent.  A ConcreteTensor created in a
+// network keeps no links of its own but reads and writes them here,
+// so traversals of a network need touch only these arrays.
+//
+// A network may also own tensors, created by create() in pooled
+// blocks of storage.  Owned tensors are destroyed with the network,
+// which then unlinks only those legs leading outside it.
+class Network
+{
+public:
+  Network() = default;
+  Network(const Network&) = delete;
+  Network& operator=(const Network&) = delete;
+  ~Network();
+  // Reserve room for a number of further tensors with the given total
+  // numbers of inputs and outputs.
+  void reserve(size_t tensors, size_t inputs, size_t outputs);
+  // Create a tensor owned by the network, as the ConcreteTensor
+  // constructors.  Its id is the previous size().  Owned tensors must
+  // not be deleted.
+  ConcreteTensor* create(size_t nin, size_t nout, size_t inrank,
+			 size_t outrank);
+  ConcreteTensor* create(size_t nin, size_t nout, size_t rank);
+  // Link tensors by id.  Legs which are unlinked are linked directly
+  // in the arrays; others are first unlinked from their old partners.
+  void link(const std::vector<NetworkEdge>& edges);
+  // Create an owned tensor for each shape, with consecutive ids, then
+  // link them.  Edges refer to ids, so in an empty network the tensor
+  // made from shapes[i] has id i.  Returns the id of the first.
+  size_t build(const std::vector<NetworkShape>& shapes,
+	       const std::vector<NetworkEdge>& edges);
+  // Build a MERA of depth layers with the given branching above
+  // sites sites, all legs of rank rank, and return the id of its top
+  // tensor.  The top has sites / branching^depth outputs (so sites
+  // must be divisible by branching^depth) and is followed, layer by
+  // layer downwards, by the isometries and then the disentanglers of
+  // each layer.  In a layer of n sites below the isometries, isometry
+  // i has one input and outputs to sites branching*i ...
+  // branching*i + branching - 1, and disentangler i acts on sites
+  // branching*i + branching - 1 and branching*(i + 1) (mod n).  The
+  // outputs of the bottom disentanglers are left unlinked.
+  size_t mera(size_t sites, size_t depth, size_t branching, size_t rank);
+  // Build a matrix product state on an open chain of sites sites, all
+  // legs of rank rank, and return the id of its first tensor.  Tensor
+  // j has the physical leg as output 0, followed by the legs of the
+  // bond to its right, which are linked in order to the inputs of
+  // tensor j + 1.  The bond has min(j + 1, sites - 1 - j, legs) legs,
+  // and so dimension up to rank^legs.  Physical legs are left
+  // unlinked.
+  size_t mps(size_t sites, size_t legs, size_t rank);
+  // Build a matrix product operator on an open chain of sites sites,
+  // all legs of rank rank, and return the id of its first tensor.
+  // Tensor j has its physical legs as input and output 0, as for a
+  // LocalOperator, followed by legs legs of the bond to its left
+  // (inputs) and right (outputs), except at the ends of the chain.
+  // Physical legs are left unlinked.
+  size_t mpo(size_t sites, size_t legs, size_t rank);
+  // Number of ids issued.  Ids are never reused, so some may belong to
+  // tensors which no longer exist.
+  size_t size() const;
+  // The tensor with a given id, or null if it has been destroyed.
+  Tensor* tensor(size_t id) const;
+  size_t inputs(size_t id) const;
+  size_t outputs(size_t id) const;
+  // The tensor and leg linked to input (output) n of tensor id, as
+  // Tensor::input_tensor() and Tensor::input_num().
+  Tensor* input_tensor(size_t id, size_t n) const;
+  Tensor* output_tensor(size_t id, size_t n) const;
+  size_t input_num(size_t id, size_t n) const;
+  size_t output_num(size_t id, size_t n) const;
+  // Id of the tensor linked to input (output) n of tensor id, or
+  // kNoTensor if the leg is unlinked or leads outside the network.
+  size_t input_id(size_t id, size_t n) const;
+  size_t output_id(size_t id, size_t n) const;
+  // Ids of the tensors reachable from id through links within the
+  // network, in breadth-first order (inputs before outputs).
+  std::vector<size_t> component(size_t id) const;
+protected:
+  friend class ConcreteTensor;
+  // Register a tensor with the given numbers of legs, all unlinked,
+  // and return its id.
+  size_t _add(Tensor *t, size_t nin, size_t nout);
+  // Forget a tensor which is being destroyed.
+  void _remove(size_t id);
+  // Set one direction of a link, as Tensor::_set_input_self().
+  void _set_input(size_t id, size_t n, Tensor *t, size_t m, size_t tid);
+  void _set_output(size_t id, size_t n, Tensor *t, size_t m, size_t tid);
+private:
+  // Per tensor, indexed by id.  The legs of tensor id occupy entries
+  // [_in_first[id], _in_first[id + 1]) of the input arrays, and
+  // likewise for outputs.
+  std::vector<Tensor*> _tensors;
+  std::vector<size_t> _in_first{0};
+  std::vector<size_t> _out_first{0};
+  // Per leg: the linked tensor, its leg, and its id in this network.
+  std::vector<Tensor*> _in_tensor;
+  std::vector<size_t> _in_num;
+  std::vector<size_t> _in_id;
+  std::vector<Tensor*> _out_tensor;
+  std::vector<size_t> _out_num;
+  std::vector<size_t> _out_id;
+  // Pooled storage for owned tensors, which are listed in _owned.
+  std::vector<std::unique_ptr<unsigned char[]>> _blocks;
+  std::vector<ConcreteTensor*> _owned;
+  // Set while the destructor destroys owned tensors, so that links
+  // among tensors of the network need not be undone.
+  bool _tearing_down = false;
+};
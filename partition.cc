@@ -0,0 +1,443 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <thread>
+#include <utility>
+#include "graph.hh"
+#include "log_msg.hh"
+#include "partition.hh"
+#include "plan.hh"
+#include "plan_cache.hh"
+
+using std::map;
+using std::pair;
+using std::set;
+using std::vector;
+
+// A vertex outside a subgraph, or not yet matched.
+const size_t kNoVertex = static_cast<size_t>(-1);
+
+// Refinement passes at each level, and moves without improvement
+// after which a pass stops.
+const size_t kRefinePasses = 8;
+const size_t kRefineStall = 64;
+
+// A graph with weighted vertices, listing for each vertex its
+// neighbours and the total weight of the edges to each.
+struct WeightedGraph
+{
+  vector<double> weight;
+  vector<vector<pair<size_t, double>>> adj;
+};
+
+// ########################### total_weight ##########################
+static double total_weight(const WeightedGraph& g)
+{
+  double ret = 0;
+  for(double w : g.weight) ret += w;
+  return ret;
+}
+
+// ########################### induced ###############################
+// The subgraph of g on vertices vs, numbered in the order given.
+static WeightedGraph induced(const WeightedGraph& g, const vector<size_t>& vs)
+{
+  vector<size_t> index(g.weight.size(), kNoVertex);
+  for(size_t i = 0; i < vs.size(); ++i) index[vs[i]] = i;
+
+  WeightedGraph ret{vector<double>(vs.size()),
+      vector<vector<pair<size_t, double>>>(vs.size())};
+  for(size_t i = 0; i < vs.size(); ++i)
+    {
+      ret.weight[i] = g.weight[vs[i]];
+      for(const pair<size_t, double> &e : g.adj[vs[i]])
+	if(kNoVertex != index[e.first])
+	  ret.adj[i].push_back(std::make_pair(index[e.first], e.second));
+    }
+  return ret;
+}
+
+// ########################### coarsen ###############################
+// Merge each vertex with the unmatched neighbour joined by the
+// heaviest edge, setting coarse to the vertex of the result holding
+// each vertex of g.
+static WeightedGraph coarsen(const WeightedGraph& g, vector<size_t>& coarse)
+{
+  const size_t n = g.weight.size();
+  coarse.assign(n, kNoVertex);
+  size_t m = 0;
+  for(size_t v = 0; v < n; ++v)
+    {
+      if(kNoVertex != coarse[v]) continue;
+      size_t best = kNoVertex;
+      double heaviest = -1;
+      for(const pair<size_t, double> &e : g.adj[v])
+	if(kNoVertex == coarse[e.first] && e.first != v
+	   && e.second > heaviest)
+	  {
+	    best = e.first;
+	    heaviest = e.second;
+	  }
+      coarse[v] = m;
+      if(kNoVertex != best) coarse[best] = m;
+      ++m;
+    }
+
+  // Sum the weights of merged vertices and of the edges between them,
+  // using a dense accumulator with a list of touched entries.
+  WeightedGraph ret{vector<double>(m, 0),
+      vector<vector<pair<size_t, double>>>(m)};
+  vector<vector<size_t>> members(m);
+  for(size_t v = 0; v < n; ++v)
+    {
+      ret.weight[coarse[v]] += g.weight[v];
+      members[coarse[v]].push_back(v);
+    }
+  vector<double> sum(m, 0);
+  vector<bool> seen(m, false);
+  vector<size_t> touched;
+  for(size_t c = 0; c < m; ++c)
+    {
+      for(size_t v : members[c])
+	for(const pair<size_t, double> &e : g.adj[v])
+	  {
+	    const size_t d = coarse[e.first];
+	    if(d == c) continue;
+	    if(!seen[d]) touched.push_back(d);
+	    seen[d] = true;
+	    sum[d] += e.second;
+	  }
+      std::sort(touched.begin(), touched.end());
+      for(size_t d : touched)
+	{
+	  ret.adj[c].push_back(std::make_pair(d, sum[d]));
+	  sum[d] = 0;
+	  seen[d] = false;
+	}
+      touched.clear();
+    }
+  return ret;
+}
+
+// ########################### cut_weight ############################
+static double cut_weight(const WeightedGraph& g, const vector<bool>& side)
+{
+  double ret = 0;
+  for(size_t v = 0; v < g.weight.size(); ++v)
+    for(const pair<size_t, double> &e : g.adj[v])
+      if(side[v] != side[e.first]) ret += e.second;
+  return ret / 2;
+}
+
+// ########################### overweight ############################
+// Total excess of the weights of the two sides over their limits.
+static double overweight(const double *w, const double *limit)
+{
+  return std::max(0.0, w[0] - limit[0]) + std::max(0.0, w[1] - limit[1]);
+}
+
+// ########################### gain ##################################
+// Reduction in the cut weight from moving v to the other side.
+static double gain(const WeightedGraph& g, const vector<bool>& side, size_t v)
+{
+  double ret = 0;
+  for(const pair<size_t, double> &e : g.adj[v])
+    if(e.first != v) ret += side[v] != side[e.first] ? e.second : -e.second;
+  return ret;
+}
+
+// ########################### refine ################################
+// Improve the bisection side by Fiduccia-Mattheyses passes: move
+// vertices one at a time, best gain first and each at most once, and
+// keep the best state seen, preferring balance to a smaller cut.
+static void refine(const WeightedGraph& g, vector<bool>& side,
+		   const double *limit)
+{
+  const size_t n = g.weight.size();
+  for(size_t pass = 0; pass < kRefinePasses; ++pass)
+    {
+      double w[2] = {0, 0};
+      for(size_t v = 0; v < n; ++v) w[side[v]] += g.weight[v];
+
+      // queue of unlocked vertices by decreasing gain
+      vector<double> gains(n);
+      set<pair<double, size_t>> queue;
+      for(size_t v = 0; v < n; ++v)
+	{
+	  gains[v] = gain(g, side, v);
+	  queue.insert(std::make_pair(-gains[v], v));
+	}
+
+      vector<size_t> moves;
+      double total = 0, best = 0, best_over = overweight(w, limit);
+      size_t best_moves = 0, stall = 0;
+      while(!queue.empty() && stall < kRefineStall)
+	{
+	  const size_t v = queue.begin()->second;
+	  queue.erase(queue.begin());
+	  const bool from = side[v];
+	  // never make a side heavier than its limit, unless it is the
+	  // lighter one already over
+	  if(w[!from] + g.weight[v] > limit[!from]
+	     && w[!from] + g.weight[v] > w[from])
+	    continue;
+
+	  side[v] = !from;
+	  w[from] -= g.weight[v];
+	  w[!from] += g.weight[v];
+	  total += gains[v];
+	  moves.push_back(v);
+	  for(const pair<size_t, double> &e : g.adj[v])
+	    {
+	      const size_t u = e.first;
+	      if(!queue.erase(std::make_pair(-gains[u], u))) continue;
+	      gains[u] = gain(g, side, u);
+	      queue.insert(std::make_pair(-gains[u], u));
+	    }
+
+	  const double over = overweight(w, limit);
+	  if(over < best_over || (over == best_over && total > best))
+	    {
+	      best = total;
+	      best_over = over;
+	      best_moves = moves.size();
+	      stall = 0;
+	    }
+	  else
+	    ++stall;
+	}
+
+      // undo the moves after the best state
+      for(size_t i = best_moves; i < moves.size(); ++i)
+	side[moves[i]] = !side[moves[i]];
+      if(0 == best_moves) break;
+    }
+}
+
+// ########################### grow ##################################
+// Bisect g by growing side false from start, adding at each step the
+// vertex whose move reduces the cut the most, until it holds target.
+static vector<bool> grow(const WeightedGraph& g, size_t start, double target)
+{
+  const size_t n = g.weight.size();
+  vector<bool> side(n, true);
+  vector<double> gains(n);
+  set<pair<double, size_t>> queue;
+  for(size_t v = 0; v < n; ++v)
+    {
+      gains[v] = gain(g, side, v);
+      queue.insert(std::make_pair(v == start ? -HUGE_VAL : -gains[v], v));
+    }
+
+  double w = 0;
+  while(!queue.empty() && w < target)
+    {
+      const size_t v = queue.begin()->second;
+      queue.erase(queue.begin());
+      // stop rather than overshoot by more than half the vertex
+      if(0 != w && w + g.weight[v] / 2 > target) break;
+      side[v] = false;
+      w += g.weight[v];
+      for(const pair<size_t, double> &e : g.adj[v])
+	{
+	  const size_t u = e.first;
+	  if(!queue.erase(std::make_pair(-gains[u], u))) continue;
+	  gains[u] = gain(g, side, u);
+	  queue.insert(std::make_pair(-gains[u], u));
+	}
+    }
+  return side;
+}
+
+// ########################### bisect ################################
+// Divide g into sides false and true holding fractions fraction and
+// 1 - fraction of its weight.
+static vector<bool> bisect(const WeightedGraph& g, double fraction,
+			   double imbalance)
+{
+  const size_t n = g.weight.size();
+  const double total = total_weight(g);
+  const double limit[2] = {(1 + imbalance) * fraction * total,
+			   (1 + imbalance) * (1 - fraction) * total};
+
+  vector<size_t> coarse;
+  WeightedGraph c;
+  if(n > kCoarsestPartition) c = coarsen(g, coarse);
+
+  // Recurse while coarsening makes progress; otherwise grow from a
+  // spread of start vertices and keep the best.
+  if(n > kCoarsestPartition && 10 * c.weight.size() < 9 * n)
+    {
+      vector<bool> cs = bisect(c, fraction, imbalance), side(n);
+      for(size_t v = 0; v < n; ++v) side[v] = cs[coarse[v]];
+      refine(g, side, limit);
+      return side;
+    }
+
+  vector<bool> best;
+  double best_cut = 0, best_over = 0;
+  const size_t starts = std::min(n, kCoarsestPartition);
+  for(size_t s = 0; s < starts; ++s)
+    {
+      vector<bool> side = grow(g, s * n / starts, fraction * total);
+      refine(g, side, limit);
+      double w[2] = {0, 0};
+      for(size_t v = 0; v < n; ++v) w[side[v]] += g.weight[v];
+      const double over = overweight(w, limit), cut = cut_weight(g, side);
+      if(best.empty() || over < best_over
+	 || (over == best_over && cut < best_cut))
+	{
+	  best.swap(side);
+	  best_cut = cut;
+	  best_over = over;
+	}
+    }
+  return best;
+}
+
+// ########################### split #################################
+// Assign vertices vs of g to parts [first, first + parts).
+static void split(const WeightedGraph& g, const vector<size_t>& vs,
+		  size_t first, size_t parts, double imbalance,
+		  vector<size_t>& part)
+{
+  if(1 == parts || vs.size() <= 1)
+    {
+      for(size_t v : vs) part[v] = first;
+      return;
+    }
+
+  const size_t lower = parts / 2;
+  vector<bool> side = bisect(induced(g, vs), double(lower) / parts,
+			     imbalance);
+  vector<size_t> halves[2];
+  for(size_t i = 0; i < vs.size(); ++i) halves[side[i]].push_back(vs[i]);
+  split(g, halves[0], first, lower, imbalance, part);
+  split(g, halves[1], first + lower, parts - lower, imbalance, part);
+}
+
+// ###################################################################
+// ########################### partition #############################
+Partition partition(const vector<TensorView>& operands, size_t parts,
+		    double imbalance)
+{
+#ifndef NO_ERROR_CHECKING
+  if(0 == parts)
+    LOG_MSG_(FATAL) << kErrBounds << "partition() into zero parts";
+#endif // NO_ERROR_CHECKING
+
+  // the operands carrying each label, in label order
+  const size_t n = operands.size();
+  map<size_t, vector<size_t>> owners;
+  map<size_t, size_t> dims;
+  for(size_t i = 0; i < n; ++i)
+    for(size_t k = 0; k < operands[i].labels.size(); ++k)
+      {
+	owners[operands[i].labels[k]].push_back(i);
+	dims[operands[i].labels[k]] = operands[i].dims[k];
+      }
+
+  WeightedGraph g{vector<double>(n), vector<vector<pair<size_t, double>>>(n)};
+  for(size_t i = 0; i < n; ++i)
+    g.weight[i] = std::max<double>(1, operands[i].size());
+  for(const auto &o : owners)
+    {
+#ifndef NO_ERROR_CHECKING
+      if(o.second.size() > 2)
+	LOG_MSG_(FATAL) << kErrIncompatible << "label " << o.first <<
+	  " appears on more than two operands passed to partition()";
+#endif // NO_ERROR_CHECKING
+      if(o.second.size() < 2 || o.second[0] == o.second[1]) continue;
+      const double w = std::log2(double(dims[o.first]));
+      g.adj[o.second[0]].push_back(std::make_pair(o.second[1], w));
+      g.adj[o.second[1]].push_back(std::make_pair(o.second[0], w));
+    }
+
+  Partition ret{parts, vector<size_t>(n, 0), {}, 0, vector<double>(parts, 1),
+      0};
+  vector<size_t> all(n);
+  for(size_t i = 0; i < n; ++i) all[i] = i;
+  split(g, all, 0, parts, imbalance, ret.part);
+
+  // statistics of the cut
+  vector<bool> used(parts, false);
+  for(size_t p : ret.part) used[p] = true;
+  for(const auto &o : owners)
+    {
+      const vector<size_t> &v = o.second;
+      const bool cut = 2 == v.size() && ret.part[v[0]] != ret.part[v[1]];
+      if(cut)
+	{
+	  ret.cut.push_back(o.first);
+	  ret.cut_cost += std::log2(double(dims[o.first]));
+	}
+      if(1 == v.size() || cut)
+	for(size_t i : v) ret.volume[ret.part[i]] *= dims[o.first];
+    }
+  size_t largest = 0;
+  for(size_t p = 0; p < parts; ++p)
+    {
+      if(!used[p]) ret.volume[p] = 0;
+      if(ret.volume[p] > ret.volume[largest]) largest = p;
+    }
+  // summing the others avoids subtracting volumes which overflow
+  for(size_t p = 0; p < parts; ++p)
+    if(p != largest) ret.communication += ret.volume[p];
+  return ret;
+}
+
+Partition partition(Graph& g, size_t parts, double imbalance)
+{
+  return partition(topology_operands(topology(g)), parts, imbalance);
+}
+
+// ########################### execute_partitioned ###################
+DenseTensor execute_partitioned(const Partition& p,
+				const vector<TensorView>& operands)
+{
+#ifndef NO_ERROR_CHECKING
+  if(p.part.size() != operands.size())
+    LOG_MSG_(FATAL) << kErrListLength << "partition passed to "
+      "execute_partitioned() covers " << p.part.size() << " operands, "
+      "not " << operands.size();
+#endif // NO_ERROR_CHECKING
+
+  vector<vector<TensorView>> members(p.parts);
+  for(size_t i = 0; i < operands.size(); ++i)
+    members[p.part[i]].push_back(operands[i]);
+
+  // parts are independent, and are contracted concurrently
+  vector<DenseTensor> results(p.parts);
+  vector<std::thread> pool;
+  for(size_t k = 0; k < p.parts; ++k)
+    if(!members[k].empty())
+      pool.emplace_back([&members, &results, k]()
+			{
+			  results[k] = execute(greedy_plan(members[k]),
+					       members[k]);
+			});
+  for(std::thread &t : pool) t.join();
+
+  vector<TensorView> views;
+  for(size_t k = 0; k < p.parts; ++k)
+    if(!members[k].empty()) views.push_back(results[k].view());
+  return execute(greedy_plan(views), views);
+}
@@ -0,0 +1,74 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// division of networks into parts which can be contracted separately
+
+#pragma once
+
+#include <vector>
+#include "contract.hh"
+
+// forward declare to avoid dependencies between headers
+class Graph;
+
+// Graphs of at most this many vertices are bisected directly; larger
+// ones are first coarsened.
+const size_t kCoarsestPartition = 16;
+// Allowed excess of the size of a part over its share of the total,
+// as a fraction of that share.
+const double kPartitionImbalance = 0.1;
+
+// A division of the operands of a network into parts.
+struct Partition
+{
+  // Number of parts, and the part holding each operand.
+  size_t parts;
+  std::vector<size_t> part;
+  // Labels joining operands in different parts, in increasing order.
+  std::vector<size_t> cut;
+  // Sum over cut labels of log2 of their dimension, which is what the
+  // partitioner minimizes: each cut leg multiplies the size of the
+  // results of the parts it joins.
+  double cut_cost;
+  // For each part, the number of entries left by contracting it: the
+  // product of the dimensions of its legs which leave the part, cut
+  // or open.  Zero for an empty part.
+  std::vector<double> volume;
+  // Entries moved if every part is contracted where it lives and the
+  // results are gathered to the part with the largest: the sum of the
+  // volumes of the others.
+  double communication;
+};
+
+// Divide operands into parts by multilevel recursive bisection.  The
+// graph has a vertex for every operand, weighted by its size, and an
+// edge for every shared label, weighted by log2 of its dimension.  It
+// is coarsened by heavy-edge matching, the coarsest graph bisected by
+// greedy growth from every vertex, and the bisection refined by
+// Fiduccia-Mattheyses passes at each level on the way back.  Each part
+// is kept within 1 + imbalance times its share of the total size
+// where possible.  Labels are as for greedy_plan().
+Partition partition(const std::vector<TensorView>& operands, size_t parts,
+		    double imbalance = kPartitionImbalance);
+// Divide the tensors of g, seen as topology_operands(topology(g)), so
+// that operand i is vertex i of topology(g).
+Partition partition(Graph& g, size_t parts,
+		    double imbalance = kPartitionImbalance);
+// Contract the operands of every part on a thread of its own, each by
+// greedy_plan(), and then contract the results of the parts.
+DenseTensor execute_partitioned(const Partition& p,
+				const std::vector<TensorView>& operands);
@@ -0,0 +1,606 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include "log_msg.hh"
+#include "plan.hh"
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+using std::complex;
+using std::set;
+using std::unordered_map;
+using std::vector;
+
+// The shape of an operand, as tracked while planning.
+struct PlanOperand
+{
+  vector<size_t> dims;
+  vector<size_t> labels;
+  bool live;
+};
+
+// Operands carrying a label.  A label has at most two owners; an
+// unused slot holds kNoOwner.
+const size_t kNoOwner = static_cast<size_t>(-1);
+struct LabelOwners
+{
+  size_t first;
+  size_t second;
+};
+
+// ########################### operand_size ##########################
+static double operand_size(const PlanOperand& a)
+{
+  double n = 1;
+  for(size_t d : a.dims) n *= d;
+  return n;
+}
+
+// ########################### contracted_shape ######################
+// Shape of the contraction of a and b, with legs in the order
+// produced by contract().
+static PlanOperand contracted_shape(const PlanOperand& a,
+				    const PlanOperand& b)
+{
+  PlanOperand ret{ {}, {}, true };
+  for(size_t i = 0; i < a.labels.size(); ++i)
+    {
+      size_t j = 0;
+      while(j < b.labels.size() && b.labels[j] != a.labels[i]) ++j;
+      if(j == b.labels.size())
+	{
+	  ret.dims.push_back(a.dims[i]);
+	  ret.labels.push_back(a.labels[i]);
+	}
+    }
+  for(size_t j = 0; j < b.labels.size(); ++j)
+    {
+      size_t i = 0;
+      while(i < a.labels.size() && a.labels[i] != b.labels[j]) ++i;
+      if(i == a.labels.size())
+	{
+	  ret.dims.push_back(b.dims[j]);
+	  ret.labels.push_back(b.labels[j]);
+	}
+    }
+  return ret;
+}
+
+// ########################### pair_cost #############################
+// Multiply-adds needed to contract a and b into result, which is the
+// product of the dimensions of every distinct leg.
+static double pair_cost(const PlanOperand& a, const PlanOperand& b,
+			const PlanOperand& result)
+{
+  return std::sqrt(operand_size(a) * operand_size(b) * operand_size(result));
+}
+
+// ########################### smallest_pair #########################
+// The two smallest live operands, a being no larger than b.
+static void smallest_pair(const vector<PlanOperand>& shapes, size_t& a,
+			  size_t& b)
+{
+  a = b = kNoOwner;
+  for(size_t i = 0; i < shapes.size(); ++i)
+    {
+      if(!shapes[i].live) continue;
+      if(kNoOwner == a || operand_size(shapes[i]) < operand_size(shapes[a]))
+	{
+	  b = a;
+	  a = i;
+	}
+      else if(kNoOwner == b || operand_size(shapes[i])
+	      < operand_size(shapes[b]))
+	b = i;
+    }
+}
+
+// ########################### other_owner ###########################
+// The owner of label l other than operand i, or kNoOwner.
+static size_t other_owner(const vector<LabelOwners>& owners, size_t l,
+			  size_t i)
+{
+  return i == owners[l].first ? owners[l].second : owners[l].first;
+}
+
+// ########################### elimination_key #######################
+// Position of a summed label in the order of elimination, by the
+// primary and secondary measures of the heuristic, each scaled by the
+// label's weight, and then by the label itself.  Labels are dense
+// indices into owners.
+typedef std::tuple<double, double, size_t> EliminationKey;
+static EliminationKey elimination_key(const vector<PlanOperand>& shapes,
+				      const vector<LabelOwners>& owners,
+				      EliminationHeuristic heuristic,
+				      const vector<double>& weight, size_t l)
+{
+  const size_t a = owners[l].first, b = owners[l].second;
+
+  // Eliminating l makes every leg of the contraction of its owners
+  // adjacent.  Legs of one owner are already adjacent to each other,
+  // and a leg of a only to a leg of b if they share a third operand.
+  double fill = 0;
+  for(size_t x : shapes[a].labels)
+    {
+      const size_t xo = other_owner(owners, x, a);
+      if(b == xo) continue;
+      for(size_t z : shapes[b].labels)
+	{
+	  const size_t zo = other_owner(owners, z, b);
+	  if(a != zo && (kNoOwner == xo || xo != zo)) ++fill;
+	}
+    }
+  // the weighted degree of l, less the legs summed with it
+  const double degree = std::log2(operand_size(contracted_shape(shapes[a],
+								shapes[b])));
+
+  if(ELIMINATE_MIN_FILL == heuristic)
+    return EliminationKey{weight[l] * fill, weight[l] * degree, l};
+  return EliminationKey{weight[l] * degree, weight[l] * fill, l};
+}
+
+// ########################### eliminate #############################
+// The plan contracting the owners of each summed label in the order
+// of elimination, with shapes and owners as set up by tree_plan().
+static ContractionPlan eliminate(vector<PlanOperand> shapes,
+				 vector<LabelOwners> owners,
+				 EliminationHeuristic heuristic,
+				 const vector<double>& weight)
+{
+  const size_t n = shapes.size();
+  shapes.reserve(2*n - 1);
+
+  // Labels awaiting elimination, with their current keys.  A label is
+  // queued while it joins two distinct live operands.
+  set<EliminationKey> queue;
+  vector<EliminationKey> key(owners.size());
+  vector<bool> queued(owners.size(), false);
+  auto rescore = [&](size_t l)
+    {
+      if(queued[l]) queue.erase(key[l]);
+      queued[l] = kNoOwner != owners[l].second
+	&& owners[l].first != owners[l].second;
+      if(!queued[l]) return;
+      key[l] = elimination_key(shapes, owners, heuristic, weight, l);
+      queue.insert(key[l]);
+    };
+  for(size_t l = 0; l < owners.size(); ++l)
+    rescore(l);
+
+  ContractionPlan plan{ {}, 0, 0 };
+  for(size_t step = 0; step + 1 < n; ++step)
+    {
+      size_t a, b;
+      if(queue.empty()) smallest_pair(shapes, a, b);
+      else
+	{
+	  const size_t l = std::get<2>(*queue.begin());
+	  a = owners[l].first;
+	  b = owners[l].second;
+	}
+
+      PlanOperand r = contracted_shape(shapes[a], shapes[b]);
+      plan.steps.push_back(ContractionStep{a, b});
+      plan.flops += pair_cost(shapes[a], shapes[b], r);
+      plan.peak = std::max(plan.peak, operand_size(r));
+
+      // Legs shared by a and b are summed and leave the graph, and the
+      // result takes over the rest.
+      const size_t id = shapes.size();
+      for(size_t l : shapes[a].labels)
+	if(b == other_owner(owners, l, a) && queued[l])
+	  {
+	    queue.erase(key[l]);
+	    queued[l] = false;
+	  }
+      for(size_t l : r.labels)
+	{
+	  LabelOwners &o = owners[l];
+	  if(a == o.first || b == o.first) o.first = id;
+	  else o.second = id;
+	}
+      shapes[a].live = shapes[b].live = false;
+      shapes.push_back(std::move(r));
+
+      // The keys of the legs of the result change, as do those of legs
+      // of its neighbours, which may now be adjacent to more labels.
+      for(size_t l : shapes[id].labels)
+	{
+	  rescore(l);
+	  const size_t o = other_owner(owners, l, id);
+	  if(kNoOwner != o)
+	    for(size_t m : shapes[o].labels)
+	      rescore(m);
+	}
+    }
+
+  return plan;
+}
+
+// ########################### plan_cost #############################
+// Set the flops and peak of plan over operands of the given shapes,
+// and list the labels of any intermediate with more than memory
+// entries in large.
+static void plan_cost(ContractionPlan& plan, vector<PlanOperand> shapes,
+		      double memory, set<size_t>& large)
+{
+  plan.flops = plan.peak = 0;
+  large.clear();
+  for(const ContractionStep &s : plan.steps)
+    {
+      PlanOperand r = contracted_shape(shapes[s.first], shapes[s.second]);
+      plan.flops += pair_cost(shapes[s.first], shapes[s.second], r);
+      plan.peak = std::max(plan.peak, operand_size(r));
+      if(operand_size(r) > memory) large.insert(r.labels.begin(),
+						r.labels.end());
+      shapes.push_back(std::move(r));
+    }
+}
+
+// ########################### slice_view ############################
+// View of v with each leg labelled sliced[i] fixed at value[i].
+static TensorView slice_view(TensorView v, const vector<size_t>& sliced,
+			     const vector<size_t>& value)
+{
+  size_t j = 0;
+  for(size_t i = 0; i < v.labels.size(); ++i)
+    {
+      const size_t k = std::find(sliced.begin(), sliced.end(), v.labels[i])
+	- sliced.begin();
+      if(k < sliced.size()) v.data += value[k] * v.strides[i];
+      else
+	{
+	  v.dims[j] = v.dims[i];
+	  v.strides[j] = v.strides[i];
+	  v.labels[j] = v.labels[i];
+	  ++j;
+	}
+    }
+  v.dims.resize(j);
+  v.strides.resize(j);
+  v.labels.resize(j);
+  return v;
+}
+
+// ########################### greedy_plan ###########################
+ContractionPlan greedy_plan(const vector<TensorView>& operands)
+{
+#ifndef NO_ERROR_CHECKING
+  if(operands.empty())
+    LOG_MSG_(FATAL) << kErrListLength << "greedy_plan() called with no "
+      "operands";
+#endif // NO_ERROR_CHECKING
+
+  const size_t n = operands.size();
+  vector<PlanOperand> shapes;
+  shapes.reserve(2*n - 1);
+  unordered_map<size_t, LabelOwners> owners;
+  for(size_t i = 0; i < n; ++i)
+    {
+      shapes.push_back(PlanOperand{operands[i].dims, operands[i].labels,
+	    true});
+      for(size_t l : operands[i].labels)
+	{
+	  LabelOwners &o = owners.emplace(l, LabelOwners{kNoOwner, kNoOwner})
+	    .first->second;
+	  if(kNoOwner == o.first) o.first = i;
+	  else if(kNoOwner == o.second) o.second = i;
+#ifndef NO_ERROR_CHECKING
+	  else
+	    LOG_MSG_(FATAL) << kErrIncompatible << "label " << l <<
+	      " appears on more than two operands passed to greedy_plan()";
+#endif // NO_ERROR_CHECKING
+	}
+    }
+
+  ContractionPlan plan{ {}, 0, 0 };
+  for(size_t step = 0; step + 1 < n; ++step)
+    {
+      // Consider every pair of live operands joined by a label, and
+      // keep the one which removes the most entries from the network.
+      size_t best_a = kNoOwner, best_b = kNoOwner;
+      double best_score = 0;
+      for(const auto &entry : owners)
+	{
+	  const LabelOwners &o = entry.second;
+	  if(kNoOwner == o.second) continue;
+	  PlanOperand r = contracted_shape(shapes[o.first], shapes[o.second]);
+	  double score = operand_size(r) - operand_size(shapes[o.first])
+	    - operand_size(shapes[o.second]);
+	  // break ties by operand number so the plan does not depend on
+	  // the iteration order of owners
+	  const size_t lo = std::min(o.first, o.second),
+	    hi = std::max(o.first, o.second);
+	  if(kNoOwner == best_a || score < best_score
+	     || (score == best_score && (lo < best_a
+					 || (lo == best_a && hi < best_b))))
+	    {
+	      best_a = lo;
+	      best_b = hi;
+	      best_score = score;
+	    }
+	}
+
+      // With nothing left to join, take the outer product of the two
+      // smallest operands.
+      if(kNoOwner == best_a) smallest_pair(shapes, best_a, best_b);
+
+      // record the step, and update the network to contain its result
+      PlanOperand r = contracted_shape(shapes[best_a], shapes[best_b]);
+      plan.steps.push_back(ContractionStep{best_a, best_b});
+      plan.flops += pair_cost(shapes[best_a], shapes[best_b], r);
+      plan.peak = std::max(plan.peak, operand_size(r));
+
+      // The result takes over the free labels of both operands, and
+      // the labels summed by this step disappear.
+      const size_t id = shapes.size();
+      for(size_t l : r.labels)
+	{
+	  LabelOwners &o = owners[l];
+	  if(best_a == o.first || best_b == o.first) o.first = id;
+	  else o.second = id;
+	}
+      for(size_t l : shapes[best_a].labels)
+	if(owners[l].first != id && owners[l].second != id) owners.erase(l);
+      shapes[best_a].live = shapes[best_b].live = false;
+      shapes.push_back(std::move(r));
+    }
+
+  return plan;
+}
+
+// ########################### tree_plan #############################
+ContractionPlan tree_plan(const vector<TensorView>& operands,
+			  EliminationHeuristic heuristic, double seconds)
+{
+#ifndef NO_ERROR_CHECKING
+  if(operands.empty())
+    LOG_MSG_(FATAL) << kErrListLength << "tree_plan() called with no "
+      "operands";
+#endif // NO_ERROR_CHECKING
+
+  // Number the labels densely, so that the line graph can be held in
+  // arrays.  Its edges are implicit: two labels are adjacent while
+  // they share a live operand.
+  const size_t n = operands.size();
+  vector<PlanOperand> shapes;
+  shapes.reserve(n);
+  vector<LabelOwners> owners;
+  unordered_map<size_t, size_t> index;
+  for(size_t i = 0; i < n; ++i)
+    {
+      shapes.push_back(PlanOperand{operands[i].dims, operands[i].labels,
+	    true});
+      for(size_t &l : shapes[i].labels)
+	{
+	  auto entry = index.emplace(l, owners.size());
+	  if(entry.second) owners.push_back(LabelOwners{i, kNoOwner});
+	  else if(kNoOwner == owners[entry.first->second].second)
+	    owners[entry.first->second].second = i;
+#ifndef NO_ERROR_CHECKING
+	  else
+	    LOG_MSG_(FATAL) << kErrIncompatible << "label " << l <<
+	      " appears on more than two operands passed to tree_plan()";
+#endif // NO_ERROR_CHECKING
+	  l = entry.first->second;
+	}
+    }
+
+  vector<double> weight(owners.size(), 1);
+  ContractionPlan ret = eliminate(shapes, owners, heuristic, weight);
+  if(seconds <= 0) return ret;
+
+  // Refine by randomized restarts.  The generator is seeded
+  // identically on each call, so that only the number of restarts
+  // depends on the time allowed.
+  const auto stop = steady_clock::now() + duration<double>(seconds);
+  std::mt19937 generator;
+  std::uniform_real_distribution<double> noise(1, 1 + kTreeNoise);
+  while(steady_clock::now() < stop)
+    {
+      for(double &w : weight) w = noise(generator);
+      ContractionPlan plan = eliminate(shapes, owners, heuristic, weight);
+      if(plan.peak < ret.peak
+	 || (plan.peak == ret.peak && plan.flops < ret.flops))
+	ret = std::move(plan);
+    }
+  return ret;
+}
+
+// ########################### contraction_width #####################
+double contraction_width(const ContractionPlan& plan)
+{
+  return std::log2(plan.peak);
+}
+
+// ########################### slice_plan ############################
+SlicedPlan slice_plan(const vector<TensorView>& operands,
+		      const ContractionPlan& plan, double memory)
+{
+#ifndef NO_ERROR_CHECKING
+  if(operands.empty() || plan.steps.size() + 1 != operands.size())
+    LOG_MSG_(FATAL) << kErrListLength << "plan passed to slice_plan() "
+      "has " << plan.steps.size() << " steps for " << operands.size() <<
+      " operands";
+#endif // NO_ERROR_CHECKING
+
+  // Slicing a label is costed by setting its dimension to one.
+  vector<PlanOperand> shapes;
+  unordered_map<size_t, size_t> uses;
+  for(const TensorView &v : operands)
+    {
+      shapes.push_back(PlanOperand{v.dims, v.labels, true});
+      for(size_t l : v.labels) ++uses[l];
+    }
+
+  SlicedPlan ret{plan, {}, 1, 0, 0};
+  set<size_t> large;
+  plan_cost(ret.plan, shapes, memory, large);
+  ret.flops = ret.plan.flops;
+  ret.peak = ret.plan.peak;
+  while(ret.peak > memory)
+    {
+      size_t best = kNoOwner, best_dim = 1;
+      ContractionPlan trial = ret.plan, chosen{};
+      set<size_t> trial_large;
+      for(size_t l : large)
+	{
+	  if(2 != uses[l]) continue;
+	  vector<PlanOperand> sliced = shapes;
+	  size_t dim = 1;
+	  for(PlanOperand &a : sliced)
+	    for(size_t i = 0; i < a.labels.size(); ++i)
+	      if(l == a.labels[i]) std::swap(dim, a.dims[i]);
+	  if(1 == dim) continue;
+	  plan_cost(trial, sliced, memory, trial_large);
+	  if(kNoOwner == best || trial.flops * dim < chosen.flops * best_dim
+	     || (trial.flops * dim == chosen.flops * best_dim
+		 && trial.peak < chosen.peak))
+	    {
+	      best = l;
+	      best_dim = dim;
+	      chosen = trial;
+	    }
+	}
+      if(kNoOwner == best) break;
+
+      for(PlanOperand &a : shapes)
+	for(size_t i = 0; i < a.labels.size(); ++i)
+	  if(best == a.labels[i]) a.dims[i] = 1;
+      ret.sliced.push_back(best);
+      ret.slices *= best_dim;
+      plan_cost(ret.plan, shapes, memory, large);
+      ret.flops = ret.slices * ret.plan.flops;
+      ret.peak = ret.plan.peak;
+    }
+  return ret;
+}
+
+// ########################### execute ###############################
+DenseTensor execute(const ContractionPlan& plan,
+		    const vector<TensorView>& operands)
+{
+  const size_t n = operands.size();
+
+#ifndef NO_ERROR_CHECKING
+  if(operands.empty() || plan.steps.size() + 1 != n)
+    LOG_MSG_(FATAL) << kErrListLength << "plan passed to execute() has " <<
+      plan.steps.size() << " steps for " << n << " operands";
+#endif // NO_ERROR_CHECKING
+
+  if(plan.steps.empty()) return to_dense(operands[0]);
+
+  vector<DenseTensor> results(plan.steps.size());
+  vector<bool> used(n + plan.steps.size(), false);
+  for(size_t i = 0; i < plan.steps.size(); ++i)
+    {
+      const size_t a = plan.steps[i].first, b = plan.steps[i].second;
+#ifndef NO_ERROR_CHECKING
+      // each operand must already exist and be consumed exactly once
+      if(a >= n + i || b >= n + i || a == b || used[a] || used[b])
+	LOG_MSG_(FATAL) << kErrBounds << "step " << i << " of plan passed "
+	  "to execute() uses operands " << a << " and " << b;
+#endif // NO_ERROR_CHECKING
+      used[a] = used[b] = true;
+
+      results[i] = contract(a < n ? operands[a] : results[a - n].view(),
+			    b < n ? operands[b] : results[b - n].view());
+
+      // intermediates are used only once, so release them immediately
+      if(a >= n) vector<complex<double>>{}.swap(results[a - n].data);
+      if(b >= n) vector<complex<double>>{}.swap(results[b - n].data);
+    }
+
+  return std::move(results.back());
+}
+
+DenseTensor execute(const SlicedPlan& plan, const vector<TensorView>& operands,
+		    size_t threads)
+{
+  if(plan.sliced.empty()) return execute(plan.plan, operands);
+
+  // Find the dimension of each sliced label, and densify any identity
+  // carrying one, since its view has no data to offset.
+  vector<size_t> dims(plan.sliced.size(), 0);
+  vector<TensorView> views = operands;
+  vector<DenseTensor> dense;
+  dense.reserve(views.size());
+  for(TensorView &v : views)
+    for(size_t i = 0; i < v.labels.size(); ++i)
+      {
+	const size_t k = std::find(plan.sliced.begin(), plan.sliced.end(),
+				   v.labels[i]) - plan.sliced.begin();
+	if(k == plan.sliced.size()) continue;
+	dims[k] = v.dims[i];
+	if(v.identity)
+	  {
+	    dense.push_back(to_dense(v));
+	    v = dense.back().view();
+	  }
+      }
+
+  size_t slices = 1;
+  for(size_t d : dims)
+    {
+#ifndef NO_ERROR_CHECKING
+      if(0 == d)
+	LOG_MSG_(FATAL) << kErrIncompatible << "sliced label passed to "
+	  "execute() appears on no operand";
+#endif // NO_ERROR_CHECKING
+      slices *= d;
+    }
+
+  if(0 == threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, slices);
+  vector<DenseTensor> sums(threads);
+  auto work = [&](size_t t)
+    {
+      vector<size_t> value(dims.size());
+      vector<TensorView> slice(views.size());
+      for(size_t s = slices * t / threads; s < slices * (t + 1) / threads;
+	  ++s)
+	{
+	  // the last sliced label varies fastest
+	  for(size_t k = dims.size(), rest = s; k-- > 0; rest /= dims[k])
+	    value[k] = rest % dims[k];
+	  for(size_t i = 0; i < views.size(); ++i)
+	    slice[i] = slice_view(views[i], plan.sliced, value);
+	  DenseTensor r = execute(plan.plan, slice);
+	  if(sums[t].data.empty()) sums[t] = std::move(r);
+	  else
+	    for(size_t i = 0; i < r.data.size(); ++i)
+	      sums[t].data[i] += r.data[i];
+	}
+    };
+  vector<std::thread> pool;
+  for(size_t t = 1; t < threads; ++t) pool.emplace_back(work, t);
+  work(0);
+  for(std::thread &p : pool) p.join();
+
+  for(size_t t = 1; t < threads; ++t)
+    for(size_t i = 0; i < sums[0].data.size(); ++i)
+      sums[0].data[i] += sums[t].data[i];
+  return std::move(sums[0]);
+}
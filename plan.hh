@@ -0,0 +1,128 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// planning and evaluation of contractions of whole networks
+
+#pragma once
+
+#include <vector>
+#include "contract.hh"
+
+// Relative size of the random perturbations of the elimination
+// heuristic in the refinement runs of tree_plan().
+const double kTreeNoise = 0.5;
+
+// A single pairwise contraction.  Operands are numbered in the order
+// they were given to the planner, and the result of step i receives
+// the number (operands + i), so that later steps may refer to it.
+struct ContractionStep
+{
+  size_t first;
+  size_t second;
+};
+
+// An ordered sequence of pairwise contractions reducing a network to
+// a single tensor, together with estimates of its cost.
+struct ContractionPlan
+{
+  std::vector<ContractionStep> steps;
+  // Total number of complex multiply-adds.
+  double flops;
+  // Number of entries in the largest intermediate result.
+  double peak;
+};
+
+// Choose a contraction order greedily, at each step contracting the
+// pair of operands sharing a label whose result shrinks the network
+// the most.  Only the dimensions and labels of the operands are
+// examined.  Every label must appear on at most two operands; labels
+// appearing on one operand are left open in the result.
+ContractionPlan greedy_plan(const std::vector<TensorView>& operands);
+
+// Heuristics for choosing the next vertex to eliminate from a graph.
+// MIN_FILL takes the vertex whose neighbours lack the fewest edges
+// among themselves, and MIN_DEGREE the vertex of least weighted
+// degree, each breaking ties by the other measure.
+enum EliminationHeuristic
+{
+  ELIMINATE_MIN_FILL,
+  ELIMINATE_MIN_DEGREE
+};
+
+// Choose a contraction order from a tree decomposition of the line
+// graph of the network, whose vertices are the labels and whose edges
+// join labels appearing on a common operand, weighted by log2 of
+// their dimensions.  Summed labels are eliminated one at a time as
+// chosen by heuristic, and eliminating a label contracts the two
+// operands carrying it, so that each bag of the decomposition holds
+// the legs of one pairwise contraction.  Open labels remain in the
+// graph but are never eliminated, and disconnected parts are finally
+// joined as by greedy_plan().  For networks which are far from trees,
+// such as grids and circuits, this avoids the wide intermediates into
+// which greedy_plan() is drawn.
+//
+// If seconds is positive, further orders are tried for that long with
+// the heuristic's measures scaled by random factors in [1, 1 +
+// kTreeNoise), and the plan with the smallest peak (then the fewest
+// flops) is kept; the result then depends on the speed of the
+// machine.  Labels are as for greedy_plan(); the operands of the
+// network spanned by a DFSGraph are topology_operands(topology(g)).
+ContractionPlan tree_plan(const std::vector<TensorView>& operands,
+			  EliminationHeuristic heuristic = ELIMINATE_MIN_FILL,
+			  double seconds = 0);
+// The contraction width of plan: log2 of the number of entries of its
+// largest intermediate, so that a job whose intermediates must fit in
+// 2^w entries is feasible when the width is at most w.
+double contraction_width(const ContractionPlan& plan);
+
+// Evaluate plan over operands.  The legs of the result appear in the
+// order in which the pairwise contractions leave them.
+DenseTensor execute(const ContractionPlan& plan,
+		    const std::vector<TensorView>& operands);
+
+// A contraction plan evaluated in slices.  Fixing each sliced label to
+// one of its values leaves a network with those legs removed, which is
+// contracted by plan; summing over every combination of values gives
+// the contraction of the whole network.  Costs are those of the plan
+// over all slices, and peak is that of a single slice.
+struct SlicedPlan
+{
+  ContractionPlan plan;
+  std::vector<size_t> sliced;
+  // Number of slices: the product of the dimensions of sliced labels.
+  double slices;
+  double flops;
+  double peak;
+};
+
+// Choose labels to slice so that no intermediate of plan has more than
+// memory entries, keeping the order of plan.  Labels are chosen one at
+// a time, each being the summed label, among those of intermediates
+// still too large, which adds the fewest flops over all slices.  Open
+// labels are never sliced, so if the result itself exceeds memory, or
+// slicing every summed label does not suffice, the peak of the result
+// remains above memory and the caller should check it.
+SlicedPlan slice_plan(const std::vector<TensorView>& operands,
+		      const ContractionPlan& plan, double memory);
+// Evaluate plan over operands, dividing the slices between a number of
+// threads, which is taken from the hardware if zero.  Each thread sums
+// a contiguous range of slices, and the sums are added in order, so the
+// result does not vary between runs with the same number of threads.
+// The legs of the result are as for execute() with plan.plan.
+DenseTensor execute(const SlicedPlan& plan,
+		    const std::vector<TensorView>& operands,
+		    size_t threads = 0);
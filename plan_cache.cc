@@ -0,0 +1,672 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "graph.hh"
+#include "log_msg.hh"
+#include "matrix.hh"
+#include "network.hh"
+#include "plan_cache.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::ifstream;
+using std::ofstream;
+using std::ostringstream;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// Tag and version written at the head of every plan file.
+const char* const kPlanFileTag = "tensor-network-plan";
+const int kPlanFileVersion = 1;
+// Tag ("tnresult" read as a little-endian word) and version written
+// at the head of every result file, and the alignment of its entries.
+const uint64_t kResultFileTag = 0x746c757365726e74ULL;
+const uint64_t kResultFileVersion = 1;
+const size_t kResultAlign = 64;
+
+// Codes used in place of a vertex position for legs which are not
+// linked within the graph.
+const size_t kUnlinked = 0;
+const size_t kOutside = 1;
+
+// A leg as seen by the canonicalization: the vertex it is linked to
+// (a position in the vertex list, or kNoVertex) and the linked leg.
+const size_t kNoVertex = static_cast<size_t>(-1);
+struct TopologyLeg
+{
+  size_t vertex;
+  size_t num;
+  bool linked;
+};
+
+// A result held by a ResultCache, with the encoding and content hashes
+// it was computed for and when it was last used.  Its entries are in
+// result, or in a mapping of a result file.
+struct CachedResult
+{
+  vector<size_t> encoding;
+  vector<uint64_t> content;
+  DenseTensor result;
+  void *mapping = nullptr;
+  size_t mapped = 0;
+  TensorView view;
+  uint64_t used = 0;
+  ~CachedResult()
+  {
+    if(nullptr != mapping) munmap(mapping, mapped);
+  }
+};
+
+// ########################### mix ###################################
+// Combine v into the hash h.  The finalizer is that of splitmix64.
+static uint64_t mix(uint64_t h, uint64_t v)
+{
+  h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+// ########################### distinct ##############################
+static size_t distinct(vector<uint64_t> colors)
+{
+  std::sort(colors.begin(), colors.end());
+  return std::unique(colors.begin(), colors.end()) - colors.begin();
+}
+
+// ########################### canonical_encoding ####################
+// Number the vertices by breadth-first search from start, visiting
+// the inputs and then the outputs of each vertex in order, and encode
+// the graph under that numbering.  Vertices not reached from start
+// are numbered by further searches, each started from the remaining
+// vertex of least colour.
+static vector<size_t> canonical_encoding(const vector<Tensor*>& tensors,
+					 const vector<vector<TopologyLeg>>& legs,
+					 const vector<uint64_t>& colors,
+					 size_t start, vector<size_t>& order)
+{
+  const size_t n = tensors.size();
+  vector<size_t> pos(n, kNoVertex);
+  order.clear();
+  order.reserve(n);
+  for(size_t next = start; kNoVertex != next; )
+    {
+      pos[next] = order.size();
+      order.push_back(next);
+      for(size_t i = order.size() - 1; i < order.size(); ++i)
+	for(const TopologyLeg &l : legs[order[i]])
+	  if(kNoVertex != l.vertex && kNoVertex == pos[l.vertex])
+	    {
+	      pos[l.vertex] = order.size();
+	      order.push_back(l.vertex);
+	    }
+
+      next = kNoVertex;
+      for(size_t i = 0; i < n; ++i)
+	if(kNoVertex == pos[i] && (kNoVertex == next || colors[i] < colors[next]))
+	  next = i;
+    }
+
+  vector<size_t> enc;
+  enc.push_back(n);
+  for(size_t v : order)
+    {
+      Tensor *t = tensors[v];
+      enc.push_back(t->inputs());
+      enc.push_back(t->outputs());
+      enc.push_back(t->input_rank());
+      enc.push_back(t->output_rank());
+      for(const TopologyLeg &l : legs[v])
+	{
+	  enc.push_back(!l.linked ? kUnlinked : kNoVertex == l.vertex ?
+			kOutside : pos[l.vertex] + 2);
+	  enc.push_back(l.linked ? l.num : 0);
+	}
+    }
+  return enc;
+}
+
+// ########################### canonical_topology ####################
+// The canonical topology of tensors, whose legs have been gathered in
+// legs (inputs before outputs).
+static Topology canonical_topology(const vector<Tensor*>& tensors,
+				   const vector<vector<TopologyLeg>>& legs)
+{
+  const size_t n = tensors.size();
+
+  // Refine colours, starting from the shape of each tensor, until the
+  // number of colour classes stops growing.
+  vector<uint64_t> colors(n);
+  for(size_t i = 0; i < n; ++i)
+    colors[i] = mix(mix(mix(mix(0, tensors[i]->inputs()),
+			    tensors[i]->outputs()),
+			tensors[i]->input_rank()), tensors[i]->output_rank());
+  for(size_t classes = distinct(colors); ; )
+    {
+      vector<uint64_t> next(n);
+      for(size_t i = 0; i < n; ++i)
+	{
+	  uint64_t h = colors[i];
+	  for(const TopologyLeg &l : legs[i])
+	    h = mix(mix(h, !l.linked ? kUnlinked : kNoVertex == l.vertex ?
+			kOutside : colors[l.vertex]), l.num);
+	  next[i] = h;
+	}
+      colors.swap(next);
+      size_t refined = distinct(colors);
+      if(refined == classes) break;
+      classes = refined;
+    }
+
+  // The search is started from each member of the rarest colour class
+  // (the least colour among equally rare classes), keeping the least
+  // encoding.  For a MERA the top tensor is usually alone in its class.
+  unordered_map<uint64_t, size_t> counts;
+  for(uint64_t c : colors) ++counts[c];
+  uint64_t rarest = 0;
+  size_t rarest_count = 0;
+  for(const auto &c : counts)
+    if(0 == rarest_count || c.second < rarest_count
+       || (c.second == rarest_count && c.first < rarest))
+      {
+	rarest = c.first;
+	rarest_count = c.second;
+      }
+
+  Topology ret{0, {}, {}};
+  vector<size_t> order, best_order;
+  for(size_t i = 0; i < n; ++i)
+    {
+      if(colors[i] != rarest) continue;
+      vector<size_t> enc = canonical_encoding(tensors, legs, colors, i, order);
+      if(ret.encoding.empty() || enc < ret.encoding)
+	{
+	  ret.encoding.swap(enc);
+	  best_order.swap(order);
+	}
+    }
+  if(0 == n) ret.encoding.push_back(0);
+
+  for(size_t v : best_order) ret.vertices.push_back(tensors[v]);
+  ret.fingerprint = 0;
+  for(size_t e : ret.encoding) ret.fingerprint = mix(ret.fingerprint, e);
+  return ret;
+}
+
+// ########################### topology ##############################
+Topology topology(Graph& g)
+{
+  vector<Tensor*> tensors(g.vertex_begin(), g.vertex_end());
+  const size_t n = tensors.size();
+  unordered_map<Tensor*, size_t> index;
+  for(size_t i = 0; i < n; ++i) index[tensors[i]] = i;
+
+  // gather the legs of every vertex, inputs before outputs
+  vector<vector<TopologyLeg>> legs(n);
+  for(size_t i = 0; i < n; ++i)
+    {
+      Tensor *t = tensors[i];
+      for(size_t j = 0; j < t->inputs(); ++j)
+	{
+	  auto it = index.find(t->input_tensor(j));
+	  legs[i].push_back(TopologyLeg{it == index.end() ? kNoVertex
+		: it->second, t->input_num(j), nullptr != t->input_tensor(j)});
+	}
+      for(size_t j = 0; j < t->outputs(); ++j)
+	{
+	  auto it = index.find(t->output_tensor(j));
+	  legs[i].push_back(TopologyLeg{it == index.end() ? kNoVertex
+		: it->second, t->output_num(j), nullptr != t->output_tensor(j)});
+	}
+    }
+  return canonical_topology(tensors, legs);
+}
+
+// ########################### topology ##############################
+Topology topology(Network& net)
+{
+  // the ids of the tensors in net, and their positions among them
+  vector<Tensor*> tensors;
+  vector<size_t> index(net.size(), kNoVertex);
+  for(size_t id = 0; id < net.size(); ++id)
+    if(nullptr != net.tensor(id))
+      {
+	index[id] = tensors.size();
+	tensors.push_back(net.tensor(id));
+      }
+
+  // gather the legs of every vertex from the link arrays
+  vector<vector<TopologyLeg>> legs(tensors.size());
+  for(size_t id = 0; id < net.size(); ++id)
+    {
+      if(kNoVertex == index[id]) continue;
+      vector<TopologyLeg> &l = legs[index[id]];
+      for(size_t j = 0; j < net.inputs(id); ++j)
+	{
+	  size_t linked = net.input_id(id, j);
+	  l.push_back(TopologyLeg{kNoTensor == linked ? kNoVertex
+		: index[linked], net.input_num(id, j),
+		nullptr != net.input_tensor(id, j)});
+	}
+      for(size_t j = 0; j < net.outputs(id); ++j)
+	{
+	  size_t linked = net.output_id(id, j);
+	  l.push_back(TopologyLeg{kNoTensor == linked ? kNoVertex
+		: index[linked], net.output_num(id, j),
+		nullptr != net.output_tensor(id, j)});
+	}
+    }
+  return canonical_topology(tensors, legs);
+}
+
+// ########################### topology_operands #####################
+vector<TensorView> topology_operands(const Topology& t)
+{
+  const size_t n = t.vertices.size();
+  vector<size_t> offset(n);
+  vector<vector<size_t>> out(n);
+  size_t label = 0;
+
+  // Every output gets a label of its own, which linked inputs share.
+  for(size_t v = 0, p = 1; v < n; ++v)
+    {
+      const size_t nin = t.encoding[p], nout = t.encoding[p + 1];
+      offset[v] = p + 4;
+      for(size_t j = 0; j < nout; ++j) out[v].push_back(label++);
+      p += 4 + 2*(nin + nout);
+    }
+
+  vector<TensorView> ret;
+  ret.reserve(n);
+  for(size_t v = 0; v < n; ++v)
+    {
+      vector<size_t> in(t.vertices[v]->inputs());
+      for(size_t j = 0; j < in.size(); ++j)
+	{
+	  const size_t code = t.encoding[offset[v] + 2*j];
+	  in[j] = code >= 2 ? out[code - 2][t.encoding[offset[v] + 2*j + 1]]
+	    : label++;
+	}
+      ret.push_back(tensor_view(t.vertices[v], in, out[v]));
+    }
+  return ret;
+}
+
+// ########################### PlanCache #############################
+// ########################### constructor ###########################
+PlanCache::PlanCache(const string& directory)
+  : _directory{directory}, _hits{0}, _misses{0}
+{
+  if(0 != mkdir(_directory.c_str(), 0777) && EEXIST != errno)
+    LOG_MSG_(WARNING) << "unable to create plan cache directory " <<
+      _directory << "; plans will not persist";
+}
+
+// ########################### plan ##################################
+ContractionPlan PlanCache::plan(const Topology& t,
+				const vector<TensorView>& operands)
+{
+#ifndef NO_ERROR_CHECKING
+  if(operands.size() != t.vertices.size())
+    LOG_MSG_(FATAL) << kErrListLength << "PlanCache::plan() given " <<
+      operands.size() << " operands for a topology with " <<
+      t.vertices.size() << " vertices";
+#endif // NO_ERROR_CHECKING
+
+  auto it = _plans.find(t.fingerprint);
+  if(it != _plans.end() && it->second.first == t.encoding)
+    {
+      ++_hits;
+      return it->second.second;
+    }
+
+  ContractionPlan p;
+  if(_load(t, p))
+    ++_hits;
+  else
+    {
+      ++_misses;
+      p = greedy_plan(operands);
+      if(!_store(t, p))
+	LOG_MSG_(WARNING) << "unable to write plan cache file " <<
+	  _path(t.fingerprint);
+    }
+
+  _plans[t.fingerprint] = std::make_pair(t.encoding, p);
+  return p;
+}
+
+// ########################### hits ##################################
+size_t PlanCache::hits()
+{
+  return _hits;
+}
+
+// ########################### misses ################################
+size_t PlanCache::misses()
+{
+  return _misses;
+}
+
+// ########################### _path #################################
+string PlanCache::_path(uint64_t fingerprint)
+{
+  ostringstream s;
+  s << _directory << "/" << std::hex << std::setw(16) << std::setfill('0')
+    << fingerprint << ".plan";
+  return s.str();
+}
+
+// ########################### _load #################################
+bool PlanCache::_load(const Topology& t, ContractionPlan& plan)
+{
+  ifstream f{_path(t.fingerprint)};
+  string tag;
+  int version = 0;
+  size_t n = 0;
+  f >> tag >> version >> n;
+  if(!f || tag != kPlanFileTag || version != kPlanFileVersion
+     || n != t.encoding.size())
+    return false;
+
+  // the stored topology must match exactly
+  for(size_t i = 0, e = 0; i < n; ++i)
+    if(!(f >> e) || e != t.encoding[i]) return false;
+
+  size_t steps = 0;
+  f >> steps;
+  if(!f || steps + 1 != std::max<size_t>(t.vertices.size(), 1))
+    return false;
+  plan.steps.resize(steps);
+  for(ContractionStep &s : plan.steps)
+    f >> s.first >> s.second;
+  f >> plan.flops >> plan.peak;
+  return static_cast<bool>(f);
+}
+
+// ########################### _store ################################
+bool PlanCache::_store(const Topology& t, const ContractionPlan& plan)
+{
+  // Write to a temporary file and rename it into place, so that other
+  // processes never see a partially written plan.
+  const string path = _path(t.fingerprint), tmp = path + ".tmp";
+  {
+    ofstream f{tmp};
+    f << kPlanFileTag << " " << kPlanFileVersion << "\n" << t.encoding.size();
+    for(size_t e : t.encoding) f << " " << e;
+    f << "\n" << plan.steps.size();
+    for(const ContractionStep &s : plan.steps)
+      f << " " << s.first << " " << s.second;
+    f << "\n" << std::setprecision(17) << plan.flops << " " << plan.peak
+      << "\n";
+    if(!f) return false;
+  }
+  return 0 == std::rename(tmp.c_str(), path.c_str());
+}
+
+// ########################### word ##################################
+// The bits of d, for hashing.
+static uint64_t word(double d)
+{
+  uint64_t ret;
+  std::memcpy(&ret, &d, sizeof(ret));
+  return ret;
+}
+
+// ########################### content_hash ##########################
+// Hash of the matrix of t.
+static uint64_t content_hash(Tensor *t)
+{
+  MatrixStruct m = t->matrix();
+  uint64_t h = mix(mix(mix(0, m.matrix->rows()), m.matrix->cols()),
+		   m.conjugate);
+  complex<double> scale;
+  if(m.matrix->scaled_identity(scale))
+    return mix(mix(mix(h, 1), word(scale.real())), word(scale.imag()));
+
+  // Four independent lanes keep the multipliers busy, so that hashing
+  // runs near memory bandwidth.
+  const size_t n = 2 * m.matrix->rows() * m.matrix->cols();
+  const double *d = reinterpret_cast<const double*>(m.matrix->data());
+  uint64_t lane[4] = {h, h + 1, h + 2, h + 3};
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+    for(size_t k = 0; k < 4; ++k)
+      {
+	lane[k] = (lane[k] ^ word(d[i + k])) * 0x9e3779b97f4a7c15ULL;
+	lane[k] ^= lane[k] >> 29;
+      }
+  for(; i < n; ++i) lane[0] = mix(lane[0], word(d[i]));
+  return mix(mix(mix(mix(h, lane[0]), lane[1]), lane[2]), lane[3]);
+}
+
+// ########################### content_hashes ########################
+vector<uint64_t> content_hashes(const Topology& t)
+{
+  vector<uint64_t> ret;
+  ret.reserve(t.vertices.size());
+  for(Tensor *v : t.vertices) ret.push_back(content_hash(v));
+  return ret;
+}
+
+// ########################### ResultCache ###########################
+// ########################### constructor ###########################
+ResultCache::ResultCache(const string& directory, PlanCache *plans,
+			 double capacity)
+  : _directory{directory}, _plans{plans}, _capacity{capacity}, _clock{0},
+    _hits{0}, _misses{0}
+{
+  if(0 != mkdir(_directory.c_str(), 0777) && EEXIST != errno)
+    LOG_MSG_(WARNING) << "unable to create result cache directory " <<
+      _directory << "; results will not persist";
+}
+
+// ########################### destructor ############################
+ResultCache::~ResultCache()
+{
+}
+
+// ########################### contract ##############################
+TensorView ResultCache::contract(const Topology& t)
+{
+  const vector<uint64_t> content = content_hashes(t);
+  uint64_t key = t.fingerprint;
+  for(uint64_t c : content) key = mix(key, c);
+
+  ++_clock;
+  auto it = _latest.find(key);
+  if(it != _latest.end() && it->second->encoding == t.encoding
+     && it->second->content == content)
+    {
+      ++_hits;
+      it->second->used = _clock;
+      return it->second->view;
+    }
+
+  std::unique_ptr<CachedResult> r{new CachedResult};
+  r->encoding = t.encoding;
+  r->content = content;
+  r->used = _clock;
+  if(_load(key, *r))
+    ++_hits;
+  else
+    {
+      ++_misses;
+      const vector<TensorView> operands = topology_operands(t);
+      r->result = execute(nullptr == _plans ? greedy_plan(operands)
+			  : _plans->plan(t, operands), operands);
+      r->view = r->result.view();
+      if(!_store(key, *r))
+	LOG_MSG_(WARNING) << "unable to write result cache file " <<
+	  _path(key);
+    }
+
+  // a result under a colliding key is replaced
+  std::unique_ptr<CachedResult>& entry = _latest[key];
+  entry = std::move(r);
+  const TensorView ret = entry->view;
+  _evict(key);
+  return ret;
+}
+
+// ########################### hits ##################################
+size_t ResultCache::hits()
+{
+  return _hits;
+}
+
+// ########################### misses ################################
+size_t ResultCache::misses()
+{
+  return _misses;
+}
+
+// ########################### _path #################################
+string ResultCache::_path(uint64_t key)
+{
+  ostringstream s;
+  s << _directory << "/" << std::hex << std::setw(16) << std::setfill('0')
+    << key << ".result";
+  return s.str();
+}
+
+// ########################### _evict ################################
+void ResultCache::_evict(uint64_t key)
+{
+  double held = 0;
+  vector<std::pair<uint64_t, uint64_t>> order;
+  for(const auto& e : _latest)
+    {
+      held += e.second->view.size();
+      if(e.first != key) order.emplace_back(e.second->used, e.first);
+    }
+  if(held <= _capacity) return;
+
+  std::sort(order.begin(), order.end());
+  for(size_t i = 0; i < order.size() && held > _capacity; ++i)
+    {
+      auto it = _latest.find(order[i].second);
+      held -= it->second->view.size();
+      _latest.erase(it);
+    }
+}
+
+// ########################### _load #################################
+bool ResultCache::_load(uint64_t key, CachedResult& r)
+{
+  const int fd = open(_path(key).c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if(0 == fstat(fd, &st) && st.st_size > 0)
+    mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(MAP_FAILED == mapping) return false;
+
+  // The header is a sequence of words: tag, version, the encoding and
+  // the content hashes (each preceded by its length), and the
+  // dimensions and labels of the result (preceded by their number).
+  const uint64_t *w = static_cast<const uint64_t*>(mapping);
+  const size_t words = st.st_size / sizeof(uint64_t);
+  size_t p = 0;
+  bool ok = words >= 4 && kResultFileTag == w[p++]
+    && kResultFileVersion == w[p++] && r.encoding.size() == w[p++]
+    && words - p > r.encoding.size()
+    && std::equal(r.encoding.begin(), r.encoding.end(), w + p);
+  if(ok)
+    {
+      p += r.encoding.size();
+      ok = r.content.size() == w[p++] && words - p > r.content.size()
+	&& std::equal(r.content.begin(), r.content.end(), w + p);
+    }
+  size_t rank = 0;
+  if(ok)
+    {
+      p += r.content.size();
+      rank = w[p++];
+      ok = (words - p) / 2 >= rank;
+    }
+
+  // the entries follow, aligned, and must lie within the file
+  size_t entries = 1;
+  for(size_t i = 0; ok && i < rank; ++i)
+    {
+      ok = 0 != w[p + i] && entries <= (st.st_size / sizeof(complex<double>))
+	/ w[p + i];
+      entries *= w[p + i];
+    }
+  const size_t offset = (p + 2*rank) * sizeof(uint64_t);
+  const size_t start = (offset + kResultAlign - 1) / kResultAlign
+    * kResultAlign;
+  if(!ok || start > static_cast<size_t>(st.st_size)
+     || entries > (st.st_size - start) / sizeof(complex<double>))
+    {
+      munmap(mapping, st.st_size);
+      return false;
+    }
+
+  r.mapping = mapping;
+  r.mapped = st.st_size;
+  vector<size_t> dims(w + p, w + p + rank), labels(w + p + rank,
+						   w + p + 2*rank);
+  vector<size_t> strides(rank);
+  for(size_t i = rank, s = 1; i-- > 0; s *= dims[i]) strides[i] = s;
+  r.view = TensorView{reinterpret_cast<const complex<double>*>
+		      (static_cast<const char*>(mapping) + start), false, dims,
+		      strides, labels, false, 0};
+  return true;
+}
+
+// ########################### _store ################################
+bool ResultCache::_store(uint64_t key, const CachedResult& r)
+{
+  vector<uint64_t> header{kResultFileTag, kResultFileVersion,
+      r.encoding.size()};
+  header.insert(header.end(), r.encoding.begin(), r.encoding.end());
+  header.push_back(r.content.size());
+  header.insert(header.end(), r.content.begin(), r.content.end());
+  header.push_back(r.result.dims.size());
+  header.insert(header.end(), r.result.dims.begin(), r.result.dims.end());
+  header.insert(header.end(), r.result.labels.begin(),
+		r.result.labels.end());
+  header.resize((header.size() * sizeof(uint64_t) + kResultAlign - 1)
+		/ kResultAlign * kResultAlign / sizeof(uint64_t), 0);
+
+  // written to a temporary file and renamed into place, as for plans
+  const string path = _path(key), tmp = path + ".tmp";
+  {
+    ofstream f{tmp, std::ios::binary};
+    f.write(reinterpret_cast<const char*>(header.data()),
+	    header.size() * sizeof(uint64_t));
+    f.write(reinterpret_cast<const char*>(r.result.data.data()),
+	    r.result.data.size() * sizeof(complex<double>));
+    if(!f) return false;
+  }
+  return 0 == std::rename(tmp.c_str(), path.c_str());
+}
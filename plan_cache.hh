@@ -0,0 +1,168 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// canonical network topologies and persistent caches of plans and
+// contraction results
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "plan.hh"
+
+// forward declare to avoid dependencies between headers
+class Graph;
+class Network;
+struct CachedResult;
+
+// Default number of entries of the results held in memory by a
+// ResultCache.
+const double kResultCacheCapacity = 1 << 24;
+
+// Canonical description of the topology of a graph: the shapes of its
+// tensors and how their legs are linked, independent of tensor
+// addresses and of the iteration order of the graph.
+struct Topology
+{
+  // Hash of encoding.
+  uint64_t fingerprint;
+  // Vertices of the graph in canonical order.
+  std::vector<Tensor*> vertices;
+  // For each vertex in canonical order: number of inputs and outputs,
+  // input and output rank, and then for each input and each output
+  // the position of the linked vertex plus two (zero if unlinked, one
+  // if linked to a tensor outside the graph) and the linked leg.
+  std::vector<size_t> encoding;
+};
+
+// Compute the canonical topology of g.  Vertices are numbered by a
+// breadth-first search which visits legs in order, started from the
+// start vertex giving the smallest encoding among those in the
+// rarest class of a Weisfeiler-Lehman colour refinement.  For a
+// connected graph this numbering is canonical; for disconnected
+// graphs it may not be, which can only cause a spurious cache miss.
+Topology topology(Graph& g);
+// Compute the canonical topology of every tensor in net, reading the
+// links straight from its arrays.  This agrees with topology() of a
+// graph holding the same tensors.
+Topology topology(Network& net);
+// Operands for contracting all of g, one per vertex in canonical
+// order.  Each edge and each unlinked leg receives a label, assigned
+// in canonical order.
+std::vector<TensorView> topology_operands(const Topology& t);
+
+// A cache of contraction plans keyed by topology, persisted as one
+// file per topology in a directory so that plans survive the
+// process.  Each file records the full encoding of its topology,
+// which is checked on load so that a fingerprint collision can never
+// return a plan for the wrong network.
+class PlanCache
+{
+public:
+  // Store plans under directory, creating it if needed.
+  explicit PlanCache(const std::string& directory);
+  PlanCache(const PlanCache&) = delete;
+  PlanCache& operator=(const PlanCache&) = delete;
+  // Return the plan for contracting operands, which must have been
+  // built from t (as by topology_operands()).  Plans found neither in
+  // memory nor on disk are computed with greedy_plan() and stored.
+  ContractionPlan plan(const Topology& t,
+		       const std::vector<TensorView>& operands);
+  // Number of plans found in memory or on disk, and number computed.
+  size_t hits();
+  size_t misses();
+protected:
+  // Name of the file holding the plan for fingerprint.
+  std::string _path(uint64_t fingerprint);
+  // Read or write the plan for t, returning false on failure.
+  bool _load(const Topology& t, ContractionPlan& plan);
+  bool _store(const Topology& t, const ContractionPlan& plan);
+private:
+  std::string _directory;
+  // Plans already seen by this process, with their encodings.
+  std::unordered_map<uint64_t, std::pair<std::vector<size_t>,
+					 ContractionPlan>> _plans;
+  size_t _hits;
+  size_t _misses;
+};
+
+// Hashes of the entries of the tensors of t, one per vertex in
+// canonical order, covering the dimensions and conjugation of each
+// matrix.  An identity which was never stored is hashed by its scale
+// alone, so it differs from a stored identity; this can only cause a
+// spurious cache miss.
+std::vector<uint64_t> content_hashes(const Topology& t);
+
+// A persistent cache of the contractions of whole networks, for
+// subnetworks contracted identically by many jobs.  Results are keyed
+// by topology together with the content hashes of the tensors, and are
+// stored as one file per key in a directory on local disk.  Each file
+// records the full encoding and the content hashes, which are checked
+// on load, followed by the entries aligned for mapping in place: a
+// result found on disk is mapped rather than read.  Files are in the
+// byte order of the machine.
+//
+// In memory the cache holds the latest result for each key.  Results
+// beyond the capacity (in entries) are dropped, least recently used
+// first, and found on disk again when next needed.
+class ResultCache
+{
+public:
+  // Store results under directory, creating it if needed.  Plans for
+  // results which must be computed are taken from plans if given, and
+  // from greedy_plan() otherwise.
+  explicit ResultCache(const std::string& directory,
+		       PlanCache *plans = nullptr,
+		       double capacity = kResultCacheCapacity);
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+  ~ResultCache();
+  // The contraction of every tensor of t, as execute() over
+  // topology_operands(t): the view has the labels of those operands,
+  // in the order the plan leaves them.  It is found in memory or on
+  // disk if these tensors (or others of the same topology with the
+  // same entries) were contracted before, and otherwise computed and
+  // stored.  The view remains valid until a later call drops its
+  // result, by replacing it under the same key or to keep within the
+  // capacity; the result just returned is never dropped.
+  TensorView contract(const Topology& t);
+  // Number of results found in memory or on disk, and number computed.
+  size_t hits();
+  size_t misses();
+protected:
+  // Name of the file holding the result for key.
+  std::string _path(uint64_t key);
+  // Map or write the result for key, returning false on failure.
+  bool _load(uint64_t key, CachedResult& r);
+  bool _store(uint64_t key, const CachedResult& r);
+  // Drop results, least recently used first, until they fit within
+  // the capacity, keeping that for key.
+  void _evict(uint64_t key);
+private:
+  std::string _directory;
+  PlanCache *_plans;
+  double _capacity;
+  // The latest result for each key, and the number of calls to
+  // contract(), by which each result records when it was last used.
+  std::unordered_map<uint64_t, std::unique_ptr<CachedResult>> _latest;
+  uint64_t _clock;
+  size_t _hits;
+  size_t _misses;
+};
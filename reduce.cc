@@ -0,0 +1,263 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "log_msg.hh"
+#include "matrix.hh"
+#include "reduce.hh"
+#include "tensor.hh"
+
+using std::complex;
+using std::vector;
+
+// Number of independent accumulators used within a block, so that the
+// compensated sums can be evaluated in vector registers.
+const size_t kReductionLanes = 4;
+
+// A compensated sum of real numbers, accumulated in kReductionLanes
+// lanes.  add() takes one value per lane.
+struct CompensatedSum
+{
+  double sum[kReductionLanes];
+  double carry[kReductionLanes];
+  CompensatedSum()
+  {
+    std::fill(sum, sum + kReductionLanes, 0.0);
+    std::fill(carry, carry + kReductionLanes, 0.0);
+  }
+  void add(const double *x)
+  {
+    for(size_t l = 0; l < kReductionLanes; ++l)
+      {
+	const double t = sum[l] + x[l];
+	carry[l] += std::abs(sum[l]) >= std::abs(x[l])
+	  ? (sum[l] - t) + x[l] : (x[l] - t) + sum[l];
+	sum[l] = t;
+      }
+  }
+  // Add another sum, lane by lane.
+  void add(const CompensatedSum& s)
+  {
+    add(s.sum);
+    for(size_t l = 0; l < kReductionLanes; ++l) carry[l] += s.carry[l];
+  }
+  // The total of all lanes.
+  double value() const
+  {
+    CompensatedSum total;
+    double x[kReductionLanes] = {};
+    for(size_t l = 0; l < kReductionLanes; ++l)
+      {
+	x[0] = sum[l];
+	total.add(x);
+      }
+    double carried = total.carry[0];
+    for(size_t l = 0; l < kReductionLanes; ++l) carried += carry[l];
+    return total.sum[0] + carried;
+  }
+};
+
+// Compensated sums of the real and imaginary parts of complex numbers.
+struct ComplexSum
+{
+  CompensatedSum re;
+  CompensatedSum im;
+};
+
+// ########################### reduce_blocks #########################
+// Evaluate block(first, last) for consecutive blocks of [0, n) in
+// parallel, returning the results in order.
+template <class Result, class Block>
+static vector<Result> reduce_blocks(size_t n, size_t threads, Block block)
+{
+  const size_t blocks = (n + kReductionBlock - 1) / kReductionBlock;
+  vector<Result> ret(blocks);
+  if(0 == threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  if(n < kParallelReduction) threads = 1;
+  threads = std::min(threads, blocks);
+
+  std::atomic<size_t> next{0};
+  auto work = [&]()
+    {
+      for(size_t b = next++; b < blocks; b = next++)
+	ret[b] = block(b * kReductionBlock,
+		       std::min(n, (b + 1) * kReductionBlock));
+    };
+  vector<std::thread> pool;
+  for(size_t i = 1; i < threads; ++i) pool.emplace_back(work);
+  work();
+  for(std::thread &p : pool) p.join();
+  return ret;
+}
+
+// ########################### sum_blocks ############################
+// Sum f(i) over [0, n) for a real or complex f, with compensation.
+template <class F>
+static complex<double> sum_blocks(size_t n, size_t threads, F f)
+{
+  vector<ComplexSum> partial = reduce_blocks<ComplexSum>
+    (n, threads, [&f](size_t first, size_t last)
+     {
+       ComplexSum ret;
+       double x[kReductionLanes], y[kReductionLanes];
+       for(size_t i = first; i < last; i += kReductionLanes)
+	 {
+	   for(size_t l = 0; l < kReductionLanes; ++l)
+	     {
+	       const complex<double> c = i + l < last ? complex<double>(f(i + l))
+		 : complex<double>{};
+	       x[l] = c.real();
+	       y[l] = c.imag();
+	     }
+	   ret.re.add(x);
+	   ret.im.add(y);
+	 }
+       return ret;
+     });
+
+  // blocks keep their carries until the end
+  ComplexSum total;
+  for(const ComplexSum &p : partial)
+    {
+      total.re.add(p.re);
+      total.im.add(p.im);
+    }
+  return complex<double>{total.re.value(), total.im.value()};
+}
+
+// ########################### storage ###############################
+// The storage of m, or null if it is empty or an implicit multiple of
+// the identity, in which case scale is set.
+static const complex<double>* storage(const MatrixStruct& m,
+				      complex<double>& scale)
+{
+  scale = 0;
+  if(nullptr == m.matrix || m.matrix->scaled_identity(scale)) return nullptr;
+  return m.matrix->data();
+}
+
+// ########################### diagonal_sum ##########################
+// Sum of the diagonal of the matrix of t as the tensor sees it.
+static complex<double> diagonal_sum(const MatrixStruct& m, size_t threads)
+{
+  complex<double> scale;
+  const complex<double> *data = storage(m, scale);
+  if(nullptr == m.matrix) return 0;
+  const size_t rows = m.matrix->rows(), cols = m.matrix->cols(),
+    n = std::min(rows, cols);
+
+  complex<double> ret = nullptr == data ? scale * double(n)
+    : sum_blocks(n, threads, [data, cols](size_t i)
+		 { return data[i*cols + i]; });
+  return m.conjugate ? std::conj(ret) : ret;
+}
+
+// ###################################################################
+// ########################### frobenius_norm ########################
+double frobenius_norm(Tensor *t, size_t threads)
+{
+  MatrixStruct m = t->matrix();
+  complex<double> scale;
+  const complex<double> *data = storage(m, scale);
+  if(nullptr == m.matrix) return 0;
+  const size_t rows = m.matrix->rows(), cols = m.matrix->cols();
+  if(nullptr == data)
+    return std::abs(scale) * std::sqrt(double(std::min(rows, cols)));
+
+  return std::sqrt(sum_blocks(rows*cols, threads, [data](size_t i)
+			      { return std::norm(data[i]); }).real());
+}
+
+// ########################### max_abs ###############################
+double max_abs(Tensor *t, size_t threads)
+{
+  MatrixStruct m = t->matrix();
+  complex<double> scale;
+  const complex<double> *data = storage(m, scale);
+  if(nullptr == m.matrix) return 0;
+  const size_t rows = m.matrix->rows(), cols = m.matrix->cols();
+  if(nullptr == data)
+    return 0 == std::min(rows, cols) ? 0 : std::abs(scale);
+
+  // compare squared magnitudes, taking a single square root at the end
+  vector<double> partial = reduce_blocks<double>
+    (rows*cols, threads, [data](size_t first, size_t last)
+     {
+       double ret = 0;
+       for(size_t i = first; i < last; ++i)
+	 ret = std::max(ret, std::norm(data[i]));
+       return ret;
+     });
+  double ret = 0;
+  for(double p : partial) ret = std::max(ret, p);
+  return std::sqrt(ret);
+}
+
+// ########################### trace #################################
+complex<double> trace(Tensor *t, size_t threads)
+{
+  MatrixStruct m = t->matrix();
+#ifndef NO_ERROR_CHECKING
+  if(m.nin != m.nout || m.inrank != m.outrank)
+    LOG_MSG_(FATAL) << kErrIncompatible << "trace() of a tensor with " <<
+      m.nin << " inputs of rank " << m.inrank << " and " << m.nout <<
+      " outputs of rank " << m.outrank;
+#endif // NO_ERROR_CHECKING
+
+  return diagonal_sum(m, threads);
+}
+
+// ########################### overlap ###############################
+complex<double> overlap(Tensor *a, Tensor *b, size_t threads)
+{
+  MatrixStruct ma = a->matrix(), mb = b->matrix();
+#ifndef NO_ERROR_CHECKING
+  if(ma.nin != mb.nin || ma.nout != mb.nout || ma.inrank != mb.inrank
+     || ma.outrank != mb.outrank)
+    LOG_MSG_(FATAL) << kErrIncompatible << "overlap() of tensors of "
+      "differing shape";
+#endif // NO_ERROR_CHECKING
+
+  complex<double> sa, sb;
+  const complex<double> *x = storage(ma, sa), *y = storage(mb, sb);
+  if(nullptr == ma.matrix || nullptr == mb.matrix) return 0;
+  // against a multiple of the identity only the diagonal contributes
+  if(nullptr == x)
+    return std::conj(ma.conjugate ? std::conj(sa) : sa)
+      * diagonal_sum(mb, threads);
+  if(nullptr == y)
+    return (mb.conjugate ? std::conj(sb) : sb)
+      * std::conj(diagonal_sum(ma, threads));
+
+  // Where one tensor is conjugate its storage is the transpose of the
+  // other's, and is read across.
+  const size_t rows = ma.matrix->rows(), cols = ma.matrix->cols();
+  if(ma.conjugate == mb.conjugate)
+    {
+      complex<double> ret = sum_blocks(rows*cols, threads, [x, y](size_t i)
+				       { return std::conj(x[i]) * y[i]; });
+      return ma.conjugate ? std::conj(ret) : ret;
+    }
+  complex<double> ret = sum_blocks(rows*cols, threads,
+				   [x, y, rows, cols](size_t i)
+				   { return x[i] * y[i%cols*rows + i/cols]; });
+  return ma.conjugate ? ret : std::conj(ret);
+}
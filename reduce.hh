@@ -0,0 +1,48 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// reductions over the entries of tensors
+
+#pragma once
+
+#include <complex>
+
+// forward declare to avoid dependencies between headers
+class Tensor;
+
+// Entries are reduced in blocks of this many, each summed with
+// compensation (Neumaier's variant of Kahan summation) and the block
+// results then combined in order.  Since the blocks do not depend on
+// the number of threads, neither do the results.
+const size_t kReductionBlock = 4096;
+// Matrices with fewer entries than this are reduced by one thread.
+const size_t kParallelReduction = 1 << 18;
+
+// The following reduce the matrix of a tensor as stored, so they do
+// not allocate, and avoid reading an implicit ScaledIdentityMatrix at
+// all.  threads is taken from the hardware if zero.
+//
+// Frobenius norm, the square root of the sum of |entry|^2.
+double frobenius_norm(Tensor *t, size_t threads = 0);
+// Largest magnitude of any entry.
+double max_abs(Tensor *t, size_t threads = 0);
+// Trace of a tensor with as many inputs as outputs, all of one rank:
+// the sum over entries whose input n equals output n for every n.
+std::complex<double> trace(Tensor *t, size_t threads = 0);
+// Inner product <a|b>, the sum over entries of conj(a) b, of two
+// tensors with the same numbers and ranks of inputs and outputs.
+std::complex<double> overlap(Tensor *a, Tensor *b, size_t threads = 0);
@@ -15,6 +15,7 @@
 // along with Tensor Network.  If not, see
 // <http://www.gnu.org/licenses/>.
 
+#include <utility>
 #include "log_msg.hh"
 #include "matrix.hh"
 #include "tensor.hh"
@@ -22,35 +23,118 @@
 
 using std::complex;
 using std::initializer_list;
+using std::make_shared;
 using std::shared_ptr;
 using std::vector;
 
+// The hook called on races, which by default aborts.
+static RaceHook race_hook = [](Tensor *t, TensorAccess a)
+{
+  LOG_MSG_(FATAL) << kErrRace << (TENSOR_READ == a ? "read" :
+				  TENSOR_WRITE == a ? "write" : "publication")
+		  << " of tensor " << t << " overlaps a conflicting access";
+};
+
+// ########################### network_id ############################
+// The id of T in net, or kNoTensor if T is not a ConcreteTensor of net.
+static size_t network_id(Network *net, Tensor *T)
+{
+  ConcreteTensor *c = dynamic_cast<ConcreteTensor*>(T);
+  if(nullptr == c || c->network() != net)
+    return kNoTensor;
+  return c->id();
+}
+
+// ########################### set_race_hook #########################
+RaceHook set_race_hook(RaceHook hook)
+{
+  std::swap(race_hook, hook);
+  return hook;
+}
+
+// ########################### AccessGuard ###########################
+struct ConcreteTensor::AccessGuard
+{
+#ifdef DEBUG
+  // Reads conflict with writes, writes with everything, and
+  // publications with writes and publications.
+  AccessGuard(ConcreteTensor *t, TensorAccess a) : tensor{t}, access{a}
+  {
+    bool race = false;
+    switch(a)
+      {
+      case TENSOR_READ:
+	++tensor->_readers;
+	race = tensor->_writers > 0;
+	break;
+      case TENSOR_WRITE:
+	race = tensor->_writers++ > 0 || tensor->_readers > 0
+	  || tensor->_publishers > 0;
+	break;
+      case TENSOR_PUBLISH:
+	race = tensor->_publishers++ > 0 || tensor->_writers > 0;
+	break;
+      }
+    if(race && race_hook) race_hook(tensor, access);
+  }
+  ~AccessGuard()
+  {
+    switch(access)
+      {
+      case TENSOR_READ: --tensor->_readers; break;
+      case TENSOR_WRITE: --tensor->_writers; break;
+      case TENSOR_PUBLISH: --tensor->_publishers; break;
+      }
+  }
+  ConcreteTensor *tensor;
+  TensorAccess access;
+#else
+  AccessGuard(ConcreteTensor*, TensorAccess) {}
+#endif // DEBUG
+};
+
 // ########################### constructor ###########################
 ConcreteTensor::ConcreteTensor(size_t nin, size_t nout,
 			       size_t inrank, size_t outrank)
   : _nin{nin}, _nout{nout}, _inrank{inrank}, _outrank{outrank},
     _conjugate{false}
 {
-  _initialize(true);
+  _initialize(nullptr, true);
 }
 
 ConcreteTensor::ConcreteTensor(MatrixStruct m)
   : _nin{m.nin}, _nout{m.nout}, _inrank{m.inrank},
     _outrank{m.outrank}, _conjugate{m.conjugate}, _matrix{m.matrix}
 {
-  _initialize(false);
+  _initialize(nullptr, false);
+}
+
+ConcreteTensor::ConcreteTensor(Network& net, size_t nin, size_t nout,
+			       size_t inrank, size_t outrank)
+  : _nin{nin}, _nout{nout}, _inrank{inrank}, _outrank{outrank},
+    _conjugate{false}
+{
+  _initialize(&net, true);
 }
 
 // ########################### destructor ############################
 ConcreteTensor::~ConcreteTensor()
 {
+  // When the network is being torn down, the tensors it links this
+  // one to are being destroyed too, so only links leaving the network
+  // need be undone.
+  const bool teardown = nullptr != _network && _network->_tearing_down;
   if(nullptr != _matrix)
     {
       for(size_t i = 0; i < _nin; ++i)
-	_unset_input(i);
+	if(!teardown || kNoTensor == _network->input_id(_id, i))
+	  _unset_input(i);
       for(size_t i = 0; i < _nout; ++i)
-	_unset_output(i);
+	if(!teardown || kNoTensor == _network->output_id(_id, i))
+	  _unset_output(i);
     }
+  if(nullptr != _network && !teardown)
+    _network->_remove(_id);
 }
 
 // ###################################################################
@@ -70,12 +154,14 @@ size_t ConcreteTensor::output_rank()
 complex<double> ConcreteTensor::entry(const vector<size_t>& in,
 				      const vector<size_t>& out)
 {
+  AccessGuard guard{this, TENSOR_READ};
   return _entry(in, out);
 }
 
 complex<double> ConcreteTensor::entry(initializer_list<size_t> in,
 				      initializer_list<size_t> out)
 {
+  AccessGuard guard{this, TENSOR_READ};
   return _entry( vector<size_t>{in}, vector<size_t>{out} );
 }
 
@@ -83,6 +169,7 @@ complex<double> ConcreteTensor::entry(initializer_list<size_t> in,
 void ConcreteTensor::set_entry(const vector<size_t>& in,
 			       const vector<size_t>& out, complex<double> val)
 {
+  AccessGuard guard{this, TENSOR_WRITE};
   _set_entry(in,out,val);
 }
 
@@ -90,6 +177,7 @@ void ConcreteTensor::set_entry(initializer_list<size_t> in,
 			       initializer_list<size_t> out,
 			       complex<double> val)
 {
+  AccessGuard guard{this, TENSOR_WRITE};
   _set_entry(vector<size_t>{in}, vector<size_t>{out}, val);
 }
 
@@ -108,6 +196,7 @@ void ConcreteTensor::set_output(size_t n, Tensor *T, size_t m)
 // ########################### input_tensor ##########################
 Tensor* ConcreteTensor::input_tensor(size_t n)
 {
+  AccessGuard guard{this, TENSOR_READ};
   // guard against out-of-bounds arguments
 #ifndef NO_ERROR_CHECKING
   if(n >= _nin)
@@ -116,12 +205,14 @@ Tensor* ConcreteTensor::input_tensor(size_t n)
       " exceeds input list length " << _nin;
 #endif // NO_ERROR_CHECKING
 
-  return _in[n];
+  if(nullptr == _network) return _links[n].tensor;
+  return _network->input_tensor(_id, n);
 }
 
 // ########################### output_tensor #########################
 Tensor* ConcreteTensor::output_tensor(size_t n)
 {
+  AccessGuard guard{this, TENSOR_READ};
 #ifndef NO_ERROR_CHECKING
   // guard against out-of-bounds arguments
   if(n >= _nout)
@@ -130,12 +221,14 @@ Tensor* ConcreteTensor::output_tensor(size_t n)
       " exceeds output list length " << _nout;
 #endif
 
-  return _out[n];
+  if(nullptr == _network) return _links[_nin + n].tensor;
+  return _network->output_tensor(_id, n);
 }
 
 // ########################### input_num #############################
 size_t ConcreteTensor::input_num(size_t n)
 {
+  AccessGuard guard{this, TENSOR_READ};
 #ifndef NO_ERROR_CHECKING
   // guard against out-of-bounds arguments
   if(n >= _nin)
@@ -144,12 +237,14 @@ size_t ConcreteTensor::input_num(size_t n)
       " exceeds input list length " << _nin;
 #endif // NO_ERROR_CHECKING
 
-  return _indest[n];
+  if(nullptr == _network) return _links[n].num;
+  return _network->input_num(_id, n);
 }
 
 // ########################### output_num ############################
 size_t ConcreteTensor::output_num(size_t n)
 {
+  AccessGuard guard{this, TENSOR_READ};
 #ifndef NO_ERROR_CHECKING
   // guard against out-of-bounds arguments
   if(n >= _nout)
@@ -158,7 +253,8 @@ size_t ConcreteTensor::output_num(size_t n)
       " exceeds output list length " << _nout;
 #endif // NO_ERROR_CHECKING
 
-  return _outdest[n];
+  if(nullptr == _network) return _links[_nin + n].num;
+  return _network->output_num(_id, n);
 }
 
 // ########################### inputs ################################
@@ -176,6 +272,7 @@ size_t ConcreteTensor::outputs()
 // ########################### matrix ################################
 MatrixStruct ConcreteTensor::matrix(bool conjugate)
 {
+  AccessGuard guard{this, TENSOR_READ};
   MatrixStruct m;
   // If conjugate is true, swap inputs and outputs, and invert
   // _conjugate flag.
@@ -197,28 +294,65 @@ MatrixStruct ConcreteTensor::matrix(bool conjugate)
     }
   // Create a copy of the initial matrix which won't delete the
   // underlying data when destroyed.
-  m.matrix = shared_ptr<Matrix>{_matrix};
+  m.matrix = std::atomic_load(&_matrix);
 
   return m;
 }
 
+// ########################### set_matrix ############################
+void ConcreteTensor::set_matrix(shared_ptr<Matrix> m)
+{
+  AccessGuard guard{this, TENSOR_PUBLISH};
+#ifndef NO_ERROR_CHECKING
+  // the new matrix must have the shape of the old
+  shared_ptr<Matrix> old = std::atomic_load(&_matrix);
+  if(nullptr == m || nullptr == old || m->rows() != old->rows()
+     || m->cols() != old->cols())
+    LOG_MSG_(FATAL) << kErrIncompatible << "matrix passed to "
+      "ConcreteTensor::set_matrix() does not match the shape of the tensor";
+#endif // NO_ERROR_CHECKING
+
+  std::atomic_store(&_matrix, m);
+  ++_version;
+}
+
+// ########################### version ###############################
+uint64_t ConcreteTensor::version()
+{
+  return _version;
+}
+
+// ########################### network ###############################
+Network* ConcreteTensor::network()
+{
+  return _network;
+}
+
+// ########################### id ####################################
+size_t ConcreteTensor::id()
+{
+  return _id;
+}
+
 // ########################### _entry ################################
 complex<double> ConcreteTensor::_entry(const vector<size_t>& in,
 			       const vector<size_t>& out)
 {
+  shared_ptr<Matrix> m = std::atomic_load(&_matrix);
   if(!_conjugate)
-    return  _matrix->get( _pack_input(in), _pack_output(out) );
+    return  m->get( _pack_input(in), _pack_output(out) );
   else
     // Exchange rows and columns and take the complex conjugate to
     // simulate retrieving data from the Hermitian conjugate of the
     // underlying matrix.
-    return conjugate(_matrix->get( _pack_output(out), _pack_input(in) ));
+    return conjugate(m->get( _pack_output(out), _pack_input(in) ));
 }
 
 // ########################### _set_entry ############################
 void ConcreteTensor::_set_entry(const vector<size_t>& in,
 				const vector<size_t>& out, complex<double> val)
 {
+  _detach();
   if(!_conjugate)
     _matrix->set(_pack_input(in), _pack_output(out), val );
   else
@@ -226,6 +360,16 @@ void ConcreteTensor::_set_entry(const vector<size_t>& in,
     // simulate retrieving data from the Hermitian conjugate of the
     // underlying matrix
     _matrix->set( _pack_output(out), _pack_input(in), conjugate(val) );
+  ++_version;
+}
+
+// ########################### _detach ###############################
+void ConcreteTensor::_detach()
+{
+  // Only this tensor can hand out new references to a matrix which it
+  // alone holds, and writes are exclusive, so a count of one is exact.
+  if(nullptr != _matrix && _matrix.use_count() > 1)
+    std::atomic_store(&_matrix, shared_ptr<Matrix>{_matrix->clone()});
 }
 
 // ########################### _pack_input ###########################
@@ -379,8 +523,10 @@ void ConcreteTensor::_unset_input(size_t n)
 #endif // NO_ERROR_CHECKING
 
   // unlink tensors
-  if(_in[n] != nullptr)
-    Tensor::_set_output(_in[n], _indest[n], nullptr, 0);
+  const Link l = nullptr == _network ? _links[n]
+    : Link{_network->input_tensor(_id, n), _network->input_num(_id, n)};
+  if(l.tensor != nullptr)
+    Tensor::_set_output(l.tensor, l.num, nullptr, 0);
   _set_input_self(n, nullptr, 0);
 }
 
@@ -396,14 +542,17 @@ void ConcreteTensor::_unset_output(size_t n)
 #endif // NO_ERROR_CHECKING
 
   // unlink tensors
-  if(_out[n] != nullptr)
-    Tensor::_set_input(_out[n], _outdest[n], nullptr, 0);
+  const Link l = nullptr == _network ? _links[_nin + n]
+    : Link{_network->output_tensor(_id, n), _network->output_num(_id, n)};
+  if(l.tensor != nullptr)
+    Tensor::_set_input(l.tensor, l.num, nullptr, 0);
   _set_output_self(n, nullptr, 0);
 }
 
 // ########################### _set_input_self #######################
 void ConcreteTensor::_set_input_self(size_t n, Tensor *T, size_t m)
 {
+  AccessGuard guard{this, TENSOR_WRITE};
 #ifndef NO_ERROR_CHECKING
   // guard against out-of-bounds arguments
   if(n >= _nin)
@@ -413,13 +562,17 @@ void ConcreteTensor::_set_input_self(size_t n, Tensor *T, size_t m)
 #endif // NO_ERROR_CHECKING
 
   // set input tensor and destination
-  _in[n] = T;
-  _indest[n] = T != nullptr ? m : 0;
+  if(nullptr == _network)
+    _links[n] = Link{T, T != nullptr ? m : 0};
+  else
+    _network->_set_input(_id, n, T, T != nullptr ? m : 0,
+			 network_id(_network, T));
 }
 
 // ########################### _set_output_self ######################
 void ConcreteTensor::_set_output_self(size_t n, Tensor *T, size_t m)
 {
+  AccessGuard guard{this, TENSOR_WRITE};
 #ifndef NO_ERROR_CHECKING
   // guard against out-of-bounds arguments
   if(n >= _nout)
@@ -429,18 +582,29 @@ void ConcreteTensor::_set_output_self(size_t n, Tensor *T, size_t m)
 #endif // NO_ERROR_CHECKING
 
   // set output tensor and destination
-  _out[n] = T;
-  _outdest[n] = T != nullptr ? m : 0;
+  if(nullptr == _network)
+    _links[_nin + n] = Link{T, T != nullptr ? m : 0};
+  else
+    _network->_set_output(_id, n, T, T != nullptr ? m : 0,
+			  network_id(_network, T));
 }
 
 // ########################### _initialize ###########################
-void ConcreteTensor::_initialize(bool init_matrix)
+void ConcreteTensor::_initialize(Network *net, bool init_matrix)
 {
-  // initialize variables
-  _in = vector<Tensor*>(_nin, nullptr);
-  _out = vector<Tensor*>(_nout, nullptr);
-  _indest = vector<size_t>(_nin,0);
-  _outdest = vector<size_t>(_nout,0);
+  // register the (unlinked) legs with the network, or keep them here
+  _network = net;
+  if(nullptr == net)
+    {
+      _id = kNoTensor;
+      _links.assign(_nin + _nout, Link{nullptr, 0});
+    }
+  else
+    _id = _network->_add(this, _nin, _nout);
+  _version = 0;
+#ifdef DEBUG
+  _readers = _writers = _publishers = 0;
+#endif // DEBUG
 
   if(!init_matrix) return;
 
@@ -455,6 +619,30 @@ void ConcreteTensor::_initialize(bool init_matrix)
       size_t in = 1, out = 1;
       for (size_t i=0; i<_nin; i++) in *= _inrank;
       for (size_t i=0; i<_nout; i++) out *= _outrank;
-      _matrix = shared_ptr<Matrix> {new GSLMatrix{in,out}};
+      _matrix = make_shared<ScaledIdentityMatrix>(in, out);
     }
 }
+
+// ###################################################################
+
+// ########################### snapshot ##############################
+vector<shared_ptr<Matrix>> snapshot(const vector<Tensor*>& t)
+{
+  vector<shared_ptr<Matrix>> ret;
+  ret.reserve(t.size());
+  for(Tensor *x : t) ret.push_back(x->matrix().matrix);
+  return ret;
+}
+
+// ########################### restore ###############################
+void restore(const vector<Tensor*>& t, const vector<shared_ptr<Matrix>>& s)
+{
+#ifndef NO_ERROR_CHECKING
+  if(t.size() != s.size())
+    LOG_MSG_(FATAL) << kErrListLength << "restore() given a snapshot of " <<
+      s.size() << " matrices for " << t.size() << " tensors";
+#endif // NO_ERROR_CHECKING
+
+  for(size_t i = 0; i < t.size(); ++i)
+    if(t[i]->matrix().matrix != s[i]) t[i]->set_matrix(s[i]);
+}
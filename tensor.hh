@@ -19,13 +19,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <complex>
+#include <cstdint>
+#include <functional>
 #include <initializer_list>
 #include <memory>
 #include <vector>
+#include "network.hh"
 
 // forward declare to avoid dependencies between headers
 class Matrix;
+class Tensor;
 
 // Data format storing the information needed to reconstruct a tensor.
 // Note that setting conjugate indicates only that the complex
@@ -41,9 +46,36 @@ struct MatrixStruct
   std::shared_ptr<Matrix> matrix;
 };
 
+// Kinds of access to a tensor, as reported to the race hook.  Reads
+// include reading links; writes change entries or links in place;
+// publications replace the whole matrix with set_matrix().
+enum TensorAccess {
+  TENSOR_READ,
+  TENSOR_WRITE,
+  TENSOR_PUBLISH
+};
+
+// Called in debug builds when an access by the calling thread overlaps
+// an access by another thread which the concurrency model (see Tensor)
+// forbids.  The default hook aborts.
+typedef std::function<void(Tensor *t, TensorAccess a)> RaceHook;
+// Install hook, returning the previous one.  This is not itself thread
+// safe: install hooks before starting threads.
+RaceHook set_race_hook(RaceHook hook);
+
 // A single tensor in the tensor network.  Note that, when the tensor
 // represents a gate in a MERA the input should indicate the direction
 // of *greater* renormalization flow.
+//
+// Concurrency model: any number of threads may read a tensor at once
+// (entries, links and matrix()) without locking.  Its data may be
+// updated while others read it only through set_matrix(), which
+// publishes a new matrix atomically: readers holding a MatrixStruct
+// keep the old matrix alive and see it unchanged.  At most one thread
+// may publish at a time.  Writes in place -- set_entry(), link changes,
+// or writes through matrix().matrix->data() -- require that no other
+// thread is accessing the tensor.  Debug builds check the accesses
+// made through the interface and report violations to the race hook.
 class Tensor
 {
 public:
@@ -84,6 +116,13 @@ public:
   // that this is a shallow copy, but that a tensor object constructed
   // from it will not delete the underlying data when destructed.
   virtual MatrixStruct matrix(bool conjugate = false) = 0;
+  // Replace the matrix by m, which has the dimensions and layout of
+  // matrix().matrix, publishing it to concurrent readers.  Tensors
+  // which shared the old matrix keep it.
+  virtual void set_matrix(std::shared_ptr<Matrix> m) = 0;
+  // Number of changes made to the entries of this tensor by
+  // set_entry() and set_matrix().
+  virtual uint64_t version() = 0;
 protected:
   // Like set_(input|output) above, but setting only a single
   // direction.  The above should call these functions on both objects.
@@ -102,11 +141,22 @@ protected:
 class ConcreteTensor : public Tensor
 {
 public:
-  // Constructors and destructor.
+  // Constructors and destructor.  A new tensor holds the identity
+  // matrix, which is only allocated when first written or exposed.
   ConcreteTensor(size_t nin, size_t nout, size_t inrank, size_t outrank);
   ConcreteTensor(size_t nin, size_t nout, size_t rank)
     : ConcreteTensor(nin, nout, rank, rank) {}
+  // Share the matrix of m.  Storage shared between tensors is copied
+  // on the first write through set_entry(), so that the tensors then
+  // diverge.
   ConcreteTensor(MatrixStruct m);
+  // Construct a tensor whose links are stored in net, which must
+  // outlive it.  Tensors created without a network keep their links
+  // inline.
+  ConcreteTensor(Network& net, size_t nin, size_t nout, size_t inrank,
+		 size_t outrank);
+  ConcreteTensor(Network& net, size_t nin, size_t nout, size_t rank)
+    : ConcreteTensor(net, nin, nout, rank, rank) {}
   ConcreteTensor& operator=(const ConcreteTensor&) = delete;
   ConcreteTensor(const ConcreteTensor&) = delete;
   ~ConcreteTensor();
@@ -132,12 +182,21 @@ public:
   size_t inputs() override;
   size_t outputs() override;
   MatrixStruct matrix(bool conjugate = false) override;
+  void set_matrix(std::shared_ptr<Matrix> m) override;
+  uint64_t version() override;
+  // The network holding the links of this tensor, and its id there,
+  // or null and kNoTensor if it was created without one.
+  Network* network();
+  size_t id();
 protected:
   // Methods interacting directly with underlying data.
   std::complex<double> _entry(const std::vector<size_t>& in,
 			      const std::vector<size_t>& out);
   void _set_entry(const std::vector<size_t>& in,
 		  const std::vector<size_t>& out, std::complex<double> val);
+  // Give this tensor a private copy of its matrix if the storage is
+  // shared with other tensors or snapshots.
+  void _detach();
   // Convert between tensor notation for the interface and matrix
   // notation for underlying storage.
   size_t _pack_input(const std::vector<size_t>& in);
@@ -155,7 +214,17 @@ protected:
   void _set_input_self(size_t n, Tensor *T, size_t m) override final;
   void _set_output_self(size_t n, Tensor *T, size_t m) override final;
 private:
-  void _initialize(bool init_matrix);
+  // Marks an access for the duration of a call, checking it against
+  // the accesses in progress in debug builds.
+  struct AccessGuard;
+  // A link of a tensor created without a network: the tensor and leg
+  // at the other end.
+  struct Link
+  {
+    Tensor *tensor;
+    size_t num;
+  };
+  void _initialize(Network *net, bool init_matrix);
   // Number of input and output sites.
   size_t _nin;
   size_t _nout;
@@ -170,14 +239,33 @@ private:
   // underlying matrix.  Functions which directly interact with matrix
   // elements must check this flag and alter their behavior appropriately.
   bool _conjugate;
-  // The following pointers represent arrays which encode the
-  // placement of this tensor in the tensor network.  Specifically,
-  // input n of this tensor is connected to output _indest[n] of tensor
-  // _in[n].  _out and _outdest work analogously.
-  std::vector<Tensor*> _in;
-  std::vector<Tensor*> _out;
-  std::vector<size_t> _indest;
-  std::vector<size_t> _outdest;
-  // The matrix itself.
+  // The placement of this tensor in the tensor network is recorded in
+  // _network under the id _id: input n of this tensor is connected to
+  // output _network->input_num(_id, n) of tensor
+  // _network->input_tensor(_id, n), and likewise for outputs.  A
+  // tensor created without a network has a null _network and keeps
+  // its links in _links instead, inputs before outputs, in a single
+  // allocation.
+  Network *_network;
+  size_t _id;
+  std::vector<Link> _links;
+  // The matrix itself, only ever loaded and stored atomically.
   std::shared_ptr<Matrix> _matrix;
+  std::atomic<uint64_t> _version;
+#ifdef DEBUG
+  // Numbers of accesses of each kind in progress.
+  std::atomic<unsigned> _readers;
+  std::atomic<unsigned> _writers;
+  std::atomic<unsigned> _publishers;
+#endif // DEBUG
 };
+
+// Shallow copies of the matrices of tensors, which share storage with
+// them until the tensors are written.  A snapshot is cheap to take
+// before a trial update of a network and restores it exactly, provided
+// the update goes through set_entry() or set_matrix() rather than
+// writing through Matrix::data().
+std::vector<std::shared_ptr<Matrix>> snapshot(const std::vector<Tensor*>& t);
+// Publish the matrices of a snapshot of t back to the tensors.
+void restore(const std::vector<Tensor*>& t,
+	     const std::vector<std::shared_ptr<Matrix>>& s);
@@ -0,0 +1,71 @@
+# Copyright 2013 Jacob Emmert-Aronson
+# This file is part of Tensor Network.
+#
+# Tensor Network is free software: you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# Tensor Network is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Tensor Network.  If not, see
+# <http://www.gnu.org/licenses/>.
+# smoke test of the Python module tensor_network ("make python_check")
+
+import unittest
+
+import numpy as np
+import tensor_network as tn
+
+
+class BindingsTest(unittest.TestCase):
+    def test_array(self):
+        t = tn.Tensor(1, 1, 2)
+        a = t.array()
+        self.assertEqual((2, 2), a.shape)
+        np.testing.assert_array_equal(np.eye(2), a)
+        # views are read-only, so that writes go through set_array()
+        with self.assertRaises(ValueError):
+            a[0, 0] = 5
+        self.assertTrue(np.asarray(t.matrix()).flags.readonly)
+
+        version = t.version()
+        t.set_array(np.array([[1, 2], [3, 4]]))
+        self.assertGreater(t.version(), version)
+        self.assertEqual(4, t.entry([1], [1]))
+        # the old view keeps the old storage alive, unchanged
+        self.assertEqual(1, a[0, 0])
+        self.assertEqual(3, t.array()[1, 0])
+
+    def test_contract(self):
+        a = tn.Tensor(0, 1, 0, 2)
+        b = tn.Tensor(1, 0, 2, 0)
+        a.set_array(np.array([1, 2]))
+        b.set_array(np.array([3, 4]))
+        a.set_output(0, b, 0)
+        self.assertIs(b, a.output_tensor(0))
+        self.assertAlmostEqual(11, np.asarray(tn.contract(a, b)).item())
+
+    def test_network(self):
+        net = tn.Network()
+        top = net.mera(8, 2, 2, 2)
+        self.assertEqual(len(net), len(net.component(top)))
+        graph = tn.DFSGraph(net.tensor(top))
+        self.assertEqual(len(net), len(graph.tensors()))
+        psi = tn.contract(graph, planner="greedy")
+        self.assertEqual(8, len(psi.dims))
+
+    def test_errors(self):
+        t = tn.Tensor(1, 1, 2)
+        with self.assertRaises(IndexError):
+            t.entry([2], [0])
+        with self.assertRaises(ValueError):
+            t.set_output(0, tn.Tensor(1, 0, 3, 0), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,91 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+// Per-call cost of tiny contractions, such as those applying gates to
+// a few legs, through each entry point of contract.hh.  Each time is
+// the best of several batches, in nanoseconds per call.
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "../contract.hh"
+
+using std::complex;
+using std::cout;
+using std::vector;
+
+// Number of batches timed, and calls in each.
+const int kBatches = 50;
+const int kCalls = 20000;
+
+// ########################### per_call ##############################
+static double per_call(const std::function<void()>& f)
+{
+  typedef std::chrono::steady_clock Clock;
+  double best = 0;
+  for(int b = 0; b < kBatches; ++b)
+    {
+      const Clock::time_point start = Clock::now();
+      for(int i = 0; i < kCalls; ++i) f();
+      const double t = std::chrono::duration<double, std::nano>
+	(Clock::now() - start).count() / kCalls;
+      if(0 == b || t < best) best = t;
+    }
+  return best;
+}
+
+// ########################### main ##################################
+int main()
+{
+  // 2x2x2 with 2x2x2 over one leg, and a 2x2 gate on one leg of a
+  // 2x2x2 tensor
+  const vector<vector<vector<size_t>>> shapes{
+    { {2,2,2}, {0,1,2}, {2,2,2}, {2,3,4} },
+    { {2,2}, {3,1}, {2,2,2}, {0,1,2} },
+  };
+  cout << "# shapes contract contract_small contract_small_into\n";
+  for(const vector<vector<size_t>> &s : shapes)
+    {
+      DenseTensor a{s[0], s[1]}, b{s[2], s[3]}, r;
+      for(size_t i = 0; i < a.data.size(); ++i)
+	a.data[i] = complex<double>(1.0 + i, 0.5);
+      for(size_t i = 0; i < b.data.size(); ++i)
+	b.data[i] = complex<double>(0.25, 1.0 - i);
+      const TensorView av = a.view(), bv = b.view();
+      volatile double sink = 0;
+
+      for(const DenseTensor *t : {&a, &b})
+	{
+	  for(size_t i = 0; i < t->dims.size(); ++i)
+	    cout << (0 == i ? "" : "x") << t->dims[i];
+	  cout << (t == &a ? "*" : " ");
+	}
+      cout << std::fixed << std::setprecision(1) <<
+	per_call([&]() { sink = sink + contract(av, bv).data[0].real(); })
+	   << " " <<
+	per_call([&]() { sink = sink + contract_small(av, bv).data[0].real(); })
+	   << " " <<
+	per_call([&]()
+		 {
+		   contract_small(av, bv, r);
+		   sink = sink + r.data[0].real();
+		 }) << "\n";
+    }
+  return 0;
+}
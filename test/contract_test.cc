@@ -0,0 +1,248 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <memory>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../contract.hh"
+#include "../matrix.hh"
+#include "../tensor.hh"
+#include "utils_test.hh"
+
+using std::complex;
+using std::vector;
+
+class ContractTest : public ::testing::Test {
+protected:
+  // a has 2 inputs and 1 output of rank 3; b has 1 input and 2
+  // outputs of rank 3.  Output 0 of b feeds input 1 of a.
+  virtual void SetUp()
+  {
+    a = new ConcreteTensor(2, 1, 3);
+    b = new ConcreteTensor(1, 2, 3);
+    for(size_t i = 0; i < 3; ++i)
+      for(size_t j = 0; j < 3; ++j)
+	for(size_t k = 0; k < 3; ++k)
+	  {
+	    a->set_entry( {i,j}, {k}, complex<double>(i + 0.5*j, k - 1.0*j) );
+	    b->set_entry( {i}, {j,k}, complex<double>(1.0*k - i, 0.25*j) );
+	  }
+    a->set_input(1, b, 0);
+  }
+
+  virtual void TearDown()
+  {
+    delete a;
+    delete b;
+  }
+
+  // Reference value of the contraction, with legs (a_in0, a_out0,
+  // b_in0, b_out1).
+  complex<double> expected(size_t i, size_t k, size_t l, size_t m)
+  {
+    complex<double> sum;
+    for(size_t j = 0; j < 3; ++j)
+      sum += a->entry( {i,j}, {k} ) * b->entry( {l}, {j,m} );
+    return sum;
+  }
+
+  Tensor *a;
+  Tensor *b;
+};
+typedef ContractTest ContractDeathTest;
+
+TEST_F(ContractTest,LinkedTensors) {
+  DenseTensor c = contract(a, b);
+
+  // labels of a are 0, 1, 2 and b continues with 3, (linked), 5
+  EXPECT_EQ((vector<size_t>{3,3,3,3}), c.dims);
+  EXPECT_EQ((vector<size_t>{0,2,3,5}), c.labels);
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t k = 0; k < 3; ++k)
+      for(size_t l = 0; l < 3; ++l)
+	for(size_t m = 0; m < 3; ++m)
+	  TN_EXPECT_COMPLEX_EQ(expected(i,k,l,m),
+			       c.data[((i*3 + k)*3 + l)*3 + m]);
+}
+
+// The fused loop and GEMM kernels must agree, including on conjugate
+// views where the storage is transposed.
+TEST_F(ContractTest,KernelsAgree) {
+  Tensor *ac = new ConcreteTensor{a->matrix(true)};
+  TensorView av = tensor_view(ac, {7}, {8,9});
+  TensorView bv = tensor_view(b, {9}, {10,8});
+
+  DenseTensor small = contract_small(av, bv), gemm = contract_gemm(av, bv);
+  EXPECT_EQ((vector<size_t>{7,10}), small.labels);
+  EXPECT_EQ(small.labels, gemm.labels);
+  ASSERT_EQ(small.data.size(), gemm.data.size());
+  for(size_t i = 0; i < small.data.size(); ++i)
+    TN_EXPECT_COMPLEX_EQ(small.data[i], gemm.data[i]);
+
+  // spot-check against the interface of the tensors
+  complex<double> sum;
+  for(size_t j = 0; j < 3; ++j)
+    for(size_t k = 0; k < 3; ++k)
+      sum += ac->entry( {2}, {j,k} ) * b->entry( {k}, {1,j} );
+  TN_EXPECT_COMPLEX_EQ(sum, small.data[2*3 + 1]);
+
+  delete ac;
+}
+
+TEST_F(ContractTest,Permuted) {
+  DenseTensor c = contract(a, b);
+  DenseTensor p = c.permuted( {5,0,3,2} );
+  EXPECT_EQ((vector<size_t>{5,0,3,2}), p.labels);
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t k = 0; k < 3; ++k)
+      for(size_t l = 0; l < 3; ++l)
+	for(size_t m = 0; m < 3; ++m)
+	  TN_EXPECT_COMPLEX_EQ(expected(i,k,l,m),
+			       p.data[((m*3 + i)*3 + l)*3 + k]);
+}
+
+// Parallel legs are fused before contraction, which must not change
+// the result.  The tensors are large enough for contract() to choose
+// the GEMM kernel, reading the fused operands in place (transposed
+// for the conjugate view); crossed legs cannot be fused and are
+// packed instead.
+TEST(ContractFusionTest,FusedLegs) {
+  Tensor *e = new ConcreteTensor(2, 2, 5), *f = new ConcreteTensor(2, 2, 5);
+  for(size_t i = 0; i < 5; ++i)
+    for(size_t j = 0; j < 5; ++j)
+      for(size_t k = 0; k < 5; ++k)
+	for(size_t l = 0; l < 5; ++l)
+	  {
+	    e->set_entry( {i,j}, {k,l}, complex<double>(i - 0.5*k, j + 0.25*l) );
+	    f->set_entry( {i,j}, {k,l}, complex<double>(0.5*j + l, 1.0*i - k) );
+	  }
+  Tensor *ec = new ConcreteTensor{e->matrix(true)};
+
+  const vector<vector<TensorView>> cases = {
+    { tensor_view(e, {0,1}, {2,3}), tensor_view(f, {2,3}, {4,5}) },
+    { tensor_view(ec, {0,1}, {2,3}), tensor_view(f, {2,3}, {4,5}) },
+    { tensor_view(e, {0,1}, {2,3}), tensor_view(f, {3,2}, {4,5}) }
+  };
+  for(const vector<TensorView> &v : cases)
+    {
+      DenseTensor fused = contract(v[0], v[1]),
+	reference = contract_small(v[0], v[1]);
+      EXPECT_EQ((vector<size_t>{5,5,5,5}), fused.dims);
+      EXPECT_EQ((vector<size_t>{0,1,4,5}), fused.labels);
+      ASSERT_EQ(reference.data.size(), fused.data.size());
+      for(size_t i = 0; i < reference.data.size(); ++i)
+	TN_EXPECT_COMPLEX_EQ(reference.data[i], fused.data[i]);
+    }
+
+  // spot-check the conjugate case against the interface of the tensors
+  DenseTensor c = contract(cases[1][0], cases[1][1]);
+  complex<double> sum;
+  for(size_t j = 0; j < 5; ++j)
+    for(size_t k = 0; k < 5; ++k)
+      sum += ec->entry( {1,2}, {j,k} ) * f->entry( {j,k}, {3,4} );
+  TN_EXPECT_COMPLEX_EQ(sum, c.data[((1*5 + 2)*5 + 3)*5 + 4]);
+
+  delete ec;
+  delete e;
+  delete f;
+}
+
+// Contracting with an identity which was never stored renames legs of
+// the other operand, and must agree with contracting the stored one.
+TEST_F(ContractTest,Identity) {
+  Tensor *id = new ConcreteTensor(1, 1, 3);
+  id->set_matrix(std::make_shared<ScaledIdentityMatrix>
+		 (3, 3, complex<double>(0, 2)));
+  TensorView av = tensor_view(a, {0,1}, {2}), iv = tensor_view(id, {2}, {5});
+  ASSERT_TRUE(iv.identity);
+
+  DenseTensor ref = contract_small(av, iv), c = contract(av, iv),
+    d = contract(iv, av), p = ref.permuted( {5,0,1} );
+  EXPECT_EQ((vector<size_t>{0,1,5}), c.labels);
+  EXPECT_EQ((vector<size_t>{5,0,1}), d.labels);
+  ASSERT_EQ(ref.data.size(), c.data.size());
+  for(size_t i = 0; i < ref.data.size(); ++i)
+    {
+      TN_EXPECT_COMPLEX_EQ(ref.data[i], c.data[i]);
+      TN_EXPECT_COMPLEX_EQ(p.data[i], d.data[i]);
+    }
+  TN_EXPECT_COMPLEX_EQ(complex<double>(0, 2) * a->entry( {1,2}, {0} ),
+		       c.data[(1*3 + 2)*3 + 0]);
+
+  // summing both legs of the identity is a trace of a, which needs
+  // the stored matrix
+  TensorView tv = tensor_view(id, {0}, {1});
+  DenseTensor tr = contract(av, tv), tref = contract_small(av, tv);
+  ASSERT_EQ(tref.data.size(), tr.data.size());
+  for(size_t i = 0; i < tref.data.size(); ++i)
+    TN_EXPECT_COMPLEX_EQ(tref.data[i], tr.data[i]);
+
+  // none of this stored the identity
+  complex<double> scale;
+  EXPECT_TRUE(id->matrix().matrix->scaled_identity(scale));
+  delete id;
+}
+
+// The small kernel keeps the tables of the last layouts it saw, which
+// must be rebuilt when the labels change, and may write into the
+// storage of a given result.
+TEST(ContractSmallTest,Repeated) {
+  DenseTensor x{{2,2,2}, {0,1,2}}, y{{2,2,2}, {2,3,4}};
+  for(size_t i = 0; i < 8; ++i)
+    {
+      x.data[i] = complex<double>(1.0 + i, 0.5*i);
+      y.data[i] = complex<double>(0.3*i, 2.0 - i);
+    }
+  auto check = [](const TensorView& u, const TensorView& v,
+		  const DenseTensor& r)
+    {
+      const DenseTensor expected = contract_gemm(u, v);
+      EXPECT_EQ(expected.labels, r.labels);
+      ASSERT_EQ(expected.data.size(), r.data.size());
+      for(size_t i = 0; i < r.data.size(); ++i)
+	TN_EXPECT_COMPLEX_EQ(expected.data[i], r.data[i]);
+    };
+
+  DenseTensor r;
+  TensorView u = x.view(), v = y.view();
+  contract_small(u, v, r);
+  check(u, v, r);
+  const complex<double> *storage = r.data.data();
+  x.data[5] = complex<double>(-3, 1);
+  u.conjugate = true;
+  contract_small(u, v, r);
+  check(u, v, r);
+  EXPECT_EQ(storage, r.data.data());
+
+  // the same dimensions summed over other legs
+  v.labels = {4, 1, 3};
+  contract_small(u, v, r);
+  check(u, v, r);
+  check(u, v, contract(u, v));
+}
+
+TEST_F(ContractDeathTest,Mismatch) {
+  Tensor *d = new ConcreteTensor(1, 1, 2);
+  // summed legs of differing dimension
+  EXPECT_DEATH(contract(tensor_view(a, {0,1}, {2}),
+			tensor_view(d, {2}, {3})), "");
+  // wrong number of labels
+  EXPECT_DEATH(tensor_view(a, {0}, {2}), "");
+  // contracting a tensor with itself
+  EXPECT_DEATH(contract(a, a), "");
+  delete d;
+}
@@ -0,0 +1,221 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../dag.hh"
+#include "../plan.hh"
+#include "../tensor.hh"
+#include "utils_test.hh"
+
+using std::complex;
+using std::vector;
+
+class DagTest : public ::testing::Test {
+protected:
+  // Matrices a (2x3), b (3x4), c (4x2) and d (4x3) with distinct
+  // entries.
+  virtual void SetUp()
+  {
+    const vector<vector<size_t>> dims{ {2,3}, {3,4}, {4,2}, {4,3} };
+    for(const vector<size_t> &d : dims)
+      {
+	tensors.emplace_back(d, vector<size_t>{0, 1});
+	for(size_t i = 0; i < tensors.back().data.size(); ++i)
+	  tensors.back().data[i] = complex<double>{std::sin(1.0 + i
+							    + tensors.size()),
+						   std::cos(3.0*i)};
+      }
+  }
+
+  // View of tensor i with the given labels.
+  TensorView view(size_t i, const vector<size_t>& labels)
+  {
+    TensorView ret = tensors[i].view();
+    ret.labels = labels;
+    return ret;
+  }
+
+  vector<DenseTensor> tensors;
+};
+
+TEST_F(DagTest,Shared) {
+  // a b c and a b d, labelled differently, both contract a with b
+  // first
+  const vector<TensorView> abc{ view(0, {0,1}), view(1, {1,2}),
+				view(2, {2,3}) };
+  const vector<TensorView> abd{ view(0, {7,5}), view(1, {5,9}),
+				view(3, {9,4}) };
+  const ContractionPlan plan{ { {0,1}, {3,2} }, 0, 0 };
+  // b d a, with the pair given in the other order
+  const vector<TensorView> bda{ view(1, {5,9}), view(3, {9,4}),
+				view(0, {7,5}) };
+  const ContractionPlan swapped{ { {2,0}, {3,1} }, 0, 0 };
+
+  ContractionDag dag;
+  EXPECT_EQ(0, dag.add(abc, plan));
+  EXPECT_EQ(1, dag.add(abd, plan));
+  EXPECT_EQ(2, dag.add(bda, swapped));
+  EXPECT_EQ(3, dag.outputs());
+  EXPECT_EQ(3, dag.steps());
+
+  vector<DenseTensor> r = dag.evaluate();
+  ASSERT_EQ(3, r.size());
+  const DenseTensor x = execute(plan, abc), y = execute(plan, abd);
+  const DenseTensor s = r[0].permuted(x.labels), t = r[1].permuted(y.labels),
+    u = r[2].permuted(y.labels);
+  for(size_t i = 0; i < x.data.size(); ++i)
+    TN_EXPECT_COMPLEX_EQ(x.data[i], s.data[i]);
+  for(size_t i = 0; i < y.data.size(); ++i)
+    {
+      TN_EXPECT_COMPLEX_EQ(y.data[i], t.data[i]);
+      TN_EXPECT_COMPLEX_EQ(y.data[i], u.data[i]);
+    }
+}
+
+TEST_F(DagTest,Distinct) {
+  // the same operands joined differently, or conjugated, do not share
+  ContractionDag dag;
+  const ContractionPlan plan{ { {0,1} }, 0, 0 };
+  dag.add({ view(1, {0,1}), view(3, {1,2}) }, plan);
+  dag.add({ view(1, {0,1}), view(3, {2,0}) }, plan);
+  TensorView conj = view(3, {1,2});
+  conj.conjugate = true;
+  dag.add({ view(1, {0,1}), conj }, plan);
+  EXPECT_EQ(3, dag.steps());
+
+  // a single operand is its own output
+  dag.add({ view(2, {4,5}) }, ContractionPlan{ {}, 0, 0 });
+  vector<DenseTensor> r = dag.evaluate();
+  ASSERT_EQ(4, r.size());
+  EXPECT_EQ((vector<size_t>{4,5}), r[3].labels);
+  for(size_t i = 0; i < r[3].data.size(); ++i)
+    TN_EXPECT_COMPLEX_EQ(tensors[2].data[i], r[3].data[i]);
+}
+
+TEST(DagRetainTest,Versions) {
+  // a chain of three matrices, contracted a b first
+  ConcreteTensor a(1, 1, 2, 3), b(1, 1, 3, 3), c(1, 1, 3, 2);
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t j = 0; j < 3; ++j)
+      {
+	if(i < 2) a.set_entry( {i}, {j}, complex<double>(i + 1.0, j) );
+	b.set_entry( {i}, {j}, complex<double>(0.5*i, 1.0*i - j) );
+	if(j < 2) c.set_entry( {i}, {j}, complex<double>(j - 1.0*i, 1) );
+      }
+  const vector<Tensor*> tensors{ &a, &b, &c };
+  const ContractionPlan plan{ { {0,1}, {3,2} }, 0, 0 };
+  auto operands = [&]()
+    {
+      return vector<TensorView>{ tensor_view(&a, {0}, {1}),
+	  tensor_view(&b, {1}, {2}), tensor_view(&c, {2}, {3}) };
+    };
+  auto check = [&](const DenseTensor& r)
+    {
+      vector<TensorView> v = operands();
+      DenseTensor x = execute(plan, v), y = r.permuted(x.labels);
+      for(size_t i = 0; i < x.data.size(); ++i)
+	TN_EXPECT_COMPLEX_EQ(x.data[i], y.data[i]);
+    };
+
+  ContractionDag dag{true};
+  dag.add(operands(), plan, tensors);
+  check(dag.evaluate()[0]);
+  EXPECT_EQ(2, dag.computed());
+
+  // unchanged tensors reuse every retained result
+  dag.add(operands(), plan, tensors);
+  check(dag.evaluate(1)[0]);
+  EXPECT_EQ(0, dag.computed());
+
+  // changing c leaves the contraction of a and b valid
+  c.set_entry( {1}, {0}, complex<double>(3, -2) );
+  dag.add(operands(), plan, tensors);
+  check(dag.evaluate(2)[0]);
+  EXPECT_EQ(1, dag.computed());
+
+  // changing a invalidates both
+  a.set_entry( {0}, {2}, complex<double>(-1, 4) );
+  dag.add(operands(), plan, tensors);
+  check(dag.evaluate(3)[0]);
+  EXPECT_EQ(2, dag.computed());
+  EXPECT_EQ(2, dag.steps());
+
+  // without room to keep them, results are recomputed
+  ContractionDag small{true, 0};
+  small.add(operands(), plan, tensors);
+  small.add(operands(), plan, tensors);
+  check(small.evaluate(0)[1]);
+  EXPECT_EQ(2, small.computed());
+  small.add(operands(), plan, tensors);
+  check(small.evaluate(2)[0]);
+  EXPECT_EQ(2, small.computed());
+}
+
+TEST(DagRetainTest,SharedMatrix) {
+  // a and s share one Matrix, so are one leaf
+  ConcreteTensor a(1, 1, 2, 3), b(1, 1, 3, 2);
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t j = 0; j < 3; ++j)
+      {
+	if(i < 2) a.set_entry( {i}, {j}, complex<double>(i + 1.0, j) );
+	if(j < 2) b.set_entry( {i}, {j}, complex<double>(j - 1.0*i, 1) );
+      }
+  ConcreteTensor s{a.matrix()};
+  const ContractionPlan plan{ { {0,1} }, 0, 0 };
+  auto add = [&](ContractionDag& dag, Tensor *t)
+    {
+      return dag.add({ tensor_view(t, {0}, {1}), tensor_view(&b, {1}, {2}) },
+		     plan, { t, &b });
+    };
+  auto check = [&](Tensor *t, const DenseTensor& r)
+    {
+      const vector<TensorView> v{ tensor_view(t, {0}, {1}),
+	  tensor_view(&b, {1}, {2}) };
+      DenseTensor x = execute(plan, v), y = r.permuted(x.labels);
+      for(size_t i = 0; i < x.data.size(); ++i)
+	TN_EXPECT_COMPLEX_EQ(x.data[i], y.data[i]);
+    };
+
+  ContractionDag dag{true};
+  add(dag, &a);
+  add(dag, &s);
+  EXPECT_EQ(1, dag.steps());
+  vector<DenseTensor> r = dag.evaluate();
+  EXPECT_EQ(1, dag.computed());
+  check(&a, r[0]);
+  check(&s, r[1]);
+
+  // a change to either tensor discards the results of the leaf
+  s.set_entry( {1}, {2}, complex<double>(2, 2) );
+  add(dag, &a);
+  check(&a, dag.evaluate(2)[0]);
+  EXPECT_EQ(1, dag.computed());
+  add(dag, &s);
+  check(&s, dag.evaluate(3)[0]);
+  EXPECT_EQ(1, dag.computed());
+}
+
+TEST(DagDeathTest,Invalid) {
+  DenseTensor a{ {2}, {0} };
+  ContractionDag dag;
+  EXPECT_DEATH(dag.add({ a.view(), a.view() }, ContractionPlan{ {}, 0, 0 }),
+	       "");
+  EXPECT_DEATH(dag.add({ a.view(), a.view() },
+		       ContractionPlan{ { {0,2} }, 0, 0 }), "");
+}
@@ -0,0 +1,142 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../distributed.hh"
+
+using std::complex;
+using std::vector;
+
+// MPI is started once for the whole test binary.  Run on a single
+// process by make check, or on several local processes by make
+// mpi_check.
+class MPIEnvironment : public ::testing::Environment {
+public:
+  virtual void SetUp()
+  {
+    int initialized = 0;
+    MPI_Initialized(&initialized);
+    if(!initialized) MPI_Init(nullptr, nullptr);
+  }
+
+  virtual void TearDown()
+  {
+    MPI_Finalize();
+  }
+};
+
+static ::testing::Environment *const mpi_environment =
+  ::testing::AddGlobalTestEnvironment(new MPIEnvironment);
+
+// A tensor with distinct, deterministic entries, the same on every
+// process.
+static DenseTensor filled(const vector<size_t>& dims,
+			  const vector<size_t>& labels, double seed)
+{
+  DenseTensor t{dims, labels};
+  for(size_t i = 0; i < t.data.size(); ++i)
+    t.data[i] = complex<double>{std::sin(seed + i), std::cos(seed*i)};
+  return t;
+}
+
+static void expect_near(const DenseTensor& expected, const DenseTensor& t)
+{
+  EXPECT_EQ(expected.dims, t.dims);
+  EXPECT_EQ(expected.labels, t.labels);
+  ASSERT_EQ(expected.data.size(), t.data.size());
+  for(size_t i = 0; i < t.data.size(); ++i)
+    EXPECT_NEAR(0, std::abs(expected.data[i] - t.data[i]), 1e-10) << i;
+}
+
+TEST(DistributedTest,Layout) {
+  ProcessGrid grid;
+  int size = 0;
+  MPI_Comm_size(grid.comm(), &size);
+  EXPECT_EQ(size, grid.rows() * grid.cols());
+  EXPECT_LE(grid.rows(), grid.cols());
+
+  // every entry is held by exactly one process
+  DistributedMatrix m{grid, 37, 23, 4};
+  vector<int> owned(37*23, 0), total(37*23);
+  for(size_t i = 0; i < m.local_rows(); ++i)
+    for(size_t j = 0; j < m.local_cols(); ++j)
+      ++owned[m.global_row(i)*23 + m.global_col(j)];
+  MPI_Allreduce(owned.data(), total.data(), 37*23, MPI_INT, MPI_SUM,
+		grid.comm());
+  for(int n : total) EXPECT_EQ(1, n);
+}
+
+TEST(DistributedTest,Summa) {
+  ProcessGrid grid;
+  DenseTensor a = filled({45, 30}, {0, 1}, 1), b = filled({30, 27}, {1, 2}, 2);
+  DistributedTensor da = distribute(grid, a.view(), 1, 8),
+    db = distribute(grid, b.view(), 1, 8);
+  DistributedTensor dc{{45, 27}, {0, 2}, 1, DistributedMatrix{grid, 45, 27, 8}};
+  summa(da.matrix, db.matrix, dc.matrix);
+  expect_near(contract_gemm(a.view(), b.view()), gather(dc));
+}
+
+TEST(DistributedTest,Contract) {
+  ProcessGrid grid;
+  DenseTensor a = filled({3, 4, 5}, {0, 1, 2}, 3),
+    b = filled({5, 6, 3}, {2, 3, 0}, 4);
+  TensorView av = a.view();
+  av.conjugate = true;
+
+  // the summed legs are split differently on the two operands, so
+  // both must be redistributed
+  DistributedTensor da = distribute(grid, av, 1, 2),
+    db = distribute(grid, b.view(), 2, 2);
+  expect_near(contract(av, b.view()), gather(contract(da, db)));
+}
+
+TEST(DistributedTest,Execute) {
+  ProcessGrid grid;
+  vector<DenseTensor> t;
+  t.push_back(filled({6, 7}, {0, 1}, 5));
+  t.push_back(filled({7, 8, 9}, {1, 2, 3}, 6));
+  t.push_back(filled({9, 6}, {3, 4}, 7));
+  t.push_back(filled({8, 6, 5}, {2, 0, 5}, 8));
+  vector<TensorView> operands;
+  for(const DenseTensor &x : t) operands.push_back(x.view());
+  ContractionPlan plan = greedy_plan(operands);
+  DenseTensor expected = execute(plan, operands);
+
+  // everything replicated, everything distributed, and a mixture
+  expect_near(expected, execute_distributed(grid, plan, operands));
+  expect_near(expected, execute_distributed(grid, plan, operands, 0));
+  expect_near(expected, execute_distributed(grid, plan, operands, 400));
+
+  // gathered onto one process
+  DenseTensor r = execute_distributed(grid, plan, operands, 0, 0);
+  if(0 == grid.row() && 0 == grid.col())
+    expect_near(expected, r);
+  else
+    EXPECT_TRUE(r.data.empty());
+
+  // some operands distributed, and the result left distributed
+  vector<DistributedTensor> d;
+  for(const TensorView &v : operands) d.push_back(distribute(grid, v, 1, 4));
+  const vector<const DistributedTensor*> leaves{&d[0], nullptr, &d[2],
+      nullptr};
+  expect_near(expected, gather(execute_distributed(grid, plan, operands,
+						   leaves)));
+  expect_near(expected, gather(execute_distributed(grid, plan, operands,
+						   leaves, 0)));
+}
@@ -0,0 +1,158 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../einsum.hh"
+#include "../matrix.hh"
+#include "../tensor.hh"
+#include "utils_test.hh"
+
+using std::complex;
+using std::vector;
+
+class EinsumTest : public ::testing::Test {
+protected:
+  // Matrices a (2x3), b (3x4) and d (4x2), and a tensor c (3x2x4),
+  // with distinct entries.
+  virtual void SetUp()
+  {
+    const vector<vector<size_t>> dims{ {2,3}, {3,4}, {4,2}, {3,2,4} };
+    for(const vector<size_t> &d : dims)
+      {
+	tensors.emplace_back(d, vector<size_t>(d.size(), 0));
+	for(size_t i = 0; i < tensors.back().data.size(); ++i)
+	  tensors.back().data[i] = complex<double>{std::sin(1.0 + i
+							    + tensors.size()),
+						   std::cos(3.0*i)};
+      }
+  }
+
+  // Entry i, j of a b.
+  complex<double> ab(size_t i, size_t j)
+  {
+    complex<double> ret;
+    for(size_t k = 0; k < 3; ++k)
+      ret += tensors[0].data[i*3 + k] * tensors[1].data[k*4 + j];
+    return ret;
+  }
+
+  vector<DenseTensor> tensors;
+};
+
+typedef EinsumTest EinsumDeathTest;
+
+TEST_F(EinsumTest,Product) {
+  const DenseTensor &a = tensors[0], &b = tensors[1];
+  DenseTensor c;
+  c("ij") = a("ik") * b("kj");
+  ASSERT_EQ((vector<size_t>{2, 4}), c.dims);
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      TN_EXPECT_COMPLEX_EQ(ab(i, j), c.data[i*4 + j]);
+
+  // the result may be transposed, and a network closed to a scalar
+  DenseTensor t, s;
+  t("ji") = a("ik") * b("kj");
+  s("") = a("ik") * b("kj") * tensors[2]("ji");
+  complex<double> trace;
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      {
+	TN_EXPECT_COMPLEX_EQ(ab(i, j), t.data[j*2 + i]);
+	trace += ab(i, j) * tensors[2].data[j*2 + i];
+      }
+  ASSERT_EQ(1, s.data.size());
+  TN_EXPECT_COMPLEX_EQ(trace, s.data[0]);
+}
+
+TEST_F(EinsumTest,Sum) {
+  const DenseTensor &a = tensors[0], &b = tensors[1], &d = tensors[2];
+  // sums, differences and scalars in any position, with products of
+  // sums distributed (terms are summed in another order, so results
+  // agree only to rounding)
+  DenseTensor r;
+  r("ij") = 2.0 * a("ik") * b("kj") - d("ji") * complex<double>{0, 1}
+    + (a("ik") + 2.0 * a("ik")) * (b("kj") - b("kj") * 2.0) * (1.0/3)
+    + -(a("ik") * b("kj")) + a("ik") * b("kj");
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      {
+	const complex<double> expected = ab(i, j)
+	  - complex<double>{0, 1} * d.data[j*2 + i];
+	EXPECT_NEAR(0, std::abs(expected - r.data[i*4 + j]), 1e-12);
+      }
+
+  // accumulation, and the destination on the right
+  DenseTensor s = r;
+  r("ij") += r("ij");
+  s("ij") = s("ij") + 2.0 * s("ij") - s("ij");
+  for(size_t i = 0; i < 8; ++i)
+    EXPECT_NEAR(0, std::abs(r.data[i] - s.data[i]), 1e-12);
+}
+
+TEST_F(EinsumTest,Tensors) {
+  // a tensor with 1 input of rank 2 and 1 output of rank 4
+  ConcreteTensor t{1, 1, 2, 4}, id{1, 1, 2};
+  indexed(&t, "ij") = tensors[0]("ik") * tensors[1]("kj");
+  const uint64_t version = t.version();
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      TN_EXPECT_COMPLEX_EQ(ab(i, j), t.entry({i}, {j}));
+
+  // the identity is read without being stored, and a conjugate tensor
+  // is written through its transposed storage
+  ConcreteTensor h{t.matrix(true)};
+  indexed(&h, "ji") = 3.0 * indexed(&id, "ik") * indexed(&t, "kj");
+  EXPECT_EQ(version, t.version());
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      TN_EXPECT_COMPLEX_EQ(3.0 * ab(i, j), h.entry({j}, {i}));
+  complex<double> scale;
+  EXPECT_TRUE(id.matrix().matrix->scaled_identity(scale));
+
+  // an expression reads the storage a tensor has when evaluated
+  const auto e = 2.0 * indexed(&t, "ij");
+  MatrixStruct m = t.matrix();
+  std::shared_ptr<Matrix> s = std::make_shared<GSLMatrix>(m.matrix->rows(),
+							  m.matrix->cols());
+  for(size_t i = 0; i < s->rows() * s->cols(); ++i)
+    s->data()[i] = complex<double>{1.0 + i, -0.5*i};
+  t.set_matrix(s);
+  DenseTensor r;
+  r("ij") = e;
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      TN_EXPECT_COMPLEX_EQ(2.0 * t.entry({i}, {j}), r.data[i*4 + j]);
+}
+
+TEST_F(EinsumDeathTest,Mismatch) {
+  const DenseTensor &a = tensors[0], &b = tensors[1], &c = tensors[3];
+  DenseTensor r;
+  // open indices differing from the result
+  EXPECT_DEATH(r("ik") = a("ik") * b("kj"), "");
+  // terms with different open indices
+  EXPECT_DEATH(r("ij") = a("ij") + a("ik") * b("kj"), "");
+  // summed legs of differing dimension
+  EXPECT_DEATH(r("ij") = a("ik") * b("jk"), "");
+  // an index on three tensors, or twice on one
+  EXPECT_DEATH(r("x") = a("ik") * b("kj") * c("kxj"), "");
+  EXPECT_DEATH(a("ii"), "");
+  // wrong number of indices
+  EXPECT_DEATH(a("ijk"), "");
+}
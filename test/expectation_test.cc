@@ -0,0 +1,210 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../dag.hh"
+#include "../expectation.hh"
+#include "../matrix.hh"
+#include "../tensor.hh"
+#include "utils_test.hh"
+
+using std::complex;
+using std::vector;
+
+class ExpectationTest : public ::testing::Test {
+protected:
+  // A two-level tree on four sites: top feeds isometries w1 (sites 0
+  // and 1) and w2 (sites 2 and 3).
+  virtual void SetUp()
+  {
+    const double r = 1 / std::sqrt(2.0);
+    const complex<double> i{0, 1};
+    top = new ConcreteTensor(0, 2, 0, 2);
+    w1 = new ConcreteTensor(1, 2, 2);
+    w2 = new ConcreteTensor(1, 2, 2);
+    set_rows(top, { 0.5, 0.5*i, -0.5, 0.5 });
+    set_rows(w1, { r, r*i, 0, 0, 0, 0, r, -r });
+    set_rows(w2, { 0.6, 0, 0, 0.8, 0, 0.8*i, -0.6*i, 0 });
+    top->set_output(0, w1, 0);
+    top->set_output(1, w2, 0);
+
+    // the full state, for comparison
+    for(size_t s = 0; s < 16; ++s)
+      {
+	psi[s] = 0;
+	for(size_t a = 0; a < 2; ++a)
+	  for(size_t b = 0; b < 2; ++b)
+	    psi[s] += top->entry( {}, {a,b} )
+	      * w1->entry( {a}, {s>>3 & 1, s>>2 & 1} )
+	      * w2->entry( {b}, {s>>1 & 1, s & 1} );
+      }
+
+    op = new ConcreteTensor(2, 2, 2);
+    for(size_t j = 0; j < 4; ++j)
+      for(size_t k = 0; k < 4; ++k)
+	op->set_entry( {j>>1, j&1}, {k>>1, k&1},
+		       complex<double>(1.0*j - 0.5*k, 0.25*j*k) );
+  }
+
+  virtual void TearDown()
+  {
+    delete op;
+    delete w1;
+    delete w2;
+    delete top;
+  }
+
+  // Set the entries of t from its matrix, listed row by row.
+  void set_rows(Tensor *t, vector<complex<double>> entries)
+  {
+    MatrixStruct m = t->matrix();
+    for(size_t j = 0; j < entries.size(); ++j)
+      m.matrix->set(j / m.matrix->cols(), j % m.matrix->cols(), entries[j]);
+  }
+
+  // <psi|op|psi> with op acting on sites 1 and 2.
+  complex<double> brute_force()
+  {
+    complex<double> sum;
+    for(size_t s = 0; s < 16; ++s)
+      for(size_t t = 0; t < 16; ++t)
+	if((s & 9) == (t & 9))
+	  sum += std::conj(psi[s]) * psi[t]
+	    * op->entry( {s>>2 & 1, s>>1 & 1}, {t>>2 & 1, t>>1 & 1} );
+    return sum;
+  }
+
+  Tensor *top;
+  Tensor *w1;
+  Tensor *w2;
+  Tensor *op;
+  complex<double> psi[16];
+};
+
+TEST_F(ExpectationTest,ReducedDensityMatrix) {
+  DenseTensor rho = reduced_density_matrix(top, { GraphEdge{nullptr,0,w1,0} });
+  ASSERT_EQ((vector<size_t>{2,2}), rho.dims);
+  // unit trace, and agreement with the full state
+  TN_EXPECT_COMPLEX_EQ(1, rho.data[0] + rho.data[3]);
+  complex<double> rho01;
+  for(size_t s = 0; s < 8; ++s)
+    rho01 += psi[s] * std::conj(psi[s + 8]);
+  EXPECT_NEAR(rho01.real(), rho.data[1].real(), 1e-12);
+  EXPECT_NEAR(rho01.imag(), rho.data[1].imag(), 1e-12);
+}
+
+TEST_F(ExpectationTest,TwoSiteOperator) {
+  LocalOperator o{op, { GraphEdge{nullptr,0,w1,1},
+			GraphEdge{nullptr,0,w2,0} } };
+  complex<double> e = expectation(top, o), expected = brute_force();
+  EXPECT_NEAR(expected.real(), e.real(), 1e-12);
+  EXPECT_NEAR(expected.imag(), e.imag(), 1e-12);
+}
+
+TEST_F(ExpectationTest,Batch) {
+  Tensor *id = new ConcreteTensor(1, 1, 2);
+  vector<LocalOperator> ops{
+    { op, { GraphEdge{nullptr,0,w1,1}, GraphEdge{nullptr,0,w2,0} } },
+    { id, { GraphEdge{nullptr,0,w2,1} } },
+    { op, { GraphEdge{nullptr,0,w1,1}, GraphEdge{nullptr,0,w2,0} } } };
+
+  vector<complex<double>> e = expectation(top, ops);
+  ASSERT_EQ(3, e.size());
+  EXPECT_NEAR(brute_force().real(), e[0].real(), 1e-12);
+  EXPECT_NEAR(1, e[1].real(), 1e-12);
+  EXPECT_NEAR(0, e[1].imag(), 1e-12);
+  TN_EXPECT_COMPLEX_EQ(e[0], e[2]);
+  delete id;
+}
+
+TEST(ExpectationDeathTest,InvalidSite) {
+  Tensor *t0 = new ConcreteTensor(0, 1, 0, 2),
+    *t1 = new ConcreteTensor(1, 1, 2), *t2 = new ConcreteTensor(0, 1, 0, 2);
+  t0->set_output(0, t1, 0);
+  // a linked output is not a site
+  EXPECT_DEATH(reduced_density_matrix(t0, { GraphEdge{nullptr,0,t0,0} }), "");
+  // the top tensor must lie in the causal cone
+  EXPECT_DEATH(reduced_density_matrix(t2, { GraphEdge{nullptr,0,t1,0} }), "");
+  delete t0;
+  delete t1;
+  delete t2;
+}
+
+TEST_F(ExpectationTest,Environment) {
+  LocalOperator o{op, { GraphEdge{nullptr,0,w1,1},
+			GraphEdge{nullptr,0,w2,0} } };
+  const complex<double> expected = expectation(top, o);
+
+  // contracting the environment with the conjugate tensor recovers
+  // the expectation value
+  for(Tensor *t : { top, w1, w2 })
+    {
+      DenseTensor env = environment(top, o, t);
+      MatrixStruct m = t->matrix();
+      ASSERT_EQ(m.matrix->rows() * m.matrix->cols(), env.data.size());
+      complex<double> sum;
+      for(size_t i = 0; i < env.data.size(); ++i)
+	sum += env.data[i] * std::conj(m.matrix->data()[i]);
+      EXPECT_NEAR(expected.real(), sum.real(), 1e-12);
+      EXPECT_NEAR(expected.imag(), sum.imag(), 1e-12);
+    }
+
+  // w2 lies outside the causal cone of a site below w1
+  LocalOperator one{op, { GraphEdge{nullptr,0,w1,0},
+			  GraphEdge{nullptr,0,w1,1} } };
+  for(const complex<double> &x : environment(top, one, w2).data)
+    TN_EXPECT_COMPLEX_EQ(0, x);
+}
+
+TEST_F(ExpectationTest,EnvironmentSum) {
+  vector<LocalOperator> ops{
+    { op, { GraphEdge{nullptr,0,w1,1}, GraphEdge{nullptr,0,w2,0} } },
+    { op, { GraphEdge{nullptr,0,w1,0}, GraphEdge{nullptr,0,w1,1} } } };
+  for(Tensor *t : { top, w1, w2 })
+    {
+      DenseTensor sum = environment(top, ops, t);
+      DenseTensor a = environment(top, ops[0], t),
+	b = environment(top, ops[1], t);
+      ASSERT_EQ(a.data.size(), sum.data.size());
+      for(size_t i = 0; i < sum.data.size(); ++i)
+	TN_EXPECT_COMPLEX_EQ(a.data[i] + b.data[i], sum.data[i]);
+    }
+}
+
+TEST_F(ExpectationTest,EnvironmentCache) {
+  vector<LocalOperator> ops{
+    { op, { GraphEdge{nullptr,0,w1,1}, GraphEdge{nullptr,0,w2,0} } },
+    { op, { GraphEdge{nullptr,0,w2,0}, GraphEdge{nullptr,0,w2,1} } } };
+  ContractionDag cache{true};
+  for(size_t round = 0; round < 2; ++round)
+    {
+      // the second round follows an update of w2, which the cache must
+      // notice
+      if(1 == round) w2->set_entry( {1}, {0,1}, complex<double>(0.3, -0.1) );
+      for(Tensor *t : { top, w1, w2 })
+	{
+	  DenseTensor cached = environment(top, ops, t, &cache);
+	  DenseTensor fresh = environment(top, ops, t);
+	  ASSERT_EQ(fresh.data.size(), cached.data.size());
+	  // shared results may have been summed in another order
+	  for(size_t i = 0; i < fresh.data.size(); ++i)
+	    EXPECT_NEAR(0, std::abs(fresh.data[i] - cached.data[i]), 1e-12);
+	}
+    }
+}
@@ -15,12 +15,14 @@
 // along with Tensor Network.  If not, see
 // <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "../tensor.hh"
 #include "../graph.hh"
 
 using std::unordered_set;
+using std::vector;
 
 TEST(GraphTest,EdgeEquality) {
   GraphEdge e0 {nullptr, 0, nullptr, 0};
@@ -87,3 +89,74 @@ TEST(GraphTest,BuildGraph) {
   delete t3;
   delete t4;
 }
+
+// Causal cone of one site in a binary tree, with top feeding w1 and
+// w2.
+TEST(GraphTest,CausalCone) {
+  Tensor *top = new ConcreteTensor(0,2,0,2),
+    *w1 = new ConcreteTensor(1,2,2),
+    *w2 = new ConcreteTensor(1,2,2);
+  top->set_output(0,w1,0);
+  top->set_output(1,w2,0);
+
+  CausalConeGraph cone{ {GraphEdge{nullptr,0,w1,1}} };
+
+  unordered_set<Tensor*> vertices(cone.vertex_begin(), cone.vertex_end());
+  unordered_set<GraphEdge> edges(cone.edge_begin(), cone.edge_end());
+  unordered_set<GraphEdge> endpts(cone.endpt_begin(), cone.endpt_end());
+  unordered_set<GraphEdge> cancelled(cone.cancelled_begin(),
+				     cone.cancelled_end());
+
+  EXPECT_EQ(2, vertices.size());
+  EXPECT_EQ(1, vertices.count(top));
+  EXPECT_EQ(1, vertices.count(w1));
+
+  EXPECT_EQ(1, edges.size());
+  EXPECT_EQ(1, edges.count(GraphEdge{w1,0,top,0}));
+
+  EXPECT_EQ(1, endpts.size());
+  EXPECT_EQ(1, endpts.count(GraphEdge{nullptr,0,w1,1}));
+
+  // the other site of w1 and everything below w2 cancel
+  EXPECT_EQ(2, cone.cancellations());
+  EXPECT_EQ(1, cancelled.count(GraphEdge{nullptr,0,w1,0}));
+  EXPECT_EQ(1, cancelled.count(GraphEdge{w2,0,top,1}));
+
+  delete top;
+  delete w1;
+  delete w2;
+}
+
+// u and v are joined by two outputs of u feeding the inputs of v in
+// order, which fuse into one leg, and by two outputs of v feeding the
+// inputs of u crossed, which cannot.  The single edge to w is not
+// parallel.
+TEST(GraphTest,ParallelEdges) {
+  Tensor *u = new ConcreteTensor(2,2,2),
+    *v = new ConcreteTensor(2,3,2),
+    *w = new ConcreteTensor(1,1,2);
+  u->set_output(0,v,0);
+  u->set_output(1,v,1);
+  v->set_output(1,u,1);
+  v->set_output(2,u,0);
+  v->set_output(0,w,0);
+
+  DFSGraph graph{u};
+  vector<EdgeBundle> bundles = parallel_edges(graph);
+
+  ASSERT_EQ(1, bundles.size());
+  EXPECT_EQ(std::min(u,v), bundles[0].first);
+  EXPECT_EQ(std::max(u,v), bundles[0].second);
+  EXPECT_EQ(4, bundles[0].edges.size());
+  EXPECT_EQ(3, bundles[0].fused_legs);
+  unordered_set<GraphEdge> edges(bundles[0].edges.begin(),
+				 bundles[0].edges.end());
+  EXPECT_EQ(1, edges.count(GraphEdge{v,0,u,0}));
+  EXPECT_EQ(1, edges.count(GraphEdge{v,1,u,1}));
+  EXPECT_EQ(1, edges.count(GraphEdge{u,1,v,1}));
+  EXPECT_EQ(1, edges.count(GraphEdge{u,0,v,2}));
+
+  delete u;
+  delete v;
+  delete w;
+}
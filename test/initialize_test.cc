@@ -0,0 +1,109 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../initialize.hh"
+#include "../matrix.hh"
+#include "../tensor.hh"
+
+using std::array;
+using std::complex;
+using std::vector;
+
+// Known-answer vectors of the Random123 reference implementation.
+TEST(InitializeTest,Philox) {
+  EXPECT_EQ((array<uint32_t, 4>{{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+	    0x9b00dbd8}}),
+    philox(array<uint32_t, 4>{{0, 0, 0, 0}}, array<uint32_t, 2>{{0, 0}}));
+  EXPECT_EQ((array<uint32_t, 4>{{0x408f276d, 0x41c83b0e, 0xa20bc7c6,
+	    0x6d5451fd}}),
+    philox(array<uint32_t, 4>{{0xffffffff, 0xffffffff, 0xffffffff,
+	      0xffffffff}}, array<uint32_t, 2>{{0xffffffff, 0xffffffff}}));
+}
+
+TEST(InitializeTest,Gaussian) {
+  // moments of many draws
+  const size_t n = 100000;
+  complex<double> mean;
+  double var = 0;
+  for(size_t i = 0; i < n; ++i)
+    {
+      const complex<double> x = gaussian(7, 3, i);
+      mean += x;
+      var += std::norm(x);
+    }
+  EXPECT_NEAR(0, std::abs(mean / double(n)), 0.02);
+  EXPECT_NEAR(2, var / n, 0.05);
+  // streams and seeds are independent
+  EXPECT_NE(gaussian(7, 3, 0), gaussian(7, 4, 0));
+  EXPECT_NE(gaussian(7, 3, 0), gaussian(8, 3, 0));
+}
+
+// Results must not depend on the number of threads.
+TEST(InitializeTest,Reproducible) {
+  vector<Tensor*> one, many;
+  for(size_t i = 0; i < 20; ++i)
+    {
+      one.push_back(new ConcreteTensor(1, 2, 1 + i % 3));
+      many.push_back(new ConcreteTensor(1, 2, 1 + i % 3));
+    }
+  initialize(one, INIT_GAUSSIAN, 42, 0, 1);
+  initialize(many, INIT_GAUSSIAN, 42, 0, 4);
+  for(size_t i = 0; i < one.size(); ++i)
+    {
+      Matrix &a = *one[i]->matrix().matrix, &b = *many[i]->matrix().matrix;
+      for(size_t j = 0; j < a.rows()*a.cols(); ++j)
+	EXPECT_EQ(a.data()[j], b.data()[j]);
+      EXPECT_EQ(gaussian(42, i, 0), a.data()[0]);
+      EXPECT_EQ(1, one[i]->version());
+    }
+  for(Tensor *t : one) delete t;
+  for(Tensor *t : many) delete t;
+}
+
+TEST(InitializeTest,Haar) {
+  // an isometry with orthonormal rows and a square unitary
+  Tensor *w = new ConcreteTensor(1, 2, 3, 2), *u = new ConcreteTensor(2, 2, 2);
+  initialize({w, u}, INIT_HAAR, 1);
+  for(Tensor *t : {w, u})
+    {
+      Matrix &m = *t->matrix().matrix;
+      for(size_t p = 0; p < m.rows(); ++p)
+	for(size_t q = 0; q < m.rows(); ++q)
+	  {
+	    complex<double> dot;
+	    for(size_t j = 0; j < m.cols(); ++j)
+	      dot += m.get(p, j) * std::conj(m.get(q, j));
+	    EXPECT_NEAR(0, std::abs(dot - (p == q ? 1.0 : 0.0)), 1e-12);
+	  }
+    }
+  delete w;
+  delete u;
+}
+
+TEST(InitializeTest,Identity) {
+  Tensor *t = new ConcreteTensor(1, 1, 3);
+  initialize({t}, INIT_IDENTITY, 5);
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t j = 0; j < 3; ++j)
+      EXPECT_EQ(complex<double>(i == j ? 1 : 0), t->entry({i}, {j}));
+  initialize({t}, INIT_IDENTITY, 5, 0.1);
+  EXPECT_EQ(1.0 + 0.1 * gaussian(5, 0, 4), t->entry({1}, {1}));
+  delete t;
+}
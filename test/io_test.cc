@@ -0,0 +1,236 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include "../io.hh"
+#include "../matrix.hh"
+#include "../network.hh"
+#include "../tensor.hh"
+
+using std::complex;
+using std::string;
+using std::vector;
+
+class IoTest : public ::testing::Test {
+protected:
+  virtual void SetUp()
+  {
+    char dir[] = "/tmp/io_test.XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    path = dir;
+  }
+
+  virtual void TearDown()
+  {
+    ASSERT_EQ(0, system(("rm -rf " + path).c_str()));
+  }
+
+  // Write text to the file name in the test directory.
+  string write(const string& name, const string& text)
+  {
+    const string ret = path + "/" + name;
+    std::ofstream f{ret, std::ios::binary};
+    f << text;
+    return ret;
+  }
+
+  // Fill t with distinct entries.
+  void fill(Tensor *t)
+  {
+    vector<size_t> in(t->inputs()), out(t->outputs());
+    for(size_t k = 0; ; ++k)
+      {
+	t->set_entry(in, out, complex<double>{std::sin(1.0 + k),
+					       std::cos(2.0*k)});
+	size_t l = 0;
+	for(; l < in.size() + out.size(); ++l)
+	  {
+	    size_t &x = l < out.size() ? out[out.size() - 1 - l]
+	      : in[in.size() + out.size() - 1 - l];
+	    const size_t r = l < out.size() ? t->output_rank()
+	      : t->input_rank();
+	    if(++x < r) break;
+	    x = 0;
+	  }
+	if(l == in.size() + out.size()) return;
+      }
+  }
+
+  // Expect s and t to have the same entries.
+  void expect_equal(Tensor *s, Tensor *t)
+  {
+    ASSERT_EQ(s->inputs(), t->inputs());
+    ASSERT_EQ(s->outputs(), t->outputs());
+    vector<size_t> in(t->inputs()), out(t->outputs());
+    for(;;)
+      {
+	EXPECT_EQ(s->entry(in, out), t->entry(in, out));
+	size_t l = 0;
+	for(; l < in.size() + out.size(); ++l)
+	  {
+	    size_t &x = l < out.size() ? out[out.size() - 1 - l]
+	      : in[in.size() + out.size() - 1 - l];
+	    const size_t r = l < out.size() ? t->output_rank()
+	      : t->input_rank();
+	    if(++x < r) break;
+	    x = 0;
+	  }
+	if(l == in.size() + out.size()) return;
+      }
+  }
+
+  string path;
+};
+
+TEST_F(IoTest,EdgeList) {
+  // a chain 0 -> 1 -> 3, with the tensor of id 2 destroyed and a loose
+  // output left on the first
+  Network a;
+  const vector<NetworkShape> shapes{ {0, 2, 0, 2}, {1, 1, 2, 3} };
+  a.build(shapes, {NetworkEdge{1, 0, 0, 0}});
+  delete new ConcreteTensor(a, 2, 1, 2);
+  a.create(1, 0, 3, 0);
+  a.create(1, 1, 4);
+  a.link({NetworkEdge{3, 0, 1, 0}});
+  ASSERT_TRUE(write_edge_list(path + "/net", a));
+
+  // read after a tensor already in the network, whose ids shift
+  Network b;
+  b.create(1, 1, 5);
+  ASSERT_EQ(1, read_edge_list(path + "/net", b));
+  ASSERT_EQ(5, b.size());
+  const vector<size_t> nin{0, 1, 1, 1}, nout{2, 1, 0, 1};
+  const vector<size_t> inrank{0, 2, 3, 4}, outrank{2, 3, 0, 4};
+  for(size_t i = 0; i < 4; ++i)
+    {
+      Tensor *t = b.tensor(1 + i);
+      EXPECT_EQ(nin[i], t->inputs());
+      EXPECT_EQ(nout[i], t->outputs());
+      EXPECT_EQ(inrank[i], t->input_rank());
+      EXPECT_EQ(outrank[i], t->output_rank());
+    }
+  EXPECT_EQ(1, b.input_id(2, 0));
+  EXPECT_EQ(0, b.input_num(2, 0));
+  EXPECT_EQ(2, b.input_id(3, 0));
+  EXPECT_EQ(kNoTensor, b.output_id(1, 1));
+  EXPECT_EQ(kNoTensor, b.input_id(4, 0));
+  EXPECT_EQ((vector<Tensor*>{b.tensor(1), b.tensor(2), b.tensor(3),
+	  b.tensor(4)}), network_tensors(b, 1));
+}
+
+TEST_F(IoTest,EdgeListInvalid) {
+  const vector<string> bad{
+    "tensor 1 1 2\n",				// missing rank
+    "tensor 1 1 2 2 2\n",			// trailing token
+    "tensor 1 1 2 2\nlink 0 0 1 0\n",		// missing tensor
+    "tensor 1 1 2 2\nlink 0 1 0 0\n",		// missing leg
+    "tensor 1 1 2 3\nlink 0 0 0 0\n",		// ranks differ
+    "tensor 2 2 2 2\nlink 0 0 0 0\nlink 0 1 0 0\n", // output used twice
+    "tensor 1 1 0 2\n",				// empty space
+    "tensor 64 64 2 2\n",			// too large to store
+    "tensor 9000000000000000000 0 1 1\n",	// too many legs
+    "tensor 200 100 1 1\n",			// too many legs of rank 1
+    "vertex 1 1 2 2\n",				// unknown record
+  };
+  Network net;
+  net.create(1, 1, 2);
+  for(size_t i = 0; i < bad.size(); ++i)
+    {
+      EXPECT_EQ(kNoTensor, read_edge_list(write("bad" + std::to_string(i),
+						bad[i]), net)) << bad[i];
+      EXPECT_EQ(1, net.size());
+    }
+  EXPECT_EQ(kNoTensor, read_edge_list(path + "/missing", net));
+
+  // comments and blank lines are skipped, and links may come first
+  const string good = "# a loop\n\nlink 0 0 0 0 # self\ntensor 1 1 2 2\n";
+  ASSERT_EQ(1, read_edge_list(write("good", good), net));
+  EXPECT_EQ(1, net.input_id(1, 0));
+}
+
+TEST_F(IoTest,Npz) {
+  // stored, conjugate and lazy identity tensors
+  ConcreteTensor a{2, 1, 2, 3}, b{1, 2, 3, 2}, c{1, 1, 3};
+  fill(&a);
+  fill(&b);
+  c.set_matrix(std::make_shared<ScaledIdentityMatrix>(3, 3,
+						       complex<double>{2, -1}));
+  ConcreteTensor h{b.matrix(true)};
+  vector<Tensor*> tensors{&a, &h, &c};
+  ASSERT_TRUE(write_npz(path + "/t.npz", tensors));
+
+  ConcreteTensor x{2, 1, 2, 3}, y{2, 1, 2, 3}, z{1, 1, 3};
+  ASSERT_TRUE(read_npz(path + "/t.npz", {&x, &y, &z}));
+  expect_equal(&a, &x);
+  expect_equal(&h, &y);
+  expect_equal(&c, &z);
+
+  // into conjugate tensors, whose storage is transposed
+  ConcreteTensor s{1, 2, 3, 2};
+  ConcreteTensor t{s.matrix(true)};
+  ASSERT_TRUE(read_npz(path + "/t.npz", {&t}));
+  expect_equal(&a, &t);
+
+  // nothing is read unless every array matches
+  ConcreteTensor u{2, 1, 2, 3}, v{1, 1, 2, 3};
+  const uint64_t version = u.version();
+  EXPECT_FALSE(read_npz(path + "/t.npz", {&u, &v}));
+  EXPECT_EQ(version, u.version());
+  EXPECT_FALSE(read_npz(path + "/t.npz", {&u, &y, &z, &c}));
+  EXPECT_FALSE(read_npz(path + "/missing.npz", {&u}));
+}
+
+TEST_F(IoTest,Npy) {
+  // float64 entries of the matrix, with the header NumPy writes
+  string header = "{'descr': '<f8', 'fortran_order': False, "
+    "'shape': (2, 3), }";
+  header.resize(117, ' ');
+  header.push_back('\n');
+  string file = string("\x93NUMPY\x01\x00", 8) + string("\x76\x00", 2)
+    + header;
+  for(size_t i = 0; i < 6; ++i)
+    {
+      const double d = i + 0.5;
+      file.append(reinterpret_cast<const char*>(&d), sizeof(d));
+    }
+  ConcreteTensor t{1, 1, 2, 3};
+  ASSERT_TRUE(read_npy(write("t.npy", file), &t));
+  EXPECT_EQ(complex<double>(5.5), t.entry({1}, {2}));
+  EXPECT_EQ(complex<double>(1.5), t.entry({0}, {1}));
+
+  // Fortran order and mismatched shapes are refused
+  ConcreteTensor u{1, 1, 3, 2};
+  EXPECT_FALSE(read_npy(path + "/t.npy", &u));
+  string fortran = file;
+  fortran.replace(fortran.find("False"), 5, "True ");
+  EXPECT_FALSE(read_npy(write("f.npy", fortran), &t));
+  EXPECT_FALSE(read_npy(write("short.npy", file.substr(0, 150)), &t));
+
+  // round trip, with the data aligned
+  ASSERT_TRUE(write_npy(path + "/u.npy", &t));
+  std::ifstream f{path + "/u.npy", std::ios::binary};
+  f.seekg(0, std::ios::end);
+  EXPECT_EQ(0, (static_cast<size_t>(f.tellg()) - 6*16) % 64);
+  ConcreteTensor v{1, 1, 2, 3};
+  ASSERT_TRUE(read_npy(path + "/u.npy", &v));
+  expect_equal(&t, &v);
+}
@@ -0,0 +1,120 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../krylov.hh"
+#include "../linalg.hh"
+
+using std::complex;
+using std::vector;
+
+class KrylovTest : public ::testing::Test {
+protected:
+  // Build Hermitian and non-Hermitian matrices of dimension n with
+  // known spectra: q diag(lambda) q^dagger and q t q^dagger with t
+  // upper triangular, for a unitary q.
+  virtual void SetUp()
+  {
+    vector<complex<double>> a(n*n);
+    for(size_t i = 0; i < a.size(); ++i)
+      a[i] = complex<double>{std::sin(1.0 + i), std::cos(3.0*i)};
+    vector<complex<double>> q = polar(a.data(), n, n), t(n*n);
+    for(size_t i = 0; i < n; ++i)
+      {
+	t[i*n + i] = 1.0 + i;
+	for(size_t j = i + 1; j < n; ++j) t[i*n + j] = 0.1 * std::cos(1.0*i*j);
+      }
+    // the extreme eigenvalues are -1 and 2 + n, well separated
+    t[0] = -1;
+    t[(n - 1)*n + n - 1] = 2.0 + n;
+
+    hermitian.assign(n*n, 0);
+    general.assign(n*n, 0);
+    for(size_t i = 0; i < n; ++i)
+      for(size_t j = 0; j < n; ++j)
+	for(size_t k = 0; k < n; ++k)
+	  {
+	    hermitian[i*n + j] += q[i*n + k] * t[k*n + k] * std::conj(q[j*n + k]);
+	    for(size_t l = k; l < n; ++l)
+	      general[i*n + j] += q[i*n + k] * t[k*n + l] * std::conj(q[j*n + l]);
+	  }
+  }
+
+  static LinearMap apply(const vector<complex<double>>& matrix)
+  {
+    return [&matrix](const complex<double> *x, complex<double> *y)
+      {
+	for(size_t i = 0; i < n; ++i)
+	  {
+	    y[i] = 0;
+	    for(size_t j = 0; j < n; ++j) y[i] += matrix[i*n + j] * x[j];
+	  }
+      };
+  }
+
+  // Norm of a x - lambda x.
+  static double residual(const vector<complex<double>>& matrix,
+			 const EigenPair& p)
+  {
+    vector<complex<double>> y(n);
+    apply(matrix)(p.vector.data(), y.data());
+    double r = 0;
+    for(size_t i = 0; i < n; ++i) r += std::norm(y[i] - p.value * p.vector[i]);
+    return std::sqrt(r);
+  }
+
+  static const size_t n = 40;
+  vector<complex<double>> hermitian;
+  vector<complex<double>> general;
+};
+
+const size_t KrylovTest::n;
+
+TEST_F(KrylovTest,Lanczos) {
+  EigenPair p = lanczos(apply(hermitian), n, {});
+  EXPECT_TRUE(p.converged);
+  EXPECT_NEAR(-1, p.value.real(), 1e-9);
+  EXPECT_DOUBLE_EQ(0, p.value.imag());
+  EXPECT_LT(residual(hermitian, p), 1e-8);
+}
+
+TEST_F(KrylovTest,Arnoldi) {
+  EigenPair p = arnoldi(apply(general), n, {});
+  EXPECT_TRUE(p.converged);
+  EXPECT_NEAR(2.0 + n, p.value.real(), 1e-8);
+  EXPECT_NEAR(0, p.value.imag(), 1e-8);
+  EXPECT_LT(residual(general, p), 1e-7);
+}
+
+TEST_F(KrylovTest,Restarts) {
+  // a small Krylov space forces restarts, which must still converge
+  EigenPair p = lanczos(apply(hermitian), n, {}, 4, 1e-8, 1000);
+  EXPECT_TRUE(p.converged);
+  EXPECT_GT(p.restarts, 0);
+  EXPECT_NEAR(-1, p.value.real(), 1e-7);
+}
+
+TEST_F(KrylovTest,WarmStart) {
+  EigenPair cold = lanczos(apply(hermitian), n, {});
+  ASSERT_TRUE(cold.converged);
+  EigenPair warm = lanczos(apply(hermitian), n, cold.vector);
+  EXPECT_TRUE(warm.converged);
+  EXPECT_LT(warm.applications, cold.applications);
+  EXPECT_NEAR(cold.value.real(), warm.value.real(), 1e-9);
+}
@@ -0,0 +1,163 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../linalg.hh"
+
+using std::complex;
+using std::vector;
+
+// A matrix with distinct, deterministic entries.
+static vector<complex<double>> filled(size_t m, size_t n)
+{
+  vector<complex<double>> a(m*n);
+  for(size_t i = 0; i < a.size(); ++i)
+    a[i] = complex<double>{std::sin(1.0 + i), std::cos(2.0*i)};
+  return a;
+}
+
+// Expect the columns of the m x k matrix u to be orthonormal.
+static void expect_orthonormal(const vector<complex<double>>& u, size_t m,
+			       size_t k)
+{
+  for(size_t p = 0; p < k; ++p)
+    for(size_t q = 0; q < k; ++q)
+      {
+	complex<double> dot;
+	for(size_t i = 0; i < m; ++i)
+	  dot += std::conj(u[i*k + p]) * u[i*k + q];
+	EXPECT_NEAR(p == q ? 1 : 0, std::abs(dot), 1e-12) << p << " " << q;
+      }
+}
+
+// Check that d is a valid decomposition of the m x n matrix a.
+static void expect_decomposition(const vector<complex<double>>& a, size_t m,
+				 size_t n, const SVD& d)
+{
+  const size_t k = std::min(m, n);
+  ASSERT_EQ(k, d.s.size());
+  ASSERT_EQ(m*k, d.u.size());
+  ASSERT_EQ(n*k, d.v.size());
+  expect_orthonormal(d.u, m, k);
+  expect_orthonormal(d.v, n, k);
+  for(size_t l = 1; l < k; ++l) EXPECT_GE(d.s[l - 1], d.s[l]);
+  for(size_t i = 0; i < m; ++i)
+    for(size_t j = 0; j < n; ++j)
+      {
+	complex<double> x;
+	for(size_t l = 0; l < k; ++l)
+	  x += d.u[i*k + l] * d.s[l] * std::conj(d.v[j*k + l]);
+	EXPECT_NEAR(0, std::abs(x - a[i*n + j]), 1e-12) << i << " " << j;
+      }
+}
+
+TEST(LinalgTest,Tall) {
+  vector<complex<double>> a = filled(7, 4);
+  expect_decomposition(a, 7, 4, svd(a.data(), 7, 4));
+}
+
+TEST(LinalgTest,Wide) {
+  vector<complex<double>> a = filled(3, 8);
+  expect_decomposition(a, 3, 8, svd(a.data(), 3, 8));
+}
+
+TEST(LinalgTest,RankDeficient) {
+  // an outer product has a single nonzero singular value, and the
+  // remaining singular vectors must still be orthonormal
+  vector<complex<double>> x = filled(5, 1), y = filled(1, 4), a(20);
+  for(size_t i = 0; i < 5; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      a[i*4 + j] = x[i] * std::conj(y[j]);
+  SVD d = svd(a.data(), 5, 4);
+  expect_decomposition(a, 5, 4, d);
+  for(size_t l = 1; l < 4; ++l) EXPECT_NEAR(0, d.s[l], 1e-12);
+}
+
+TEST(LinalgTest,Polar) {
+  vector<complex<double>> a = filled(3, 6), p = polar(a.data(), 3, 6);
+  // rows of p are orthonormal
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t j = 0; j < 3; ++j)
+      {
+	complex<double> dot;
+	for(size_t k = 0; k < 6; ++k)
+	  dot += p[i*6 + k] * std::conj(p[j*6 + k]);
+	EXPECT_NEAR(i == j ? 1 : 0, std::abs(dot), 1e-12);
+      }
+
+  // and p is the isometry closest to a, so its overlap with a (the sum
+  // of the singular values) is real and maximal
+  complex<double> overlap;
+  for(size_t i = 0; i < 18; ++i) overlap += std::conj(p[i]) * a[i];
+  double trace = 0;
+  for(double s : svd(a.data(), 3, 6).s) trace += s;
+  EXPECT_NEAR(trace, overlap.real(), 1e-12);
+  EXPECT_NEAR(0, overlap.imag(), 1e-12);
+}
+
+TEST(LinalgTest,Orthonormalize) {
+  // tall: q has orthonormal columns and r = q^dagger a is upper
+  // triangular with a positive diagonal
+  vector<complex<double>> a = filled(5, 3), q = a;
+  orthonormalize(q.data(), 5, 3);
+  expect_orthonormal(q, 5, 3);
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t j = 0; j <= i; ++j)
+      {
+	complex<double> r;
+	for(size_t k = 0; k < 5; ++k) r += std::conj(q[k*3 + i]) * a[k*3 + j];
+	if(i == j)
+	  {
+	    EXPECT_GT(r.real(), 0);
+	    EXPECT_NEAR(0, r.imag(), 1e-12);
+	  }
+	else
+	  EXPECT_NEAR(0, std::abs(r), 1e-12) << i << " " << j;
+      }
+
+  // wide: the rows become orthonormal
+  vector<complex<double>> w = filled(2, 4);
+  orthonormalize(w.data(), 2, 4);
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t j = 0; j < 2; ++j)
+      {
+	complex<double> dot;
+	for(size_t k = 0; k < 4; ++k)
+	  dot += w[i*4 + k] * std::conj(w[j*4 + k]);
+	EXPECT_NEAR(i == j ? 1 : 0, std::abs(dot), 1e-12);
+      }
+}
+
+TEST(LinalgTest,HessenbergEigensystem) {
+  const size_t m = 6;
+  vector<complex<double>> h = filled(m, m);
+  for(size_t i = 2; i < m; ++i)
+    for(size_t j = 0; j + 1 < i; ++j) h[i*m + j] = 0;
+
+  Eigensystem e = hessenberg_eigensystem(h.data(), m);
+  ASSERT_EQ(m, e.values.size());
+  for(size_t k = 0; k < m; ++k)
+    for(size_t i = 0; i < m; ++i)
+      {
+	complex<double> hv;
+	for(size_t j = 0; j < m; ++j) hv += h[i*m + j] * e.vectors[j*m + k];
+	EXPECT_NEAR(0, std::abs(hv - e.values[k] * e.vectors[i*m + k]), 1e-10)
+	  << k << " " << i;
+      }
+}
@@ -0,0 +1,148 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <string>
+#include "../expectation.hh"
+#include "../matrix.hh"
+#include "../mera.hh"
+#include "../tensor.hh"
+
+using std::complex;
+using std::string;
+using std::vector;
+
+TEST(MeraTest,Hamiltonian) {
+  BondHamiltonian ising = ising_hamiltonian(1), xxz = xxz_hamiltonian(1);
+  for(const BondHamiltonian &h : { ising, xxz })
+    {
+      ASSERT_EQ(16, h.term.size());
+      // the bond term is Hermitian
+      for(size_t i = 0; i < 4; ++i)
+	for(size_t j = 0; j < 4; ++j)
+	  EXPECT_EQ(std::conj(h.term[i*4 + j]), h.term[j*4 + i]);
+    }
+  // the singlet has energy -3 under the Heisenberg term, which is
+  // within the bound of 1 for the triplet
+  EXPECT_GE(bond_bound(xxz), 1);
+  EXPECT_DOUBLE_EQ(-3, xxz.term[5].real() - xxz.term[6].real());
+}
+
+TEST(MeraTest,Structure) {
+  BinaryMera m{2, 2, 3, 1};
+  ASSERT_EQ(8, m.length());
+  // 4 + 2 disentanglers, as many isometries, and the top
+  EXPECT_EQ(13, m.tensors().size());
+  EXPECT_EQ(2, m.disentangler(0, 0)->output_rank());
+  EXPECT_EQ(3, m.isometry(1, 0)->input_rank());
+  EXPECT_EQ(3, m.top()->output_rank());
+
+  // every tensor is an isometry
+  for(Tensor *t : m.tensors())
+    {
+      MatrixStruct s = t->matrix();
+      const size_t rows = s.matrix->rows(), cols = s.matrix->cols();
+      for(size_t i = 0; i < rows; ++i)
+	for(size_t j = 0; j < rows; ++j)
+	  {
+	    complex<double> dot;
+	    for(size_t k = 0; k < cols; ++k)
+	      dot += s.matrix->get(i, k) * std::conj(s.matrix->get(j, k));
+	    EXPECT_NEAR(i == j ? 1 : 0, std::abs(dot), 1e-12);
+	  }
+    }
+
+  // so the state is normalized
+  for(size_t n = 0; n < m.length(); ++n)
+    {
+      DenseTensor rho = reduced_density_matrix(m.top(), { m.site(n) });
+      EXPECT_NEAR(1, (rho.data[0] + rho.data[3]).real(), 1e-12);
+    }
+}
+
+TEST(MeraTest,Sweep) {
+  BinaryMera m{2, 2, 2, 3};
+  BondHamiltonian h = ising_hamiltonian(1);
+  const double initial = energy(m, h);
+  double e = initial;
+  for(size_t s = 0; s < 10; ++s)
+    {
+      EXPECT_EQ(m.tensors().size(), sweep(m, h));
+      const double next = energy(m, h);
+      EXPECT_LE(next, e + 1e-10);
+      e = next;
+    }
+  // the ground state energy per site on 8 sites is about -1.2814
+  EXPECT_LT(e, initial - 0.1);
+  EXPECT_GT(e, -1.2815);
+}
+
+TEST(MeraTest,Checkpoint) {
+  char dir[] = "/tmp/mera_test.XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  const string path = string(dir) + "/mera";
+  BondHamiltonian h = xxz_hamiltonian(0.5);
+
+  BinaryMera a{2, 2, 3, 1}, b{2, 2, 3, 2}, c{2, 2, 2, 1};
+  sweep(a, h);
+  ASSERT_TRUE(a.save(path));
+  EXPECT_NE(energy(a, h), energy(b, h));
+  ASSERT_TRUE(b.load(path));
+  EXPECT_DOUBLE_EQ(energy(a, h), energy(b, h));
+  // a network of another shape is left untouched
+  EXPECT_FALSE(c.load(path));
+  EXPECT_FALSE(c.load(path + ".missing"));
+  ASSERT_EQ(0, system(("rm -rf " + string(dir)).c_str()));
+}
+
+TEST(MeraTest,ScaleInvariant) {
+  // take an isometry and disentangler of matching ranks from a small
+  // network
+  BinaryMera m{1, 2, 2, 5};
+  Tensor *w = m.isometry(0, 0), *u = m.disentangler(0, 0);
+  DenseTensor rho = scale_invariant_density_matrix(w, u);
+  ASSERT_EQ((vector<size_t>{2, 2, 2, 2}), rho.dims);
+
+  // a Hermitian fixed point of unit trace
+  DenseTensor next = descend(rho, w, u);
+  complex<double> trace;
+  for(size_t i = 0; i < 4; ++i) trace += rho.data[i*4 + i];
+  EXPECT_NEAR(1, trace.real(), 1e-12);
+  EXPECT_NEAR(0, trace.imag(), 1e-12);
+  for(size_t i = 0; i < 4; ++i)
+    for(size_t j = 0; j < 4; ++j)
+      {
+	EXPECT_NEAR(0, std::abs(rho.data[i*4 + j]
+				- std::conj(rho.data[j*4 + i])), 1e-8);
+	EXPECT_NEAR(0, std::abs(next.data[i*4 + j] - rho.data[i*4 + j]), 1e-8);
+      }
+
+  // descending preserves the trace of any operator
+  DenseTensor mixed{{2, 2, 2, 2}, {0, 1, 2, 3}};
+  for(size_t i = 0; i < 4; ++i) mixed.data[i*4 + i] = 0.25;
+  DenseTensor d = descend(mixed, w, u);
+  complex<double> dtrace;
+  for(size_t i = 0; i < 4; ++i) dtrace += d.data[i*4 + i];
+  EXPECT_NEAR(1, dtrace.real(), 1e-12);
+
+  // a warm start from the solution is accepted
+  DenseTensor again = scale_invariant_density_matrix(w, u, rho);
+  for(size_t i = 0; i < 16; ++i)
+    EXPECT_NEAR(0, std::abs(again.data[i] - rho.data[i]), 1e-8);
+}
@@ -28,4 +28,9 @@ public:
   MOCK_METHOD0(die, void()); // called in destructor
   MOCK_METHOD2(get, std::complex<double>(size_t i, size_t j));
   MOCK_METHOD3(set, void(size_t i, size_t j, const std::complex<double>& c));
+  MOCK_METHOD0(rows, size_t());
+  MOCK_METHOD0(cols, size_t());
+  MOCK_METHOD0(data, std::complex<double>*());
+  MOCK_METHOD0(clone, Matrix*());
+  MOCK_METHOD1(scaled_identity, bool(std::complex<double>& scale));
 };
@@ -50,6 +50,8 @@ public:
   MOCK_METHOD0(inputs, size_t());
   MOCK_METHOD0(outputs, size_t());
   MOCK_METHOD1(matrix, MatrixStruct(bool conjugate));
+  MOCK_METHOD1(set_matrix, void(std::shared_ptr<Matrix> m));
+  MOCK_METHOD0(version, uint64_t());
   MOCK_METHOD3(_set_input_self, void(size_t n, Tensor *T, size_t m));
   MOCK_METHOD3(_set_output_self, void(size_t n, Tensor *T, size_t m));
 };
@@ -0,0 +1,198 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include "../expectation.hh"
+#include "../krylov.hh"
+#include "../matrix.hh"
+#include "../mps.hh"
+#include "../tensor.hh"
+
+using std::complex;
+using std::shared_ptr;
+using std::vector;
+
+// The ground state energy of h on an open chain of n sites, by the
+// Lanczos method on the full Hamiltonian.
+static double exact_energy(const BondHamiltonian& h, size_t n)
+{
+  const size_t d = h.dim, d2 = d*d;
+  size_t size = 1;
+  for(size_t j = 0; j < n; ++j) size *= d;
+  LinearMap full = [&](const complex<double> *x, complex<double> *y)
+    {
+      std::fill(y, y + size, 0);
+      // site 0 is the most significant digit of a basis state
+      for(size_t low = size / d2; low > 0; low /= d)
+	for(size_t i = 0; i < size; ++i)
+	  {
+	    const size_t p = i / low % d2, base = i - p*low;
+	    for(size_t q = 0; q < d2; ++q)
+	      y[base + q*low] += h.term[q*d2 + p] * x[i];
+	  }
+    };
+  // start away from symmetric states, which may be eigenvectors
+  vector<complex<double>> start(size);
+  for(size_t i = 0; i < size; ++i) start[i] = std::sin(1.0 + i);
+  return lanczos(full, size, start).value.real();
+}
+
+// The energy of psi from the reduced density matrices of its bonds,
+// treating the first tensor as the top of a MERA.  This holds for a
+// normalized right-canonical state.
+static double bond_energy(MatrixProductState& psi, const BondHamiltonian& h)
+{
+  Tensor *op = bond_operator(h);
+  vector<LocalOperator> ops;
+  for(size_t j = 0; j + 1 < psi.length(); ++j)
+    ops.push_back(LocalOperator{op, {psi.site(j), psi.site(j + 1)}});
+  double e = 0;
+  for(const complex<double> &x : expectation(psi.tensor(0), ops))
+    e += x.real();
+  delete op;
+  return e;
+}
+
+TEST(MpsTest,Structure) {
+  MatrixProductState psi{6, 2, 2, 1};
+  const vector<size_t> bonds{2, 4, 4, 4, 2};
+  for(size_t j = 0; j < bonds.size(); ++j)
+    EXPECT_EQ(bonds[j], psi.bond(j));
+  EXPECT_EQ(0u, psi.tensor(0)->inputs());
+  EXPECT_EQ(2u, psi.tensor(0)->outputs());
+  EXPECT_EQ(2u, psi.tensor(2)->inputs());
+  EXPECT_EQ(3u, psi.tensor(2)->outputs());
+  EXPECT_EQ(1u, psi.tensor(5)->inputs());
+  EXPECT_EQ(1u, psi.tensor(5)->outputs());
+  EXPECT_EQ(psi.tensor(2), psi.tensor(3)->input_tensor(1));
+  EXPECT_EQ(2u, psi.tensor(3)->input_num(1));
+
+  // every tensor is right-canonical
+  for(Tensor *t : psi.tensors())
+    {
+      MatrixStruct s = t->matrix();
+      const size_t rows = s.matrix->rows(), cols = s.matrix->cols();
+      const complex<double> *a = s.matrix->data();
+      for(size_t i = 0; i < rows; ++i)
+	for(size_t k = 0; k < rows; ++k)
+	  {
+	    complex<double> x;
+	    for(size_t j = 0; j < cols; ++j)
+	      x += a[i*cols + j] * std::conj(a[k*cols + j]);
+	    EXPECT_NEAR(i == k ? 1 : 0, std::abs(x), 1e-12);
+	  }
+    }
+}
+
+TEST(MpsTest,Operator) {
+  BondHamiltonian ising = ising_hamiltonian(0.7), xxz = xxz_hamiltonian(0.5);
+  for(const BondHamiltonian &h : { ising, xxz })
+    {
+      // three terms, carried by three legs of rank 2
+      MatrixProductOperator w{h, 5};
+      EXPECT_EQ(5u, w.bond());
+      EXPECT_EQ(4u, w.tensor(2)->inputs());
+      EXPECT_EQ(w.tensor(1), w.tensor(2)->input_tensor(3));
+
+      // on two sites, the product of the end tensors is the bond term
+      MatrixProductOperator pair{h, 2};
+      MatrixStruct a = pair.tensor(0)->matrix(), b = pair.tensor(1)->matrix();
+      const size_t legs = b.matrix->rows() / 2;
+      for(size_t s1 = 0; s1 < 2; ++s1)
+	for(size_t s2 = 0; s2 < 2; ++s2)
+	  for(size_t t1 = 0; t1 < 2; ++t1)
+	    for(size_t t2 = 0; t2 < 2; ++t2)
+	      {
+		complex<double> x;
+		for(size_t k = 0; k < legs; ++k)
+		  x += a.matrix->get(s1, t1*legs + k)
+		    * b.matrix->get(s2*legs + k, t2);
+		const complex<double> y = h.term[(s1*2 + s2)*4 + t1*2 + t2];
+		EXPECT_NEAR(0, std::abs(x - y), 1e-12);
+	      }
+    }
+}
+
+TEST(MpsTest,Energy) {
+  // the sandwich kernels agree with the expectation values of the
+  // general contraction engine
+  BondHamiltonian h = ising_hamiltonian(0.7);
+  MatrixProductState psi{8, 2, 2, 3};
+  MatrixProductOperator w{h, 8};
+  EXPECT_NEAR(bond_energy(psi, h), energy(psi, w), 1e-10);
+}
+
+TEST(MpsTest,Ground) {
+  BondHamiltonian h = ising_hamiltonian(1);
+  // four legs hold every state of eight sites, so DMRG is exact
+  MatrixProductState psi{8, 2, 4, 5};
+  MatrixProductOperator w{h, 8};
+  Dmrg dmrg{psi, w};
+  double e = dmrg.energy();
+  for(size_t s = 0; s < 4; ++s)
+    {
+      const double next = dmrg.sweep();
+      EXPECT_LE(next, e + 1e-10);
+      e = next;
+    }
+  EXPECT_NEAR(exact_energy(h, 8), e, 1e-8);
+  EXPECT_NEAR(e, dmrg.energy(), 1e-8);
+  EXPECT_LT(dmrg.truncation(), 1e-10);
+  // the sweep leaves the state right-canonical
+  EXPECT_NEAR(e, bond_energy(psi, h), 1e-8);
+}
+
+TEST(MpsTest,Truncation) {
+  BondHamiltonian h = xxz_hamiltonian(1);
+  MatrixProductState psi{10, 2, 1, 7};
+  MatrixProductOperator w{h, 10};
+  Dmrg dmrg{psi, w};
+  const double initial = dmrg.energy();
+  double e = initial;
+  for(size_t s = 0; s < 3; ++s)
+    e = dmrg.sweep();
+  // bonds of dimension 2 cannot hold the ground state
+  EXPECT_GT(dmrg.truncation(), 0);
+  EXPECT_LT(e, initial - 1);
+  EXPECT_GT(dmrg.energy(), exact_energy(h, 10) - 1e-10);
+}
+
+TEST(MpsTest,Environments) {
+  MatrixProductState psi{6, 2, 2, 2};
+  MatrixProductOperator w{ising_hamiltonian(1), 6};
+  Dmrg dmrg{psi, w};
+  const double e = dmrg.energy();
+  EXPECT_EQ(6u, dmrg.environments());
+  EXPECT_EQ(e, dmrg.energy());
+  EXPECT_EQ(6u, dmrg.environments());
+
+  // replacing the tensor of site 4 invalidates only the environments
+  // which include it
+  Tensor *t = psi.tensor(4);
+  t->set_matrix(shared_ptr<Matrix>(t->matrix().matrix->clone()));
+  EXPECT_DOUBLE_EQ(e, dmrg.energy());
+  EXPECT_EQ(8u, dmrg.environments());
+}
+
+TEST(MpsDeathTest,Mismatch) {
+  MatrixProductState psi{4, 2, 2};
+  MatrixProductOperator w{ising_hamiltonian(1), 5};
+  EXPECT_DEATH(Dmrg(psi, w), "");
+}
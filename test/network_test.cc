@@ -0,0 +1,171 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+#include "../graph.hh"
+#include "../mera.hh"
+#include "../network.hh"
+#include "../plan_cache.hh"
+#include "../tensor.hh"
+
+using std::vector;
+
+TEST(NetworkTest, Links)
+{
+  Network net;
+  ConcreteTensor a(net, 0, 2, 0, 2), b(net, 1, 1, 2), c(net, 2, 0, 2, 0);
+  ConcreteTensor outside(1, 0, 2, 0);
+  EXPECT_EQ(3u, net.size());
+  EXPECT_EQ(0u, a.id());
+  EXPECT_EQ(2u, c.id());
+  EXPECT_EQ(&net, b.network());
+  EXPECT_EQ(&b, net.tensor(1));
+  EXPECT_EQ(1u, net.inputs(1));
+  EXPECT_EQ(2u, net.inputs(2));
+
+  a.set_output(0, &b, 0);
+  b.set_output(0, &c, 1);
+  a.set_output(1, &outside, 0);
+  EXPECT_EQ(&c, net.output_tensor(1, 0));
+  EXPECT_EQ(1u, net.output_num(1, 0));
+  EXPECT_EQ(2u, net.output_id(1, 0));
+  EXPECT_EQ(1u, net.input_id(2, 1));
+  EXPECT_EQ(0u, net.input_id(1, 0));
+  EXPECT_EQ(kNoTensor, net.input_id(2, 0));
+  // a link leaving the network keeps its tensor but has no id
+  EXPECT_EQ(&outside, net.output_tensor(0, 1));
+  EXPECT_EQ(kNoTensor, net.output_id(0, 1));
+  EXPECT_EQ(&a, outside.input_tensor(0));
+  // a tensor made without a network keeps its links itself
+  EXPECT_EQ(nullptr, outside.network());
+  EXPECT_EQ(kNoTensor, outside.id());
+  EXPECT_EQ(1u, outside.input_num(0));
+
+  EXPECT_EQ((vector<size_t>{1, 0, 2}), net.component(1));
+
+  {
+    ConcreteTensor d(net, 0, 1, 0, 2);
+    c.set_input(0, &d, 0);
+    EXPECT_EQ(3u, net.input_id(2, 0));
+  }
+  // destroying d unlinks it and retires its id
+  EXPECT_EQ(4u, net.size());
+  EXPECT_EQ(nullptr, net.tensor(3));
+  EXPECT_EQ(nullptr, c.input_tensor(0));
+  EXPECT_EQ(kNoTensor, net.input_id(2, 0));
+}
+
+TEST(NetworkTest, Topology)
+{
+  // the same tree as a standalone graph and as a network
+  Network net;
+  vector<ConcreteTensor*> t{new ConcreteTensor(net, 0, 2, 0, 2)};
+  for(size_t i = 1; i < 4; ++i)
+    t.push_back(new ConcreteTensor(net, 1, 2, 2));
+  t[0]->set_output(0, t[1], 0);
+  t[0]->set_output(1, t[2], 0);
+  t[1]->set_output(1, t[3], 0);
+
+  DFSGraph g{t[0]};
+  Topology a = topology(g), b = topology(net);
+  EXPECT_EQ(a.encoding, b.encoding);
+  EXPECT_EQ(a.fingerprint, b.fingerprint);
+  EXPECT_EQ(a.vertices, b.vertices);
+  for(Tensor *x : t) delete x;
+}
+
+TEST(NetworkTest, Build)
+{
+  ConcreteTensor outside(1, 0, 2, 0);
+  {
+    Network net;
+    ConcreteTensor *a = net.create(0, 2, 0, 2);
+    EXPECT_EQ(1u, net.build({NetworkShape{1, 1, 2, 2},
+	    NetworkShape{2, 0, 2, 0}}, {NetworkEdge{1, 0, 0, 0},
+		NetworkEdge{2, 1, 1, 0}, NetworkEdge{2, 0, 0, 1}}));
+    EXPECT_EQ(3u, net.size());
+    Tensor *b = net.tensor(1), *c = net.tensor(2);
+    EXPECT_EQ(b, a->output_tensor(0));
+    EXPECT_EQ(a, b->input_tensor(0));
+    EXPECT_EQ(1u, c->input_num(0));
+    EXPECT_EQ(b, c->input_tensor(1));
+    EXPECT_EQ(2u, net.output_id(1, 0));
+    EXPECT_EQ(1u, net.input_id(2, 1));
+
+    // relinking a linked leg unlinks its old partner
+    net.link({NetworkEdge{1, 0, 0, 1}});
+    EXPECT_EQ(b, a->output_tensor(1));
+    EXPECT_EQ(nullptr, c->input_tensor(0));
+    EXPECT_EQ(nullptr, a->output_tensor(0));
+
+    b->set_output(0, &outside, 0);
+    EXPECT_EQ(b, outside.input_tensor(0));
+  }
+  // tearing down the network undoes links leaving it
+  EXPECT_EQ(nullptr, outside.input_tensor(0));
+}
+
+TEST(NetworkTest, Mera)
+{
+  Network net;
+  size_t top = net.mera(16, 3, 2, 2);
+  EXPECT_EQ(0u, top);
+  EXPECT_EQ(29u, net.size());
+  EXPECT_EQ(29u, net.component(top).size());
+
+  // the template is linked as BinaryMera
+  BinaryMera m(3, 2, 2);
+  DFSGraph g{m.top()};
+  EXPECT_EQ(topology(g).encoding, topology(net).encoding);
+
+  // a ternary MERA: isometries of the middle sites skip disentanglers
+  Network ternary;
+  ternary.mera(27, 2, 3, 2);
+  EXPECT_EQ(1u + 3 + 3 + 9 + 9, ternary.size());
+  EXPECT_EQ(3u, ternary.outputs(0));
+  // isometry 0 of the first layer (id 1) feeds disentanglers 2 and 0
+  // (ids 6 and 4) and passes its middle site straight to isometry 1 of
+  // the next layer (id 8)
+  EXPECT_EQ(6u, ternary.output_id(1, 0));
+  EXPECT_EQ(8u, ternary.output_id(1, 1));
+  EXPECT_EQ(4u, ternary.output_id(1, 2));
+}
+
+TEST(NetworkTest, Chains)
+{
+  // bonds of 1, 2, 2 and 1 legs between five sites
+  Network net;
+  size_t first = net.mps(5, 2, 3);
+  EXPECT_EQ(0u, first);
+  EXPECT_EQ(5u, net.size());
+  EXPECT_EQ(5u, net.component(first).size());
+  EXPECT_EQ(3u, net.outputs(1));
+  EXPECT_EQ(2u, net.inputs(2));
+  EXPECT_EQ(1u, net.outputs(4));
+  EXPECT_EQ(2u, net.input_id(3, 1));
+  EXPECT_EQ(2u, net.input_num(3, 1));
+  EXPECT_EQ(kNoTensor, net.output_id(2, 0));
+
+  // an operator beside it, sharing no links
+  size_t op = net.mpo(5, 2, 3);
+  EXPECT_EQ(5u, op);
+  EXPECT_EQ(5u, net.component(op).size());
+  EXPECT_EQ(1u, net.inputs(op));
+  EXPECT_EQ(3u, net.inputs(op + 1));
+  EXPECT_EQ(op + 1, net.output_id(op, 2));
+  EXPECT_EQ(kNoTensor, net.input_id(op + 1, 0));
+}
@@ -0,0 +1,130 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../graph.hh"
+#include "../network.hh"
+#include "../partition.hh"
+#include "../plan.hh"
+#include "utils_test.hh"
+
+using std::complex;
+using std::vector;
+
+// A tensor with the given legs and distinct, deterministic entries.
+static DenseTensor filled(const vector<size_t>& dims,
+			  const vector<size_t>& labels)
+{
+  DenseTensor ret{dims, labels};
+  for(size_t i = 0; i < ret.data.size(); ++i)
+    ret.data[i] = complex<double>{std::sin(1.0 + i + labels[0]),
+				  0.5 * std::cos(2.0*i)};
+  return ret;
+}
+
+class PartitionTest : public ::testing::Test {
+protected:
+  // Two rings of four tensors with bonds of dimension 4, labelled 0-3
+  // and 10-13, joined by a single bond 100 of dimension 2.
+  virtual void SetUp()
+  {
+    for(size_t r = 0; r < 2; ++r)
+      for(size_t i = 0; i < 4; ++i)
+	{
+	  vector<size_t> dims{4, 4}, labels{10*r + i, 10*r + (i + 1) % 4};
+	  if(0 == i)
+	    {
+	      dims.push_back(2);
+	      labels.push_back(100);
+	    }
+	  tensors.push_back(filled(dims, labels));
+	}
+    for(const DenseTensor &t : tensors) operands.push_back(t.view());
+  }
+
+  vector<DenseTensor> tensors;
+  vector<TensorView> operands;
+};
+
+TEST_F(PartitionTest,Rings) {
+  Partition p = partition(operands, 2);
+  ASSERT_EQ(8, p.part.size());
+  for(size_t i = 1; i < 4; ++i)
+    {
+      EXPECT_EQ(p.part[0], p.part[i]);
+      EXPECT_EQ(p.part[4], p.part[4 + i]);
+    }
+  EXPECT_NE(p.part[0], p.part[4]);
+
+  EXPECT_EQ((vector<size_t>{100}), p.cut);
+  EXPECT_DOUBLE_EQ(1, p.cut_cost);
+  EXPECT_EQ((vector<double>{2, 2}), p.volume);
+  EXPECT_DOUBLE_EQ(2, p.communication);
+}
+
+// Contracting the parts separately gives the same result.
+TEST_F(PartitionTest,Execute) {
+  DenseTensor expected = execute(greedy_plan(operands), operands);
+  for(size_t parts : {1, 2, 3})
+    {
+      DenseTensor c = execute_partitioned(partition(operands, parts),
+					  operands);
+      ASSERT_EQ(1, c.data.size());
+      EXPECT_NEAR(0, std::abs(expected.data[0] - c.data[0]),
+		  1e-12 * std::abs(expected.data[0]));
+    }
+}
+
+// A chain divides into contiguous, balanced runs with one cut bond
+// between each.
+TEST(PartitionChainTest,Balance) {
+  vector<DenseTensor> tensors;
+  vector<TensorView> operands;
+  for(size_t i = 0; i < 64; ++i) tensors.push_back(filled({2, 2}, {i, i + 1}));
+  for(const DenseTensor &t : tensors) operands.push_back(t.view());
+
+  Partition p = partition(operands, 4);
+  EXPECT_EQ(3, p.cut.size());
+  vector<size_t> count(4, 0);
+  for(size_t i = 0; i < 64; ++i)
+    {
+      ++count[p.part[i]];
+      if(i > 0 && p.part[i] != p.part[i - 1])
+	{
+	  EXPECT_TRUE(std::count(p.cut.begin(), p.cut.end(), i)) << i;
+	}
+    }
+  for(size_t c : count)
+    EXPECT_LE(c, 16 * (1 + kPartitionImbalance));
+}
+
+// Partitioning a graph uses the bond dimensions of its tensors.
+TEST(PartitionGraphTest,Mera) {
+  Network net;
+  const size_t top = net.mera(16, 2, 2, 2);
+  DFSGraph g{net.tensor(top)};
+
+  Partition p = partition(g, 2);
+  ASSERT_EQ(g.vertices(), p.part.size());
+  EXPECT_FALSE(p.cut.empty());
+  EXPECT_DOUBLE_EQ(p.cut.size(), p.cut_cost);
+  EXPECT_NE(0, p.volume[0]);
+  EXPECT_NE(0, p.volume[1]);
+}
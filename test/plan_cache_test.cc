@@ -0,0 +1,223 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdlib>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include "../graph.hh"
+#include "../matrix.hh"
+#include "../plan_cache.hh"
+#include "../tensor.hh"
+
+using std::complex;
+using std::string;
+using std::vector;
+
+class PlanCacheTest : public ::testing::Test {
+protected:
+  virtual void SetUp()
+  {
+    char dir[] = "/tmp/plan_cache_test.XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    directory = dir;
+  }
+
+  virtual void TearDown()
+  {
+    for(Tensor *t : tensors) delete t;
+    ASSERT_EQ(0, system(("rm -rf " + directory).c_str()));
+  }
+
+  // Build a binary tree of depth 2 beneath a top tensor.  The tensors
+  // are allocated in a different order when reversed is set, so that
+  // their addresses differ between otherwise identical networks.
+  Tensor* tree(bool reversed)
+  {
+    vector<Tensor*> t(4);
+    for(size_t i = 0; i < 4; ++i)
+      {
+	size_t j = reversed ? 3 - i : i;
+	t[j] = 0 == j ? new ConcreteTensor(0, 2, 0, 2)
+	  : new ConcreteTensor(1, 2, 2);
+	tensors.push_back(t[j]);
+      }
+    t[0]->set_output(0, t[1], 0);
+    t[0]->set_output(1, t[2], 0);
+    t[1]->set_output(1, t[3], 0);
+    return t[0];
+  }
+
+  // Give the tensors of t entries depending on their canonical
+  // positions and on phase.
+  void fill(const Topology& t, double phase)
+  {
+    for(size_t v = 0; v < t.vertices.size(); ++v)
+      {
+	MatrixStruct m = t.vertices[v]->matrix();
+	std::shared_ptr<Matrix> s = std::make_shared<GSLMatrix>
+	  (m.matrix->rows(), m.matrix->cols());
+	for(size_t i = 0; i < s->rows() * s->cols(); ++i)
+	  s->data()[i] = complex<double>{std::sin(phase + v + 0.3*i),
+					 std::cos(v - 0.7*i)};
+	t.vertices[v]->set_matrix(s);
+      }
+  }
+
+  string directory;
+  vector<Tensor*> tensors;
+};
+
+TEST_F(PlanCacheTest,Fingerprint) {
+  DFSGraph g1{tree(false)}, g2{tree(true)};
+  Topology t1 = topology(g1), t2 = topology(g2);
+  EXPECT_EQ(t1.fingerprint, t2.fingerprint);
+  EXPECT_EQ(t1.encoding, t2.encoding);
+
+  // attaching another tensor changes the topology
+  Tensor *t = tree(false), *extra = new ConcreteTensor(1, 1, 2);
+  tensors.push_back(extra);
+  t->output_tensor(0)->set_output(0, extra, 0);
+  DFSGraph g3{t};
+  EXPECT_NE(t1.fingerprint, topology(g3).fingerprint);
+}
+
+TEST_F(PlanCacheTest,Operands) {
+  DFSGraph g{tree(false)};
+  Topology t = topology(g);
+  vector<TensorView> operands = topology_operands(t);
+  ASSERT_EQ(4, operands.size());
+  // each of the 3 edges is labelled once, and each of the 5 unlinked
+  // legs has a label of its own
+  std::map<size_t, size_t> uses;
+  for(const TensorView &v : operands)
+    for(size_t l : v.labels) ++uses[l];
+  EXPECT_EQ(8, uses.size());
+  size_t shared = 0;
+  for(const auto &u : uses) shared += 2 == u.second;
+  EXPECT_EQ(3, shared);
+}
+
+TEST_F(PlanCacheTest,Persistence) {
+  DFSGraph g1{tree(false)}, g2{tree(true)};
+  Topology t1 = topology(g1), t2 = topology(g2);
+  ContractionPlan p1, p2;
+  {
+    PlanCache cache{directory};
+    p1 = cache.plan(t1, topology_operands(t1));
+    cache.plan(t1, topology_operands(t1));
+    EXPECT_EQ(1, cache.misses());
+    EXPECT_EQ(1, cache.hits());
+  }
+
+  // a new cache finds the plan on disk
+  PlanCache cache{directory};
+  p2 = cache.plan(t2, topology_operands(t2));
+  EXPECT_EQ(0, cache.misses());
+  EXPECT_EQ(1, cache.hits());
+  ASSERT_EQ(p1.steps.size(), p2.steps.size());
+  for(size_t i = 0; i < p1.steps.size(); ++i)
+    {
+      EXPECT_EQ(p1.steps[i].first, p2.steps[i].first);
+      EXPECT_EQ(p1.steps[i].second, p2.steps[i].second);
+    }
+  EXPECT_DOUBLE_EQ(p1.flops, p2.flops);
+}
+
+TEST_F(PlanCacheTest,CorruptFile) {
+  DFSGraph g{tree(false)};
+  Topology t = topology(g);
+  {
+    PlanCache cache{directory};
+    cache.plan(t, topology_operands(t));
+  }
+  // overwrite every plan file with garbage
+  ASSERT_EQ(0, system(("for f in " + directory + "/*.plan; do "
+		       "echo garbage > $f; done").c_str()));
+  PlanCache cache{directory};
+  ContractionPlan p = cache.plan(t, topology_operands(t));
+  EXPECT_EQ(1, cache.misses());
+  EXPECT_EQ(3, p.steps.size());
+}
+
+TEST_F(PlanCacheTest,Results) {
+  DFSGraph g1{tree(false)}, g2{tree(true)};
+  Topology t1 = topology(g1), t2 = topology(g2);
+  fill(t1, 0);
+  fill(t2, 0);
+  EXPECT_EQ(content_hashes(t1), content_hashes(t2));
+  const vector<TensorView> operands = topology_operands(t1);
+  const DenseTensor expected = execute(greedy_plan(operands), operands);
+
+  {
+    ResultCache cache{directory};
+    TensorView r = cache.contract(t1);
+    EXPECT_EQ(r.data, cache.contract(t1).data);
+    EXPECT_EQ(1, cache.misses());
+    EXPECT_EQ(1, cache.hits());
+    EXPECT_EQ(expected.labels, r.labels);
+    EXPECT_EQ(expected.data, to_dense(r).data);
+  }
+
+  // A new cache maps the stored result for the other copy of the
+  // network, but recomputes once an entry changes.
+  ResultCache cache{directory};
+  TensorView r = cache.contract(t2);
+  EXPECT_EQ(0, cache.misses());
+  EXPECT_EQ(expected.dims, r.dims);
+  EXPECT_EQ(expected.data, to_dense(r).data);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(r.data) % 64);
+  fill(t2, 1);
+  EXPECT_NE(content_hashes(t1), content_hashes(t2));
+  TensorView s = cache.contract(t2);
+  EXPECT_EQ(1, cache.misses());
+  EXPECT_NE(expected.data, to_dense(s).data);
+  EXPECT_EQ(expected.data, to_dense(r).data);
+
+  // corrupt files are ignored
+  ASSERT_EQ(0, system(("for f in " + directory + "/*.result; do "
+		       "echo garbage > $f; done").c_str()));
+  ResultCache fresh{directory};
+  EXPECT_EQ(expected.data, to_dense(fresh.contract(t1)).data);
+  EXPECT_EQ(1, fresh.misses());
+}
+
+TEST_F(PlanCacheTest,ResultCapacity) {
+  DFSGraph g1{tree(false)}, g2{tree(true)};
+  Topology t1 = topology(g1), t2 = topology(g2);
+  fill(t1, 0);
+  fill(t2, 1);
+  const vector<TensorView> operands = topology_operands(t1);
+  const DenseTensor expected = execute(greedy_plan(operands), operands);
+
+  // With no capacity only the result just returned is held, so others
+  // are found on disk, or recomputed once their files are gone.
+  ResultCache cache{directory, nullptr, 0};
+  cache.contract(t1);
+  cache.contract(t2);
+  EXPECT_EQ(2, cache.misses());
+  EXPECT_EQ(expected.data, to_dense(cache.contract(t1)).data);
+  EXPECT_EQ(2, cache.misses());
+  EXPECT_EQ(1, cache.hits());
+  ASSERT_EQ(0, system(("rm -f " + directory + "/*.result").c_str()));
+  EXPECT_EQ(expected.data, to_dense(cache.contract(t1)).data);
+  EXPECT_EQ(2, cache.hits());
+  cache.contract(t2);
+  EXPECT_EQ(3, cache.misses());
+}
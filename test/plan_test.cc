@@ -0,0 +1,211 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../plan.hh"
+#include "../tensor.hh"
+#include "utils_test.hh"
+
+using std::complex;
+using std::vector;
+
+class PlanTest : public ::testing::Test {
+protected:
+  // A chain of matrices with a large middle bond: a(0,1) b(1,2) c(2,3)
+  // plus a disconnected vector d(4).
+  virtual void SetUp()
+  {
+    a = new ConcreteTensor(1, 1, 2, 5);
+    b = new ConcreteTensor(1, 1, 5, 5);
+    c = new ConcreteTensor(1, 1, 5, 2);
+    d = new ConcreteTensor(0, 1, 0, 3);
+    for(size_t i = 0; i < 5; ++i)
+      for(size_t j = 0; j < 5; ++j)
+	{
+	  if(i < 2) a->set_entry( {i}, {j}, complex<double>(i + 1.0, j) );
+	  if(j < 2) c->set_entry( {i}, {j}, complex<double>(j - 1.0*i, 1) );
+	  b->set_entry( {i}, {j}, complex<double>(0.5*i*j, 1.0*i - j) );
+	}
+    for(size_t i = 0; i < 3; ++i)
+      d->set_entry( {}, {i}, complex<double>(i, 2) );
+    operands = { tensor_view(a, {0}, {1}), tensor_view(b, {1}, {2}),
+		 tensor_view(c, {2}, {3}), tensor_view(d, {}, {4}) };
+  }
+
+  virtual void TearDown()
+  {
+    delete a;
+    delete b;
+    delete c;
+    delete d;
+  }
+
+  Tensor *a;
+  Tensor *b;
+  Tensor *c;
+  Tensor *d;
+  vector<TensorView> operands;
+};
+typedef PlanTest PlanDeathTest;
+
+TEST_F(PlanTest,GreedyPlan) {
+  ContractionPlan plan = greedy_plan(operands);
+  ASSERT_EQ(3, plan.steps.size());
+  // the final step takes the outer product with the disconnected vector
+  EXPECT_EQ(8, plan.steps[2].first + plan.steps[2].second);
+  EXPECT_GT(plan.flops, 0);
+  EXPECT_EQ(12, plan.peak);
+}
+
+TEST_F(PlanTest,Execute) {
+  DenseTensor r = execute(greedy_plan(operands), operands);
+  DenseTensor p = r.permuted( {0,3,4} );
+  for(size_t i = 0; i < 2; ++i)
+    for(size_t l = 0; l < 2; ++l)
+      for(size_t m = 0; m < 3; ++m)
+	{
+	  complex<double> sum;
+	  for(size_t j = 0; j < 5; ++j)
+	    for(size_t k = 0; k < 5; ++k)
+	      sum += a->entry( {i}, {j} ) * b->entry( {j}, {k} )
+		* c->entry( {k}, {l} );
+	  sum *= d->entry( {}, {m} );
+	  TN_EXPECT_COMPLEX_EQ(sum, p.data[(i*2 + l)*3 + m]);
+	}
+}
+
+TEST_F(PlanTest,TreePlan) {
+  ContractionPlan plan = tree_plan(operands);
+  ASSERT_EQ(3, plan.steps.size());
+  EXPECT_EQ(8, plan.steps[2].first + plan.steps[2].second);
+  EXPECT_EQ(12, plan.peak);
+  EXPECT_DOUBLE_EQ(std::log2(12.0), contraction_width(plan));
+
+  DenseTensor r = execute(plan, operands).permuted( {0,3,4} );
+  DenseTensor g = execute(greedy_plan(operands), operands)
+    .permuted( {0,3,4} );
+  for(size_t i = 0; i < r.data.size(); ++i)
+    TN_EXPECT_COMPLEX_EQ(g.data[i], r.data[i]);
+}
+
+// A closed square grid of side n with bonds of dimension 2.  The
+// bonds to the right of and below tensor (i, j) are labelled 2(in + j)
+// and 2(in + j) + 1.
+static vector<DenseTensor> grid(size_t n)
+{
+  vector<DenseTensor> ret;
+  for(size_t i = 0; i < n; ++i)
+    for(size_t j = 0; j < n; ++j)
+      {
+	vector<size_t> labels;
+	if(j + 1 < n) labels.push_back(2*(i*n + j));
+	if(j > 0) labels.push_back(2*(i*n + j - 1));
+	if(i + 1 < n) labels.push_back(2*(i*n + j) + 1);
+	if(i > 0) labels.push_back(2*((i - 1)*n + j) + 1);
+	ret.emplace_back(vector<size_t>(labels.size(), 2), labels);
+	for(size_t k = 0; k < ret.back().data.size(); ++k)
+	  ret.back().data[k] = complex<double>{std::cos(1.0 + k + 3*i),
+					       0.25 * std::sin(k + 2.0*j)};
+      }
+  return ret;
+}
+
+TEST(PlanGridTest,TreePlan) {
+  // An order sweeping the grid needs intermediates of only 2^8
+  // entries, which the greedy order exceeds.
+  vector<DenseTensor> tensors = grid(8);
+  vector<TensorView> operands;
+  for(const DenseTensor &t : tensors) operands.push_back(t.view());
+  const double greedy = contraction_width(greedy_plan(operands));
+  for(EliminationHeuristic h : {ELIMINATE_MIN_FILL, ELIMINATE_MIN_DEGREE})
+    {
+      ContractionPlan plan = tree_plan(operands, h);
+      EXPECT_EQ(operands.size() - 1, plan.steps.size());
+      EXPECT_LE(contraction_width(plan), 8);
+      EXPECT_LT(contraction_width(plan), greedy);
+      // refinement never gives a wider plan
+      ContractionPlan refined = tree_plan(operands, h, 0.05);
+      EXPECT_LE(refined.peak, plan.peak);
+    }
+
+  tensors = grid(3);
+  operands.clear();
+  for(const DenseTensor &t : tensors) operands.push_back(t.view());
+  DenseTensor r = execute(tree_plan(operands), operands);
+  DenseTensor g = execute(greedy_plan(operands), operands);
+  ASSERT_EQ(1, r.data.size());
+  TN_EXPECT_COMPLEX_EQ(g.data[0], r.data[0]);
+}
+
+TEST_F(PlanTest,SliceIdentity) {
+  // an identity in place of b, whose lazy view must be densified to be
+  // sliced
+  ConcreteTensor e(1, 1, 5, 5);
+  operands[1] = tensor_view(&e, {1}, {2});
+  ASSERT_TRUE(operands[1].identity);
+  ContractionPlan plan = greedy_plan(operands);
+  SlicedPlan sliced = slice_plan(operands, plan, 6);
+  ASSERT_EQ(1, sliced.sliced.size());
+  EXPECT_EQ(5, sliced.slices);
+  // the open legs of the result cannot be sliced
+  EXPECT_EQ(12, sliced.peak);
+
+  DenseTensor r = execute(sliced, operands, 2).permuted( {0,3,4} );
+  DenseTensor g = execute(plan, operands).permuted( {0,3,4} );
+  for(size_t i = 0; i < r.data.size(); ++i)
+    TN_EXPECT_COMPLEX_EQ(g.data[i], r.data[i]);
+}
+
+TEST(PlanGridTest,Slice) {
+  vector<DenseTensor> tensors = grid(4);
+  vector<TensorView> operands;
+  for(const DenseTensor &t : tensors) operands.push_back(t.view());
+  ContractionPlan plan = tree_plan(operands);
+  ASSERT_GT(plan.peak, 4);
+
+  SlicedPlan sliced = slice_plan(operands, plan, plan.peak / 4);
+  EXPECT_LE(sliced.peak, plan.peak / 4);
+  EXPECT_GE(sliced.slices, 4);
+  EXPECT_GE(sliced.flops, plan.flops);
+  EXPECT_EQ(plan.steps.size(), sliced.plan.steps.size());
+
+  // a plan within the memory is not sliced
+  SlicedPlan whole = slice_plan(operands, plan, plan.peak);
+  EXPECT_TRUE(whole.sliced.empty());
+  EXPECT_EQ(1, whole.slices);
+
+  const DenseTensor expected = execute(plan, operands);
+  for(size_t threads : {1, 3})
+    {
+      DenseTensor r = execute(sliced, operands, threads);
+      ASSERT_EQ(1, r.data.size());
+      TN_EXPECT_COMPLEX_EQ(expected.data[0], r.data[0]);
+    }
+}
+
+TEST_F(PlanDeathTest,Invalid) {
+  // a label may join at most two operands
+  operands.push_back(tensor_view(d, {}, {2}));
+  EXPECT_DEATH(greedy_plan(operands), "");
+  EXPECT_DEATH(tree_plan(operands), "");
+  // steps must refer to existing, unused operands
+  operands.pop_back();
+  ContractionPlan plan{ { {0,1}, {0,2}, {3,4} }, 0, 0 };
+  EXPECT_DEATH(execute(plan, operands), "");
+}
@@ -0,0 +1,164 @@
+// Copyright 2013 Jacob Emmert-Aronson
+// This file is part of Tensor Network.
+//
+// Tensor Network is free software: you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// Tensor Network is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Tensor Network.  If not, see
+// <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <memory>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "../matrix.hh"
+#include "../reduce.hh"
+#include "../tensor.hh"
+#include "utils_test.hh"
+
+using std::complex;
+using std::make_shared;
+
+class ReduceTest : public ::testing::Test {
+protected:
+  // a has 2 inputs and 1 output of rank 3, and b the same shape.
+  virtual void SetUp()
+  {
+    a = new ConcreteTensor(2, 1, 3);
+    b = new ConcreteTensor(2, 1, 3);
+    for(size_t i = 0; i < 3; ++i)
+      for(size_t j = 0; j < 3; ++j)
+	for(size_t k = 0; k < 3; ++k)
+	  {
+	    a->set_entry( {i,j}, {k}, complex<double>(i + 0.5*j, k - 1.0*j) );
+	    b->set_entry( {i,j}, {k}, complex<double>(1.0*k - i, 0.25*j) );
+	  }
+  }
+
+  virtual void TearDown()
+  {
+    delete a;
+    delete b;
+  }
+
+  // Reference inner product, entry by entry.
+  complex<double> expected_overlap(Tensor *x, Tensor *y)
+  {
+    complex<double> sum;
+    for(size_t i = 0; i < 3; ++i)
+      for(size_t j = 0; j < 3; ++j)
+	for(size_t k = 0; k < 3; ++k)
+	  sum += std::conj(x->entry( {i,j}, {k} )) * y->entry( {i,j}, {k} );
+    return sum;
+  }
+
+  Tensor *a;
+  Tensor *b;
+};
+typedef ReduceTest ReduceDeathTest;
+
+TEST_F(ReduceTest,Norms) {
+  double sum = 0, largest = 0;
+  for(size_t i = 0; i < 3; ++i)
+    for(size_t j = 0; j < 3; ++j)
+      for(size_t k = 0; k < 3; ++k)
+	{
+	  sum += std::norm(a->entry( {i,j}, {k} ));
+	  largest = std::max(largest, std::abs(a->entry( {i,j}, {k} )));
+	}
+  EXPECT_DOUBLE_EQ(std::sqrt(sum), frobenius_norm(a));
+  EXPECT_DOUBLE_EQ(largest, max_abs(a));
+
+  // an implicit identity is not read
+  Tensor *id = new ConcreteTensor(2, 2, 3);
+  EXPECT_DOUBLE_EQ(3, frobenius_norm(id));
+  EXPECT_DOUBLE_EQ(1, max_abs(id));
+  complex<double> scale;
+  EXPECT_TRUE(id->matrix().matrix->scaled_identity(scale));
+  delete id;
+}
+
+TEST_F(ReduceTest,Trace) {
+  Tensor *t = new ConcreteTensor(2, 2, 2);
+  t->set_entry( {0,1}, {0,1}, complex<double>(2, 3) );
+  t->set_entry( {1,0}, {0,1}, 7 );
+  TN_EXPECT_COMPLEX_EQ(complex<double>(5, 3), trace(t));
+  // the trace of the Hermitian conjugate is the conjugate
+  Tensor *c = new ConcreteTensor{t->matrix(true)};
+  TN_EXPECT_COMPLEX_EQ(complex<double>(5, -3), trace(c));
+  delete c;
+  delete t;
+}
+
+TEST_F(ReduceDeathTest,Trace) {
+  EXPECT_DEATH(trace(a), "");
+  Tensor *c = new ConcreteTensor(1, 2, 3);
+  EXPECT_DEATH(overlap(a, c), "");
+  delete c;
+}
+
+// Overlaps agree with the entries whichever of the tensors are
+// conjugate, and so stored transposed.
+TEST_F(ReduceTest,Overlap) {
+  TN_EXPECT_COMPLEX_EQ(expected_overlap(a, b), overlap(a, b));
+
+  Tensor *ac = new ConcreteTensor{a->matrix(true)},
+    *bc = new ConcreteTensor{b->matrix(true)};
+  // ac and bc are 1 -> 2 tensors; take them back to the shape of a
+  Tensor *acc = new ConcreteTensor{ac->matrix(true)},
+    *bcc = new ConcreteTensor{bc->matrix(true)};
+  TN_EXPECT_COMPLEX_EQ(expected_overlap(a, b), overlap(acc, bcc));
+  TN_EXPECT_COMPLEX_EQ(expected_overlap(a, b), overlap(a, bcc));
+  TN_EXPECT_COMPLEX_EQ(expected_overlap(a, b), overlap(acc, b));
+  TN_EXPECT_COMPLEX_EQ(std::norm(frobenius_norm(a)), overlap(a, a));
+
+  // against an implicit multiple of the identity
+  Tensor *id = new ConcreteTensor(2, 1, 3);
+  id->set_matrix(make_shared<ScaledIdentityMatrix>(9, 3,
+						   complex<double>(0, 2)));
+  complex<double> diagonal;
+  for(size_t i = 0; i < 3; ++i) diagonal += b->entry( {0,i}, {i} );
+  TN_EXPECT_COMPLEX_EQ(complex<double>(0, -2) * diagonal, overlap(id, b));
+  TN_EXPECT_COMPLEX_EQ(std::conj(complex<double>(0, -2) * diagonal),
+		       overlap(b, id));
+
+  delete id;
+  delete acc;
+  delete bcc;
+  delete ac;
+  delete bc;
+}
+
+// Sums are compensated, and do not depend on the number of threads.
+TEST(ReduceLargeTest,Compensated) {
+  const size_t n = 2 * kParallelReduction;
+  Tensor *x = new ConcreteTensor(0, 1, 0, n), *y = new ConcreteTensor(0, 1, 0, n);
+  std::shared_ptr<Matrix> mx = make_shared<GSLMatrix>(1, n),
+    my = make_shared<GSLMatrix>(1, n);
+  for(size_t i = 0; i < n; ++i)
+    {
+      mx->data()[i] = 1;
+      my->data()[i] = 1;
+    }
+  // terms which cancel, and would swamp the others in a naive sum
+  my->data()[0] = 1e16;
+  my->data()[n/2 + 1] = -1e16;
+  x->set_matrix(mx);
+  y->set_matrix(my);
+
+  const complex<double> one = overlap(x, y, 1), many = overlap(x, y, 4);
+  EXPECT_EQ(double(n - 2), one.real());
+  EXPECT_EQ(one, many);
+  EXPECT_EQ(frobenius_norm(y, 1), frobenius_norm(y, 4));
+  EXPECT_EQ(1e16, max_abs(y, 3));
+  delete x;
+  delete y;
+}
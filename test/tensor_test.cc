@@ -15,8 +15,11 @@
 // along with Tensor Network.  If not, see
 // <http://www.gnu.org/licenses/>.
 
+#include <atomic>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <thread>
+#include "../matrix.hh"
 #include "../tensor.hh"
 #include "../utils.hh"
 #include "mock_matrix.hh"
@@ -24,6 +27,7 @@
 #include "utils_test.hh"
 
 using std::complex;
+using std::make_shared;
 using std::shared_ptr;
 using std::vector;
 
@@ -59,6 +63,31 @@ TEST_F(TensorTest,EntryInitialState) {
   TN_EXPECT_COMPLEX_EQ(0, t->entry( {5,5}, {5,5,5} ) );
 }
 
+// A new tensor holds an identity which is stored only when written.
+TEST_F(TensorTest,LazyIdentity) {
+  complex<double> scale;
+  shared_ptr<Matrix> m = t->matrix().matrix;
+  ASSERT_TRUE(m->scaled_identity(scale));
+  TN_EXPECT_COMPLEX_EQ(1, scale);
+
+  // copies of an unwritten identity are themselves implicit
+  ConcreteTensor alias(t->matrix());
+  t->set_entry( {0,0}, {0,0,1}, 3 );
+  EXPECT_TRUE(alias.matrix().matrix->scaled_identity(scale));
+  EXPECT_FALSE(t->matrix().matrix->scaled_identity(scale));
+  TN_EXPECT_COMPLEX_EQ(3, t->entry( {0,0}, {0,0,1} ));
+  TN_EXPECT_COMPLEX_EQ(1, t->entry( {0,0}, {0,0,0} ));
+  TN_EXPECT_COMPLEX_EQ(0, alias.entry( {0,0}, {0,0,1} ));
+
+  // exposing the storage allocates it with the same entries
+  ScaledIdentityMatrix z{2, 3, complex<double>(0, 2)};
+  TN_EXPECT_COMPLEX_EQ(complex<double>(0, 2), z.get(1, 1));
+  complex<double> *d = z.data();
+  EXPECT_FALSE(z.scaled_identity(scale));
+  TN_EXPECT_COMPLEX_EQ(complex<double>(0, 2), d[1*3 + 1]);
+  TN_EXPECT_COMPLEX_EQ(0, d[1*3 + 2]);
+}
+
 TEST_F(TensorTest,EntryManipulations) {
   complex<double> c1{2.4, 2.6}, c2{3.14, 2.718};
   // test setting and retrieving values, exercizing both method signatures
@@ -191,19 +220,22 @@ TEST_F(TensorTest,Copying) {
   t->set_entry( {2,4}, {1,5,3}, c1 );
   t->set_entry( {0,3}, {5,2,4}, c2 );
 
-  // create a copy of t
+  // create a copy of t, which shares its storage until written
   Tensor *t0 = new ConcreteTensor{t->matrix()};
+  EXPECT_EQ(t->matrix().matrix, t0->matrix().matrix);
   // ensure entries exist in both copies
   TN_EXPECT_COMPLEX_EQ(c1, t->entry( {2,4}, {1,5,3} ));
   TN_EXPECT_COMPLEX_EQ(c1, t0->entry( {2,4}, {1,5,3} ));
 
-  // set entries in one tensor and ensure the other updates
-  t->set_entry( {0,3}, {5,2,4}, c2 );
+  // set entries in one tensor and ensure the other does not change
   t0->set_entry( {4,3}, {2,2,5}, c3 );
-  TN_EXPECT_COMPLEX_EQ(c2, t->entry( {0,3}, {5,2,4} ));
+  EXPECT_NE(t->matrix().matrix, t0->matrix().matrix);
+  t->set_entry( {0,3}, {5,2,4}, c3 );
+  TN_EXPECT_COMPLEX_EQ(c3, t->entry( {0,3}, {5,2,4} ));
   TN_EXPECT_COMPLEX_EQ(c2, t0->entry( {0,3}, {5,2,4} ));
-  TN_EXPECT_COMPLEX_EQ(c3, t->entry( {4,3}, {2,2,5} ));
+  TN_EXPECT_COMPLEX_EQ(0, t->entry( {4,3}, {2,2,5} ));
   TN_EXPECT_COMPLEX_EQ(c3, t0->entry( {4,3}, {2,2,5} ));
+  TN_EXPECT_COMPLEX_EQ(c1, t0->entry( {2,4}, {1,5,3} ));
   delete t0;
 }
 
@@ -218,19 +250,20 @@ TEST_F(TensorTest,Conjugate) {
   TN_EXPECT_COMPLEX_EQ(c1, t->entry( {2,4}, {1,5,3} ));
   TN_EXPECT_COMPLEX_EQ(conjugate(c1), tc->entry( {1,5,3}, {2,4} ));
 
-  // set entries in one tensor and ensure the other updates
+  // set entries in each tensor and ensure the other does not change
   t->set_entry( {2,0}, {1,0,3}, c2 );
   tc->set_entry( {2,1,5}, {3,1}, c3 );
   TN_EXPECT_COMPLEX_EQ(c2, t->entry( {2,0}, {1,0,3} ));
-  TN_EXPECT_COMPLEX_EQ(conjugate(c2), tc->entry( {1,0,3}, {2,0} ));
-  TN_EXPECT_COMPLEX_EQ(conjugate(c3), t->entry( {3,1}, {2,1,5} ));
+  TN_EXPECT_COMPLEX_EQ(0, tc->entry( {1,0,3}, {2,0} ));
+  TN_EXPECT_COMPLEX_EQ(0, t->entry( {3,1}, {2,1,5} ));
   TN_EXPECT_COMPLEX_EQ(c3, tc->entry( {2,1,5}, {3,1} ));
+  TN_EXPECT_COMPLEX_EQ(conjugate(c1), tc->entry( {1,5,3}, {2,4} ));
 
   // create a double-conjugate copy and ensure it is equivalent to the
-  // original
+  // tensor it was taken from
   Tensor *tcc = new ConcreteTensor{tc->matrix(true)};
-  TN_EXPECT_COMPLEX_EQ(t->entry( {3,1}, {2,1,5} ),
-		       tcc->entry( {3,1}, {2,1,5} ));
+  TN_EXPECT_COMPLEX_EQ(conjugate(c3), tcc->entry( {3,1}, {2,1,5} ));
+  TN_EXPECT_COMPLEX_EQ(c1, tcc->entry( {2,4}, {1,5,3} ));
 
   delete tc;
   delete tcc;
@@ -268,3 +301,125 @@ TEST_F(TensorTest,MatrixDeletion) {
   EXPECT_CALL(*mock, die());
   delete t1;
 }
+
+// test publishing matrices and versions
+TEST_F(TensorTest,SetMatrix) {
+  MatrixStruct before = t->matrix();
+  ConcreteTensor alias(before);
+  EXPECT_EQ(0, t->version());
+  t->set_entry({0,0}, {0,0,0}, 2);
+  EXPECT_EQ(1, t->version());
+
+  shared_ptr<Matrix> m = make_shared<GSLMatrix>(36, 216);
+  m->set(0, 0, 5);
+  t->set_matrix(m);
+  EXPECT_EQ(2, t->version());
+  EXPECT_EQ(m, t->matrix().matrix);
+  TN_EXPECT_COMPLEX_EQ(5, t->entry({0,0}, {0,0,0}));
+
+  // readers and tensors holding the old matrix still see it, and the
+  // write before that copied the shared storage
+  TN_EXPECT_COMPLEX_EQ(1, before.matrix->get(0, 0));
+  TN_EXPECT_COMPLEX_EQ(1, alias.entry({0,0}, {0,0,0}));
+  EXPECT_EQ(0, alias.version());
+}
+
+TEST_F(TensorDeathTest,SetMatrix) {
+  EXPECT_DEATH(t->set_matrix(make_shared<GSLMatrix>(6, 6)),
+	       "does not match the shape");
+}
+
+// test snapshots taken before a trial update
+TEST_F(TensorTest,Snapshot) {
+  Tensor *u = new ConcreteTensor(1, 1, 2);
+  vector<Tensor*> tensors{t, u};
+  vector<shared_ptr<Matrix>> s = snapshot(tensors);
+  EXPECT_EQ(t->matrix().matrix, s[0]);
+
+  t->set_entry({1,1}, {0,1,1}, 3);
+  shared_ptr<Matrix> m = make_shared<GSLMatrix>(2, 2);
+  m->set(0, 0, 4);
+  u->set_matrix(m);
+  TN_EXPECT_COMPLEX_EQ(1, s[0]->get(7, 7));
+  TN_EXPECT_COMPLEX_EQ(1, s[1]->get(0, 0));
+
+  restore(tensors, s);
+  TN_EXPECT_COMPLEX_EQ(1, t->entry({1,1}, {0,1,1}));
+  TN_EXPECT_COMPLEX_EQ(1, u->entry({0}, {0}));
+  // writing after a restore leaves the snapshot intact
+  u->set_entry({0}, {0}, 5);
+  TN_EXPECT_COMPLEX_EQ(1, s[1]->get(0, 0));
+  delete u;
+}
+
+// test readers against a thread publishing matrices
+TEST_F(TensorTest,ConcurrentReads) {
+  ConcreteTensor u(1, 1, 2);
+  u.set_matrix(make_shared<GSLMatrix>(2, 2));
+  std::fill(u.matrix().matrix->data(), u.matrix().matrix->data() + 4, 0.0);
+
+  std::atomic<bool> done{false};
+  std::atomic<size_t> torn{0};
+  vector<std::thread> readers;
+  for(int r = 0; r < 4; ++r)
+    readers.emplace_back([&]()
+			 {
+			   while(!done)
+			     {
+			       MatrixStruct m = u.matrix();
+			       const complex<double> *d = m.matrix->data();
+			       for(size_t i = 1; i < 4; ++i)
+				 if(d[i] != d[0]) ++torn;
+			       if(u.entry({1}, {0}).imag() != 0) ++torn;
+			     }
+			 });
+  for(int k = 1; k <= 1000; ++k)
+    {
+      shared_ptr<Matrix> m = make_shared<GSLMatrix>(2, 2);
+      std::fill(m->data(), m->data() + 4, complex<double>(k));
+      u.set_matrix(m);
+    }
+  done = true;
+  for(std::thread &r : readers) r.join();
+  EXPECT_EQ(0, torn);
+  EXPECT_EQ(1001, u.version());
+}
+
+#ifdef DEBUG
+// A matrix whose reads wait to be released, holding a read in progress.
+class GatedMatrix : public GSLMatrix
+{
+public:
+  GatedMatrix() : GSLMatrix(2, 2) {}
+  complex<double> get(size_t i, size_t j) override
+  {
+    entered = true;
+    while(!open) std::this_thread::yield();
+    return GSLMatrix::get(i, j);
+  }
+  std::atomic<bool> entered{false};
+  std::atomic<bool> open{false};
+};
+
+// test that overlapping accesses are reported in debug builds
+TEST_F(TensorTest,RaceHook) {
+  shared_ptr<GatedMatrix> gated = make_shared<GatedMatrix>();
+  ConcreteTensor u(MatrixStruct{1, 1, 2, 2, false, gated});
+  vector<TensorAccess> races;
+  RaceHook old = set_race_hook([&](Tensor *r, TensorAccess a)
+			       {
+				 EXPECT_EQ(&u, r);
+				 races.push_back(a);
+			       });
+  std::thread reader([&]() { u.entry({0}, {0}); });
+  while(!gated->entered) std::this_thread::yield();
+
+  // publishing alongside the read is allowed; writing in place is not
+  u.set_matrix(make_shared<GSLMatrix>(2, 2));
+  u.set_entry({0}, {0}, 1);
+  gated->open = true;
+  reader.join();
+  set_race_hook(old);
+  EXPECT_EQ(vector<TensorAccess>{TENSOR_WRITE}, races);
+}
+#endif // DEBUG